@@ -50,14 +50,26 @@ using namespace util;
 
 bool WinAPI::m_IsLoaded = false;
 
+AML_IMPLEMENT_WINAPI_FN(GetNumaHighestNodeNumber);
 AML_IMPLEMENT_WINAPI_FN(GetTickCount64);
+AML_IMPLEMENT_WINAPI_FN(VirtualAllocExNuma);
+AML_IMPLEMENT_WINAPI_FN(GetActiveProcessorGroupCount);
+AML_IMPLEMENT_WINAPI_FN(GetActiveProcessorCount);
+AML_IMPLEMENT_WINAPI_FN(SetThreadGroupAffinity);
+AML_IMPLEMENT_WINAPI_FN(GetNumaNodeProcessorMaskEx);
 
 //----------------------------------------------------------------------------------------------------------------------
 AML_NOINLINE void WinAPI::Load()
 {
 	if (HMODULE kernel32 = ::GetModuleHandleA("kernel32.dll"))
 	{
+		AML_LOAD_WINAPI_FN(kernel32, GetNumaHighestNodeNumber);
 		AML_LOAD_WINAPI_FN(kernel32, GetTickCount64);
+		AML_LOAD_WINAPI_FN(kernel32, VirtualAllocExNuma);
+		AML_LOAD_WINAPI_FN(kernel32, GetActiveProcessorGroupCount);
+		AML_LOAD_WINAPI_FN(kernel32, GetActiveProcessorCount);
+		AML_LOAD_WINAPI_FN(kernel32, SetThreadGroupAffinity);
+		AML_LOAD_WINAPI_FN(kernel32, GetNumaNodeProcessorMaskEx);
 	}
 
 	std::atomic_thread_fence(std::memory_order_release);
@@ -52,8 +52,20 @@ namespace util {
 
 namespace winapi {
 
+// Windows Server 2003 / Windows XP SP2
+using GetNumaHighestNodeNumberFn = BOOL(WINAPI*)(PULONG highestNodeNumber);
+
 // Windows Server 2008 / Windows Vista
 using GetTickCount64Fn = ULONGLONG(WINAPI*)();
+using VirtualAllocExNumaFn = LPVOID(WINAPI*)(HANDLE process, LPVOID address, SIZE_T size, DWORD allocationType,
+	DWORD protect, DWORD preferredNode);
+
+// Windows Server 2008 R2 / Windows 7 (типы GROUP_AFFINITY и др. объявлены в winnt.h независимо от _WIN32_WINNT)
+using GetActiveProcessorGroupCountFn = WORD(WINAPI*)();
+using GetActiveProcessorCountFn = DWORD(WINAPI*)(WORD groupNumber);
+using SetThreadGroupAffinityFn = BOOL(WINAPI*)(HANDLE thread, const GROUP_AFFINITY* groupAffinity,
+	PGROUP_AFFINITY previousGroupAffinity);
+using GetNumaNodeProcessorMaskExFn = BOOL(WINAPI*)(USHORT node, PGROUP_AFFINITY processorMask);
 
 } // namespace winapi
 
@@ -76,7 +88,13 @@ using GetTickCount64Fn = ULONGLONG(WINAPI*)();
 //----------------------------------------------------------------------------------------------------------------------
 struct WinAPI final
 {
+	AML_DECLARE_WINAPI_FN(GetNumaHighestNodeNumber)
 	AML_DECLARE_WINAPI_FN(GetTickCount64)
+	AML_DECLARE_WINAPI_FN(VirtualAllocExNuma)
+	AML_DECLARE_WINAPI_FN(GetActiveProcessorGroupCount)
+	AML_DECLARE_WINAPI_FN(GetActiveProcessorCount)
+	AML_DECLARE_WINAPI_FN(SetThreadGroupAffinity)
+	AML_DECLARE_WINAPI_FN(GetNumaNodeProcessorMaskEx)
 
 private:
 	static void Load();
@@ -108,11 +108,10 @@ unsigned DBFileIndex::GetLevel(const std::wstring& filePath)
 	{
 		bool fileOk = false;
 		uint64_t fileSize, fileTime;
-		const auto fullPath = m_Data.GetBasePath() + filePath;
 		// Первым делом пытаемся получить размер файла и дату/время его последней модификации.
 		// Если файл не существует, то функция вернёт false. И если размер файла не изменился,
 		// то сравниваем дату/время его последней модификации или вычисляем и проверяем CRC32
-		if (GetOSFileInfo(fullPath, fileSize, fileTime) && fileSize == pInfo->fileSize)
+		if (m_Data.GetChunkFileInfo(filePath, fileSize, fileTime) && fileSize == pInfo->fileSize)
 		{
 			// Если время последней модификации файла не изменилось (поле pInfo->fileTime будет
 			// больше 0, только если мы уже ранее проверили CRC32 файла), то считаем, что это
@@ -121,8 +120,8 @@ unsigned DBFileIndex::GetLevel(const std::wstring& filePath)
 				fileOk = true;
 			else
 			{
-				util::BinaryFile file;
-				if (file.Open(fullPath, util::FILE_OPEN_READ))
+				DBFile file;
+				if (m_Data.OpenChunkFile(filePath, file))
 				{
 					const long long fSize = file.GetSize();
 					if (fSize >= 0 && fSize == pInfo->fileSize)
@@ -165,10 +164,9 @@ bool DBFileIndex::SetLevel(const std::wstring& filePath, unsigned level, bool re
 		if (!remove)
 		{
 			uint64_t fileSize, fileTime;
-			const auto fullPath = m_Data.GetBasePath() + filePath;
 			// Получаем размер файла и дату/время его последней модификации. Если файл
 			// не существует, то функция вернёт false, а мы завершимся с ошибкой
-			if (!GetOSFileInfo(fullPath, fileSize, fileTime))
+			if (!m_Data.GetChunkFileInfo(filePath, fileSize, fileTime))
 				return false;
 
 			// Если размер файла корректен и время последней модификации не изменилось (поле pInfo->fileTime
@@ -178,8 +176,8 @@ bool DBFileIndex::SetLevel(const std::wstring& filePath, unsigned level, bool re
 				pInfo->isRemoved = false;
 			else
 			{
-				util::BinaryFile file;
-				if (file.Open(fullPath, util::FILE_OPEN_READ))
+				DBFile file;
+				if (m_Data.OpenChunkFile(filePath, file))
 				{
 					uint32_t fileCRC = 0;
 					const long long fSize = file.GetSize();
@@ -434,20 +432,6 @@ bool DBFileIndex::IsGreater(const char* pLhs, size_t lhsLen, const char* pRhs, s
 	return false;
 }
 
-//----------------------------------------------------------------------------------------------------------------------
-bool DBFileIndex::GetOSFileInfo(const std::wstring& filePath, uint64_t& fileSize, uint64_t& lastWriteTime)
-{
-	WIN32_FILE_ATTRIBUTE_DATA attrData;
-	if (::GetFileAttributesExW(filePath.c_str(), GetFileExInfoStandard, &attrData))
-	{
-		fileSize = (static_cast<uint64_t>(attrData.nFileSizeHigh) << 32) | attrData.nFileSizeLow;
-		lastWriteTime = (static_cast<uint64_t>(attrData.ftLastWriteTime.dwHighDateTime) << 32) |
-			attrData.ftLastWriteTime.dwLowDateTime;
-		return true;
-	}
-	return false;
-}
-
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   CheckDBMode
@@ -463,26 +447,15 @@ CheckDBMode::CheckDBMode()
 //----------------------------------------------------------------------------------------------------------------------
 bool CheckDBMode::Run()
 {
-	if (!m_Executed)
+	if (!m_Executed && CheckOptions({ "noremove" }))
 	{
-		// Команда "check" - многоуровневая проверка файлов базы данных. Опциональный
-		// параметр "--noremove" запрещает автоматическое удаление некорректных файлов
-		if (m_Params.size() >= 1 && m_Params.size() <= 2 && !util::StrInsCmp(m_Params[0], "check"))
+		// Команда "check" - многоуровневая проверка файлов базы данных. Необязательная
+		// опция "--noremove" запрещает автоматическое удаление некорректных файлов
+		if (m_Params.size() == 1 && !util::StrInsCmp(m_Params[0], "check"))
 		{
-			bool okToGo = true;
-			if (m_Params.size() == 2)
-			{
-				if (!util::StrInsCmp(m_Params[1], "--noremove"))
-					m_DontRemoveBroken = true;
-				else
-					okToGo = false;
-			}
-
-			if (okToGo)
-			{
-				m_Executed = true;
-				return CheckDataBase();
-			}
+			m_DontRemoveBroken = GetOption("noremove");
+			m_Executed = true;
+			return CheckDataBase();
 		}
 
 		OnInvalidCmdLine();
@@ -557,6 +530,7 @@ float CheckDBMode::CheckDBChunks(size_t totalChunkC)
 			// только на этих уровнях). Это важно для L6, так как иначе глубокий поиск попросту не будет
 			// выполняться из-за добавленых на L5 чисел Лишрел (которые на L5 не проверяются полностью)
 			m_LychThreads.Clear(false);
+			m_WideLychThreads.Clear(false);
 
 			uint32_t lastTick = 0;
 			size_t chunkC = 0, errorC = 0;
@@ -593,7 +567,7 @@ float CheckDBMode::CheckDBChunks(size_t totalChunkC)
 					{
 						++errorC;
 						if (!m_DontRemoveBroken)
-							util::FileSystem::RemoveFile(m_Data.GetBasePath() + filePath);
+							m_Data.RemoveChunkFile(filePath);
 					}
 
 					if (!m_IsCancelled)
@@ -643,7 +617,10 @@ bool CheckDBMode::CheckDBChunk(DBChunk* pChunk, unsigned level)
 
 	if (pChunk && level)
 	{
-		if (!pChunk->LoadData(m_Data, DBChunkState::FULLDATA))
+		// Уровень L1 проверяет, что файл целиком загружается кодом БД. Файлы, прошедшие эту проверку, на
+		// следующих уровнях не загружаются в DBChunk полностью: их числа перебираются объектом m_Numbers
+		const auto stateNeeded = (level > 1) ? DBChunkState::WITHSTATS : DBChunkState::FULLDATA;
+		if (!pChunk->LoadData(m_Data, stateNeeded) || (level > 1 && !pChunk->GetNumbers(m_Data, m_Numbers)))
 			return OnError(pChunk, 1, "File structure is broken");
 
 		switch (level)
@@ -668,6 +645,9 @@ bool CheckDBMode::CheckDBChunk(DBChunk* pChunk, unsigned level)
 				break;
 		}
 
+		if (isCorrect && m_Numbers.HasError())
+			isCorrect = OnError(pChunk, level, "Incorrect number in DataBlock");
+		m_Numbers.Clear();
 		pChunk->UnloadData(DBChunkState::DATAUNLOADED);
 	}
 
@@ -744,7 +724,7 @@ bool CheckDBMode::CheckLevel2(DBChunk* pChunk)
 	unsigned counterA[Const::MAX_STEP + 1];
 	AML_FILLA(counterA, 0, Const::MAX_STEP + 1);
 
-	for (const auto& item : pChunk->GetNumbers())
+	for (const auto& item : m_Numbers)
 	{
 		if (!item.step || item.step > Const::MAX_STEP)
 			return OnError(pChunk, level, "Incorrect step value in DataBlock");
@@ -770,11 +750,10 @@ bool CheckDBMode::CheckLevel3(DBChunk* pChunk)
 	constexpr unsigned level = 3;
 
 	BigNumber num;
-	const auto& numbers = pChunk->GetNumbers();
-
 	if (pChunk->GetFormatVer() <= 3)
 	{
-		pChunk->SortNumbers();
+		// Файлы старых форматов загружены до FULLDATA (см. DBChunk::GetNumbers), а их числа уже отсортированы
+		const auto& numbers = pChunk->GetNumbers();
 		const size_t numberC = numbers.size();
 		for (size_t i = 1; i < numberC; ++i)
 		{
@@ -789,7 +768,7 @@ bool CheckDBMode::CheckLevel3(DBChunk* pChunk)
 	}
 
 	Number allSavedPalC;
-	for (const auto& item : numbers)
+	for (const auto& item : m_Numbers)
 	{
 		num = item.num;
 		unsigned doneC = 0;
@@ -877,18 +856,16 @@ bool CheckDBMode::CheckLevel5Or6(DBChunk* pChunk, unsigned level)
 			lowestStep = steps.GetSearchLimit(last) + 1;
 	}
 
-	size_t conseqLen = 20;
-	if (last.GetLength() + 4 > conseqLen)
-		conseqLen = std::min(last.GetLength() + 4, Const::MAX_DIGIT_C);
+	const size_t conseqLen = GetSiftLength(last.GetLength());
+	const bool isWideSift = conseqLen > FixNumber::MAX_LENGTH;
 
 	BigNumber num, cur;
 	uint64_t iterationC = 0;
 	uint64_t palindromeC = 0;
 	Number allLychrelC, cnum;
 
-	pChunk->SortNumbers();
-	const auto& numbers = pChunk->GetNumbers();
-	auto nextPalindrome = numbers.cbegin();
+	// Числа блока данных перебираются по возрастанию (см. DBNumberView)
+	auto nextPalindrome = m_Numbers.begin();
 
 	for (num = pChunk->GetFirst();; ++num)
 	{
@@ -904,7 +881,7 @@ bool CheckDBMode::CheckLevel5Or6(DBChunk* pChunk, unsigned level)
 			++palindromeC;
 			if (totalDoneC >= lowestStep)
 			{
-				if (nextPalindrome == numbers.end() || num != nextPalindrome->num)
+				if (nextPalindrome == m_Numbers.end() || num != nextPalindrome->num)
 				{
 					return OnError(pChunk, level, util::Format("Missing palindrome detected: [%u] %s",
 						totalDoneC, SeparateWithCommas(num).c_str()));
@@ -914,12 +891,12 @@ bool CheckDBMode::CheckLevel5Or6(DBChunk* pChunk, unsigned level)
 		}
 		// Случай 2: число не стало палиндромом, попытаемся его отсеять,
 		// то есть проверим, не является ли оно числом Лишрел
-		else if (m_LychThreads.Exists(cur))
+		else if (isWideSift ? m_WideLychThreads.Exists(cur) : m_LychThreads.Exists(cur))
 			allLychrelC += 1 + num.GetKinNumberCount();
 		else
 		{
 			// Случай 3: num - найденный палиндром из блока данных
-			if (nextPalindrome != numbers.end() && num == nextPalindrome->num)
+			if (nextPalindrome != m_Numbers.end() && num == nextPalindrome->num)
 			{
 				++palindromeC;
 				++nextPalindrome;
@@ -946,7 +923,10 @@ bool CheckDBMode::CheckLevel5Or6(DBChunk* pChunk, unsigned level)
 						}
 					}
 					allLychrelC += 1 + num.GetKinNumberCount();
-					m_LychThreads.Insert(cnum);
+					if (isWideSift)
+						m_WideLychThreads.Insert(cnum);
+					else
+						m_LychThreads.Insert(cnum);
 				}
 			}
 		}
@@ -970,7 +950,7 @@ bool CheckDBMode::CheckLevel5Or6(DBChunk* pChunk, unsigned level)
 	if (pChunk->GetAllLychrelC() != allLychrelC && pChunk->GetFormatVer() > 3)
 		return OnError(pChunk, level, "Incorrect Header:ALYCH value");
 
-	if (nextPalindrome != numbers.end())
+	if (nextPalindrome != m_Numbers.end())
 	{
 		return OnError(pChunk, level, util::Format("Incorrect palindrome found in DataBlock: [%u] %s",
 			nextPalindrome->step, SeparateWithCommas(nextPalindrome->num).c_str()));
@@ -72,7 +72,6 @@ private:
 	static bool AToCRC(uint32_t& out, const char* pData);
 	static bool AToInt(unsigned& out, const char* pNum, size_t len);
 	static bool IsGreater(const char* pLhs, size_t lhsLen, const char* pRhs, size_t rhsLen);
-	static bool GetOSFileInfo(const std::wstring& filePath, uint64_t& fileSize, uint64_t& lastWriteTime);
 
 	DataBase& m_Data;
 	FileIndex m_Index;
@@ -111,6 +110,8 @@ private:
 
 	DBFileIndex m_Index;
 	NumberSet m_LychThreads;
+	WideNumberSet m_WideLychThreads;	// Набор отсева для длины отсева больше 30 цифр (см. GetSiftLength)
+	DBNumberView m_Numbers;				// Числа блока данных проверяемого файла (на уровнях L2-L6)
 
 	bool m_Executed = false;			// true, если функция Run была вызвана
 	bool m_IsCancelled = false;			// true, если пользователь отменил операцию
@@ -0,0 +1,452 @@
+﻿//∙MDPN
+#include "pch.h"
+#include "codec.h"
+
+#include "util.h"
+
+#include <core/array.h>
+#include <core/file.h>
+#include <core/strutil.h>
+#include <zlib/zlib.h>
+
+#if MDPN_EXTRA_CODECS
+	#include <lz4/lz4.h>
+	#include <lz4/lz4hc.h>
+	#include <zstd/zdict.h>
+	#include <zstd/zstd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   DataCodec
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+struct CodecInfo
+{
+	const char* pName;		// Имя алгоритма в заголовке файла БД
+	int minLevel;			// Минимальный уровень сжатия
+	int maxLevel;			// Максимальный уровень сжатия (используется при максимальном сжатии)
+	int defaultLevel;		// Уровень сжатия по умолчанию
+};
+
+// Уровень deflate по умолчанию тот же, что и до 7-й версии формата. Уровни zstd и LZ4 по умолчанию - предварительные:
+// их нужно проверить на двоичных блоках данных реальной БД командой "codecs". Уровни LZ4 выше 2 соответствуют LZ4HC
+static constexpr CodecInfo s_CodecInfo[] = {
+	{ "DEFLATE", 1, 9, 5 },
+	{ "ZSTD", 1, 19, 3 },
+	{ "LZ4", 1, 12, 1 }
+};
+static_assert(util::CountOf(s_CodecInfo) == static_cast<size_t>(CodecId::COUNT), "Invalid size of s_CodecInfo");
+
+// Максимальный размер блока данных, который сжимается за один вызов (значение LZ4_MAX_INPUT_SIZE)
+static constexpr size_t MAX_BLOCK_SIZE = 0x7e000000;
+
+#if MDPN_EXTRA_CODECS
+	static_assert(s_CodecInfo[static_cast<size_t>(CodecId::LZ4)].maxLevel == LZ4HC_CLEVEL_MAX, "Invalid LZ4 level");
+	static_assert(MAX_BLOCK_SIZE == LZ4_MAX_INPUT_SIZE, "Invalid MAX_BLOCK_SIZE");
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+struct DataCodec::Dictionary
+{
+	std::vector<uint8_t> data;				// Содержимое словаря
+	uint32_t id = 0;						// ID словаря (часть его содержимого)
+#if MDPN_EXTRA_CODECS
+	ZSTD_DDict* pDDict = nullptr;			// Словарь, подготовленный для распаковки
+	ZSTD_CDict* pCDictA[2] = {};			// Словари, подготовленные для обычного и максимального сжатия
+#endif
+
+	~Dictionary();
+	void FreeCDicts();
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+DataCodec::Dictionary::~Dictionary()
+{
+	FreeCDicts();
+#if MDPN_EXTRA_CODECS
+	if (pDDict)
+		::ZSTD_freeDDict(pDDict);
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DataCodec::Dictionary::FreeCDicts()
+{
+#if MDPN_EXTRA_CODECS
+	for (auto& pCDict : pCDictA)
+	{
+		if (pCDict)
+			::ZSTD_freeCDict(pCDict);
+		pCDict = nullptr;
+	}
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+DataCodec::DataCodec()
+{
+	Set(CodecId::DEFLATE);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+DataCodec::~DataCodec()
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataCodec::Set(const std::string& spec)
+{
+	CodecId id;
+	const size_t pos = spec.find(':');
+	const size_t nameLen = (pos != std::string::npos) ? pos : spec.size();
+	if (!FindId(id, spec.c_str(), nameLen) || !IsAvailable(id))
+		return false;
+
+	int level = 0;
+	if (pos != std::string::npos)
+	{
+		const char* pLevel = spec.c_str() + pos + 1;
+		if (!IsNumber(pLevel) || spec.size() - pos > 3)
+			return false;
+
+		const CodecInfo& info = s_CodecInfo[static_cast<size_t>(id)];
+		level = atoi(pLevel);
+		if (level < info.minLevel || level > info.maxLevel)
+			return false;
+	}
+
+	Set(id, level);
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DataCodec::Set(CodecId id, int level)
+{
+	const size_t index = static_cast<size_t>(id);
+	const CodecInfo& info = s_CodecInfo[(index < util::CountOf(s_CodecInfo)) ? index : 0];
+
+	m_Id = (index < util::CountOf(s_CodecInfo)) ? id : CodecId::DEFLATE;
+	m_Level = level ? util::Clamp(level, info.minLevel, info.maxLevel) : info.defaultLevel;
+	PrepareDictionary();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+int DataCodec::GetLevel(bool maxCompression) const
+{
+	const CodecInfo& info = s_CodecInfo[static_cast<size_t>(m_Id)];
+	return maxCompression ? info.maxLevel : m_Level;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::string DataCodec::GetName(bool maxCompression) const
+{
+	std::string name = util::Format("%s:%i", GetName(m_Id), GetLevel(maxCompression));
+	for (char& c : name)
+		c = (c >= 'A' && c <= 'Z') ? c + 32 : c;
+	return name;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+const char* DataCodec::GetName(CodecId id)
+{
+	const size_t index = static_cast<size_t>(id);
+	return (index < util::CountOf(s_CodecInfo)) ? s_CodecInfo[index].pName : nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataCodec::FindId(CodecId& out, const char* pName, size_t len)
+{
+	for (size_t i = 0; i < util::CountOf(s_CodecInfo); ++i)
+	{
+		const char* pCodecName = s_CodecInfo[i].pName;
+		if (strlen(pCodecName) == len && !util::StrNInsCmp(pName, pCodecName, len))
+		{
+			out = static_cast<CodecId>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataCodec::IsAvailable(CodecId id)
+{
+	return id == CodecId::DEFLATE || (MDPN_EXTRA_CODECS && id < CodecId::COUNT);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataCodec::LoadDictionary(const std::wstring& path, bool makeCurrent)
+{
+	// Словарь zstd обычно имеет размер порядка 100 KiB; словари больше 16 MiB считаем некорректными
+	constexpr long long MAX_DICT_SIZE = 16 << 20;
+
+	util::BinaryFile file;
+	if (!file.Open(path, util::FILE_OPEN_READ))
+		return false;
+
+	const long long size = file.GetSize();
+	if (size <= 0 || size > MAX_DICT_SIZE)
+		return false;
+
+	std::vector<uint8_t> data(static_cast<size_t>(size));
+	return file.Read(data.data(), data.size()) && AddDictionary(data.data(), data.size(), makeCurrent);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+#if MDPN_EXTRA_CODECS
+bool DataCodec::AddDictionary(const void* pData, size_t size, bool makeCurrent)
+{
+	// У словаря, созданного функцией TrainDictionary, ID всегда отличен от 0. Если ID равен 0, то это либо
+	// не словарь zstd, либо словарь без заголовка (просто данные), который нельзя однозначно идентифицировать
+	const uint32_t dictId = ::ZSTD_getDictID_fromDict(pData, size);
+	if (!dictId)
+		return false;
+
+	Dictionary* pDict = const_cast<Dictionary*>(FindDictionary(dictId));
+	if (!pDict)
+	{
+		auto dict = std::make_unique<Dictionary>();
+		const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+		dict->data.assign(pBytes, pBytes + size);
+		dict->id = dictId;
+		dict->pDDict = ::ZSTD_createDDict(dict->data.data(), size);
+		if (!dict->pDDict)
+			return false;
+
+		pDict = dict.get();
+		m_Dicts.push_back(std::move(dict));
+	}
+
+	if (makeCurrent)
+	{
+		if (m_pCurrentDict)
+			m_pCurrentDict->FreeCDicts();
+		m_pCurrentDict = pDict;
+		PrepareDictionary();
+	}
+	return true;
+}
+#else
+bool DataCodec::AddDictionary(const void*, size_t, bool)
+{
+	// Словари используются только алгоритмом zstd
+	return false;
+}
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataCodec::HasDictionary(uint32_t dictId) const
+{
+	return FindDictionary(dictId) != nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t DataCodec::GetDictId() const
+{
+	return m_pCurrentDict ? m_pCurrentDict->id : 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::wstring DataCodec::GetDictFileName(uint32_t dictId)
+{
+	return util::Format(L"zstd-%08X.dict", dictId);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataCodec::Compress(util::File& src, util::File& dst, bool maxCompression) const
+{
+	const long long position = src.GetPosition();
+	const long long fileSize = src.GetSize();
+	if (position < 0 || fileSize < position || fileSize - position > static_cast<long long>(MAX_BLOCK_SIZE))
+		return false;
+
+	// Блок данных файла БД невелик (около 1 MiB), поэтому он сжимается за один вызов целиком
+	const size_t size = static_cast<size_t>(fileSize - position);
+	util::DynamicArray<uint8_t> data(size + 1);
+	std::vector<uint8_t> packedData;
+
+	return (!size || src.Read(data, size)) && Compress(data, size, packedData, maxCompression) &&
+		dst.Write(packedData.data(), packedData.size());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataCodec::Compress(const void* pSrc, size_t srcSize, std::vector<uint8_t>& out, bool maxCompression) const
+{
+	const int level = GetLevel(maxCompression);
+	if (srcSize > MAX_BLOCK_SIZE)
+		return false;
+
+	switch (m_Id)
+	{
+		case CodecId::DEFLATE:
+		{
+			// Параметры совпадают с параметрами функции CompressFile (без заголовка zlib)
+			z_stream stream;
+			memset(&stream, 0, sizeof(stream));
+			if (::deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+				return false;
+
+			out.resize(::deflateBound(&stream, static_cast<uLong>(srcSize)));
+			stream.next_in = static_cast<Bytef*>(const_cast<void*>(pSrc));
+			stream.avail_in = static_cast<unsigned>(srcSize);
+			stream.next_out = out.data();
+			stream.avail_out = static_cast<unsigned>(out.size());
+			const bool ok = ::deflate(&stream, Z_FINISH) == Z_STREAM_END;
+			out.resize(ok ? stream.total_out : 0);
+			::deflateEnd(&stream);
+			return ok;
+		}
+#if MDPN_EXTRA_CODECS
+		case CodecId::ZSTD:
+		{
+			std::unique_ptr<ZSTD_CCtx, decltype(&::ZSTD_freeCCtx)> ctx(::ZSTD_createCCtx(), ::ZSTD_freeCCtx);
+			if (!ctx)
+				return false;
+
+			out.resize(::ZSTD_compressBound(srcSize));
+			const ZSTD_CDict* pCDict = m_pCurrentDict ? m_pCurrentDict->pCDictA[maxCompression ? 1 : 0] : nullptr;
+			const size_t size = pCDict ?
+				::ZSTD_compress_usingCDict(ctx.get(), out.data(), out.size(), pSrc, srcSize, pCDict) :
+				::ZSTD_compressCCtx(ctx.get(), out.data(), out.size(), pSrc, srcSize, level);
+			out.resize(::ZSTD_isError(size) ? 0 : size);
+			return !out.empty();
+		}
+		case CodecId::LZ4:
+		{
+			// Уровни ниже LZ4HC_CLEVEL_MIN соответствуют быстрому алгоритму LZ4, остальные - LZ4HC
+			const int bufferSize = ::LZ4_compressBound(static_cast<int>(srcSize));
+			out.resize(bufferSize);
+			const char* pData = static_cast<const char*>(pSrc);
+			char* pBuffer = reinterpret_cast<char*>(out.data());
+			const int size = (level < LZ4HC_CLEVEL_MIN) ?
+				::LZ4_compress_default(pData, pBuffer, static_cast<int>(srcSize), bufferSize) :
+				::LZ4_compress_HC(pData, pBuffer, static_cast<int>(srcSize), bufferSize, level);
+			out.resize((size > 0) ? size : 0);
+			return !out.empty();
+		}
+#endif
+		default:
+			break;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataCodec::Decompress(CodecId id, uint32_t dictId, const void* pSrc, size_t srcSize,
+	void* pDst, size_t dstSize) const
+{
+	if (dictId && id != CodecId::ZSTD)
+		return false;
+
+	switch (id)
+	{
+		case CodecId::DEFLATE:
+		{
+			z_stream stream;
+			memset(&stream, 0, sizeof(stream));
+			if (srcSize > UINT_MAX || dstSize > UINT_MAX || ::inflateInit2(&stream, -15) != Z_OK)
+				return false;
+
+			stream.next_in = static_cast<Bytef*>(const_cast<void*>(pSrc));
+			stream.avail_in = static_cast<unsigned>(srcSize);
+			stream.next_out = static_cast<Bytef*>(pDst);
+			stream.avail_out = static_cast<unsigned>(dstSize);
+			const int res = ::inflate(&stream, Z_FINISH);
+			const bool ok = res == Z_STREAM_END && stream.total_out == dstSize;
+			::inflateEnd(&stream);
+			return ok;
+		}
+#if MDPN_EXTRA_CODECS
+		case CodecId::ZSTD:
+		{
+			const Dictionary* pDict = dictId ? FindDictionary(dictId) : nullptr;
+			if (dictId && !pDict)
+				return false;
+
+			std::unique_ptr<ZSTD_DCtx, decltype(&::ZSTD_freeDCtx)> ctx(::ZSTD_createDCtx(), ::ZSTD_freeDCtx);
+			if (!ctx)
+				return false;
+
+			const size_t res = pDict ?
+				::ZSTD_decompress_usingDDict(ctx.get(), pDst, dstSize, pSrc, srcSize, pDict->pDDict) :
+				::ZSTD_decompressDCtx(ctx.get(), pDst, dstSize, pSrc, srcSize);
+			return !::ZSTD_isError(res) && res == dstSize;
+		}
+		case CodecId::LZ4:
+		{
+			if (srcSize > LZ4_MAX_INPUT_SIZE || dstSize > LZ4_MAX_INPUT_SIZE)
+				return false;
+
+			const int res = ::LZ4_decompress_safe(static_cast<const char*>(pSrc), static_cast<char*>(pDst),
+				static_cast<int>(srcSize), static_cast<int>(dstSize));
+			return res >= 0 && static_cast<size_t>(res) == dstSize;
+		}
+#endif
+		default:
+			break;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+#if MDPN_EXTRA_CODECS
+bool DataCodec::TrainDictionary(const std::vector<uint8_t>& samples, const std::vector<size_t>& sampleSizes,
+	size_t dictSize, std::vector<uint8_t>& dict)
+{
+	dict.clear();
+	if (sampleSizes.empty() || !dictSize)
+		return false;
+
+	dict.resize(dictSize);
+	const size_t size = ::ZDICT_trainFromBuffer(dict.data(), dictSize, samples.data(), sampleSizes.data(),
+		static_cast<unsigned>(sampleSizes.size()));
+	if (::ZDICT_isError(size))
+	{
+		dict.clear();
+		return false;
+	}
+
+	dict.resize(size);
+	return true;
+}
+#else
+bool DataCodec::TrainDictionary(const std::vector<uint8_t>&, const std::vector<size_t>&, size_t,
+	std::vector<uint8_t>& dict)
+{
+	dict.clear();
+	return false;
+}
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+void DataCodec::PrepareDictionary()
+{
+	if (!m_pCurrentDict)
+		return;
+
+	// Подготовка словаря для сжатия (особенно с максимальным уровнем) занимает заметное время, поэтому
+	// выполняется один раз при смене словаря или уровня сжатия. Для других алгоритмов словарь не нужен
+	m_pCurrentDict->FreeCDicts();
+#if MDPN_EXTRA_CODECS
+	if (m_Id == CodecId::ZSTD)
+	{
+		const std::vector<uint8_t>& data = m_pCurrentDict->data;
+		for (size_t i = 0; i < 2; ++i)
+			m_pCurrentDict->pCDictA[i] = ::ZSTD_createCDict(data.data(), data.size(), GetLevel(i > 0));
+	}
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+const DataCodec::Dictionary* DataCodec::FindDictionary(uint32_t dictId) const
+{
+	for (auto& dict : m_Dicts)
+	{
+		if (dict->id == dictId)
+			return dict.get();
+	}
+	return nullptr;
+}
@@ -0,0 +1,114 @@
+﻿//∙MDPN
+#pragma once
+
+#include <core/forward.h>
+#include <core/platform.h>
+#include <core/util.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   DataCodec - алгоритм сжатия блока данных файлов БД
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Идентификатор алгоритма сжатия сохраняется в заголовке файла БД (поле CODEC). Файлы, в заголовке которых нет
+// этого поля, сжаты алгоритмом deflate. Алгоритм zstd может использовать словарь, общий для всей БД: он хранится в
+// директории БД (файл DICT_FILE_NAME), а его ID сохраняется в заголовке файла (поле DICT). Словарь может уменьшить
+// размер небольших файлов, которые формируются во время поиска; выигрыш от него следует проверять командой "codecs"
+
+// Алгоритмы zstd и LZ4 собираются, только если макрос MDPN_EXTRA_CODECS равен 1 (свойство MdpnExtraCodecs проекта
+// palindrome.vcxproj): их библиотек пока нет в submodule extern. Без них доступен только алгоритм deflate, а файлы
+// БД, сжатые другими алгоритмами, прочитать нельзя. Алгоритм по умолчанию - deflate; другие выбираются явно
+#ifndef MDPN_EXTRA_CODECS
+	#define MDPN_EXTRA_CODECS 0
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+enum class CodecId : uint8_t {
+	DEFLATE = 0,	// zlib deflate без заголовка zlib
+	ZSTD,			// Zstandard (опционально со словарём)
+	LZ4,			// LZ4 (при уровне сжатия выше 2 - LZ4HC): самая быстрая распаковка
+	COUNT
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+class DataCodec final
+{
+	AML_NONCOPYABLE(DataCodec)
+
+public:
+	// Имя файла текущего словаря zstd в директории БД. Словари, которые были заменены новыми (см. функцию
+	// GetDictFileName), сохраняются рядом, пока файлы, сжатые с их использованием, не будут пересохранены
+	static constexpr const wchar_t* DICT_FILE_NAME = L"zstd.dict";
+	// Размер словаря, создаваемого функцией TrainDictionary по умолчанию
+	static constexpr size_t DEFAULT_DICT_SIZE = 112 * 1024;
+
+	// Создаёт объект для алгоритма deflate с уровнем сжатия по умолчанию
+	DataCodec();
+	~DataCodec();
+
+	// Задаёт алгоритм и уровень сжатия строкой вида "имя[:уровень]", где имя - "deflate", "zstd" или "lz4". Если
+	// уровень не указан, то используется уровень по умолчанию. Если строка некорректна или алгоритм недоступен
+	// (см. IsAvailable), то функция вернёт false
+	bool Set(const std::string& spec);
+	// Задаёт алгоритм и уровень сжатия. Значение level, равное 0, соответствует уровню по умолчанию
+	void Set(CodecId id, int level = 0);
+
+	CodecId GetId() const { return m_Id; }
+	// Возвращает уровень сжатия: обычный или максимальный (для алгоритма GetId())
+	int GetLevel(bool maxCompression = false) const;
+	// Возвращает имя алгоритма с уровнем сжатия (например, "zstd:3")
+	std::string GetName(bool maxCompression = false) const;
+
+	// Возвращает имя алгоритма в заголовке файла БД или nullptr, если id некорректен
+	static const char* GetName(CodecId id);
+	// Находит алгоритм по имени (без учёта регистра букв). Возвращает false, если имя неизвестно
+	static bool FindId(CodecId& out, const char* pName, size_t len);
+	// Возвращает true, если алгоритм id собран в программе (см. MDPN_EXTRA_CODECS)
+	static bool IsAvailable(CodecId id);
+
+	// Загружает словарь zstd из файла. Если параметр makeCurrent равен true, то словарь становится текущим, то
+	// есть используется при сжатии; иначе - только для распаковки. Возвращает false, если словарь некорректен
+	bool LoadDictionary(const std::wstring& path, bool makeCurrent = true);
+	// То же, что и LoadDictionary, но словарь задаётся массивом pData размером size байт
+	bool AddDictionary(const void* pData, size_t size, bool makeCurrent = true);
+	// Возвращает true, если словарь с указанным ID загружен
+	bool HasDictionary(uint32_t dictId) const;
+	// Возвращает ID текущего словаря или 0, если его нет
+	uint32_t GetDictId() const;
+	// Возвращает ID словаря, который используется при сжатии: ID текущего словаря для алгоритма zstd, иначе 0
+	uint32_t GetUsedDictId() const { return (m_Id == CodecId::ZSTD) ? GetDictId() : 0; }
+	// Возвращает имя файла, под которым хранится заменённый словарь с указанным ID
+	static std::wstring GetDictFileName(uint32_t dictId);
+
+	// Сжимает данные из файла src (начиная с текущей позиции до конца файла) и сохраняет их в файл dst, начиная с
+	// текущей позиции. Если maxCompression равен true, то используется максимальный уровень сжатия алгоритма
+	bool Compress(util::File& src, util::File& dst, bool maxCompression = false) const;
+	// Сжимает srcSize байт из pSrc, заменяя содержимое out сжатыми данными
+	bool Compress(const void* pSrc, size_t srcSize, std::vector<uint8_t>& out, bool maxCompression = false) const;
+	// Разжимает srcSize байт из pSrc в pDst. Параметры id и dictId - алгоритм и ID словаря, с которыми данные были
+	// сжаты. Функция вернёт false, если данные повреждены, словарь не загружен или размер данных не равен dstSize
+	bool Decompress(CodecId id, uint32_t dictId, const void* pSrc, size_t srcSize, void* pDst, size_t dstSize) const;
+
+	// Создаёт словарь zstd размером не более dictSize байт по образцам данных. Все образцы записаны подряд в массив
+	// samples, а их размеры - в массив sampleSizes. При ошибке (например, слишком мало данных или алгоритм zstd
+	// недоступен) вернёт false
+	static bool TrainDictionary(const std::vector<uint8_t>& samples, const std::vector<size_t>& sampleSizes,
+		size_t dictSize, std::vector<uint8_t>& dict);
+
+private:
+	struct Dictionary;
+
+	// Подготавливает текущий словарь для сжатия с текущими уровнями
+	void PrepareDictionary();
+	const Dictionary* FindDictionary(uint32_t dictId) const;
+
+	CodecId m_Id = CodecId::DEFLATE;
+	int m_Level = 0;										// Обычный уровень сжатия
+	std::vector<std::unique_ptr<Dictionary>> m_Dicts;		// Все загруженные словари
+	Dictionary* m_pCurrentDict = nullptr;					// Текущий словарь (элемент m_Dicts) или nullptr
+};
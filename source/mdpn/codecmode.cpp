@@ -0,0 +1,282 @@
+﻿//∙MDPN
+#include "pch.h"
+#include "codecmode.h"
+
+#include "codec.h"
+#include "dbase.h"
+#include "dbchunk.h"
+#include "log.h"
+#include "util.h"
+
+#include <core/array.h>
+#include <core/auxutil.h>
+#include <core/console.h>
+#include <core/file.h>
+#include <core/filesystem.h>
+#include <core/strutil.h>
+#include <core/util.h>
+#include <core/winapi.h>
+
+#include <chrono>
+
+//----------------------------------------------------------------------------------------------------------------------
+bool CodecMode::Run()
+{
+	// Команда "codecs" - сравнение алгоритмов сжатия на блоках данных файлов БД. Опция "--codec=имя[:уровень]"
+	// ограничивает сравнение одним алгоритмом. Опция "--train-dict[=KiB]" вместо сравнения создаёт словарь zstd
+	if (!CheckOptions({ "codec", "train-dict" }))
+		return false;
+	if (GetOption("train-dict") && !DataCodec::IsAvailable(CodecId::ZSTD))
+	{
+		aux::Printc("#12Error: #7zstd is not supported by this build\n");
+		return false;
+	}
+	if (m_Params.size() != 1)
+	{
+		OnInvalidCmdLine();
+		return false;
+	}
+	if (!ParseCodecOption())
+		return false;
+
+	std::string value;
+	size_t dictSize = 0;
+	if (GetOption("train-dict", &value))
+	{
+		dictSize = DataCodec::DEFAULT_DICT_SIZE;
+		if (!value.empty())
+		{
+			const unsigned long sizeInKiB = (IsNumber(value.c_str()) && value.size() <= 4) ?
+				strtoul(value.c_str(), nullptr, 10) : 0;
+			if (sizeInKiB < 1 || sizeInKiB > 1024)
+			{
+				OnInvalidCmdLine();
+				return false;
+			}
+			dictSize = sizeInKiB * 1024;
+		}
+	}
+
+	if (!m_Data.Init(false, DBChunkState::HEADERONLY))
+	{
+		aux::Print("Database not found, exiting...\n");
+		return false;
+	}
+
+	SystemLog::SetPath(m_Data.GetBasePath() + L"log.txt");
+	PrintDatabasePath(m_Data.GetBasePath(), 46);
+
+	const bool result = dictSize ? TrainDictionary(dictSize) : RunBenchmark();
+	SystemLog::Instance().Close();
+	return result;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool CodecMode::LoadSamples(Samples& samples, size_t sizeLimit)
+{
+	uint64_t totalSize = 0;
+	m_Data.ForEachChunk([&](DBChunk* pChunk) {
+		if (pChunk->GetFormatVer() >= DBChunkData::BINARY_FORMAT_VERSION)
+			totalSize += pChunk->GetDataSize();
+		return 0;
+	});
+
+	// Если данных больше, чем sizeLimit, то загружаем только каждый step-й файл
+	const uint64_t step = std::max<uint64_t>((totalSize + sizeLimit - 1) / sizeLimit, 1);
+	samples.data.reserve(static_cast<size_t>(std::min<uint64_t>(totalSize, sizeLimit)));
+
+	size_t chunkC = 0;
+	uint32_t lastTick = 0;
+	int retCode = m_Data.ForEachChunk([&](DBChunk* pChunk) {
+		if (pChunk->GetFormatVer() < DBChunkData::BINARY_FORMAT_VERSION || !pChunk->GetDataSize() ||
+			(chunkC++ % step))
+			return 0;
+		if (samples.data.size() + pChunk->GetDataSize() > sizeLimit)
+			return 0;
+
+		const uint32_t tick = ::GetTickCount();
+		if (tick - lastTick > 250)
+		{
+			lastTick = tick;
+			aux::Printf("\rLoading data blocks: %.1f%%...", 100.f * samples.data.size() /
+				std::max<uint64_t>(std::min<uint64_t>(totalSize, sizeLimit), 1));
+			if (util::SystemConsole::Instance().IsCtrlCPressed())
+			{
+				aux::Printc("\b\b\b, #12cancelled...\n");
+				return -1;
+			}
+		}
+		return LoadDataBlock(pChunk, samples) ? 0 : -1;
+	});
+
+	if (retCode < 0)
+		return false;
+
+	aux::Printf("\rLoaded %u data blocks (%s) of %u files\n", samples.sizes.size(),
+		FormatSize(samples.data.size()).c_str(), m_Data.GetChunkC());
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool CodecMode::LoadDataBlock(DBChunk* pChunk, Samples& samples)
+{
+	// Блок данных расположен в конце файла: сразу за заголовком и блоком статистики
+	const unsigned dataSize = pChunk->GetDataSize();
+	const unsigned cDataSize = pChunk->GetCDataSize();
+	const long long offset = static_cast<long long>(pChunk->GetFileSize()) - cDataSize;
+
+	DBFile file;
+	util::DynamicArray<uint8_t> packedData(cDataSize + 1);
+	const size_t position = samples.data.size();
+	samples.data.resize(position + dataSize);
+
+	if (!m_Data.OpenChunkFile(pChunk->GetFilePath(), file) || !file.SetPosition(offset) ||
+		!file.Read(packedData, cDataSize) || !m_Data.GetCodec().Decompress(pChunk->GetCodec(),
+		pChunk->GetDictId(), packedData, cDataSize, &samples.data[position], dataSize))
+	{
+		aux::Printf("\n#12Error: #7failed to load data block of file #15#%s\n",
+			util::ToAnsi(pChunk->GetFilePath()).c_str());
+		samples.data.resize(position);
+		return false;
+	}
+
+	samples.sizes.push_back(dataSize);
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool CodecMode::RunBenchmark()
+{
+	// Данных для сравнения достаточно и 256 MiB: если блоков данных в БД больше, то они выбираются равномерно
+	constexpr size_t SIZE_LIMIT = 256 << 20;
+
+	Samples samples;
+	if (!LoadSamples(samples, SIZE_LIMIT))
+		return false;
+	if (samples.sizes.empty())
+	{
+		aux::Printc("No binary data blocks to compress. Use #14update --compress#7 to convert database files\n");
+		return true;
+	}
+
+	// Алгоритмы, которые не собраны в программе (см. MDPN_EXTRA_CODECS), пропускаются
+	static const char* const codecA[] = {
+		"deflate:1", "deflate:5", "deflate:9", "zstd:1", "zstd:3", "zstd:9", "zstd:19", "lz4:1", "lz4:9", "lz4:12"
+	};
+
+	DataCodec& codec = m_Data.GetCodec();
+	std::vector<std::string> specA;
+	if (GetOption("codec"))
+		specA.push_back(codec.GetName());
+	else
+		specA.assign(std::begin(codecA), std::end(codecA));
+
+	const uint32_t dictId = codec.GetDictId();
+	if (dictId)
+		aux::Printf("zstd uses dictionary #15#%08X#7 from the database folder\n", dictId);
+
+	using Clock = std::chrono::steady_clock;
+	const size_t totalSize = samples.data.size();
+	std::vector<uint8_t> packedData, data(*std::max_element(samples.sizes.begin(), samples.sizes.end()));
+
+	aux::Print("Codec        Compressed     Ratio   Compression   Decompression\n");
+	for (const auto& spec : specA)
+	{
+		if (!codec.Set(spec))
+			continue;
+
+		uint64_t packedSize = 0;
+		Clock::duration compressTime{}, decompressTime{};
+		const uint8_t* pData = samples.data.data();
+		for (size_t size : samples.sizes)
+		{
+			auto t0 = Clock::now();
+			if (!codec.Compress(pData, size, packedData))
+			{
+				aux::Printf("#12Error: #7failed to compress data with %s\n", spec.c_str());
+				return false;
+			}
+			auto t1 = Clock::now();
+			if (!codec.Decompress(codec.GetId(), codec.GetUsedDictId(), packedData.data(), packedData.size(),
+				data.data(), size) || memcmp(data.data(), pData, size))
+			{
+				aux::Printf("#12Error: #7failed to decompress data with %s\n", spec.c_str());
+				return false;
+			}
+			decompressTime += Clock::now() - t1;
+			compressTime += t1 - t0;
+			packedSize += packedData.size();
+			pData += size;
+
+			if (util::SystemConsole::Instance().IsCtrlCPressed())
+			{
+				aux::Printc("#12Cancelled...\n");
+				return true;
+			}
+		}
+
+		const double totalMiB = totalSize / 1048576.;
+		const double compressSec = std::max(std::chrono::duration<double>(compressTime).count(), 1e-6);
+		const double decompressSec = std::max(std::chrono::duration<double>(decompressTime).count(), 1e-6);
+		aux::Printf("%-12s %10s   %7.3f   %7.1f MiB/s   %7.1f MiB/s\n", codec.GetName().c_str(),
+			FormatSize(packedSize).c_str(), static_cast<double>(totalSize) / std::max<uint64_t>(packedSize, 1),
+			totalMiB / compressSec, totalMiB / decompressSec);
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool CodecMode::TrainDictionary(size_t dictSize)
+{
+	// Для обучения словаря zstd рекомендуется около 100 байт данных на каждый байт словаря. Блоки данных
+	// делятся на фрагменты размером до SAMPLE_SIZE байт (примерно как небольшие файлы, создаваемые при поиске)
+	constexpr size_t SAMPLE_SIZE = 64 * 1024;
+
+	Samples samples;
+	if (!LoadSamples(samples, 100 * dictSize))
+		return false;
+
+	std::vector<size_t> sampleSizes;
+	for (size_t size : samples.sizes)
+	{
+		for (size_t pieceSize; size; size -= pieceSize)
+		{
+			pieceSize = std::min(size, SAMPLE_SIZE);
+			sampleSizes.push_back(pieceSize);
+		}
+	}
+
+	std::vector<uint8_t> dict;
+	aux::Print("Training dictionary...\n");
+	if (!DataCodec::TrainDictionary(samples.data, sampleSizes, dictSize, dict))
+	{
+		aux::Printc("#12Error: #7failed to train dictionary (not enough data?)\n");
+		return false;
+	}
+
+	// Текущий словарь сохраняем под именем с его ID: он нужен для распаковки файлов, сжатых с ним
+	DataCodec& codec = m_Data.GetCodec();
+	const std::wstring path = m_Data.GetBasePath() + DataCodec::DICT_FILE_NAME;
+	if (const uint32_t oldDictId = codec.GetDictId())
+	{
+		const std::wstring oldPath = m_Data.GetBasePath() + DataCodec::GetDictFileName(oldDictId);
+		if (!util::FileSystem::FileExists(oldPath) && !util::FileSystem::Rename(path, oldPath))
+		{
+			aux::Printc("#12Error: #7failed to rename current dictionary\n");
+			return false;
+		}
+	}
+
+	util::BinaryFile file;
+	if (!codec.AddDictionary(dict.data(), dict.size()) ||
+		!file.Open(path, util::FILE_CREATE_ALWAYS | util::FILE_OPEN_WRITE) || !file.Write(dict.data(), dict.size()))
+	{
+		aux::Printc("#12Error: #7failed to save dictionary\n");
+		return false;
+	}
+	file.Close();
+
+	aux::Printf("Dictionary #15#%08X#7 (%s) has been saved. Use '#14update --compress --codec=zstd#7' "
+		"to recompress the database\n", codec.GetDictId(), FormatSize(dict.size()).c_str());
+	return true;
+}
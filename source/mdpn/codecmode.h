@@ -0,0 +1,42 @@
+﻿//∙MDPN
+#pragma once
+
+#include "dbmode.h"
+
+#include <core/platform.h>
+
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   CodecMode - сравнение алгоритмов сжатия и создание словаря zstd (режим работы программы)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class CodecMode final : public DBMode
+{
+public:
+	virtual bool Run() override;
+
+private:
+	// Несжатые блоки данных файлов БД, записанные подряд, и их размеры
+	struct Samples {
+		std::vector<uint8_t> data;
+		std::vector<size_t> sizes;
+	};
+
+	// Загружает несжатые блоки данных файлов БД суммарным размером не более sizeLimit байт. Если данных в
+	// БД больше, то файлы выбираются равномерно по всей БД. Файлы старых версий формата (с текстовым блоком
+	// данных) пропускаются. В случае ошибки выводит сообщение и возвращает false
+	bool LoadSamples(Samples& samples, size_t sizeLimit);
+	bool LoadDataBlock(DBChunk* pChunk, Samples& samples);
+
+	// Сжимает и распаковывает загруженные блоки данных каждым алгоритмом (или только алгоритмом, заданным
+	// опцией "--codec") и выводит таблицу: размер сжатых данных, степень сжатия и скорость сжатия/распаковки
+	bool RunBenchmark();
+	// Создаёт по блокам данных файлов БД словарь zstd размером dictSize байт и сохраняет его в директорию БД
+	// как текущий. Предыдущий текущий словарь переименовывается (см. DataCodec::GetDictFileName)
+	bool TrainDictionary(size_t dictSize);
+};
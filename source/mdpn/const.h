@@ -9,7 +9,8 @@ struct Const
 {
 	// Максимально возможная длина (количество цифр) отложенного палиндрома. Текущее значение в 30 цифр
 	// обусловлено тем, что для 31-значного диапазона чисел 64-битных счётчиков прогресса (количества
-	// проверенных кандидатов) и количества первичных чисел Лишрел уже будет недостаточно
+	// проверенных кандидатов) и количества первичных чисел Лишрел уже будет недостаточно. Длина чисел
+	// набора отсева (длина отсева) этим значением не ограничена, см. функцию GetSiftLength
 	static constexpr size_t MAX_DIGIT_C = 30;
 
 	// Максимальное количество шагов для отложенного палиндрома. Это ограничение влияет только
@@ -28,4 +29,8 @@ struct Const
 	// Ограничение по времени (в ms) на накопление данных для текущего активного файла. При
 	// достижении этой отметки накопленные данные сохраняются независимо от их количества
 	static constexpr unsigned DATA_SAVE_INTERVAL = 15 * 60 * 1000;
+
+	// Минимальный интервал (в ms) между сохранениями снимка набора отсева в файл БД. Снимок также
+	// сохраняется при завершении поиска и загружается при его продолжении, см. SearchMode::SaveSiftSet
+	static constexpr unsigned SIFT_SAVE_INTERVAL = 60 * 60 * 1000;
 };
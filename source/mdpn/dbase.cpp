@@ -2,7 +2,10 @@
 #include "pch.h"
 #include "dbase.h"
 
+#include "util.h"
+
 #include <core/exception.h>
+#include <core/file.h>
 #include <core/filesystem.h>
 #include <core/strutil.h>
 #include <core/toggle.h>
@@ -33,7 +36,9 @@ bool DataBase::Init(bool createNewDb, DBChunkState dataState, const std::wstring
 	if (!FindBasePath(path) && !(createNewDb && util::FileSystem::MakeDirectory(m_BasePath, true)))
 		return false;
 
+	LoadDictionary();
 	auto fileList = m_Structure.Reload("Scanning database: %.1f%%...");
+	LoadPackIndex(fileList);
 
 	if (fileList.empty() || createNewDb)
 		m_IsInitialized = fileList.empty() && createNewDb;
@@ -52,11 +57,22 @@ bool DataBase::Init(bool createNewDb, DBChunkState dataState, const std::wstring
 		RearrangeInvalidFiles(fileList, "Rearranging files: %.1f%%...");
 		m_Structure.WipeUnusedFolders();
 
+		// Кэш заголовков загружается после того, как невалидные файлы получили постоянные пути. При
+		// безопасной инициализации кэш не используется: в режиме проверки БД читаются сами файлы
+		if (!m_SafeInitMode)
+			m_HeaderCache.Load(m_BasePath);
+
 		LoadFileHeaders(fileList, "Loading headers: %1.f%%...");
 		fileList.clear();
 
 		dataState = util::Clamp(dataState, DBChunkState::DATAUNLOADED, DBChunkState::WITHSTATS);
 		LoadStatistics(dataState, "Loading statistics: %1.f%%...");
+		m_Pack.ReleaseIndexData();
+
+		// Кэш не обязателен: если его не удастся сохранить, то при следующей инициализации файлы будут прочитаны
+		if (!m_SafeInitMode)
+			m_HeaderCache.Save();
+		m_HeaderCache.Clear();
 
 		//::SetThreadPriority(::GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
 		//::SetPriorityClass(::GetCurrentProcess(), PROCESS_MODE_BACKGROUND_END);
@@ -161,11 +177,26 @@ void DataBase::Save(const Number& last, unsigned minSavedStep, unsigned timeSpen
 			m_Last = last;
 	}
 
+	// Файл из сегмента сохраняется как отдельный файл. Сначала в него копируется образ из сегмента (поэтому
+	// можно сохранить только заголовок), а запись в сегменте удаляется только после успешного сохранения
+	const auto filePath = m_pActiveChunk->GetFilePath();
+	const bool isPacked = m_Pack.Contains(filePath) && m_pActiveChunk->IsSaveNeeded(m_Codec, maxCompression);
+	if (isPacked && !ExtractPackedFile(filePath))
+		throw util::ERuntime("Failed to unpack database file");
+
 	if (!m_pActiveChunk->Save(*this, minSavedStep, timeSpent, maxCompression))
 	{
-		util::FileSystem::RemoveFile(m_BasePath + m_pActiveChunk->GetFilePath());
+		util::FileSystem::RemoveFile(m_BasePath + filePath);
 		throw util::ERuntime("Failed to save database file");
 	}
+	UpdateFormatVer(m_pActiveChunk);
+
+	if (isPacked)
+	{
+		if (!m_Pack.Remove(filePath))
+			throw util::ERuntime("Failed to update database segment");
+		m_Structure.OnFileMoved(filePath, false);
+	}
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -190,17 +221,147 @@ bool DataBase::RemoveChunk(DBChunk* pChunk)
 		EE::Assert(m_pActiveChunk != pChunk, "Can't remove active chunk");
 
 		const auto filePath = pChunk->GetFilePath();
+		const bool isPacked = m_Pack.Contains(filePath);
 		m_Chunks.Remove(pChunk);
 
-		if (!filePath.empty() && util::FileSystem::RemoveFile(m_BasePath + filePath))
+		if (!filePath.empty() && RemoveChunkFile(filePath))
 		{
-			m_Structure.OnFileRemoved(filePath);
+			m_Structure.OnFileRemoved(filePath, isPacked);
 			return true;
 		}
 	}
 	return false;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool DataBase::OpenChunkFile(const std::wstring& filePath, DBFile& file, DBChunkState stateNeeded)
+{
+	EE::Assert(m_IsInitialized || m_IsInitializing, "Database not initialized");
+
+	if (m_Pack.Contains(filePath))
+		return m_Pack.Open(filePath, file, stateNeeded <= DBChunkState::WITHSTATS);
+	if (stateNeeded <= DBChunkState::WITHSTATS && m_HeaderCache.Open(filePath, file))
+		return true;
+	return file.Open(m_BasePath + filePath);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataBase::MapChunkFile(const std::wstring& filePath, DBFile& file)
+{
+	EE::Assert(m_IsInitialized || m_IsInitializing, "Database not initialized");
+
+	if (m_Pack.Contains(filePath))
+		return m_Pack.Open(filePath, file);
+	return file.Map(m_BasePath + filePath);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataBase::GetChunkFileInfo(const std::wstring& filePath, uint64_t& fileSize, uint64_t& fileTime) const
+{
+	EE::Assert(m_IsInitialized || m_IsInitializing, "Database not initialized");
+
+	if (m_Pack.Contains(filePath))
+		return m_Pack.GetFileInfo(filePath, fileSize, fileTime);
+	return ::GetFileInfo(m_BasePath + filePath, fileSize, fileTime);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataBase::RemoveChunkFile(const std::wstring& filePath)
+{
+	EE::Assert(m_IsInitialized, "Database not initialized");
+
+	if (m_Pack.Contains(filePath))
+		return m_Pack.Remove(filePath);
+	return util::FileSystem::RemoveFile(m_BasePath + filePath);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataBase::PackChunks(DBProgress onProgress)
+{
+	EE::Assert(m_IsInitialized, "Database not initialized");
+	EE::Assert(!m_pActiveChunk || m_pActiveChunk->GetSaveState() == DBChunkState::UNCHANGED, "Not saved changes");
+
+	// Список файлов для записи составляется заранее: при записи новых сегментов доля удалённых образов в прежних
+	// сегментах растёт, но переписываются только файлы из сегментов, которые были разреженными изначально
+	std::vector<DBChunk*> chunks;
+	m_Chunks.ForEach([&](DBChunk* pChunk) {
+		const auto filePath = pChunk->GetFilePath();
+		if (!filePath.empty() && (!m_Pack.Contains(filePath) || m_Pack.IsInSparseSegment(filePath)))
+			chunks.push_back(pChunk);
+		return 0;
+	});
+
+	bool ok = true;
+	std::vector<uint8_t> image;
+	std::vector<std::wstring> movedFiles;
+	for (size_t i = 0; ok && i < chunks.size(); ++i)
+	{
+		if (!(i & 0x3f) && onProgress)
+			onProgress(100.f * i / chunks.size());
+
+		// Образ файла - заголовок, блок статистики и блок данных (без возможного "мусора" за блоком данных).
+		// Образ из сегмента сначала проверяется, чтобы повреждённые данные не были перенесены в новый сегмент
+		DBChunk* pChunk = chunks[i];
+		const auto filePath = pChunk->GetFilePath();
+		const bool isPacked = m_Pack.Contains(filePath);
+		const size_t size = pChunk->GetFileSize();
+		const size_t prefixSize = size - pChunk->GetCDataSize();
+		image.resize(size);
+
+		DBFile file;
+		ok = (!isPacked || m_Pack.CheckFile(filePath)) && OpenChunkFile(filePath, file) &&
+			file.Read(image.data(), size);
+		file.Close();
+
+		if (ok && !m_Pack.IsWriting())
+			ok = m_Pack.BeginSegment();
+		if (ok && !m_Pack.AddFile(filePath, image.data(), size, prefixSize))
+		{
+			// Сегмент достиг предельного размера: завершаем его и записываем образ в следующий
+			ok = m_Pack.GetNewFileC() && EndPackSegment(movedFiles) && m_Pack.BeginSegment() &&
+				m_Pack.AddFile(filePath, image.data(), size, prefixSize);
+		}
+		if (ok && !isPacked)
+			movedFiles.push_back(filePath);
+	}
+
+	if (ok && m_Pack.GetNewFileC())
+		ok = EndPackSegment(movedFiles);
+	m_Pack.CancelSegment();
+
+	ok = m_Pack.RemoveDeadSegments() && ok;
+	m_Structure.WipeUnusedFolders();
+	return ok;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataBase::UnpackChunks(DBProgress onProgress)
+{
+	EE::Assert(m_IsInitialized, "Database not initialized");
+
+	std::vector<std::wstring> files;
+	m_Chunks.ForEach([&](DBChunk* pChunk) {
+		auto filePath = pChunk->GetFilePath();
+		if (m_Pack.Contains(filePath))
+			files.push_back(std::move(filePath));
+		return 0;
+	});
+
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (!(i & 0x3f) && onProgress)
+			onProgress(100.f * i / files.size());
+
+		if (!ExtractPackedFile(files[i]))
+			return false;
+		m_Structure.OnFileMoved(files[i], false);
+	}
+
+	// Все образы скопированы в отдельные файлы: удаляем сегменты и журнал удалений. Если удаление будет
+	// прервано, то при следующей инициализации БД отдельные файлы всё равно получат приоритет над сегментами
+	return m_Pack.RemoveDeadSegments(true);
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 bool DataBase::FindBasePath(const std::wstring& path)
 {
@@ -251,6 +412,39 @@ void DataBase::RearrangeInvalidFiles(std::vector<std::wstring>& dbFiles, DBProgr
 	}
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+void DataBase::LoadDictionary()
+{
+	const std::wstring path = m_BasePath + DataCodec::DICT_FILE_NAME;
+	if (util::FileSystem::FileExists(path) && !m_Codec.LoadDictionary(path))
+		throw util::ERuntime("Failed to load compression dictionary");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DataBase::LoadPackIndex(std::vector<std::wstring>& dbFiles)
+{
+	std::vector<std::wstring> packedFiles;
+	if (!m_Pack.Load(m_BasePath, packedFiles) && !m_SafeInitMode)
+		throw util::ERuntime("Failed to load database segment");
+
+	// Запись в сегменте, для которой есть отдельный файл с тем же путём, остаётся, если сохранение файла
+	// из сегмента было прервано. Отдельный файл новее, поэтому такая запись удаляется из сегмента
+	for (const auto& filePath : dbFiles)
+	{
+		if (m_Pack.Contains(filePath) && !m_Pack.Remove(filePath))
+			throw util::ERuntime("Failed to update database segment");
+	}
+
+	for (auto& filePath : packedFiles)
+	{
+		if (m_Pack.Contains(filePath))
+		{
+			m_Structure.AddPackedFile(filePath);
+			dbFiles.push_back(std::move(filePath));
+		}
+	}
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void DataBase::LoadFileHeaders(std::vector<std::wstring>& dbFiles, DBProgress onProgress)
 {
@@ -272,11 +466,36 @@ void DataBase::LoadFileHeaders(std::vector<std::wstring>& dbFiles, DBProgress on
 			if (!m_SafeInitMode)
 				throw util::ERuntime("Failed to load database file");
 		}
-		else if (m_Last < pChunk->GetLast())
-			m_Last = pChunk->GetLast();
+		else
+		{
+			// Без словаря (или без алгоритма сжатия, см. MDPN_EXTRA_CODECS) файл не может быть распакован, но сам
+			// файл при этом не повреждён. Поэтому исключение генерируется даже в режиме безопасной загрузки,
+			// чтобы файл не был удалён
+			if (!DataCodec::IsAvailable(pChunk->GetCodec()))
+			{
+				throw util::ERuntime(util::Format("Compression algorithm %s is not supported by this build",
+					DataCodec::GetName(pChunk->GetCodec())));
+			}
+			const uint32_t dictId = pChunk->GetDictId();
+			if (dictId && !m_Codec.HasDictionary(dictId) &&
+				!m_Codec.LoadDictionary(m_BasePath + DataCodec::GetDictFileName(dictId), false))
+			{
+				throw util::ERuntime(util::Format("Compression dictionary %08X not found", dictId));
+			}
+			if (m_Last < pChunk->GetLast())
+				m_Last = pChunk->GetLast();
+			UpdateFormatVer(pChunk);
+		}
 	}
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+void DataBase::UpdateFormatVer(const DBChunk* pChunk)
+{
+	const unsigned formatVer = std::min(pChunk->GetFormatVer(), DBChunkData::BINARY_FORMAT_VERSION);
+	m_FormatVer = std::max(m_FormatVer, formatVer);
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void DataBase::LoadStatistics(DBChunkState dataState, DBProgress onProgress)
 {
@@ -337,7 +556,62 @@ void DataBase::LoadStatistics(DBChunkState dataState, DBProgress onProgress)
 					++lowestStep;
 			}
 		}
+
+		// Заголовок и блок статистики файла, прочитанные не из кэша, добавляются в кэш. Файлы из сегментов не
+		// кэшируются: их копии и так хранятся в индексах сегментов
+		if (!m_SafeInitMode && pChunk->GetDataState() >= DBChunkState::HEADERONLY)
+		{
+			const auto filePath = pChunk->GetFilePath();
+			if (!m_Pack.Contains(filePath) && !m_HeaderCache.IsValid(filePath))
+				m_HeaderCache.Add(filePath, pChunk->GetFileSize() - pChunk->GetCDataSize());
+		}
 		pChunk->UnloadData(dataState);
 		return 0;
 	});
 }
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataBase::ExtractPackedFile(const std::wstring& filePath)
+{
+	// Образ сначала записывается во временный файл: отдельный файл имеет приоритет над записью в сегменте
+	// (см. LoadPackIndex), поэтому неполный отдельный файл не должен появиться даже при сбое во время записи
+	DBFile image;
+	if (!m_Pack.CheckFile(filePath) || !m_Pack.Open(filePath, image))
+		return false;
+
+	const std::wstring folderPath = m_BasePath + filePath.substr(0, 2);
+	if (!util::FileSystem::DirectoryExists(folderPath) && !util::FileSystem::MakeDirectory(folderPath))
+		return false;
+
+	const std::wstring path = m_BasePath + filePath;
+	const std::wstring tmpPath = path + L".tmp";
+
+	util::BinaryFile file;
+	bool ok = file.Open(tmpPath, util::FILE_CREATE_ALWAYS | util::FILE_OPEN_WRITE) &&
+		file.Write(image.GetData(), static_cast<size_t>(image.GetSize())) && file.Flush();
+	file.Close();
+
+	if (ok && util::FileSystem::Rename(tmpPath, path))
+		return true;
+
+	util::FileSystem::RemoveFile(tmpPath);
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DataBase::EndPackSegment(std::vector<std::wstring>& movedFiles)
+{
+	if (!m_Pack.EndSegment())
+		return false;
+
+	// Отдельные файлы удаляются только после того, как сегмент с их образами сохранён. Если файл удалить не
+	// удастся, то при следующей инициализации БД он получит приоритет, а его запись в сегменте будет удалена
+	for (const auto& filePath : movedFiles)
+	{
+		if (!util::FileSystem::RemoveFile(m_BasePath + filePath))
+			return false;
+		m_Structure.OnFileMoved(filePath, true);
+	}
+	movedFiles.clear();
+	return true;
+}
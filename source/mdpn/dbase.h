@@ -2,9 +2,12 @@
 #pragma once
 
 #include "assert.h"
+#include "codec.h"
 #include "const.h"
+#include "dbcache.h"
 #include "dbchunk.h"
 #include "dbchunklist.h"
+#include "dbpack.h"
 #include "dbprogress.h"
 #include "dbstruct.h"
 #include "number.h"
@@ -49,6 +52,15 @@ public:
 	// Возвращает полный путь к директории БД. Всегда оканчивается слешем
 	const std::wstring& GetBasePath() const;
 
+	// Возвращает алгоритм сжатия, используемый при сохранении файлов БД. Словари zstd, с которыми сжаты
+	// файлы БД, загружаются при инициализации БД; текущий словарь (если есть) используется для сжатия
+	const DataCodec& GetCodec() const { return m_Codec; }
+	DataCodec& GetCodec() { return m_Codec; }
+	// Возвращает версию формата, в которой сохраняются новые файлы БД: наибольшую версию среди файлов БД (не
+	// выше DBChunkData::BINARY_FORMAT_VERSION и не ниже BASE_FORMAT_VERSION). То есть новые файлы сохраняются
+	// в двоичном формате, только если файлы БД уже переведены в него (например, командой "update --compress")
+	unsigned GetFormatVer() const { return m_FormatVer; }
+
 	unsigned GetHighestStep() const { return m_HighestStep; }
 	bool HasFound(unsigned step) const { return step <= Const::MAX_STEP && m_FoundStepA[step]; }
 	// Возвращает количество первичных чисел Лишрел для указанного диапазона, отмеченных в БД
@@ -94,6 +106,31 @@ public:
 	// Уничтожает объект pChunk и удаляет соответствующий ему файл
 	bool RemoveChunk(DBChunk* pChunk);
 
+	// Открывает файл БД filePath (отдельный файл или его образ в сегменте, см. DBPack) только для чтения. Параметр
+	// stateNeeded задаёт уровень, до которого из файла будут загружены данные: при инициализации БД заголовок и блок
+	// статистики файла из сегмента читаются из копии в индексе сегмента, а отдельного файла - из кэша заголовков
+	// (см. DBHeaderCache), если файл не изменился. Функция MapChunkFile отображает файл в память (см.
+	// DBFile::GetData). Файлы из сегментов в память отображены всегда, поэтому их образы не копируются
+	bool OpenChunkFile(const std::wstring& filePath, DBFile& file, DBChunkState stateNeeded = DBChunkState::FULLDATA);
+	bool MapChunkFile(const std::wstring& filePath, DBFile& file);
+	// Возвращает размер файла БД и время его последней модификации. Для файла из сегмента возвращается
+	// размер его образа и время модификации сегмента (сегмент после создания не изменяется)
+	bool GetChunkFileInfo(const std::wstring& filePath, uint64_t& fileSize, uint64_t& fileTime) const;
+	// Удаляет файл БД filePath (или его образ из сегмента), не меняя список файлов. В отличие от RemoveChunk,
+	// объект DBChunk остаётся в БД, поэтому функция может вызываться во время перебора файлов (ForEachChunk)
+	bool RemoveChunkFile(const std::wstring& filePath);
+
+	// Возвращает true, если файл filePath хранится в сегменте
+	bool IsPacked(const std::wstring& filePath) const { return m_Pack.Contains(filePath); }
+	// Возвращает количество сегментов и количество хранящихся в них файлов
+	size_t GetSegmentC() const { return m_Pack.GetSegmentC(); }
+	size_t GetPackedChunkC() const { return m_Pack.GetFileC(); }
+	// Переносит отдельные файлы БД в новые сегменты в порядке возрастания их интервалов. Файлы из сегментов,
+	// значительную часть которых занимают удалённые образы, также переписываются, а сами сегменты удаляются
+	bool PackChunks(DBProgress onProgress = nullptr);
+	// Переносит все файлы из сегментов в отдельные файлы (в папки БД) и удаляет сегменты
+	bool UnpackChunks(DBProgress onProgress = nullptr);
+
 private:
 	// По аналогии с обработкой ошибок в классе DBChunk, EE::Assert и EE::Verify
 	// в DataBase используются для контроля корректности использования класса БД
@@ -104,21 +141,36 @@ private:
 	bool FindBasePath(const std::wstring& path);
 	// Перемещает (и переименовывает) все невалидные файлы в dbFiles так, чтобы они стали валидными
 	void RearrangeInvalidFiles(std::vector<std::wstring>& dbFiles, DBProgress onProgress = nullptr);
+	// Загружает текущий словарь zstd из директории БД (если он есть)
+	void LoadDictionary();
+	// Загружает индексы сегментов и добавляет в dbFiles пути хранящихся в них файлов (см. DBPack)
+	void LoadPackIndex(std::vector<std::wstring>& dbFiles);
 	// Загружает заголовки файлов БД, инициализирует список файлов m_Chunk и значение m_Last
 	void LoadFileHeaders(std::vector<std::wstring>& dbFiles, DBProgress onProgress = nullptr);
+	// Повышает версию формата новых файлов m_FormatVer до версии формата файла pChunk (см. GetFormatVer)
+	void UpdateFormatVer(const DBChunk* pChunk);
 	// Загружает статистику файлов БД, инициализирует остальные поля класса. Параметр dataState
 	// задаёт уровень, до которого данные будут выгружены из памяти после завершения загрузки
 	void LoadStatistics(DBChunkState dataState, DBProgress onProgress = nullptr);
 
+	// Копирует образ файла filePath из сегмента в отдельный файл. Запись в сегменте при этом не удаляется
+	bool ExtractPackedFile(const std::wstring& filePath);
+	// Завершает запись нового сегмента и удаляет отдельные файлы movedFiles, образы которых в него записаны
+	bool EndPackSegment(std::vector<std::wstring>& movedFiles);
+
 	std::wstring m_BasePath;
 	DBStructure m_Structure;
+	DBPack m_Pack;
+	DBHeaderCache m_HeaderCache;
 	DBChunkList m_Chunks;
+	DataCodec m_Codec;
 
 	bool m_IsInitialized = false;
 	bool m_IsInitializing = false;
 	bool m_SafeInitMode = false;
 
 	bool m_HasGaps = false;				// true, если в диапазоне числа m_Last есть непроверенные числа до m_Last
+	unsigned m_FormatVer = DBChunkData::BASE_FORMAT_VERSION;	// Версия формата новых файлов БД
 	unsigned m_HighestStep = 0;			// Наибольший шаг среди всех найденных отложенных палиндромов в БД
 	bool* m_FoundStepA = nullptr;		// Флаги наличия в БД хотя бы 1 числа для каждого шага
 	uint64_t* m_PrimLychA = nullptr;	// Кол-во первичных чисел Лишрел для каждого диапазона
@@ -0,0 +1,283 @@
+﻿//∙MDPN
+#include "pch.h"
+#include "dbcache.h"
+
+#include "codec.h"
+#include "dbpack.h"
+#include "dbstruct.h"
+#include "util.h"
+
+#include <core/crc32.h>
+#include <core/file.h>
+#include <core/filesystem.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   DBHeaderCache
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Файл кэша: заголовок CacheHeader, за ним сжатые данные - записи CacheRecord всех файлов,
+// а за ними копии заголовков и блоков статистики этих файлов в том же порядке
+
+//----------------------------------------------------------------------------------------------------------------------
+struct CacheHeader
+{
+	static constexpr uint8_t VERSION = 1;
+
+	char magic[4];				// Сигнатура "MDPC"
+	uint8_t version;			// Версия формата кэша (VERSION)
+	uint8_t codec;				// Алгоритм сжатия данных (CodecId, без словаря)
+	uint8_t reserved[2];		// Не используется (всегда 0)
+	uint32_t recordC;			// Количество записей
+	uint32_t dataSize;			// Размер несжатых данных
+	uint32_t cDataSize;			// Размер сжатых данных
+	uint32_t dataCRC;			// CRC32 несжатых данных
+};
+
+static_assert(sizeof(CacheHeader) == 24, "Invalid CacheHeader size");
+
+//----------------------------------------------------------------------------------------------------------------------
+struct CacheRecord
+{
+	char path[20];				// Путь к файлу БД (DBStructure::PATH_LEN символов, дополненный нулями)
+	uint32_t prefixSize;		// Размер копии заголовка и блока статистики
+	uint64_t fileSize;			// Размер файла
+	uint64_t fileTime;			// Время последней модификации файла
+	uint32_t prefixCRC;			// CRC32 копии заголовка и блока статистики
+	uint32_t reserved;			// Не используется (всегда 0)
+};
+
+static_assert(sizeof(CacheRecord) == 48, "Invalid CacheRecord size");
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBHeaderCache::Load(const std::wstring& basePath)
+{
+	Clear();
+	m_BasePath = basePath;
+
+	util::BinaryFile file;
+	if (!file.Open(basePath + CACHE_FILE_NAME))
+		return false;
+	// Пока файл не загружен, считаем кэш изменённым: повреждённый файл будет перезаписан (или удалён) функцией Save
+	m_IsChanged = true;
+
+	CacheHeader header;
+	const long long fileSize = file.GetSize();
+	if (!file.Read(&header, sizeof(header)))
+		return false;
+
+	const size_t recordC = AML_TO_LE32(header.recordC);
+	const size_t dataSize = AML_TO_LE32(header.dataSize);
+	const size_t cDataSize = AML_TO_LE32(header.cDataSize);
+	if (memcmp(header.magic, "MDPC", 4) || header.version != CacheHeader::VERSION ||
+		header.codec >= static_cast<uint8_t>(CodecId::COUNT) || fileSize != sizeof(header) + cDataSize ||
+		dataSize < recordC * sizeof(CacheRecord))
+	{
+		return false;
+	}
+
+	DataCodec codec;
+	std::vector<uint8_t> packedData(cDataSize), data(dataSize);
+	if (!file.Read(packedData.data(), cDataSize) || !codec.Decompress(static_cast<CodecId>(header.codec), 0,
+		packedData.data(), cDataSize, data.data(), dataSize) ||
+		hash::GetCRC32(data.data(), dataSize) != AML_TO_LE32(header.dataCRC))
+	{
+		return false;
+	}
+	file.Close();
+
+	size_t prefixOffset = recordC * sizeof(CacheRecord);
+	m_Entries.reserve(recordC);
+	for (size_t i = 0; i < recordC; ++i)
+	{
+		CacheRecord record;
+		memcpy(&record, data.data() + i * sizeof(record), sizeof(record));
+		const std::wstring path(record.path, record.path + strnlen(record.path, sizeof(record.path)));
+
+		Entry entry;
+		entry.fileSize = AML_TO_LE64(record.fileSize);
+		entry.fileTime = AML_TO_LE64(record.fileTime);
+		entry.prefixCRC = AML_TO_LE32(record.prefixCRC);
+		entry.prefixSize = AML_TO_LE32(record.prefixSize);
+		entry.prefixOffset = prefixOffset;
+		entry.state = EntryState::UNCHECKED;
+		prefixOffset += entry.prefixSize;
+
+		if (prefixOffset > dataSize || !DBStructure::IsValidPath(path) || !m_Entries.emplace(path, entry).second)
+		{
+			m_Entries.clear();
+			return false;
+		}
+	}
+	if (prefixOffset != dataSize)
+	{
+		m_Entries.clear();
+		return false;
+	}
+
+	m_Data = std::move(data);
+	m_IsChanged = false;
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBHeaderCache::Save()
+{
+	if (m_BasePath.empty())
+		return false;
+
+	size_t validC = 0, prefixSize = 0;
+	for (const auto& item : m_Entries)
+	{
+		if (item.second.state == EntryState::VALID)
+		{
+			++validC;
+			prefixSize += item.second.prefixSize;
+		}
+	}
+	// Если записи не добавлялись и все записи действительны, то файл кэша не изменился
+	if (!m_IsChanged && validC == m_Entries.size())
+		return true;
+
+	const std::wstring path = m_BasePath + CACHE_FILE_NAME;
+	if (!validC)
+		return !util::FileSystem::FileExists(path) || util::FileSystem::RemoveFile(path);
+
+	const size_t dataSize = validC * sizeof(CacheRecord) + prefixSize;
+	if (dataSize > ~uint32_t(0))
+		return false;
+
+	std::vector<uint8_t> data;
+	data.reserve(dataSize);
+	for (const auto& item : m_Entries)
+	{
+		const Entry& entry = item.second;
+		if (entry.state == EntryState::VALID)
+		{
+			CacheRecord record = {};
+			for (size_t i = 0; i < item.first.size() && i < sizeof(record.path); ++i)
+				record.path[i] = static_cast<char>(item.first[i]);
+			record.prefixSize = AML_TO_LE32(entry.prefixSize);
+			record.fileSize = AML_TO_LE64(entry.fileSize);
+			record.fileTime = AML_TO_LE64(entry.fileTime);
+			record.prefixCRC = AML_TO_LE32(entry.prefixCRC);
+
+			const auto pRecord = reinterpret_cast<const uint8_t*>(&record);
+			data.insert(data.end(), pRecord, pRecord + sizeof(record));
+		}
+	}
+	// Порядок обхода контейнера не меняется, пока он не изменён: копии записываются в том же порядке, что и записи
+	for (const auto& item : m_Entries)
+	{
+		const Entry& entry = item.second;
+		if (entry.state == EntryState::VALID)
+		{
+			data.insert(data.end(), m_Data.begin() + entry.prefixOffset,
+				m_Data.begin() + entry.prefixOffset + entry.prefixSize);
+		}
+	}
+
+	DataCodec codec;
+	std::vector<uint8_t> packedData;
+	if (!codec.Compress(data.data(), data.size(), packedData))
+		return false;
+
+	CacheHeader header = {};
+	memcpy(header.magic, "MDPC", 4);
+	header.version = CacheHeader::VERSION;
+	header.codec = static_cast<uint8_t>(codec.GetId());
+	header.recordC = AML_TO_LE32(static_cast<uint32_t>(validC));
+	header.dataSize = AML_TO_LE32(static_cast<uint32_t>(data.size()));
+	header.cDataSize = AML_TO_LE32(static_cast<uint32_t>(packedData.size()));
+	header.dataCRC = AML_TO_LE32(hash::GetCRC32(data.data(), data.size()));
+
+	// Как и индекс проверки БД, кэш сначала записывается во временный файл
+	const std::wstring tmpPath = path + L".tmp";
+	util::BinaryFile file;
+	const bool savedOk = file.Open(tmpPath, util::FILE_CREATE_ALWAYS | util::FILE_OPEN_WRITE) &&
+		file.Write(&header, sizeof(header)) && file.Write(packedData.data(), packedData.size()) && file.Flush();
+	file.Close();
+
+	if (savedOk)
+	{
+		if (util::FileSystem::FileExists(path) && !util::FileSystem::RemoveFile(path))
+			return false;
+		if (util::FileSystem::Rename(tmpPath, path))
+		{
+			m_IsChanged = false;
+			return true;
+		}
+	}
+	util::FileSystem::RemoveFile(tmpPath);
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DBHeaderCache::Clear()
+{
+	m_Entries.clear();
+	std::vector<uint8_t>().swap(m_Data);
+	m_IsChanged = false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBHeaderCache::Open(const std::wstring& path, DBFile& file)
+{
+	auto it = m_Entries.find(path);
+	if (it == m_Entries.end())
+		return false;
+
+	Entry& entry = it->second;
+	if (entry.state == EntryState::UNCHECKED)
+	{
+		uint64_t fileSize, fileTime;
+		const bool isValid = ::GetFileInfo(m_BasePath + path, fileSize, fileTime) &&
+			fileSize == entry.fileSize && fileTime == entry.fileTime &&
+			hash::GetCRC32(m_Data.data() + entry.prefixOffset, entry.prefixSize) == entry.prefixCRC;
+		entry.state = isValid ? EntryState::VALID : EntryState::INVALID;
+	}
+
+	return entry.state == EntryState::VALID && file.Open(m_Data.data() + entry.prefixOffset, entry.prefixSize);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBHeaderCache::IsValid(const std::wstring& path) const
+{
+	auto it = m_Entries.find(path);
+	return it != m_Entries.end() && it->second.state == EntryState::VALID;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBHeaderCache::Add(const std::wstring& path, size_t prefixSize)
+{
+	if (m_BasePath.empty() || !DBStructure::IsValidPath(path) || !prefixSize || prefixSize > ~uint32_t(0))
+		return false;
+
+	// Размер и время модификации получаем до чтения файла: если файл изменится
+	// после этого, то время модификации в кэше будет устаревшим и запись не пройдёт проверку
+	Entry entry;
+	util::BinaryFile file;
+	const std::wstring filePath = m_BasePath + path;
+	if (!::GetFileInfo(filePath, entry.fileSize, entry.fileTime) || entry.fileSize < prefixSize ||
+		!file.Open(filePath))
+	{
+		return false;
+	}
+
+	const size_t offset = m_Data.size();
+	m_Data.resize(offset + prefixSize);
+	if (!file.Read(m_Data.data() + offset, prefixSize))
+	{
+		m_Data.resize(offset);
+		return false;
+	}
+
+	entry.prefixCRC = hash::GetCRC32(m_Data.data() + offset, prefixSize);
+	entry.prefixSize = static_cast<uint32_t>(prefixSize);
+	entry.prefixOffset = offset;
+	entry.state = EntryState::VALID;
+	m_Entries[path] = entry;
+	m_IsChanged = true;
+	return true;
+}
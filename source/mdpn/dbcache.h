@@ -0,0 +1,77 @@
+﻿//∙MDPN
+#pragma once
+
+#include "assert.h"
+
+#include <core/platform.h>
+#include <core/util.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class DBFile;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   DBHeaderCache - кэш заголовков и блоков статистики файлов БД
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Кэш (файл "header-cache.dat" в корне БД) хранит копии заголовков и блоков статистики отдельных файлов БД вместе
+// с размером файла, временем его последней модификации и CRC32 копии. При инициализации БД файл, размер и время
+// модификации которого не изменились, открывается по копии из кэша (как и файл из сегмента, см. DBPack), поэтому
+// сам файл не открывается. Если содержимое файла всё же изменилось, то при последующей загрузке данных из файла
+// DBChunk обнаружит несовпадение CRC заголовка. Кэш обновляется в конце инициализации БД
+
+//----------------------------------------------------------------------------------------------------------------------
+class DBHeaderCache final : AssertHelper<>
+{
+	AML_NONCOPYABLE(DBHeaderCache)
+
+public:
+	// Имя файла кэша в директории БД
+	static constexpr const wchar_t* CACHE_FILE_NAME = L"header-cache.dat";
+
+	DBHeaderCache() = default;
+
+	// Загружает кэш из директории БД basePath. Если файла кэша нет или он повреждён, то функция вернёт
+	// false; кэш при этом будет пуст, но его можно пополнять функцией Add и сохранить функцией Save
+	bool Load(const std::wstring& basePath);
+	// Сохраняет кэш, если он изменился. В файл записываются только действительные записи:
+	// проверенные функцией Open (т.е. записи файлов, которые есть в БД) и добавленные функцией Add
+	bool Save();
+	// Освобождает все записи кэша
+	void Clear();
+
+	// Открывает копию заголовка и блока статистики файла path (путь относительно директории БД). При первом
+	// обращении запись проверяется: размер и время модификации файла должны совпадать с сохранёнными в кэше,
+	// а CRC32 копии - с сохранённым CRC32. Функция вернёт false, если записи нет или она недействительна
+	bool Open(const std::wstring& path, DBFile& file);
+	// Возвращает true, если запись файла path уже проверена функцией Open (или добавлена функцией Add)
+	bool IsValid(const std::wstring& path) const;
+	// Добавляет (или заменяет) запись файла path, читая из него первые prefixSize байт (заголовок и блок
+	// статистики). Функция может перераспределить память копий: файлы, открытые функцией Open, должны быть закрыты
+	bool Add(const std::wstring& path, size_t prefixSize);
+
+private:
+	enum class EntryState : uint8_t {
+		UNCHECKED,					// Запись загружена из файла кэша и ещё не проверялась
+		VALID,						// Запись действительна
+		INVALID						// Файл изменился или не существует
+	};
+
+	struct Entry {
+		uint64_t fileSize;			// Размер файла
+		uint64_t fileTime;			// Время последней модификации файла
+		uint32_t prefixCRC;			// CRC32 копии заголовка и блока статистики
+		uint32_t prefixSize;		// Размер копии
+		size_t prefixOffset;		// Смещение копии в m_Data
+		EntryState state;
+	};
+
+	std::wstring m_BasePath;
+	std::unordered_map<std::wstring, Entry> m_Entries;
+	std::vector<uint8_t> m_Data;	// Копии заголовков и блоков статистики
+	bool m_IsChanged = false;		// true, если в кэш были добавлены записи (или файл кэша повреждён)
+};
@@ -4,6 +4,7 @@
 #include "dbchunk.h"
 
 #include "dbase.h"
+#include "dbpack.h"
 #include "dbstruct.h"
 #include "util.h"
 
@@ -214,6 +215,8 @@ struct FileHeaderV5 final : public FileHeaderBase
 	unsigned dataSize = 0;		// Размер несжатого блока данных в байтах
 	uint32_t dataCRC = 0;		// CRC несжатого блока данных (dataSize байт)
 	unsigned zippedSize = 0;	// Размер сжатого блока данных (расположен сразу за блоком статистики) и бит сжатия
+	CodecId codec = {};			// Алгоритм сжатия блока данных (до 7-й версии формата - всегда deflate)
+	uint32_t dictId = 0;		// ID словаря zstd, с которым сжат блок данных, или 0
 
 	FileHeaderV5(const FileHeaderBase& header);
 	// Инициализирует значения всех полей
@@ -299,6 +302,11 @@ bool FileHeaderV5::Load(const char* pData)
 					if (!zippedSize || p[6] != '0')
 						zippedSize |= 1 << 31;
 				}
+				else if (!util::StrNInsCmp(p, "codec:", 6))
+				{
+					if (!DataCodec::FindId(codec, p + 6, len - 6))
+						return false;
+				}
 				break;
 			case 'd':
 				if (!util::StrNInsCmp(p, "depth:", 6))
@@ -316,6 +324,11 @@ bool FileHeaderV5::Load(const char* pData)
 					if (!Util::AToInt(dataSize, p + 6, len - 6))
 						return false;
 				}
+				else if (!util::StrNInsCmp(p, "dict:", 5))
+				{
+					if (len != 13 || !Util::AToCRC(dictId, p + 5) || !dictId)
+						return false;
+				}
 				break;
 			case 'f':
 				if (!util::StrNInsCmp(p, "first:", 6))
@@ -372,6 +385,166 @@ bool FileHeaderV5::Load(const char* pData)
 	return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   PackedBCD и DataBlockHeader - двоичный блок данных (начиная с 6-й версии формата)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Число длиной до 30 цифр в виде двух 64-битных слов по 15 упакованных десятичных цифр (60 бит). Сложение и вычитание
+// выполняются над всеми цифрами слова одновременно: к каждой цифре заранее прибавляется 6, чтобы десятичный перенос
+// совпал с двоичным, а затем шестёрка вычитается из тех цифр, которые переноса не дали. Перенос из старшей цифры
+// попадает в биты 60-63 слова. Байты слов (15 байт, 2 цифры в байте) совпадают с форматом BasicFixNumber
+
+//----------------------------------------------------------------------------------------------------------------------
+struct PackedBCD
+{
+	static constexpr size_t BYTE_C = 15;						// Количество значимых байт (30 цифр)
+	static constexpr uint64_t WORD_MASK = 0x0fffffffffffffff;	// Маска 15 цифр слова
+	static constexpr uint64_t SIXES = 0x0666666666666666;		// Поправки для десятичного переноса
+	static constexpr uint64_t NINES = 0x0999999999999999;		// Наибольшее значение слова (15 девяток)
+
+	uint64_t lo = 0;	// Младшие 15 цифр
+	uint64_t hi = 0;	// Старшие 15 цифр
+
+	// Загружает/сохраняет число. Функция Store возвращает false, если число не помещается в FixNumber.
+	// Параметр minLength - известная нижняя граница длины числа (ускоряет вычисление длины)
+	void Load(const FixNumber& num);
+	bool Store(FixNumber& num, size_t minLength = 1) const;
+
+	// Загружает/сохраняет BYTE_C байт упакованных цифр
+	void LoadBytes(const uint8_t* pBytes);
+	void StoreBytes(uint8_t* pBytes) const;
+	// Загружает/сохраняет упакованные цифры в виде двух слов: w0 - байты 0-7, w1 - байты 8-14
+	void LoadWords(uint64_t w0, uint64_t w1) { lo = w0 & WORD_MASK; hi = (w0 >> 60) | (w1 << 4); }
+	void StoreWords(uint64_t& w0, uint64_t& w1) const { w0 = lo | (hi << 60); w1 = hi >> 4; }
+
+	// Вычисляет this += rhs. Возвращает false при переполнении (больше 30 цифр)
+	bool Add(const PackedBCD& rhs);
+	// Вычисляет this -= rhs. Значение rhs не должно быть больше this
+	void Sub(const PackedBCD& rhs);
+
+	// Возвращает true, если все цифры числа меньше 10
+	bool IsValid() const { return !(HighDigits(lo) | HighDigits(hi)); }
+	// Возвращает true, если число равно 0
+	bool IsZero() const { return !(lo | hi); }
+
+private:
+	static uint64_t AddWords(uint64_t a, uint64_t b, uint64_t carry);
+	// Возвращает маску младших digitC цифр слова
+	static uint64_t DigitMask(size_t digitC) { return (digitC < 15) ? (1ull << 4 * digitC) - 1 : WORD_MASK; }
+	// Возвращает ненулевое значение, если слово содержит цифры больше 9
+	static uint64_t HighDigits(uint64_t v) { return (v >> 3) & ((v >> 2) | (v >> 1)) & 0x0111111111111111; }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+inline void PackedBCD::Load(const FixNumber& num)
+{
+	const size_t len = num.GetLength();
+	LoadBytes(num.GetPackedDigits());
+	// Цифры за пределами длины числа могут содержать "мусор"
+	lo &= DigitMask(len);
+	hi &= DigitMask((len > 15) ? len - 15 : 0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline bool PackedBCD::Store(FixNumber& num, size_t minLength) const
+{
+	// Длина числа - наименьшая длина (не меньше minLength), выше которой все цифры равны 0
+	size_t len = std::max(minLength, size_t(1));
+	while (len < 2 * BYTE_C && ((len < 15) ? (lo >> 4 * len) | hi : hi >> 4 * (len - 15)))
+		++len;
+
+	uint8_t bytes[BYTE_C + 1];
+	StoreBytes(bytes);
+	return num.SetPackedDigits(bytes, len);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline void PackedBCD::LoadBytes(const uint8_t* pBytes)
+{
+	uint64_t w0, w1;
+	memcpy(&w0, pBytes, 8);
+	memcpy(&w1, pBytes + 7, 8);
+	LoadWords(AML_TO_LE64(w0), AML_TO_LE64(w1) >> 8);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline void PackedBCD::StoreBytes(uint8_t* pBytes) const
+{
+	// Как и в LoadBytes, второе слово - это байты 7-14 (два 8-байтовых обращения вместо 8 + 7 байт)
+	uint64_t w0, w1;
+	StoreWords(w0, w1);
+	w1 = AML_TO_LE64((w0 >> 56) | (w1 << 8));
+	w0 = AML_TO_LE64(w0);
+	memcpy(pBytes, &w0, 8);
+	memcpy(pBytes + 7, &w1, 8);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline bool PackedBCD::Add(const PackedBCD& rhs)
+{
+	lo = AddWords(lo, rhs.lo, 0);
+	hi = AddWords(hi, rhs.hi, lo >> 60);
+	lo &= WORD_MASK;
+	return !(hi >> 60);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline void PackedBCD::Sub(const PackedBCD& rhs)
+{
+	// a - b = a + (дополнение b до девяток) + 1, перенос из старшей цифры отбрасывается
+	lo = AddWords(lo, NINES - rhs.lo, 1);
+	hi = AddWords(hi, NINES - rhs.hi, lo >> 60) & WORD_MASK;
+	lo &= WORD_MASK;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline uint64_t PackedBCD::AddWords(uint64_t a, uint64_t b, uint64_t carry)
+{
+	const uint64_t t1 = a + SIXES;
+	const uint64_t t2 = t1 + b + carry;
+	// Биты на границах цифр, в которые не пришёл перенос: в этих цифрах убираем поправку 6
+	const uint64_t noCarry = ~(t2 ^ t1 ^ b) & 0x1111111111111110;
+	return t2 - ((noCarry >> 2) | (noCarry >> 3));
+}
+
+// Двоичный блок данных состоит из заголовка DataBlockHeader и двух столбцов. В первом столбце хранятся разности
+// (дельты) соседних чисел, начиная со второго числа, в виде упакованных десятичных цифр фиксированной ширины
+// deltaSize байт. Во втором - значения шагов, уменьшенные на MINSTEP, шириной stepSize байт. Каждый столбец
+// транспонирован по байтам: сначала идут младшие байты всех значений, затем следующие и т.д. Старшие байты дельт
+// почти всегда нулевые, а младшие байты шагов повторяются, поэтому такие слои хорошо сжимаются
+
+//----------------------------------------------------------------------------------------------------------------------
+struct DataBlockHeader
+{
+	uint32_t itemC;				// Количество чисел в блоке данных
+	uint8_t deltaSize;			// Ширина значения в столбце дельт (1...PackedBCD::BYTE_C байт)
+	uint8_t stepSize;			// Ширина значения в столбце шагов (1 или 2 байта)
+	uint8_t firstLength;		// Длина первого (наименьшего) числа блока
+	uint8_t reserved;			// Не используется (всегда 0)
+	uint8_t firstDigits[16];	// Цифры первого числа (упакованные, как в BasicFixNumber)
+
+	// Возвращает полный размер блока данных (заголовок и оба столбца)
+	size_t GetBlockSize() const { return sizeof(*this) + (itemC - 1) * size_t(deltaSize) + itemC * size_t(stepSize); }
+	// Загружает заголовок из начала блока данных pData размером size байт. Возвращает false, если заголовок
+	// некорректен или не соответствует размеру блока. Значения дельт и шагов функция не проверяет
+	bool Load(const uint8_t* pData, size_t size);
+};
+
+static_assert(sizeof(DataBlockHeader) == 24, "Invalid DataBlockHeader size");
+
+//----------------------------------------------------------------------------------------------------------------------
+inline bool DataBlockHeader::Load(const uint8_t* pData, size_t size)
+{
+	if (size < sizeof(*this))
+		return false;
+	memcpy(this, pData, sizeof(*this));
+	itemC = AML_TO_LE32(itemC);
+
+	return itemC && deltaSize && deltaSize <= PackedBCD::BYTE_C && stepSize && stepSize <= 2 && GetBlockSize() == size;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   DBChunkData
@@ -410,7 +583,7 @@ void DBChunkData::Init(size_t reserveCount)
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool DBChunkData::LoadData(util::File& file, State stateNeeded)
+bool DBChunkData::LoadData(util::File& file, State stateNeeded, const DataCodec& codec)
 {
 	Assert(stateNeeded >= State::HEADERONLY);
 	if (stateNeeded <= m_Chunk->GetDataState())
@@ -432,7 +605,7 @@ bool DBChunkData::LoadData(util::File& file, State stateNeeded)
 	}
 	if (stateNeeded >= State::FULLDATA && m_Chunk->GetDataState() < State::FULLDATA)
 	{
-		if (!LoadDataBlock(file))
+		if (!LoadDataBlock(file, codec))
 			return false;
 	}
 	return true;
@@ -457,15 +630,22 @@ void DBChunkData::UnloadData(State stateNeeded)
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool DBChunkData::Save(util::File& file, bool forceFullSave, bool maxCompression)
+bool DBChunkData::Save(util::File& file, const DataCodec& codec, unsigned newFormatVer, bool forceFullSave,
+	bool maxCompression)
 {
 	std::string stats;
 	util::MemoryFile numData;
 	bool didFullSave = false;
 
-	forceFullSave |= m_Chunk->HasOldFormat();
+	// Файл сохраняется в той версии формата, в которой был загружен (новый файл - в версии newFormatVer). В
+	// двоичный формат блок данных переводится только при максимальном сжатии (см. BINARY_FORMAT_VERSION)
+	unsigned formatVer = std::max(m_FormatVer ? m_FormatVer : newFormatVer, BASE_FORMAT_VERSION);
+	if (maxCompression)
+		formatVer = std::max(formatVer, BINARY_FORMAT_VERSION);
+
+	forceFullSave |= formatVer != m_FormatVer;
 	if (m_Chunk->GetSaveState() >= State::DATACHANGED || forceFullSave ||
-		(maxCompression && !m_Chunk.Flags().Check(Flag::MAX_COMPRESSED)))
+		(maxCompression && !(m_Chunk.Flags().Check(Flag::MAX_COMPRESSED) && IsCompressedWith(codec))))
 	{
 		SaveStats(stats);
 		m_StatSize = static_cast<unsigned>(stats.size());
@@ -473,16 +653,23 @@ bool DBChunkData::Save(util::File& file, bool forceFullSave, bool maxCompression
 
 		m_DataSize = m_DataCRC = m_CDataSize = 0;
 		m_Chunk.Flags().Clear(Flag::MAX_COMPRESSED);
-
-		if (numData.Open() && SaveData(numData) && numData.GetSize() >= 0)
+		m_Codec = codec.GetId();
+		m_DictId = codec.GetUsedDictId();
+		// Алгоритм сжатия (кроме deflate) и словарь указываются в заголовке файла только начиная с 7-й версии
+		if (m_Codec != CodecId::DEFLATE || m_DictId)
+			formatVer = LATEST_FORMAT_VERSION;
+
+		const bool isBinary = formatVer >= BINARY_FORMAT_VERSION;
+		if (numData.Open() && (isBinary ? SaveBinaryData(numData) : SaveData(numData)) && numData.GetSize() >= 0)
 		{
 			m_DataSize = static_cast<unsigned>(numData.GetSize());
 			bool maxCompressed = didFullSave = !m_DataSize;
 			if (m_DataSize)
 			{
+				// Уровень сжатия (обычный или максимальный) определяется объектом codec (см. DataCodec)
 				util::MemoryFile packedData;
 				if (packedData.Open() && numData.GetCRC32(m_DataCRC) && numData.SetPosition(0) &&
-					CompressFile(numData, packedData, maxCompression ? 9 : 5) && packedData.GetSize() > 0)
+					codec.Compress(numData, packedData, maxCompression) && packedData.GetSize() > 0)
 				{
 					m_CDataSize = static_cast<unsigned>(packedData.GetSize());
 					maxCompressed = maxCompression;
@@ -499,11 +686,11 @@ bool DBChunkData::Save(util::File& file, bool forceFullSave, bool maxCompression
 			throw util::ERuntime("Unexpected error");
 	}
 
-	if (SaveHeader(file) && (!didFullSave ||
+	if (SaveHeader(file, formatVer) && (!didFullSave ||
 		((!m_StatSize || file.Write(stats.c_str(), m_StatSize)) &&
 		(!m_CDataSize || numData.SaveTo(file)) && (file.Truncate(), true))))
 	{
-		m_FormatVer = LATEST_FORMAT_VERSION;
+		m_FormatVer = formatVer;
 		m_Chunk.Flags().Clear(Flag::OLD_FORMAT_VER | Flag::IS_NEW_CHUNK);
 		m_Chunk.SetSaveState(State::UNCHANGED);
 		return true;
@@ -511,6 +698,12 @@ bool DBChunkData::Save(util::File& file, bool forceFullSave, bool maxCompression
 	return false;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool DBChunkData::IsCompressedWith(const DataCodec& codec) const
+{
+	return m_Codec == codec.GetId() && m_DictId == codec.GetUsedDictId();
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void DBChunkData::SetLast(const Number& num)
 {
@@ -592,6 +785,37 @@ void DBChunkData::SortNumbers()
 	}
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool DBChunkData::ViewData(const uint8_t* pFile, size_t fileSize, const DataCodec& codec, DBNumberView& view) const
+{
+	Assert(m_FormatVer >= 6 && m_Chunk->GetDataState() >= State::HEADERONLY);
+
+	view.Clear();
+	if (!m_CDataSize)
+		return !m_DataSize;
+
+	const size_t fileOffset = FILE_HEADER_SIZE + m_StatSize;
+	if (!pFile || fileSize < fileOffset + m_CDataSize)
+		return false;
+
+	if (view.m_Buffer.size() < m_DataSize)
+		view.m_Buffer.resize(m_DataSize);
+
+	DataBlockHeader header;
+	uint8_t* pData = view.m_Buffer.data();
+	if (!codec.Decompress(m_Codec, m_DictId, pFile + fileOffset, m_CDataSize, pData, m_DataSize) ||
+		hash::GetCRC32(pData, m_DataSize) != m_DataCRC || !header.Load(pData, m_DataSize))
+	{
+		return false;
+	}
+
+	view.m_Count = header.itemC;
+	view.m_MinSavedStep = m_MinSavedStep;
+	view.m_DeltaSize = header.deltaSize;
+	view.m_StepSize = header.stepSize;
+	return true;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void DBChunkData::AddPalindrome(const Number& num, unsigned step)
 {
@@ -762,10 +986,10 @@ bool DBChunkData::ReloadHeader(util::File& file)
 		return false;
 
 	m_FormatVer = ver.formatVer;
-	if (ver.formatVer < LATEST_FORMAT_VERSION)
+	if (ver.formatVer < BASE_FORMAT_VERSION)
 		m_Chunk.Flags().Set(Flag::OLD_FORMAT_VER);
 
-	if (ver.formatVer < 3 || ver.formatVer > 5)
+	if (ver.formatVer < 3 || ver.formatVer > LATEST_FORMAT_VERSION)
 		return false;
 
 	if (m_Chunk->GetDataState() < State::HEADERONLY)
@@ -803,6 +1027,8 @@ bool DBChunkData::ReloadHeader(util::File& file)
 		m_DataSize = header.dataSize;
 		m_DataCRC = header.dataCRC;
 		m_CDataSize = header.zippedSize & 0x7fffffff;
+		m_Codec = header.codec;
+		m_DictId = header.dictId;
 
 		if (header.zippedSize & (1 << 31))
 		{
@@ -855,7 +1081,7 @@ bool DBChunkData::LoadStatBlock(util::File& file)
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool DBChunkData::LoadDataBlock(util::File& file)
+bool DBChunkData::LoadDataBlock(util::File& file, const DataCodec& codec)
 {
 	Assert(!m_pData && m_Chunk->GetDataState() == State::WITHSTATS);
 
@@ -870,19 +1096,16 @@ bool DBChunkData::LoadDataBlock(util::File& file)
 		const long long fileOffset = headerSize + m_StatSize;
 		if (file.GetSize() >= fileOffset + m_CDataSize)
 		{
-			util::MemoryFile data;
-			if (file.SetPosition(fileOffset) && data.Open() &&
-				DecompressFile(file, data) && data.GetSize() == m_DataSize)
+			// Сжатый блок читается целиком и распаковывается за один вызов сразу в буфер для парсинга
+			util::DynamicArray<char> packedData(m_CDataSize);
+			util::DynamicArray<char> buffer(m_DataSize + 1);
+			if (file.SetPosition(fileOffset) && file.Read(packedData, m_CDataSize) &&
+				codec.Decompress(m_Codec, m_DictId, packedData, m_CDataSize, buffer, m_DataSize) &&
+				hash::GetCRC32(buffer, m_DataSize) == m_DataCRC)
 			{
-				util::DynamicArray<char> buffer(m_DataSize + 1);
-				if (data.SetPosition(0) && data.Read(buffer, m_DataSize) &&
-					hash::GetCRC32(buffer, m_DataSize) == m_DataCRC)
-				{
-					data.Close();
-					m_pData->reserve(GetTotalNumberC());
-					buffer[m_DataSize] = 0;
-					ok = ParseData(buffer);
-				}
+				m_pData->reserve(GetTotalNumberC());
+				buffer[m_DataSize] = 0;
+				ok = ParseData(buffer, m_DataSize);
 			}
 		}
 	}
@@ -923,17 +1146,22 @@ bool DBChunkData::ParseStats(const char* pData)
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool DBChunkData::ParseData(const char* pData)
+bool DBChunkData::ParseData(const char* pData, size_t size)
 {
 	DataItem item;
 	Number last, num;
 
 	const char* p = pData;
-	while (*p == 10) ++p;
-
-	if (m_FormatVer < LATEST_FORMAT_VERSION)
+	if (m_FormatVer >= 6)
+	{
+		// Блок данных в двоичном формате (начиная с 6-й версии формата)
+		if (!ParseBinaryData(reinterpret_cast<const uint8_t*>(pData), size))
+			return false;
+	}
+	else if (m_FormatVer < 5)
 	{
 		// Читаем блок данных в старых форматах: 3 и 4
+		while (*p == 10) ++p;
 		for (size_t k; *p; p += k)
 		{
 			for (k = 0; p[k] >= '0' && p[k] <= '9'; ++k);
@@ -956,8 +1184,9 @@ bool DBChunkData::ParseData(const char* pData)
 		}
 	} else
 	{
-		// Читаем блок данных в текущем актуальном (самом
-		// последнем) формате LATEST_FORMAT_VERSION
+		// Читаем блок данных в текстовом формате версии 5 (дельты чисел
+		// с буквенным кодированием последовательностей нолей и девяток)
+		while (*p == 10) ++p;
 		constexpr size_t BUF_SIZE = 64;
 		char buffer[BUF_SIZE];
 
@@ -1017,7 +1246,68 @@ bool DBChunkData::ParseData(const char* pData)
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool DBChunkData::SaveHeader(util::File& file)
+bool DBChunkData::ParseBinaryData(const uint8_t* pData, size_t size)
+{
+	DataBlockHeader header;
+	if (!header.Load(pData, size))
+		return false;
+
+	const size_t count = header.itemC;
+	const size_t deltaC = count - 1;
+	const size_t deltaSize = header.deltaSize;
+	const uint8_t* pDeltas = pData + sizeof(header);
+	const uint8_t* pSteps = pDeltas + deltaC * deltaSize;
+
+	// Добавляет элемент с индексом i. Элементы заполняются прямо в контейнере (при ошибке он
+	// всё равно будет удалён). Параметр minLength - длина предыдущего числа (см. PackedBCD::Store)
+	auto addItem = [&](size_t i, const PackedBCD& num, size_t minLength) -> bool {
+		DataItem& item = m_pData->emplace_back();
+		item.step = pSteps[i] + ((header.stepSize > 1) ? pSteps[count + i] << 8 : 0) + m_MinSavedStep;
+		return item.step && item.step <= Const::MAX_STEP && num.Store(item.num, minLength);
+	};
+
+	PackedBCD num, delta;
+	num.LoadBytes(header.firstDigits);
+	const size_t firstLength = header.firstLength;
+	if (!num.IsValid() || num.IsZero() || !addItem(0, num, firstLength) ||
+		m_pData->back().num.GetLength() != firstLength)
+	{
+		return false;
+	}
+
+	// Дельты обрабатываются порциями по TILE_SIZE: сначала байтовые слои порции собираются в 64-битные слова
+	// (w0 - байты 0-7, w1 - байты 8-14; цикл по одному слою компилятор легко векторизует), а затем каждое
+	// следующее число вычисляется как сумма предыдущего и дельты. Нулевая дельта означала бы повтор
+	// числа, поэтому, как и в текстовых форматах, она недопустима
+	constexpr size_t TILE_SIZE = 256;
+	uint64_t wordA[2][TILE_SIZE];
+	size_t length = firstLength;
+	for (size_t first = 0; first < deltaC; first += TILE_SIZE)
+	{
+		const size_t n = std::min(TILE_SIZE, deltaC - first);
+		memset(wordA, 0, sizeof(wordA));
+		for (size_t j = 0; j < deltaSize; ++j)
+		{
+			const uint8_t* pLayer = pDeltas + j * deltaC + first;
+			uint64_t* pWords = wordA[j / 8];
+			const unsigned shift = 8 * (j % 8);
+			for (size_t i = 0; i < n; ++i)
+				pWords[i] |= uint64_t(pLayer[i]) << shift;
+		}
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			delta.LoadWords(wordA[0][i], wordA[1][i]);
+			if (!delta.IsValid() || delta.IsZero() || !num.Add(delta) || !addItem(first + i + 1, num, length))
+				return false;
+			length = m_pData->back().num.GetLength();
+		}
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBChunkData::SaveHeader(util::File& file, unsigned formatVer)
 {
 	Number first;
 	util::DateTime dt;
@@ -1033,7 +1323,7 @@ bool DBChunkData::SaveHeader(util::File& file)
 	m_AllSavedPalNumC += m_AllSavedPalIntC;
 	m_AllSavedPalIntC = m_AllLychrelIntC = 0;
 
-	header += util::Format("\nFORMAT:%u\n", LATEST_FORMAT_VERSION);
+	header += util::Format("\nFORMAT:%u\n", formatVer);
 	header += util::Format("TIME:%s\n", timeStamp.c_str());
 
 	header += util::Format("FIRST:%s\n", first.AsString().c_str());
@@ -1051,6 +1341,10 @@ bool DBChunkData::SaveHeader(util::File& file)
 	header += util::Format("DSIZE:%u\nDCRC:%08X\n", m_DataSize, m_DataSize ? m_DataCRC : 0);
 	header += util::Format((m_Chunk.Flags().Check(Flag::MAX_COMPRESSED) || !m_CDataSize) ?
 		"CSIZE:%u\n" : "CSIZE:0%u\n", m_CDataSize);
+	if (m_Codec != CodecId::DEFLATE)
+		header += util::Format("CODEC:%s\n", DataCodec::GetName(m_Codec));
+	if (m_DictId)
+		header += util::Format("DICT:%08X\n", m_DictId);
 
 	header += "---\n";
 	while (header.size() < FILE_HEADER_SIZE - 8)
@@ -1162,6 +1456,198 @@ bool DBChunkData::SaveData(util::File& out)
 	return true;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool DBChunkData::SaveBinaryData(util::File& out)
+{
+	Assert(m_pData);
+
+	SortNumbers();
+
+	const DataItems& numbers = *m_pData;
+	const size_t count = numbers.size();
+	if (!count)
+		return true;
+
+	// Ширина столбца дельт определяется наибольшей из них (старшим ненулевым байтом), поэтому сначала
+	// найдём её, а сами дельты вычислим повторно при заполнении столбца. Дельты представлены словами
+	// w0 (байты 0-7) и w1 (байты 8-14), см. PackedBCD::StoreWords
+	const size_t deltaC = count - 1;
+	uint64_t w0, w1, maxW0 = 0, maxW1 = 0;
+	PackedBCD prev, cur, delta;
+	prev.Load(numbers[0].num);
+	for (size_t i = 1; i < count; ++i)
+	{
+		cur.Load(numbers[i].num);
+		delta = cur;
+		delta.Sub(prev);
+		delta.StoreWords(w0, w1);
+		maxW0 |= w0;
+		maxW1 |= w1;
+		prev = cur;
+	}
+
+	unsigned maxStep = 0;
+	for (const auto& item : numbers)
+	{
+		Assert(item.step >= m_MinSavedStep);
+		maxStep = std::max(maxStep, item.step - m_MinSavedStep);
+	}
+
+	size_t deltaSize = maxW1 ? 9 : 1;
+	for (uint64_t w = maxW1 ? maxW1 : maxW0; w > 0xff; w >>= 8)
+		++deltaSize;
+
+	DataBlockHeader header = {};
+	header.itemC = AML_TO_LE32(static_cast<uint32_t>(count));
+	header.deltaSize = static_cast<uint8_t>(deltaSize);
+	header.stepSize = (maxStep > 0xff) ? 2 : 1;
+	header.firstLength = static_cast<uint8_t>(numbers[0].num.GetLength());
+	cur.Load(numbers[0].num);
+	cur.StoreBytes(header.firstDigits);
+
+	const size_t stepSize = header.stepSize;
+	const size_t blockSize = sizeof(header) + deltaC * deltaSize + count * stepSize;
+	util::DynamicArray<uint8_t> buffer(blockSize);
+	memcpy(buffer, &header, sizeof(header));
+
+	// Столбец дельт: слой j содержит j-е байты всех дельт. Как и при чтении, дельты
+	// обрабатываются порциями: сначала вычисляются слова, затем заполняются слои
+	constexpr size_t TILE_SIZE = 256;
+	uint64_t wordA[2][TILE_SIZE];
+	uint8_t* pDeltas = buffer + sizeof(header);
+	prev.Load(numbers[0].num);
+	for (size_t first = 0; first < deltaC; first += TILE_SIZE)
+	{
+		const size_t n = std::min(TILE_SIZE, deltaC - first);
+		for (size_t i = 0; i < n; ++i)
+		{
+			cur.Load(numbers[first + i + 1].num);
+			delta = cur;
+			delta.Sub(prev);
+			delta.StoreWords(wordA[0][i], wordA[1][i]);
+			prev = cur;
+		}
+
+		for (size_t j = 0; j < deltaSize; ++j)
+		{
+			uint8_t* pLayer = pDeltas + j * deltaC + first;
+			const uint64_t* pWords = wordA[j / 8];
+			const unsigned shift = 8 * (j % 8);
+			for (size_t i = 0; i < n; ++i)
+				pLayer[i] = static_cast<uint8_t>(pWords[i] >> shift);
+		}
+	}
+
+	// Столбец шагов: шаги кодируются как разность между значением шага
+	// и минимальным сохраняемым шагом палиндромов в файле
+	uint8_t* pSteps = pDeltas + deltaC * deltaSize;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const unsigned step = numbers[i].step - m_MinSavedStep;
+		pSteps[i] = static_cast<uint8_t>(step);
+		if (stepSize > 1)
+			pSteps[count + i] = static_cast<uint8_t>(step >> 8);
+	}
+
+	return out.Write(buffer, blockSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   DBNumberView
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+void DBNumberView::Clear()
+{
+	m_pItems = nullptr;
+	m_Count = m_Index = 0;
+	m_HasError = false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBNumberView::Rewind()
+{
+	m_Index = 0;
+	m_HasError = false;
+	if (!m_Count)
+		return false;
+
+	if (m_pItems)
+	{
+		m_Item = (*m_pItems)[0];
+		return true;
+	}
+
+	// Заголовок блока данных уже проверен функцией DBChunkData::ViewData
+	DataBlockHeader header;
+	memcpy(&header, m_Buffer.data(), sizeof(header));
+	PackedBCD num;
+	num.LoadBytes(header.firstDigits);
+	m_DigitA[0] = num.lo;
+	m_DigitA[1] = num.hi;
+
+	const size_t firstLength = header.firstLength;
+	if (!num.IsValid() || num.IsZero() || !StoreItem(firstLength) || m_Item.num.GetLength() != firstLength)
+	{
+		m_HasError = true;
+		return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBNumberView::Next()
+{
+	if (m_HasError || ++m_Index >= m_Count)
+		return false;
+
+	if (m_pItems)
+	{
+		m_Item = (*m_pItems)[m_Index];
+		return true;
+	}
+
+	// Байты дельты числа m_Index находятся в соседних слоях столбца дельт, на расстоянии deltaC друг
+	// от друга (см. ParseBinaryData). Как и там, нулевая дельта (повтор числа) недопустима
+	const size_t deltaC = m_Count - 1;
+	const uint8_t* pDelta = m_Buffer.data() + sizeof(DataBlockHeader) + m_Index - 1;
+	uint64_t wordA[2] = {};
+	for (size_t j = 0; j < m_DeltaSize; ++j, pDelta += deltaC)
+		wordA[j / 8] |= uint64_t(*pDelta) << 8 * (j % 8);
+
+	PackedBCD num, delta;
+	num.lo = m_DigitA[0];
+	num.hi = m_DigitA[1];
+	delta.LoadWords(wordA[0], wordA[1]);
+	if (!delta.IsValid() || delta.IsZero() || !num.Add(delta))
+	{
+		m_HasError = true;
+		return false;
+	}
+
+	m_DigitA[0] = num.lo;
+	m_DigitA[1] = num.hi;
+	return StoreItem(m_Item.num.GetLength());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBNumberView::StoreItem(size_t minLength)
+{
+	const uint8_t* pSteps = m_Buffer.data() + sizeof(DataBlockHeader) + (m_Count - 1) * m_DeltaSize;
+	m_Item.step = pSteps[m_Index] + ((m_StepSize > 1) ? pSteps[m_Count + m_Index] << 8 : 0) + m_MinSavedStep;
+
+	PackedBCD num;
+	num.lo = m_DigitA[0];
+	num.hi = m_DigitA[1];
+	if (m_Item.step && m_Item.step <= Const::MAX_STEP && num.Store(m_Item.num, minLength))
+		return true;
+
+	m_HasError = true;
+	return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   DBChunk
@@ -1238,15 +1724,15 @@ bool DBChunk::LoadData(DataBase& db, State stateNeeded)
 	EE::Assert(GetSaveState() == State::UNCHANGED, "Not saved changes");
 	EE::Assert(m_Flags.Check(Flag::HAS_FILE_PATH), "Filepath not set");
 
-	util::BinaryFile file;
-	if (!file.Open(db.GetBasePath() + GetFilePath(), util::FILE_OPEN_READ))
+	DBFile file;
+	auto stateToLoad = std::max(stateNeeded, State::HEADERONLY);
+	if (!db.OpenChunkFile(GetFilePath(), file, stateToLoad))
 		return false;
 
 	if (!m_pData)
 		CreateData();
 
-	auto stateToLoad = std::max(stateNeeded, State::HEADERONLY);
-	const bool isLoaded = m_pData->LoadData(file, stateToLoad);
+	const bool isLoaded = m_pData->LoadData(file, stateToLoad, db.GetCodec());
 	file.Close();
 
 	// Если данные загружены и нам было нужно DATAUNLOADED, то сразу выгрузим заголовок. Нам следует так
@@ -1257,6 +1743,32 @@ bool DBChunk::LoadData(DataBase& db, State stateNeeded)
 	return isLoaded;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool DBChunk::GetNumbers(DataBase& db, DBNumberView& view)
+{
+	view.Clear();
+	CheckState(State::HEADERONLY);
+
+	if (GetDataState() < State::FULLDATA)
+	{
+		// Текстовый блок данных (до 6-й версии формата) можно разобрать только в DataItems
+		if (GetFormatVer() >= 6)
+		{
+			// Сжатый блок распаковывается прямо из отображения файла (без чтения в промежуточный буфер)
+			DBFile file;
+			return db.MapChunkFile(GetFilePath(), file) &&
+				m_pData->ViewData(file.GetData(), static_cast<size_t>(file.GetSize()), db.GetCodec(), view);
+		}
+		if (!LoadData(db, State::FULLDATA))
+			return false;
+	}
+
+	SortNumbers();
+	view.m_pItems = &GetNumbers();
+	view.m_Count = view.m_pItems->size();
+	return true;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void DBChunk::UnloadData(State stateNeeded)
 {
@@ -1291,7 +1803,7 @@ bool DBChunk::Save(DataBase& db, unsigned minSavedStep, unsigned cpuTime, bool m
 			return true;
 
 		Assert(GetDataState() >= State::FULLDATA, "Data not loaded");
-		if (IsMaxCompressed())
+		if (IsMaxCompressed(db.GetCodec()))
 			return true;
 	}
 
@@ -1304,7 +1816,7 @@ bool DBChunk::Save(DataBase& db, unsigned minSavedStep, unsigned cpuTime, bool m
 	// Если изменились данные или файл имеет старую версию, то перезапишем
 	// весь файл целиком. Иначе можно ограничиться лишь сохранением заголовка
 	const bool needFullSave = GetSaveState() >= State::DATACHANGED ||
-		HasOldFormat() || (maxCompression && !IsMaxCompressed());
+		HasOldFormat() || (maxCompression && !IsMaxCompressed(db.GetCodec()));
 	unsigned openMode = needFullSave ? util::FILE_CREATE_ALWAYS : util::FILE_OPEN_ALWAYS;
 
 	util::BinaryFile file;
@@ -1312,11 +1824,25 @@ bool DBChunk::Save(DataBase& db, unsigned minSavedStep, unsigned cpuTime, bool m
 	if (!file.Open(filePath, util::FILE_OPEN_WRITE | openMode))
 		return false;
 
-	bool ok = m_pData->Save(file, false, maxCompression);
+	bool ok = m_pData->Save(file, db.GetCodec(), db.GetFormatVer(), false, maxCompression);
 	file.Close();
 	return ok;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool DBChunk::IsSaveNeeded(const DataCodec& codec, bool maxCompression) const
+{
+	return GetSaveState() != State::UNCHANGED || (maxCompression && !IsMaxCompressed(codec));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBChunk::IsMaxCompressed(const DataCodec& codec) const
+{
+	const DBChunkData* pData = GetData(State::HEADERONLY);
+	return m_Flags.Check(Flag::MAX_COMPRESSED) && pData->IsCompressedWith(codec) &&
+		pData->GetFormatVer() >= DBChunkData::BINARY_FORMAT_VERSION;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void DBChunk::Append(const DBChunk* pOther)
 {
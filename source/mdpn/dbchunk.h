@@ -3,6 +3,7 @@
 #pragma once
 
 #include "assert.h"
+#include "codec.h"
 #include "number.h"
 
 #include <core/forward.h>
@@ -13,6 +14,7 @@
 #include <vector>
 
 class DBChunkAccessor;
+class DBNumberView;
 class DataBase;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -76,8 +78,16 @@ public:
 	// формате. Оставшееся неиспользованным простраство заголовка заполняется символами #
 	static constexpr size_t FILE_HEADER_SIZE = 400;
 
-	// Текущий (последний) формат файлов БД
-	static constexpr unsigned LATEST_FORMAT_VERSION = 5;
+	// Текущий (последний) формат файлов БД. Начиная с 7-й версии формата блок данных может быть
+	// сжат не только алгоритмом deflate (алгоритм и ID словаря указываются в заголовке файла)
+	static constexpr unsigned LATEST_FORMAT_VERSION = 7;
+	// Начиная с 6-й версии формата блок данных хранится в двоичном виде (см. SaveBinaryData). Программы,
+	// читающие только 5-ю версию, такие файлы прочитать не смогут, поэтому файл переводится в новую версию
+	// формата только явно: при максимальном сжатии (команда "update --compress") или при сжатии другим
+	// алгоритмом, кроме deflate (опция "--codec"). Иначе файл сохраняется в той версии, в которой загружен
+	static constexpr unsigned BINARY_FORMAT_VERSION = 6;
+	// Старейшая версия формата, в которой файлы сохраняются. Файлы версий 3 и 4 при сохранении переводятся в неё
+	static constexpr unsigned BASE_FORMAT_VERSION = 5;
 
 	// Элемент данных
 	struct DataItem {
@@ -100,18 +110,22 @@ public:
 
 	using State = DBChunkState;
 	using Flag = DBChunkFlags::Flag;
-	// Загружает указанное количество данных из файла. Если данные уже загружены, то ничего не делает.
+	// Загружает указанное количество данных из файла. Если данные уже загружены, то ничего не делает. Объект
+	// codec используется для распаковки блока данных (он должен содержать словарь, с которым сжат блок данных).
 	// Если при загрузке произойдёт ошибка, то функция вернёт false, а состояние объекта не изменится
-	bool LoadData(util::File& file, State stateNeeded);
+	bool LoadData(util::File& file, State stateNeeded, const DataCodec& codec);
 	// Выгружает данные из памяти, оставляя только указанное (не ниже
 	// HEADERONLY) количество. Объект не должен содержать изменений
 	void UnloadData(State stateNeeded);
 
 	// Сохраняет данные в файл: заголовок сохраняется всегда, блоки статистики и данных сохраняются
-	// при наличии изменений в данных, или если forceFullSave равен true. Если maxCompression равен
-	// true, то данные будут максимально сжаты (если при этом нет несохранённых изменений в данных,
-	// и файл не был сжат ранее, то блоки статистики и данных будут сохранены принудительно)
-	bool Save(util::File& file, bool forceFullSave = false, bool maxCompression = false);
+	// при наличии изменений в данных, или если forceFullSave равен true. Блок данных сжимается объектом
+	// codec. Если maxCompression равен true, то данные будут максимально сжаты (если при этом нет
+	// несохранённых изменений в данных, а файл не был ранее максимально сжат тем же алгоритмом
+	// и с тем же словарём, то блоки статистики и данных будут сохранены принудительно). Параметр
+	// newFormatVer задаёт версию формата нового файла (см. BINARY_FORMAT_VERSION)
+	bool Save(util::File& file, const DataCodec& codec, unsigned newFormatVer, bool forceFullSave = false,
+		bool maxCompression = false);
 
 	unsigned GetFormatVer() const { return m_FormatVer; }
 	const Number& GetLast() const { return m_Last; }
@@ -132,6 +146,12 @@ public:
 	unsigned GetCDataSize() const { return m_CDataSize; }
 	unsigned GetFileSize() const;
 
+	// Возвращает алгоритм сжатия блока данных и ID словаря (0, если словарь не использовался)
+	CodecId GetCodec() const { return m_Codec; }
+	uint32_t GetDictId() const { return m_DictId; }
+	// Возвращает true, если блок данных сжат тем же алгоритмом и с тем же словарём, что использует codec
+	bool IsCompressedWith(const DataCodec& codec) const;
+
 	void SetCPUTimeSpent(unsigned cpuTime);
 	void SetMinSavedStep(unsigned minSavedStep);
 
@@ -144,6 +164,10 @@ public:
 	const DataItems& GetNumbers() const { return *m_pData; }
 	// Сортирует числа в DataItems по возрастанию
 	void SortNumbers();
+	// Распаковывает двоичный блок данных файла в буфер объекта view (см. DBNumberView), не загружая его в
+	// DataItems. Параметр pFile - содержимое файла в памяти, fileSize - его размер. Файл должен иметь формат
+	// не ниже 6-й версии. При ошибке функция вернёт false
+	bool ViewData(const uint8_t* pFile, size_t fileSize, const DataCodec& codec, DBNumberView& view) const;
 
 	// Уведомляет о том, что найден палиндром с низким шагом, который не будет сохранён в
 	// базу данных. Эта функция может использоваться только при формировании нового файла
@@ -170,13 +194,15 @@ private:
 
 	bool ReloadHeader(util::File& file);
 	bool LoadStatBlock(util::File& file);
-	bool LoadDataBlock(util::File& file);
+	bool LoadDataBlock(util::File& file, const DataCodec& codec);
 	bool ParseStats(const char* pData);
-	bool ParseData(const char* pData);
+	bool ParseData(const char* pData, size_t size);
+	bool ParseBinaryData(const uint8_t* pData, size_t size);
 
-	bool SaveHeader(util::File& file);
+	bool SaveHeader(util::File& file, unsigned formatVer);
 	void SaveStats(std::string& out);
 	bool SaveData(util::File& out);
+	bool SaveBinaryData(util::File& out);
 
 private:
 	DBChunkAccessor& m_Chunk;
@@ -203,6 +229,8 @@ private:
 	unsigned m_DataSize = 0;		// Размер несжатого блока данных в байтах
 	uint32_t m_DataCRC = 0;			// CRC несжатого блока данных (dataSize байт)
 	unsigned m_CDataSize = 0;		// Размер сжатого блока данных (расположен сразу за блоком статистики)
+	CodecId m_Codec = {};			// Алгоритм сжатия блока данных (по умолчанию - deflate)
+	uint32_t m_DictId = 0;			// ID словаря, с которым сжат блок данных, или 0
 
 	// Блок статистики
 	unsigned* m_NumCounters = nullptr;	// Количество найденных в интервале палиндромов для каждого шага
@@ -212,6 +240,80 @@ private:
 	DataItems* m_pData = nullptr;		// Массив всех найденных в интервале палиндромов
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   DBNumberView - последовательный перебор чисел блока данных без построения массива DataItems
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Двоичный блок данных (начиная с 6-й версии формата) не разбирается в DataItems целиком: файл отображается в память,
+// сжатый блок распаковывается прямо из отображения в буфер объекта, а каждое следующее число вычисляется из предыдущего
+// и дельты при переходе к нему. Буфер используется повторно для следующих файлов, поэтому режимы, которые только
+// перебирают числа файлов БД, не выделяют память под данные каждого файла. Если данные файла загружены в DBChunk
+// (FULLDATA), то объект перебирает его массив DataItems
+
+//----------------------------------------------------------------------------------------------------------------------
+class DBNumberView final
+{
+	friend class DBChunk;
+	friend class DBChunkData;
+	AML_NONCOPYABLE(DBNumberView)
+
+public:
+	using DataItem = DBChunkData::DataItem;
+	using DataItems = DBChunkData::DataItems;
+
+	// Итератор однопроходного перебора. Каждый вызов функции begin начинает перебор сначала,
+	// при этом все итераторы, полученные ранее, становятся недействительными
+	class Iterator final
+	{
+	public:
+		const DataItem& operator *() const { return m_pView->m_Item; }
+		const DataItem* operator ->() const { return &m_pView->m_Item; }
+		Iterator& operator ++() { if (!m_pView->Next()) m_pView = nullptr; return *this; }
+
+		bool operator ==(const Iterator& rhs) const { return m_pView == rhs.m_pView; }
+		bool operator !=(const Iterator& rhs) const { return m_pView != rhs.m_pView; }
+
+	private:
+		friend class DBNumberView;
+		explicit Iterator(DBNumberView* pView) : m_pView(pView) {}
+		DBNumberView* m_pView;		// Объект перебора или nullptr для итератора end
+	};
+
+	DBNumberView() = default;
+
+	Iterator begin() { return Iterator(Rewind() ? this : nullptr); }
+	Iterator end() { return Iterator(nullptr); }
+
+	size_t size() const { return m_Count; }
+	bool empty() const { return !m_Count; }
+
+	// Возвращает true, если последний перебор был прерван из-за некорректных данных в блоке данных. Блок
+	// проверяется (CRC и заголовок) до начала перебора, а отдельные числа - только при переходе к ним
+	bool HasError() const { return m_HasError; }
+	// Освобождает ссылку на данные файла (буфер при этом не освобождается)
+	void Clear();
+
+private:
+	// Переходит к первому/следующему числу. Возвращают false, если чисел больше нет или данные некорректны
+	bool Rewind();
+	bool Next();
+	// Заполняет m_Item цифрами m_DigitA и шагом числа m_Index (см. PackedBCD::Store о параметре minLength)
+	bool StoreItem(size_t minLength);
+
+	const DataItems* m_pItems = nullptr;	// Массив DataItems загруженного файла или nullptr
+	std::vector<uint8_t> m_Buffer;			// Распакованный двоичный блок данных (в начале буфера)
+	size_t m_Count = 0;						// Количество чисел в блоке данных
+	size_t m_Index = 0;						// Индекс текущего числа
+	unsigned m_MinSavedStep = 0;			// Минимальный сохраняемый шаг (значение MINSTEP файла)
+	uint8_t m_DeltaSize = 0;				// Ширина значения в столбце дельт (см. DataBlockHeader)
+	uint8_t m_StepSize = 0;					// Ширина значения в столбце шагов
+	uint64_t m_DigitA[2] = {};				// Цифры текущего числа (см. PackedBCD в dbchunk.cpp)
+	DataItem m_Item = {};					// Текущее число
+	bool m_HasError = false;				// Перебор прерван из-за некорректных данных
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   DBChunk - основной класс, обособленная часть БД, хранимая в отдельном файле
@@ -261,6 +363,9 @@ public:
 	// равен суммарному времени CPU (в ms), которое было затрачено на проверку добавленных
 	// данных. Если maxCompression равен true, то файл будет сохранён с максимальным сжатием
 	bool Save(DataBase& db, unsigned minSavedStep, unsigned cpuTime, bool maxCompression = false);
+	// Возвращает true, если вызов Save с теми же параметрами codec (алгоритм сжатия БД) и maxCompression
+	// запишет файл, то есть если есть несохранённые изменения или требуется пересжатие файла
+	bool IsSaveNeeded(const DataCodec& codec, bool maxCompression = false) const;
 
 	unsigned GetFormatVer() const { return GetData(State::HEADERONLY)->GetFormatVer(); }
 	const FixNumber& GetFirst() const { CheckState(State::DATAUNLOADED); return m_First; }
@@ -281,7 +386,13 @@ public:
 	unsigned GetDataSize() const { return GetData(State::HEADERONLY)->GetDataSize(); }
 	unsigned GetCDataSize() const { return GetData(State::HEADERONLY)->GetCDataSize(); }
 	unsigned GetFileSize() const { return GetData(State::HEADERONLY)->GetFileSize(); }
-	bool IsMaxCompressed() const { return m_Flags.Check(Flag::MAX_COMPRESSED); }
+	// Возвращает true, если файл сохранён с максимальным сжатием тем же алгоритмом и словарём, что использует
+	// codec, а блок данных хранится в двоичном виде (см. DBChunkData::BINARY_FORMAT_VERSION)
+	bool IsMaxCompressed(const DataCodec& codec) const;
+
+	// Возвращает алгоритм сжатия блока данных и ID словаря (0, если словарь не использовался)
+	CodecId GetCodec() const { return GetData(State::HEADERONLY)->GetCodec(); }
+	uint32_t GetDictId() const { return GetData(State::HEADERONLY)->GetDictId(); }
 
 	const unsigned* GetNumCounters() const { return GetData(State::WITHSTATS)->GetNumCounters(); }
 	unsigned GetHighestStep() const { return GetData(State::WITHSTATS)->GetHighestStep(); }
@@ -290,6 +401,10 @@ public:
 
 	using DataItems = DBChunkData::DataItems;
 	const DataItems& GetNumbers() const { return GetData(State::FULLDATA)->GetNumbers(); }
+	// Предоставляет объекту view числа блока данных в порядке возрастания (см. DBNumberView). Данные должны
+	// быть загружены не менее чем до HEADERONLY. Двоичный блок данных в DBChunk не загружается; если же блок
+	// данных текстовый (старые версии формата), то данные загружаются до FULLDATA. При ошибке вернёт false
+	bool GetNumbers(DataBase& db, DBNumberView& view);
 	// Сортирует числа в DataItems по возрастанию
 	void SortNumbers() { GetData(State::FULLDATA)->SortNumbers(); }
 
@@ -63,3 +63,15 @@ void DBMode::PrintDatabasePath(const std::wstring& path, size_t lengthLimit)
 
 	EventManager::PublishEvent(L"#6Path:#7 " + dbPath);
 }
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBMode::ParseCodecOption()
+{
+	std::string value;
+	if (GetOption("codec", &value) && !m_Data.GetCodec().Set(value))
+	{
+		OnInvalidCmdLine();
+		return false;
+	}
+	return true;
+}
@@ -31,6 +31,10 @@ public:
 	static void PrintDatabasePath(const std::wstring& path, size_t lengthLimit = 60);
 
 protected:
+	// Задаёт алгоритм сжатия файлов БД опцией "--codec=имя[:уровень]" (см. DataCodec::Set). Если
+	// значение опции некорректно, то выводит сообщение об ошибке в командной строке и возвращает false
+	bool ParseCodecOption();
+
 	DataBase m_Data;
 	std::unique_ptr<StepHelper> m_Steps;
 	std::unique_ptr<EventManager> m_Events;
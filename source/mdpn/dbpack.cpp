@@ -0,0 +1,589 @@
+﻿//∙MDPN
+#include "pch.h"
+#include "dbpack.h"
+
+#include "codec.h"
+#include "dbstruct.h"
+#include "util.h"
+
+#include <core/crc32.h>
+#include <core/filesystem.h>
+#include <core/strutil.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   DBFile
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBFile::Open(const std::wstring& path, unsigned flags)
+{
+	Close();
+	if (flags & ~(util::FILE_OPEN_READ | util::FILE_DENY_READ))
+		return false;
+
+	const bool result = m_File.Open(path, flags);
+	m_OpenFlags = result ? m_File.GetOpenFlags() : 0;
+	return result;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBFile::Map(const std::wstring& path)
+{
+	Close();
+	if (!m_Mapping.Open(path))
+		return false;
+
+	m_pData = m_Mapping.GetData();
+	m_Size = m_Mapping.GetSize();
+	m_OpenFlags = util::FILE_OPEN_READ;
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBFile::Open(const uint8_t* pData, size_t size)
+{
+	Close();
+	if (!pData)
+		return false;
+
+	m_pData = pData;
+	m_Size = size;
+	m_Position = 0;
+	m_OpenFlags = util::FILE_OPEN_READ;
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DBFile::Close()
+{
+	m_File.Close();
+	m_Mapping.Close();
+	m_pData = nullptr;
+	m_Size = m_Position = 0;
+	File::Close();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBFile::Read(void* pBuffer, size_t bytesToRead, size_t& bytesRead)
+{
+	if (!m_pData)
+		return m_File.Read(pBuffer, bytesToRead, bytesRead);
+
+	bytesRead = std::min(bytesToRead, m_Size - m_Position);
+	if (bytesRead)
+	{
+		memcpy(pBuffer, m_pData + m_Position, bytesRead);
+		m_Position += bytesRead;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+long long DBFile::GetSize() const
+{
+	return m_pData ? static_cast<long long>(m_Size) : m_File.GetSize();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+long long DBFile::GetPosition() const
+{
+	return m_pData ? static_cast<long long>(m_Position) : m_File.GetPosition();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBFile::SetPosition(long long position)
+{
+	if (!m_pData)
+		return m_File.SetPosition(position);
+
+	// Как и у обычного файла, позиция может быть за концом данных (чтение с неё вернёт 0 байт)
+	if (position < 0)
+		return false;
+	m_Position = static_cast<size_t>(std::min<unsigned long long>(position, m_Size));
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   DBPack
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+struct IndexRecord
+{
+	char path[12];				// Путь к файлу БД (2 символа папки + 10 символов имени, как в DBChunk)
+	uint32_t prefixSize;		// Размер заголовка и блока статистики (их копия записана в индексе)
+	uint64_t offset;			// Смещение образа файла в сегменте
+	uint32_t size;				// Размер образа файла
+	uint32_t fileCRC;			// CRC32 образа файла
+};
+
+static_assert(sizeof(IndexRecord) == 32, "Invalid IndexRecord size");
+
+//----------------------------------------------------------------------------------------------------------------------
+struct SegmentTrailer
+{
+	static constexpr uint8_t VERSION = 1;
+
+	uint64_t indexOffset;		// Смещение сжатого индекса (сразу за последним образом файла)
+	uint32_t cIndexSize;		// Размер сжатого индекса
+	uint32_t indexSize;			// Размер несжатого индекса
+	uint32_t indexCRC;			// CRC32 несжатого индекса
+	uint32_t fileC;				// Количество записей в индексе
+	uint8_t codec;				// Алгоритм сжатия индекса (CodecId, без словаря)
+	uint8_t version;			// Версия формата сегмента (VERSION)
+	uint8_t reserved[2];		// Не используется (всегда 0)
+	char magic[4];				// Сигнатура "MDPS"
+};
+
+static_assert(sizeof(SegmentTrailer) == 32, "Invalid SegmentTrailer size");
+
+// Запись журнала удалений: номер сегмента и путь к файлу БД (12 символов, как в IndexRecord)
+struct JournalRecord {
+	uint32_t segment;
+	char path[12];
+};
+
+static_assert(sizeof(JournalRecord) == 16, "Invalid JournalRecord size");
+
+//----------------------------------------------------------------------------------------------------------------------
+DBPack::~DBPack()
+{
+	CancelSegment();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::Load(const std::wstring& basePath, std::vector<std::wstring>& files)
+{
+	m_Entries.clear();
+	m_Segments.clear();
+	m_IndexData.clear();
+	m_BasePath = basePath;
+
+	std::vector<std::wstring> segmentFiles;
+	std::vector<unsigned> numbers;
+	util::FileSystem::GetFileList(basePath + L"pack-*.seg", segmentFiles);
+	for (const auto& filePath : segmentFiles)
+	{
+		// Имя сегмента: "pack-" + номер (не менее 4 цифр, см. GetSegmentPath) + ".seg"
+		const auto name = util::FileSystem::ExtractFilename(filePath);
+		unsigned number = 0;
+		if (name.size() >= 13 && name.size() <= 18)
+		{
+			for (size_t i = 5; i < name.size() - 4 && number != ~0u; ++i)
+				number = (name[i] >= '0' && name[i] <= '9') ? 10 * number + (name[i] - '0') : ~0u;
+		}
+		if (number && number != ~0u && name == util::FileSystem::ExtractFilename(GetSegmentPath(number)))
+			numbers.push_back(number);
+	}
+	std::sort(numbers.begin(), numbers.end());
+
+	bool result = true;
+	for (unsigned number : numbers)
+	{
+		auto pSegment = std::make_unique<Segment>();
+		pSegment->number = number;
+		if (LoadSegment(pSegment.get()))
+			m_Segments.push_back(std::move(pSegment));
+		else
+			result = false;
+	}
+
+	if (!m_Segments.empty())
+		LoadJournal();
+
+	files.reserve(files.size() + m_Entries.size());
+	for (const auto& item : m_Entries)
+		files.push_back(item.first);
+	return result;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DBPack::ReleaseIndexData()
+{
+	for (auto& item : m_Entries)
+		item.second.prefixOffset = ~size_t(0);
+
+	std::vector<uint8_t>().swap(m_IndexData);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::Open(const std::wstring& path, DBFile& file, bool headerOnly) const
+{
+	auto it = m_Entries.find(path);
+	if (it == m_Entries.end())
+		return false;
+
+	const Entry& entry = it->second;
+	if (headerOnly && entry.prefixOffset != ~size_t(0))
+		return file.Open(m_IndexData.data() + entry.prefixOffset, entry.prefixSize);
+
+	return file.Open(entry.pSegment->file.GetData() + entry.offset, entry.size);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::GetFileInfo(const std::wstring& path, uint64_t& fileSize, uint64_t& fileTime) const
+{
+	auto it = m_Entries.find(path);
+	if (it == m_Entries.end())
+		return false;
+
+	fileSize = it->second.size;
+	fileTime = it->second.pSegment->fileTime;
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::CheckFile(const std::wstring& path) const
+{
+	auto it = m_Entries.find(path);
+	if (it == m_Entries.end())
+		return false;
+
+	const Entry& entry = it->second;
+	return hash::GetCRC32(entry.pSegment->file.GetData() + entry.offset, entry.size) == entry.fileCRC;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::Remove(const std::wstring& path)
+{
+	auto it = m_Entries.find(path);
+	if (it == m_Entries.end() || !AppendJournal(it->second.pSegment, path))
+		return false;
+
+	it->second.pSegment->liveSize -= it->second.size;
+	m_Entries.erase(it);
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::IsInSparseSegment(const std::wstring& path) const
+{
+	auto it = m_Entries.find(path);
+	if (it == m_Entries.end())
+		return false;
+
+	const Segment* pSegment = it->second.pSegment;
+	return 4 * (pSegment->totalSize - pSegment->liveSize) >= pSegment->totalSize;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::BeginSegment()
+{
+	Assert(!m_NewFile.IsOpened());
+
+	m_NewNumber = m_Segments.empty() ? 1 : m_Segments.back()->number + 1;
+	m_NewFileC = 0;
+	m_NewSize = 0;
+	m_NewIndex.clear();
+	m_NewPrefixes.clear();
+
+	return m_NewFile.Open(GetSegmentPath(m_NewNumber) + L".tmp", util::FILE_CREATE_ALWAYS | util::FILE_OPEN_WRITE);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::AddFile(const std::wstring& path, const uint8_t* pData, size_t size, size_t prefixSize)
+{
+	Assert(m_NewFile.IsOpened());
+
+	if (!DBStructure::IsValidPath(path) || !size || size > ~uint32_t(0) || prefixSize > size)
+		return false;
+	if (m_NewFileC && m_NewSize + size > MAX_SEGMENT_SIZE)
+		return false;
+	if (!m_NewFile.Write(pData, size))
+		return false;
+
+	IndexRecord record;
+	PackPath(path, record.path);
+	record.prefixSize = AML_TO_LE32(static_cast<uint32_t>(prefixSize));
+	record.offset = AML_TO_LE64(m_NewSize);
+	record.size = AML_TO_LE32(static_cast<uint32_t>(size));
+	record.fileCRC = AML_TO_LE32(hash::GetCRC32(pData, size));
+
+	const auto pRecord = reinterpret_cast<const uint8_t*>(&record);
+	m_NewIndex.insert(m_NewIndex.end(), pRecord, pRecord + sizeof(record));
+	m_NewPrefixes.insert(m_NewPrefixes.end(), pData, pData + prefixSize);
+	m_NewSize += size;
+	++m_NewFileC;
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::EndSegment()
+{
+	Assert(m_NewFile.IsOpened());
+
+	// Индекс: записи IndexRecord всех образов, за ними копии их заголовков и блоков статистики в том же порядке
+	m_NewIndex.insert(m_NewIndex.end(), m_NewPrefixes.begin(), m_NewPrefixes.end());
+
+	DataCodec codec;
+	std::vector<uint8_t> packedIndex;
+	if (!codec.Compress(m_NewIndex.data(), m_NewIndex.size(), packedIndex))
+	{
+		CancelSegment();
+		return false;
+	}
+
+	SegmentTrailer trailer = {};
+	trailer.indexOffset = AML_TO_LE64(m_NewSize);
+	trailer.cIndexSize = AML_TO_LE32(static_cast<uint32_t>(packedIndex.size()));
+	trailer.indexSize = AML_TO_LE32(static_cast<uint32_t>(m_NewIndex.size()));
+	trailer.indexCRC = AML_TO_LE32(hash::GetCRC32(m_NewIndex.data(), m_NewIndex.size()));
+	trailer.fileC = AML_TO_LE32(static_cast<uint32_t>(m_NewFileC));
+	trailer.codec = static_cast<uint8_t>(codec.GetId());
+	trailer.version = SegmentTrailer::VERSION;
+	memcpy(trailer.magic, "MDPS", 4);
+
+	// Сегмент получает постоянное имя только после того, как он полностью записан на диск
+	const std::wstring path = GetSegmentPath(m_NewNumber);
+	if (!m_NewFile.Write(packedIndex.data(), packedIndex.size()) || !m_NewFile.Write(&trailer, sizeof(trailer)) ||
+		!m_NewFile.Flush())
+	{
+		CancelSegment();
+		return false;
+	}
+	m_NewFile.Close();
+	if (!util::FileSystem::Rename(path + L".tmp", path))
+	{
+		CancelSegment();
+		return false;
+	}
+
+	m_NewIndex.clear();
+	m_NewPrefixes.clear();
+
+	auto pSegment = std::make_unique<Segment>();
+	pSegment->number = m_NewNumber;
+	if (!LoadSegment(pSegment.get()))
+		return false;
+
+	m_Segments.push_back(std::move(pSegment));
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DBPack::CancelSegment()
+{
+	if (m_NewFile.IsOpened())
+	{
+		m_NewFile.Close();
+		util::FileSystem::RemoveFile(GetSegmentPath(m_NewNumber) + L".tmp");
+	}
+	m_NewIndex.clear();
+	m_NewPrefixes.clear();
+	m_NewFileC = 0;
+	m_NewSize = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::RemoveDeadSegments(bool removeAll)
+{
+	if (removeAll)
+		m_Entries.clear();
+
+	bool result = true;
+	for (size_t i = m_Segments.size(); i--;)
+	{
+		Segment* pSegment = m_Segments[i].get();
+		if (pSegment->liveSize && !removeAll)
+			continue;
+
+		// Отображение нужно закрыть до удаления: в Windows файл, отображённый в память, удалить нельзя
+		pSegment->file.Close();
+		if (util::FileSystem::RemoveFile(GetSegmentPath(pSegment->number)))
+			m_Segments.erase(m_Segments.begin() + i);
+		else
+		{
+			result = false;
+			pSegment->file.Open(GetSegmentPath(pSegment->number));
+		}
+	}
+
+	// В журнале оставляем только записи существующих сегментов. Новый журнал также сохраняется под
+	// временным именем: если он не будет записан, то прежний журнал останется корректным
+	std::vector<JournalRecord> records;
+	const std::wstring path = m_BasePath + JOURNAL_FILE_NAME;
+	util::BinaryFile file;
+	if (file.Open(path))
+	{
+		const long long size = file.GetSize();
+		records.resize(size > 0 ? static_cast<size_t>(size) / sizeof(JournalRecord) : 0);
+		if (!records.empty() && !file.Read(records.data(), records.size() * sizeof(JournalRecord)))
+			return false;
+		file.Close();
+	}
+
+	records.erase(std::remove_if(records.begin(), records.end(), [this](const JournalRecord& record) {
+		const unsigned number = AML_TO_LE32(record.segment);
+		return std::none_of(m_Segments.begin(), m_Segments.end(), [number](const std::unique_ptr<Segment>& p) {
+			return p->number == number;
+		});
+	}), records.end());
+
+	if (records.empty())
+		return (!util::FileSystem::FileExists(path) || util::FileSystem::RemoveFile(path)) && result;
+
+	const std::wstring tmpPath = path + L".tmp";
+	if (!file.Open(tmpPath, util::FILE_CREATE_ALWAYS | util::FILE_OPEN_WRITE) ||
+		!file.Write(records.data(), records.size() * sizeof(JournalRecord)) || !file.Flush())
+	{
+		file.Close();
+		util::FileSystem::RemoveFile(tmpPath);
+		return false;
+	}
+	file.Close();
+
+	return util::FileSystem::RemoveFile(path) && util::FileSystem::Rename(tmpPath, path) && result;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::wstring DBPack::GetSegmentPath(unsigned number) const
+{
+	return m_BasePath + util::Format(L"pack-%04u.seg", number);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::LoadSegment(Segment* pSegment)
+{
+	const std::wstring path = GetSegmentPath(pSegment->number);
+	uint64_t osFileSize = 0;
+	if (!::GetFileInfo(path, osFileSize, pSegment->fileTime) || !pSegment->file.Open(path))
+		return false;
+
+	const uint8_t* pData = pSegment->file.GetData();
+	const size_t fileSize = pSegment->file.GetSize();
+	if (fileSize < sizeof(SegmentTrailer))
+		return false;
+
+	SegmentTrailer trailer;
+	memcpy(&trailer, pData + fileSize - sizeof(trailer), sizeof(trailer));
+	const uint64_t indexOffset = AML_TO_LE64(trailer.indexOffset);
+	const size_t cIndexSize = AML_TO_LE32(trailer.cIndexSize);
+	const size_t indexSize = AML_TO_LE32(trailer.indexSize);
+	const size_t fileC = AML_TO_LE32(trailer.fileC);
+	if (memcmp(trailer.magic, "MDPS", 4) || trailer.version != SegmentTrailer::VERSION ||
+		trailer.codec >= static_cast<uint8_t>(CodecId::COUNT) ||
+		indexOffset + cIndexSize + sizeof(trailer) != fileSize || indexSize < fileC * sizeof(IndexRecord))
+	{
+		return false;
+	}
+
+	DataCodec codec;
+	std::vector<uint8_t> index(indexSize);
+	if (!codec.Decompress(static_cast<CodecId>(trailer.codec), 0, pData + indexOffset, cIndexSize, index.data(),
+		indexSize) || hash::GetCRC32(index.data(), indexSize) != AML_TO_LE32(trailer.indexCRC))
+	{
+		return false;
+	}
+
+	// Сначала проверяем все записи индекса, и только потом добавляем их: повреждённый сегмент пропускается целиком
+	std::vector<IndexRecord> records(fileC);
+	size_t prefixOffset = fileC * sizeof(IndexRecord);
+	memcpy(records.data(), index.data(), prefixOffset);
+	for (auto& record : records)
+	{
+		record.prefixSize = AML_TO_LE32(record.prefixSize);
+		record.offset = AML_TO_LE64(record.offset);
+		record.size = AML_TO_LE32(record.size);
+		record.fileCRC = AML_TO_LE32(record.fileCRC);
+		if (!record.size || record.prefixSize > record.size || record.offset + record.size > indexOffset ||
+			!DBStructure::IsValidPath(UnpackPath(record.path)))
+		{
+			return false;
+		}
+		prefixOffset += record.prefixSize;
+	}
+	if (prefixOffset != indexSize)
+		return false;
+
+	prefixOffset = fileC * sizeof(IndexRecord);
+	m_IndexData.reserve(m_IndexData.size() + indexSize - prefixOffset);
+	for (const auto& record : records)
+	{
+		Entry entry;
+		entry.offset = record.offset;
+		entry.size = record.size;
+		entry.fileCRC = record.fileCRC;
+		entry.prefixSize = record.prefixSize;
+		entry.prefixOffset = m_IndexData.size();
+		entry.pSegment = pSegment;
+		m_IndexData.insert(m_IndexData.end(), index.data() + prefixOffset,
+			index.data() + prefixOffset + record.prefixSize);
+		prefixOffset += record.prefixSize;
+
+		// Сегменты загружаются по возрастанию номеров: запись из более нового сегмента заменяет прежнюю
+		auto result = m_Entries.emplace(UnpackPath(record.path), entry);
+		if (!result.second)
+		{
+			result.first->second.pSegment->liveSize -= result.first->second.size;
+			result.first->second = entry;
+		}
+		pSegment->totalSize += record.size;
+		pSegment->liveSize += record.size;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DBPack::LoadJournal()
+{
+	util::BinaryFile file;
+	if (!file.Open(m_BasePath + JOURNAL_FILE_NAME))
+		return;
+
+	// Неполная последняя запись (если запись в журнал была прервана) игнорируется
+	JournalRecord record;
+	while (file.Read(&record, sizeof(record)))
+	{
+		auto it = m_Entries.find(UnpackPath(record.path));
+		if (it != m_Entries.end() && it->second.pSegment->number == AML_TO_LE32(record.segment))
+		{
+			it->second.pSegment->liveSize -= it->second.size;
+			m_Entries.erase(it);
+		}
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool DBPack::AppendJournal(const Segment* pSegment, const std::wstring& path)
+{
+	JournalRecord record;
+	record.segment = AML_TO_LE32(static_cast<uint32_t>(pSegment->number));
+	PackPath(path, record.path);
+
+	util::BinaryFile file;
+	if (!file.Open(m_BasePath + JOURNAL_FILE_NAME, util::FILE_OPEN_READWRITE | util::FILE_OPEN_ALWAYS))
+		return false;
+
+	// Новая запись затирает неполную последнюю запись, если она есть
+	const long long size = file.GetSize();
+	return size >= 0 && file.SetPosition(size - size % sizeof(record)) && file.Write(&record, sizeof(record)) &&
+		file.Flush();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DBPack::PackPath(const std::wstring& path, char* pOut)
+{
+	Assert(path.size() == DBStructure::PATH_LEN);
+
+	pOut[0] = static_cast<char>(path[0]);
+	pOut[1] = static_cast<char>(path[1]);
+	for (size_t i = 2; i < 12; ++i)
+		pOut[i] = static_cast<char>(path[i + 1]);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::wstring DBPack::UnpackPath(const char* pPath)
+{
+	static_assert(DBStructure::PATH_LEN == 17, "Wrong path length");
+	std::wstring path(L"12/1234567890.pal");
+
+	path[0] = static_cast<unsigned char>(pPath[0]);
+	path[1] = static_cast<unsigned char>(pPath[1]);
+	for (size_t i = 2; i < 12; ++i)
+		path[i + 1] = static_cast<unsigned char>(pPath[i]);
+	return path;
+}
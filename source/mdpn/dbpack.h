@@ -0,0 +1,176 @@
+﻿//∙MDPN
+#pragma once
+
+#include "assert.h"
+#include "mappedfile.h"
+
+#include <core/file.h>
+#include <core/platform.h>
+#include <core/util.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   DBFile - файл БД, открытый только для чтения (отдельный файл или образ файла в сегменте)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class DBFile final : public util::File
+{
+public:
+	DBFile() = default;
+	virtual ~DBFile() override { Close(); }
+
+	// Открывает отдельный файл path для чтения (запись в файл не поддерживается)
+	virtual bool Open(const std::wstring& path, unsigned flags = util::FILE_OPEN_READ) override;
+	// Отображает отдельный файл path в память (см. MappedFile)
+	bool Map(const std::wstring& path);
+	// Открывает образ файла в памяти: pData - его начало, size - размер в байтах.
+	// Память объекту не принадлежит и должна оставаться доступной, пока файл открыт
+	bool Open(const uint8_t* pData, size_t size);
+	virtual void Close() override;
+
+	virtual bool IsOpened() const override { return m_pData || m_File.IsOpened(); }
+
+	// Возвращает указатель на содержимое файла, если файл отображён в память или
+	// открыт функцией Open(pData, size); если файл открыт функцией Open(path), то nullptr
+	const uint8_t* GetData() const { return m_pData; }
+
+	using File::Read;
+	virtual bool Read(void* pBuffer, size_t bytesToRead, size_t& bytesRead) override;
+	virtual bool Write(const void*, size_t) override { return false; }
+
+	virtual long long GetSize() const override;
+	virtual long long GetPosition() const override;
+	virtual bool SetPosition(long long position) override;
+	virtual bool Truncate() override { return false; }
+
+private:
+	util::BinaryFile m_File;			// Отдельный файл, открытый функцией Open(path)
+	MappedFile m_Mapping;				// Отдельный файл, открытый функцией Map
+	const uint8_t* m_pData = nullptr;	// Содержимое файла в памяти или nullptr
+	size_t m_Size = 0;					// Размер файла в памяти
+	size_t m_Position = 0;				// Текущая позиция в файле в памяти
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   DBPack - сегменты базы данных (большие файлы, каждый из которых хранит образы множества файлов БД)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Сегмент (файл "pack-NNNN.seg" в корне БД) содержит записанные подряд образы файлов БД (байт в байт), за ними сжатый
+// индекс и заголовок сегмента фиксированного размера в самом конце файла. Индекс содержит путь, смещение, размер и
+// CRC32 каждого образа, а также копию заголовка и блока статистики файла: поэтому инициализация БД читает только
+// индексы сегментов, не обращаясь к самим образам. Сегмент записывается один раз и больше не изменяется: удаление
+// файла из сегмента (или его перенос в отдельный файл при сохранении) отмечается записью в журнале удалений. Если
+// путь встречается в нескольких сегментах, то действительна запись сегмента с наибольшим номером; отдельный файл
+// с тем же путём имеет приоритет над записью в сегменте
+
+//----------------------------------------------------------------------------------------------------------------------
+class DBPack final : AssertHelper<>
+{
+	AML_NONCOPYABLE(DBPack)
+
+public:
+	// Имя журнала удалений в директории БД
+	static constexpr const wchar_t* JOURNAL_FILE_NAME = L"pack-removed.dat";
+	// Предельный размер сегмента: новый сегмент начинается, если очередной образ файла в текущий не помещается
+	static constexpr uint64_t MAX_SEGMENT_SIZE = 1ull << 30;
+
+	DBPack() = default;
+	~DBPack();
+
+	// Загружает индексы всех сегментов в директории basePath и журнал удалений, добавляя в files пути всех файлов
+	// БД, хранящихся в сегментах (в формате DBStructure::Reload). Повреждённые сегменты пропускаются; если хотя
+	// бы один сегмент повреждён, функция вернёт false. Загруженные ранее сегменты предварительно закрываются
+	bool Load(const std::wstring& basePath, std::vector<std::wstring>& files);
+	// Освобождает копии заголовков и блоков статистики из индексов (они нужны только для инициализации БД)
+	void ReleaseIndexData();
+
+	size_t GetFileC() const { return m_Entries.size(); }
+	size_t GetSegmentC() const { return m_Segments.size(); }
+	// Возвращает true, если файл path хранится в сегменте
+	bool Contains(const std::wstring& path) const { return m_Entries.find(path) != m_Entries.end(); }
+	// Открывает образ файла path из сегмента. Если headerOnly равен true, то файл может быть открыт по копии
+	// из индекса: такой файл содержит только заголовок и блок статистики. Возвращает false, если файла нет
+	bool Open(const std::wstring& path, DBFile& file, bool headerOnly = false) const;
+	// Возвращает размер образа файла path и время последней модификации сегмента, в котором он хранится
+	bool GetFileInfo(const std::wstring& path, uint64_t& fileSize, uint64_t& fileTime) const;
+	// Проверяет CRC32 образа файла path. Возвращает false, если файла нет или образ повреждён
+	bool CheckFile(const std::wstring& path) const;
+
+	// Удаляет файл path из сегмента, добавляя запись в журнал удалений
+	bool Remove(const std::wstring& path);
+
+	// Возвращает true, если файл path хранится в сегменте, не менее 1/4 объёма которого занимают удалённые
+	// и заменённые образы файлов. Такие сегменты уплотняются: их файлы переписываются в новые сегменты
+	bool IsInSparseSegment(const std::wstring& path) const;
+
+	// Создаёт новый сегмент (временный файл) для записи образов файлов функцией AddFile
+	bool BeginSegment();
+	// Возвращает true, если новый сегмент создан и ещё не завершён (или не отменён)
+	bool IsWriting() const { return m_NewFile.IsOpened(); }
+	// Добавляет в новый сегмент образ файла path размером size байт. Первые prefixSize байт образа (заголовок
+	// и блок статистики) копируются в индекс. Функция вернёт false, если сегмент уже достиг предельного размера
+	// (в этом случае сегмент нужно завершить и начать новый) или произошла ошибка записи
+	bool AddFile(const std::wstring& path, const uint8_t* pData, size_t size, size_t prefixSize);
+	// Возвращает количество образов файлов, добавленных в новый сегмент
+	size_t GetNewFileC() const { return m_NewFileC; }
+	// Записывает индекс нового сегмента, сохраняет сегмент под постоянным именем и загружает его. С этого момента
+	// добавленные файлы хранятся в новом сегменте (их записи в прежних сегментах становятся недействительными)
+	bool EndSegment();
+	// Отменяет создание нового сегмента, удаляя временный файл
+	void CancelSegment();
+
+	// Удаляет сегменты, в которых не осталось действительных записей (при removeAll - все сегменты), и
+	// перезаписывает журнал удалений, исключая из него записи удалённых сегментов
+	bool RemoveDeadSegments(bool removeAll = false);
+
+private:
+	struct Segment {
+		unsigned number = 0;		// Номер сегмента (из имени файла)
+		MappedFile file;			// Отображение файла сегмента
+		uint64_t fileTime = 0;		// Время последней модификации файла
+		uint64_t totalSize = 0;		// Суммарный размер всех образов в сегменте
+		uint64_t liveSize = 0;		// Суммарный размер действительных образов
+	};
+
+	struct Entry {
+		uint64_t offset;			// Смещение образа в файле сегмента
+		uint32_t size;				// Размер образа
+		uint32_t fileCRC;			// CRC32 образа
+		uint32_t prefixSize;		// Размер заголовка и блока статистики
+		size_t prefixOffset;		// Смещение копии заголовка в m_IndexData
+		Segment* pSegment;			// Сегмент, в котором хранится образ
+	};
+
+	std::wstring GetSegmentPath(unsigned number) const;
+	// Загружает индекс сегмента pSegment. Возвращает false, если сегмент повреждён
+	bool LoadSegment(Segment* pSegment);
+	// Загружает журнал удалений, отмечая перечисленные в нём записи сегментов как удалённые
+	void LoadJournal();
+	bool AppendJournal(const Segment* pSegment, const std::wstring& path);
+
+	// Преобразует путь к файлу БД в 12 символов для индекса и журнала (как в DBChunk) и обратно
+	static void PackPath(const std::wstring& path, char* pOut);
+	static std::wstring UnpackPath(const char* pPath);
+
+	std::wstring m_BasePath;
+	std::vector<std::unique_ptr<Segment>> m_Segments;		// Сегменты по возрастанию номеров
+	std::unordered_map<std::wstring, Entry> m_Entries;		// Действительные записи сегментов
+	std::vector<uint8_t> m_IndexData;						// Копии заголовков и блоков статистики
+
+	// Создаваемый сегмент
+	util::BinaryFile m_NewFile;
+	unsigned m_NewNumber = 0;				// Номер создаваемого сегмента
+	size_t m_NewFileC = 0;					// Количество записанных в сегмент образов
+	uint64_t m_NewSize = 0;					// Размер записанных в сегмент образов
+	std::vector<uint8_t> m_NewIndex;		// Записи индекса (IndexRecord)
+	std::vector<uint8_t> m_NewPrefixes;		// Копии заголовков и блоков статистики
+};
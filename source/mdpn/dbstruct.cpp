@@ -152,38 +152,34 @@ std::wstring DBStructure::GetNewFilePath()
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void DBStructure::OnFileRemoved(const std::wstring& path)
+void DBStructure::OnFileRemoved(const std::wstring& path, bool isPacked)
 {
 	if (!IsValidPath(path))
 		return;
 
 	m_FileNames.Remove(path);
+	if (!isPacked)
+		RemoveFromFolder(GetPathNumber(path), path);
+}
 
-	const unsigned number = GetPathNumber(path);
-	for (size_t i = 0; i < m_Folders.size(); ++i)
-	{
-		Folder& folder = m_Folders[i];
-		if (folder.number != number)
-			continue;
+//----------------------------------------------------------------------------------------------------------------------
+void DBStructure::AddPackedFile(const std::wstring& path)
+{
+	// NB: совпадение имени с именем другого файла возможно только для файла в другой папке. Имя
+	// в этом случае уже занято, а сами файлы не конфликтуют, так как их пути различаются
+	m_FileNames.Insert(path);
+}
 
-		if (folder.fileCount <= 1)
-		{
-			util::FileSystem::RemoveDirectory(m_Db.GetBasePath() + path.substr(0, 2));
-			m_SpareNumbers.push_back(number & 0xff);
-			m_Folders.erase(m_Folders.begin() + i);
-		} else
-		{
-			const size_t count = --folder.fileCount;
-			// При необходимости переместим изменённый элемент влево,
-			// чтобы восстановить неубывающий порядок элементов
-			size_t left = i;
-			while (left && m_Folders[left - 1].fileCount > count)
-				--left;
-			std::swap(m_Folders[left], folder);
-		}
+//----------------------------------------------------------------------------------------------------------------------
+void DBStructure::OnFileMoved(const std::wstring& path, bool isPacked)
+{
+	if (!IsValidPath(path))
+		return;
 
-		break;
-	}
+	if (isPacked)
+		RemoveFromFolder(GetPathNumber(path), path);
+	else
+		AddToFolder(GetPathNumber(path));
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -235,6 +231,59 @@ unsigned DBStructure::GetNextFolder()
 	return right->number;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+void DBStructure::AddToFolder(unsigned number)
+{
+	for (size_t i = 0; i < m_Folders.size(); ++i)
+	{
+		if (m_Folders[i].number != number)
+			continue;
+
+		// При необходимости переместим изменённый элемент вправо,
+		// чтобы восстановить неубывающий порядок элементов
+		const size_t count = ++m_Folders[i].fileCount;
+		size_t right = i;
+		while (right + 1 < m_Folders.size() && m_Folders[right + 1].fileCount < count)
+			++right;
+		std::swap(m_Folders[right], m_Folders[i]);
+		return;
+	}
+
+	auto it = std::find(m_SpareNumbers.begin(), m_SpareNumbers.end(), number);
+	if (it != m_SpareNumbers.end())
+		m_SpareNumbers.erase(it);
+	m_Folders.emplace(m_Folders.begin(), number, 1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DBStructure::RemoveFromFolder(unsigned number, const std::wstring& path)
+{
+	for (size_t i = 0; i < m_Folders.size(); ++i)
+	{
+		Folder& folder = m_Folders[i];
+		if (folder.number != number)
+			continue;
+
+		if (folder.fileCount <= 1)
+		{
+			util::FileSystem::RemoveDirectory(m_Db.GetBasePath() + path.substr(0, 2));
+			m_SpareNumbers.push_back(number & 0xff);
+			m_Folders.erase(m_Folders.begin() + i);
+		} else
+		{
+			const size_t count = --folder.fileCount;
+			// При необходимости переместим изменённый элемент влево,
+			// чтобы восстановить неубывающий порядок элементов
+			size_t left = i;
+			while (left && m_Folders[left - 1].fileCount > count)
+				--left;
+			std::swap(m_Folders[left], folder);
+		}
+
+		break;
+	}
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 unsigned DBStructure::ToNumber(wchar_t hexDigit)
 {
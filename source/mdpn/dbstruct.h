@@ -44,8 +44,13 @@ public:
 	// Генерирует уникальное имя для нового файла; имя сразу отмечается как занятое, поэтому если
 	// файл не был создан, то нужно вызвать OnFileRemoved, чтобы освободить выделенное ему имя
 	std::wstring GetNewFilePath();
-	// Освобождает указанное имя файла
-	void OnFileRemoved(const std::wstring& path);
+	// Освобождает указанное имя файла. Параметр isPacked должен быть равен true, если файл хранился в сегменте
+	void OnFileRemoved(const std::wstring& path, bool isPacked = false);
+
+	// Отмечает имя файла, хранящегося в сегменте (см. DBPack), как занятое. Такие файлы не учитываются в папках
+	void AddPackedFile(const std::wstring& path);
+	// Уведомляет о переносе файла из папки в сегмент (isPacked == true) или обратно. Имя файла остаётся занятым
+	void OnFileMoved(const std::wstring& path, bool isPacked);
 
 	// Удаляет неиспользуемые папки в базе данных. Если параметр recursive == false, то отдельные папки
 	// будут удалены, только если они пусты. При значении true папки удаляются со всем их содержимым
@@ -72,6 +77,9 @@ private:
 	};
 
 	unsigned GetNextFolder();
+	// Изменяют количество файлов в папке number, сохраняя порядок m_Folders. Пустая папка удаляется
+	void AddToFolder(unsigned number);
+	void RemoveFromFolder(unsigned number, const std::wstring& path);
 	static unsigned ToNumber(wchar_t hexDigit);
 	static unsigned GetPathNumber(const std::wstring& path);
 	static void FixPathSlashes(std::wstring& path);
@@ -3,6 +3,7 @@
 #include "largemempages.h"
 
 #include <core/array.h>
+#include <core/exception.h>
 #include <core/winapi.h>
 
 #include <ntsecapi.h>
@@ -57,6 +58,27 @@ static NTSTATUS SetPrivilegeOnAccount(LSA_HANDLE policyHandle, PSID accountSid,
 	}
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+static bool GetNumaNodeAffinity(int node, GROUP_AFFINITY& affinity)
+{
+	// Узел NUMA находится внутри одной группы процессоров. Начиная с Windows Server 2022 узел может охватывать
+	// несколько групп, тогда функция GetNumaNodeProcessorMaskEx возвращает процессоры только основной группы
+	affinity = GROUP_AFFINITY();
+	return node >= 0 && node <= USHRT_MAX && util::WinAPI::CanGetNumaNodeProcessorMaskEx() &&
+		util::WinAPI::GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) && affinity.Mask;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+static void* AllocatePages(size_t sizeInBytes, DWORD allocationType, int numaNode)
+{
+	if (numaNode >= 0 && util::WinAPI::CanVirtualAllocExNuma())
+	{
+		return util::WinAPI::VirtualAllocExNuma(::GetCurrentProcess(), nullptr, sizeInBytes, allocationType,
+			PAGE_READWRITE, static_cast<DWORD>(numaNode));
+	}
+	return ::VirtualAlloc(nullptr, sizeInBytes, allocationType, PAGE_READWRITE);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   LargeMemPages
@@ -64,6 +86,7 @@ static NTSTATUS SetPrivilegeOnAccount(LSA_HANDLE policyHandle, PSID accountSid,
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 bool LargeMemPages::s_IsEnabled = false;
+int LargeMemPages::s_NumaNode = -1;
 
 //----------------------------------------------------------------------------------------------------------------------
 void LargeMemPages::Init()
@@ -90,6 +113,65 @@ size_t LargeMemPages::GetLargePageSize()
 	return ::GetLargePageMinimum();
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+void LargeMemPages::SetNumaNode(int node)
+{
+	s_NumaNode = node;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t LargeMemPages::GetNumaNodeC()
+{
+	ULONG highestNode = 0;
+	if (util::WinAPI::CanGetNumaHighestNodeNumber() && util::WinAPI::GetNumaHighestNodeNumber(&highestNode))
+		return static_cast<size_t>(highestNode) + 1;
+	return 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t LargeMemPages::GetNumaNodeCPUC(int node)
+{
+	GROUP_AFFINITY affinity;
+	if (!GetNumaNodeAffinity(node, affinity))
+		return 0;
+
+	size_t cpuC = 0;
+	for (KAFFINITY mask = affinity.Mask; mask; mask &= mask - 1)
+		++cpuC;
+	return cpuC;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool LargeMemPages::BindThreadToNumaNode(int node)
+{
+	GROUP_AFFINITY affinity;
+	return GetNumaNodeAffinity(node, affinity) && util::WinAPI::CanSetThreadGroupAffinity() &&
+		util::WinAPI::SetThreadGroupAffinity(::GetCurrentThread(), &affinity, nullptr) != FALSE;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void* LargeMemPages::Allocate(size_t sizeInBytes, size_t largePageSize, int numaNode)
+{
+	// Страницы размещаются на узле при первом обращении к ним, а большие страницы - сразу при выделении
+	const int node = (numaNode >= 0) ? numaNode : s_NumaNode;
+	void* p = nullptr;
+	if (largePageSize && !(sizeInBytes & (largePageSize - 1)))
+		p = AllocatePages(sizeInBytes, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, node);
+	if (!p)
+		p = AllocatePages(sizeInBytes, MEM_COMMIT | MEM_RESERVE, node);
+
+	if (!p)
+		throw util::ERuntime("Failed to allocate memory");
+	return p;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LargeMemPages::Free(void* p, size_t)
+{
+	if (p)
+		::VirtualFree(p, 0, MEM_RELEASE);
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void LargeMemPages::AdjustPrivileges()
 {
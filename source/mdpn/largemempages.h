@@ -5,23 +5,46 @@
 class LargeMemPages final
 {
 public:
-	// Инициализирует поддержку больших страниц для приложения. Перед выделением памяти через
-	// VirtualAlloc с флагом MEM_LARGE_PAGES нужно вызвать эту функцию или функцию IsEnabled
+	// Инициализирует поддержку больших страниц для приложения. Перед выделением памяти
+	// функцией Allocate нужно вызвать эту функцию или функцию IsEnabled
 	static void Init();
 
 	// Возвращает true, если поддержка больших страниц активирована. Возвращает false, если большие страницы
-	// памяти недостпуны. Пользователь, от чьего имени запущено приложение, должен иметь право "Блокировка
+	// памяти недоступны. Пользователь, от чьего имени запущено приложение, должен иметь право "Блокировка
 	// страниц в памяти" / "Lock Pages in Memory" в локальной политике прав пользователей Windows
 	static bool IsEnabled();
 
-	// Возвращает размер страницы (для использования с флагом MEM_LARGE_PAGES). Размер
-	// выделяемой через VirtualAlloc памяти должен быть кратен этому значению. Если
-	// процессор не поддерживает большие страницы, то функция вернёт 0
+	// Возвращает размер большой страницы. Размер памяти, выделяемой функцией Allocate большими страницами,
+	// должен быть кратен этому значению. Если процессор не поддерживает большие страницы, то функция вернёт 0
 	static size_t GetLargePageSize();
 
+	// Задаёт узел NUMA, на котором будет размещаться память, выделяемая функцией Allocate (-1 - без
+	// привязки, по умолчанию). Размещение на узле требует Windows Vista, в более ранних версиях ОС
+	// параметр игнорируется
+	static void SetNumaNode(int node);
+
+	// Возвращает количество узлов NUMA: номер старшего узла + 1 (на системе без NUMA есть только узел 0).
+	// Номера узлов могут идти с пропусками, у таких узлов нет процессоров (см. GetNumaNodeCPUC)
+	static size_t GetNumaNodeC();
+	// Возвращает количество логических процессоров узла NUMA node (0, если узел не существует). Информация
+	// о процессорах узлов доступна начиная с Windows 7, в более ранних версиях ОС функция возвращает 0
+	static size_t GetNumaNodeCPUC(int node);
+	// Ограничивает выполнение вызывающего потока процессорами узла NUMA node. Требует Windows 7
+	static bool BindThreadToNumaNode(int node);
+
+	// Выделяет обнулённый блок памяти размером sizeInBytes байт. Если largePageSize не равен 0 и размер блока
+	// кратен ему, то сначала делается попытка выделить память большими страницами. Память размещается на узле
+	// NUMA numaNode, а если он равен -1, то на узле, заданном функцией SetNumaNode (узел предпочтительный: если
+	// на нём нет свободной памяти, то она выделяется на других узлах). В случае ошибки бросает исключение
+	// util::ERuntime
+	static void* Allocate(size_t sizeInBytes, size_t largePageSize, int numaNode = -1);
+	// Освобождает блок памяти p размером sizeInBytes байт, выделенный функцией Allocate
+	static void Free(void* p, size_t sizeInBytes);
+
 private:
 	static void AdjustPrivileges();
 	static bool CheckAlloc();
 
 	static bool s_IsEnabled;
+	static int s_NumaNode;
 };
@@ -0,0 +1,544 @@
+﻿//∙MDPN
+#include "pch.h"
+#include "limbnum.h"
+
+#include <core/exception.h>
+
+#include <intrin.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Вспомогательные функции
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t Pow10(unsigned n)
+{
+	return n ? 10 * Pow10(n - 1) : 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+static constexpr unsigned Log2Ceil(uint32_t n)
+{
+	return (n > 1) ? 1 + Log2Ceil((n + 1) / 2) : 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+class Reverse4Table final
+{
+public:
+	Reverse4Table()
+	{
+		for (unsigned i = 0; i < 10000; ++i)
+			m_Table[i] = static_cast<uint16_t>(i % 10 * 1000 + i / 10 % 10 * 100 + i / 100 % 10 * 10 + i / 1000);
+	}
+
+	// Возвращает число, цифры которого записаны в обратном порядке (x дополняется нулями до 8 цифр)
+	uint32_t Reverse8(uint32_t x) const { return m_Table[x % 10000] * 10000u + m_Table[x / 10000]; }
+
+private:
+	uint16_t m_Table[10000];	// Обратные 4-значные числа (с учётом ведущих нулей)
+};
+
+static const Reverse4Table s_Reverse4;
+
+//----------------------------------------------------------------------------------------------------------------------
+template<uint32_t D>
+static inline __m256i DivideAVX2(__m256i x)
+{
+	// Делит 8 32-битных чисел (каждое меньше 2^27) на константу D. Частное вычисляется как (x * M) >> K, где
+	// K = 27 + ceil(log2(D)), а M = ceil(2^K / D). Для делимых меньше 2^27 результат всегда точный
+	constexpr unsigned K = 27 + Log2Ceil(D);
+	constexpr uint64_t M = ((1ull << K) + D - 1) / D;
+
+	const __m256i m = _mm256_set1_epi64x(M);
+	const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(x, m), K);
+	const __m256i odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), m), K);
+	return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+static inline __m256i Reverse8AVX2(__m256i x)
+{
+	// Векторная версия Reverse4Table::Reverse8. Каждая конечность делится на две 4-значные
+	// половины, которые переворачиваются в 16-битных словах без использования таблицы
+	const __m256i hi = DivideAVX2<10000>(x);
+	const __m256i lo = _mm256_sub_epi32(x, _mm256_madd_epi16(hi, _mm256_set1_epi32(10000)));
+	const __m256i w = _mm256_or_si256(lo, _mm256_slli_epi32(hi, 16));
+
+	// Для 2-значного числа t обратное число равно 10 * t - 99 * (t / 10)
+	const __m256i k10 = _mm256_set1_epi16(10), k99 = _mm256_set1_epi16(99), k100 = _mm256_set1_epi16(100);
+	auto reverse2 = [&](__m256i t) {
+		const __m256i t10 = _mm256_mulhi_epu16(t, _mm256_set1_epi16(6554));
+		return _mm256_sub_epi16(_mm256_mullo_epi16(t, k10), _mm256_mullo_epi16(t10, k99));
+	};
+	const __m256i h = _mm256_srli_epi16(_mm256_mulhi_epu16(w, _mm256_set1_epi16(static_cast<short>(41944))), 6);
+	const __m256i l = _mm256_sub_epi16(w, _mm256_mullo_epi16(h, k100));
+	const __m256i r4 = _mm256_add_epi16(_mm256_mullo_epi16(reverse2(l), k100), reverse2(h));
+
+	// Перевёрнутая младшая половина становится старшей: r = r4.lo * 10000 + r4.hi
+	return _mm256_madd_epi16(r4, _mm256_set1_epi32(0x00012710));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<unsigned S>
+static size_t RAALimbsAVX2(const uint32_t* pIn, uint32_t* pOut, size_t limbC, uint32_t& carry)
+{
+	// Векторная версия цикла операции RAA: обрабатывает группы по 8 конечностей, пока следующие 8 конечностей
+	// обратного числа могут быть прочитаны целиком. Возвращает количество обработанных конечностей. Переносы
+	// между конечностями вычисляются по признаку переполнения (G) и признаку равенства суммы 10^8 - 1 (P)
+	constexpr uint32_t LIMB_BASE = 100000000;
+	constexpr uint32_t P10 = Pow10(S);
+	constexpr uint32_t Q10 = Pow10(8 - S);
+
+	const __m256i revIdx = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i rotIdx = _mm256_set_epi32(0, 7, 6, 5, 4, 3, 2, 1);
+	const __m256i shiftC = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+	const __m256i base = _mm256_set1_epi32(LIMB_BASE);
+	const __m256i base1 = _mm256_set1_epi32(LIMB_BASE - 1);
+	const __m256i one = _mm256_set1_epi32(1);
+
+	// Перевёрнутые конечности исходного числа, начиная со старшей: в i-м слове вектора
+	// находится перевёрнутая конечность с индексом limbC - 1 - (i + номер группы * 8)
+	auto loadReversed = [&](size_t i) {
+		const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIn + limbC - 8 - i));
+		return Reverse8AVX2(_mm256_permutevar8x32_epi32(x, revIdx));
+	};
+
+	// Перевёрнутые конечности делим на 10^S: частное (старшие 8 - S цифр) и остаток (младшие S цифр)
+	auto split = [&](__m256i x, __m256i& q, __m256i& r) {
+		q = S ? DivideAVX2<P10>(x) : x;
+		r = S ? _mm256_sub_epi32(x, _mm256_mullo_epi32(q, _mm256_set1_epi32(P10))) : x;
+	};
+
+	unsigned cr = carry;
+	__m256i q, r;
+	split(loadReversed(0), q, r);
+
+	size_t i = 0;
+	for (; i + 16 <= limbC; i += 8)
+	{
+		__m256i qNext, rNext;
+		split(loadReversed(i + 8), qNext, rNext);
+
+		// Конечности обратного числа: старшие 8 - S цифр текущей перевёрнутой
+		// конечности и младшие S цифр следующей (т.е. соседнего слова вектора)
+		__m256i rev = q;
+		if (S)
+		{
+			const __m256i low = _mm256_permutevar8x32_epi32(_mm256_blend_epi32(r, rNext, 0x01), rotIdx);
+			rev = _mm256_add_epi32(q, _mm256_mullo_epi32(low, _mm256_set1_epi32(Q10)));
+		}
+		q = qNext, r = rNext;
+
+		__m256i sum = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIn + i)), rev);
+		const unsigned g = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(sum, base1)));
+		const unsigned p = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(sum, base1)));
+		const unsigned c = (((g << 1) | cr) + p) ^ p;
+
+		sum = _mm256_add_epi32(sum, _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(c), shiftC), one));
+		sum = _mm256_sub_epi32(sum, _mm256_and_si256(_mm256_cmpgt_epi32(sum, base1), base));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pOut + i), sum);
+
+		cr = c >> 8;
+	}
+
+	_mm256_zeroupper();
+	carry = cr;
+	return i;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   LimbNumber::Reverser
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Класс последовательно (начиная с младшей) возвращает конечности обратного числа. Если длина числа не кратна 8, то
+// старшая конечность дополнена S нулями. Перевернув все конечности и записав их в обратном порядке, мы получим число,
+// умноженное на 10^S. Поэтому каждая конечность обратного числа состоит из старших 8 - S цифр очередной перевёрнутой
+// конечности и младших S цифр следующей за ней. Так как S - константа, то деление на 10^S выполняется умножением
+
+//----------------------------------------------------------------------------------------------------------------------
+template<unsigned S>
+class LimbNumber::Reverser final
+{
+public:
+	// Параметр first задаёт индекс конечности обратного числа, которая будет возвращена первой
+	Reverser(const uint32_t* pLimbs, size_t limbC, size_t first = 0)
+		: m_pNext(pLimbs + limbC - 1 - first)
+	{
+		// NB: для старшей конечности (first = 0) младшие S цифр перевёрнутой конечности - это
+		// дополняющие её нули, для остальных - цифры, уже учтённые в предыдущей конечности
+		m_High = s_Reverse4.Reverse8(*m_pNext--) / Pow10(S);
+	}
+
+	uint32_t Next()
+	{
+		// NB: конечность перед младшей всегда равна 0 (см. GUARD_LIMB_C), поэтому после
+		// последнего вызова значение m_High будет равно 0 без дополнительных проверок
+		const uint32_t high = m_High;
+		const uint32_t v = s_Reverse4.Reverse8(*m_pNext--);
+		if (S == 0)
+		{
+			m_High = v;
+			return high;
+		}
+
+		m_High = v / Pow10(S);
+		const uint32_t low = v - m_High * Pow10(S);
+		return high + low * Pow10(LIMB_DIGIT_C - S);
+	}
+
+private:
+	const uint32_t* m_pNext;	// Указатель на следующую конечность исходного числа
+	uint32_t m_High;			// Старшие 8 - S цифр следующей перевёрнутой конечности
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   LimbNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t LimbNumber::s_ZeroLimbs[GUARD_LIMB_C + 1] = { 0 };
+
+//----------------------------------------------------------------------------------------------------------------------
+LimbNumber::~LimbNumber()
+{
+	if (m_MaxLength)
+	{
+		FreeBuffer(m_pLimbs);
+		FreeBuffer(m_pRAABuffer);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LimbNumber::SetZero()
+{
+	m_Length = 1;
+	if (m_MaxLength)
+		m_pLimbs[0] = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LimbNumber::Set(unsigned long long num)
+{
+	if (m_MaxLength < 20)
+		Allocate(20, false);
+
+	size_t len = 1;
+	for (unsigned long long n = num / 10; n; n /= 10)
+		++len;
+
+	m_pLimbs[0] = static_cast<uint32_t>(num % LIMB_BASE);
+	m_pLimbs[1] = static_cast<uint32_t>(num / LIMB_BASE % LIMB_BASE);
+	m_pLimbs[2] = static_cast<uint32_t>(num / LIMB_BASE / LIMB_BASE);
+	m_Length = len;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LimbNumber::Set(const Number& num)
+{
+	const size_t len = num.m_Length;
+	if (len > m_MaxLength)
+		Allocate(len, false);
+
+	const uint8_t* p = num.m_DigitA;
+	for (size_t i = 0, limbC = (len + LIMB_DIGIT_C - 1) / LIMB_DIGIT_C; i < limbC; ++i)
+	{
+		uint32_t limb = 0;
+		for (size_t j = std::min((i + 1) * LIMB_DIGIT_C, len); j > i * LIMB_DIGIT_C; --j)
+			limb = limb * 10 + p[j - 1];
+		m_pLimbs[i] = limb;
+	}
+	m_Length = len;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LimbNumber::Reserve(size_t maxLength)
+{
+	if (maxLength > m_MaxLength)
+		Allocate(maxLength, true);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool LimbNumber::IsPalindrome() const
+{
+	switch (GetTopPadding())
+	{
+		case 0: return IsPalindrome<0>();
+		case 1: return IsPalindrome<1>();
+		case 2: return IsPalindrome<2>();
+		case 3: return IsPalindrome<3>();
+		case 4: return IsPalindrome<4>();
+		case 5: return IsPalindrome<5>();
+		case 6: return IsPalindrome<6>();
+		default: return IsPalindrome<7>();
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned LimbNumber::GetHash() const
+{
+	constexpr uint32_t FNV_SEED = 0x811c9dc5;
+	constexpr uint32_t FNV_PRIME = 0x01000193;
+
+	uint32_t hash = FNV_SEED;
+	for (size_t i = 0; i < m_Length; i += LIMB_DIGIT_C)
+	{
+		uint32_t limb = m_pLimbs[i / LIMB_DIGIT_C];
+		for (size_t j = std::min(m_Length - i, LIMB_DIGIT_C); j; --j, limb /= 10)
+			hash = (hash ^ (limb % 10)) * FNV_PRIME;
+	}
+	return hash;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::string LimbNumber::AsString() const
+{
+	std::string s(m_Length, '0');
+	for (size_t i = 0; i < m_Length; i += LIMB_DIGIT_C)
+	{
+		uint32_t limb = m_pLimbs[i / LIMB_DIGIT_C];
+		for (size_t j = i, end = std::min(i + LIMB_DIGIT_C, m_Length); j < end; ++j, limb /= 10)
+			s[m_Length - 1 - j] += limb % 10;
+	}
+	return s;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+BigNumber LimbNumber::AsNumber() const
+{
+	BigNumber num;
+	num.Allocate(static_cast<uint32_t>(m_Length));
+	num.m_Length = static_cast<uint32_t>(m_Length);
+
+	uint8_t* p = num.m_DigitA;
+	for (size_t i = 0; i < m_Length; i += LIMB_DIGIT_C)
+	{
+		uint32_t limb = m_pLimbs[i / LIMB_DIGIT_C];
+		for (size_t j = i, end = std::min(i + LIMB_DIGIT_C, m_Length); j < end; ++j, limb /= 10)
+			p[j] = limb % 10;
+	}
+	return num;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool LimbNumber::RAATillPalindrome(unsigned stepC, unsigned& doneC)
+{
+	unsigned count = m_MaxLength ? RAA(stepC, true) : 1;
+	doneC = count ? count : stepC;
+	return count != 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool LimbNumber::RAATillLength(size_t length, unsigned& doneC)
+{
+	doneC = 0;
+	if (m_Length < length)
+	{
+		if (!m_MaxLength)
+		{
+			doneC = 1;
+			return true;
+		}
+
+		while (m_Length < length)
+		{
+			// Количество операций RAA для достижения нужной длины оцениваем так же, как и в BigNumber::RAATillLength
+			unsigned stepC = static_cast<unsigned>(std::min<size_t>(length - m_Length, 0x40000000));
+			stepC = (stepC > 4) ? 2 * stepC - 2 : stepC + stepC / 4;
+
+			if (unsigned count = RAA(stepC, true))
+			{
+				doneC += count;
+				return true;
+			}
+			doneC += stepC;
+		}
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool LimbNumber::operator ==(const LimbNumber& rhs) const
+{
+	if (m_Length != rhs.m_Length)
+		return false;
+
+	for (size_t i = 0, limbC = GetLimbCount(); i < limbC; ++i)
+	{
+		if (m_pLimbs[i] != rhs.m_pLimbs[i])
+			return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+AML_NOINLINE void LimbNumber::Set(const char* pStr, size_t size)
+{
+	if (!size)
+		OnError("Empty string");
+
+	// Пропустим ноли в старших разрядах
+	while (*pStr == '0' && size > 1)
+		++pStr, --size;
+
+	if (size > m_MaxLength)
+		Allocate(size, false);
+
+	for (size_t i = 0, limbC = (size + LIMB_DIGIT_C - 1) / LIMB_DIGIT_C; i < limbC; ++i)
+	{
+		uint32_t limb = 0;
+		const size_t end = size - i * LIMB_DIGIT_C;
+		for (size_t j = (end > LIMB_DIGIT_C) ? end - LIMB_DIGIT_C : 0; j < end; ++j)
+		{
+			const char c = pStr[j];
+			if (c < '0' || c > '9')
+			{
+				SetZero();
+				OnError("Not a valid number");
+			}
+			limb = limb * 10 + (c - '0');
+		}
+		m_pLimbs[i] = limb;
+	}
+	m_Length = size;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+AML_NOINLINE void LimbNumber::Allocate(size_t maxLength, bool copy)
+{
+	if (maxLength > (~size_t(0) >> 3) - 64)
+		OnError("Length is too big");
+
+	// Длину округляем до целого количества конечностей. Дополнительная конечность в конце буфера
+	// используется для переноса, возникающего при операции RAA, когда длина числа кратна 8
+	maxLength = (maxLength + LIMB_DIGIT_C - 1) / LIMB_DIGIT_C * LIMB_DIGIT_C;
+	const size_t limbC = maxLength / LIMB_DIGIT_C + 1;
+
+	uint32_t* pLimbs = AllocateBuffer(limbC);
+	uint32_t* pRAABuffer = AllocateBuffer(limbC);
+
+	if (copy)
+		memcpy(pLimbs, m_pLimbs, sizeof(uint32_t) * GetLimbCount());
+	else
+		m_Length = 1, pLimbs[0] = 0;
+
+	if (m_MaxLength)
+	{
+		FreeBuffer(m_pLimbs);
+		FreeBuffer(m_pRAABuffer);
+	}
+
+	m_pLimbs = pLimbs;
+	m_pRAABuffer = pRAABuffer;
+	m_MaxLength = maxLength;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t* LimbNumber::AllocateBuffer(size_t limbC)
+{
+	uint32_t* p = new uint32_t[GUARD_LIMB_C + limbC];
+	for (size_t i = 0; i < GUARD_LIMB_C; ++i)
+		p[i] = 0;
+
+	return p + GUARD_LIMB_C;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LimbNumber::FreeBuffer(uint32_t* pLimbs)
+{
+	delete[] (pLimbs - GUARD_LIMB_C);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<unsigned S>
+bool LimbNumber::IsPalindrome() const
+{
+	// Сравниваем конечности младшей половины числа с соответствующими конечностями обратного числа
+	Reverser<S> reverser(m_pLimbs, GetLimbCount());
+	for (size_t i = 0, limbC = (m_Length + 2 * LIMB_DIGIT_C - 1) / (2 * LIMB_DIGIT_C); i < limbC; ++i)
+	{
+		if (m_pLimbs[i] != reverser.Next())
+			return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<unsigned S>
+void LimbNumber::RAAStep()
+{
+	const size_t limbC = GetLimbCount();
+	const uint32_t* pIn = m_pLimbs;
+	uint32_t* pOut = m_pRAABuffer;
+
+	// Если процессор поддерживает AVX2 (и для BigNumber не выбрана SSSE3-версия операции
+	// RAA), то большая часть конечностей обрабатывается векторно, остальные - по одной
+	uint32_t carry = 0;
+	size_t first = 0;
+	if (limbC >= 16 && BigNumber::GetRAAKernel() != BigNumber::RAAKernel::SSSE3)
+		first = RAALimbsAVX2<S>(pIn, pOut, limbC, carry);
+
+	Reverser<S> reverser(pIn, limbC, first);
+	for (size_t i = first; i < limbC; ++i)
+	{
+		const uint32_t sum = pIn[i] + reverser.Next() + carry;
+		carry = sum >= LIMB_BASE;
+		pOut[i] = sum - (LIMB_BASE & (0 - carry));
+	}
+
+	// Если старшая конечность была неполной, то перенос из старшего разряда уже учтён в ней (и
+	// длина числа увеличится, если конечность достигла 10^(8 - S)). Иначе он будет в carry
+	if (S)
+		m_Length += pOut[limbC - 1] >= Pow10(LIMB_DIGIT_C - S);
+	else if (carry)
+	{
+		pOut[limbC] = 1;
+		++m_Length;
+	}
+
+	m_pRAABuffer = m_pLimbs;
+	m_pLimbs = pOut;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+AML_NOINLINE void LimbNumber::OnError(const char* pMsg)
+{
+	throw util::ELogic(pMsg ? pMsg : "Unknown error");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned LimbNumber::RAA(unsigned stepC, bool stopOnPalindrome)
+{
+	unsigned doneC = 0;
+	for (unsigned step = 1; step <= stepC; ++step)
+	{
+		// Перенос в старшем разряде может увеличить длину числа на 1 цифру
+		if (m_Length >= m_MaxLength)
+			Allocate(m_Length + 1024, true);
+
+		switch (GetTopPadding())
+		{
+			case 0: RAAStep<0>(); break;
+			case 1: RAAStep<1>(); break;
+			case 2: RAAStep<2>(); break;
+			case 3: RAAStep<3>(); break;
+			case 4: RAAStep<4>(); break;
+			case 5: RAAStep<5>(); break;
+			case 6: RAAStep<6>(); break;
+			default: RAAStep<7>(); break;
+		}
+
+		if (stopOnPalindrome && IsPalindrome())
+		{
+			doneC = step;
+			break;
+		}
+	}
+
+	return doneC;
+}
@@ -0,0 +1,112 @@
+﻿//∙MDPN
+#pragma once
+
+#include "number.h"
+
+#include <core/platform.h>
+#include <core/util.h>
+
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   LimbNumber - длинное число, хранящееся в виде 32-битных "конечностей" по 8 цифр (по основанию 10^8)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Альтернативный движок для "проблемы 196". Сложение выполняется целыми 32-битными числами (1 перенос на 8 цифр),
+// а обратное число формируется поконечностно: цифры каждой конечности переворачиваются с помощью таблицы обратных
+// 4-значных чисел, а сдвиг на (8 - длина % 8) цифр выполняется делением на константу (умножением). Интерфейс класса
+// повторяет интерфейс PackedNumber, поэтому оба класса могут использоваться в шаблонном коде вместо BigNumber
+
+//----------------------------------------------------------------------------------------------------------------------
+class LimbNumber
+{
+	AML_NONCOPYABLE(LimbNumber)
+
+public:
+	LimbNumber() = default;
+	LimbNumber(const char* pNum) { Set(pNum); }
+	LimbNumber(const std::string& num) { Set(num); }
+	LimbNumber(const Number& num) { Set(num); }
+	~LimbNumber();
+
+	void SetZero();
+	void Set(unsigned long long num);
+	void Set(const char* pNum) { Set(pNum, pNum ? strlen(pNum) : 0); }
+	void Set(const std::string& num) { Set(num.c_str(), num.size()); }
+	void Set(const Number& num);
+
+	// Выделяет память, достаточную для хранения числа, состоящего из maxLength цифр.
+	// Также будет выделен временный буфер для операции RAA (такого же размера)
+	void Reserve(size_t maxLength);
+
+	// Возвращает true, если число равно 0
+	bool IsZero() const { return m_Length == 1 && !m_pLimbs[0]; }
+	// Возвращает true, если число является палиндромом
+	bool IsPalindrome() const;
+
+	// Возвращает длину числа (количество цифр)
+	size_t GetLength() const { return m_Length; }
+	// Возвращает 32-битный хеш числа (совпадает с хешем Number с тем же значением)
+	unsigned GetHash() const;
+
+	// Преобразует число в строку
+	std::string AsString() const;
+	// Преобразует число в формат BigNumber
+	BigNumber AsNumber() const;
+
+	// Добавляет к числу обратное ему число (Reverse-And-Add) stepС раз
+	void ReverseAndAdd(unsigned stepC = 1) { if (m_MaxLength) RAA(stepC, false); }
+	// Выполняет над числом операцию Reverse-And-Add до тех пор, пока оно не станет палиндромом, или
+	// не будет выполнено stepC операций. Поведение аналогично функции BigNumber::RAATillPalindrome
+	bool RAATillPalindrome(unsigned stepC, unsigned& doneC);
+	// Выполняет над числом операцию Reverse-And-Add до тех пор, пока оно не станет палиндромом, или не
+	// достигнет длины length цифр. Поведение аналогично функции BigNumber::RAATillLength
+	bool RAATillLength(size_t length, unsigned& doneC);
+
+	LimbNumber& operator =(const char* pNum) { Set(pNum); return *this; }
+	LimbNumber& operator =(const std::string& num) { Set(num); return *this; }
+	LimbNumber& operator =(const Number& num) { Set(num); return *this; }
+
+	bool operator ==(const LimbNumber& rhs) const;
+	bool operator !=(const LimbNumber& rhs) const { return !(*this == rhs); }
+
+protected:
+	static constexpr uint32_t LIMB_BASE = 100000000;	// Основание (10^8)
+	static constexpr size_t LIMB_DIGIT_C = 8;			// Количество цифр в конечности
+	// Количество нулевых конечностей, расположенных перед младшей конечностью числа в каждом из
+	// буферов. Они позволяют при формировании обратного числа читать память без лишних проверок
+	static constexpr size_t GUARD_LIMB_C = 1;
+
+	template<unsigned S> class Reverser;
+
+	void Set(const char* pStr, size_t size);
+	void Allocate(size_t maxLength, bool copy);
+
+	static uint32_t* AllocateBuffer(size_t limbC);
+	static void FreeBuffer(uint32_t* pLimbs);
+
+	size_t GetLimbCount() const { return (m_Length + LIMB_DIGIT_C - 1) / LIMB_DIGIT_C; }
+	// Возвращает количество нулей, которыми дополнена до 8 цифр старшая конечность числа
+	unsigned GetTopPadding() const { return static_cast<unsigned>((LIMB_DIGIT_C - m_Length % LIMB_DIGIT_C) % LIMB_DIGIT_C); }
+
+	template<unsigned S> bool IsPalindrome() const;
+	template<unsigned S> void RAAStep();
+
+	static void OnError(const char* pMsg = nullptr);
+
+	// Если stopOnPalindrome равен false, то функция выполнит ровно stepC операций RAA и вернёт 0. Если
+	// stopOnPalindrome равен true, то функция выполнит не более stepC шагов до нахождения палиндрома.
+	// Если палиндром был получен, то функция вернёт количество выполненных шагов, иначе вернёт 0
+	unsigned RAA(unsigned stepC, bool stopOnPalindrome);
+
+	static uint32_t s_ZeroLimbs[GUARD_LIMB_C + 1];
+
+	size_t m_Length = 1;				// Длина числа (количество цифр)
+	size_t m_MaxLength = 0;				// Макс. допустимое количество цифр в буферах m_pLimbs и m_pRAABuffer
+	// Конечности числа (от 0 до 10^8 - 1), от младших к старшим. Конечности
+	// за пределами длины числа (выше старшей конечности) не определены
+	uint32_t* m_pLimbs = s_ZeroLimbs + GUARD_LIMB_C;
+	uint32_t* m_pRAABuffer = nullptr;	// Временный буфер для операции RAA (такого же размера)
+};
@@ -199,6 +199,8 @@ static void ListAllPalindromes(std::set<Palindrome>& allPalindromes)
 		size_t fileCount = 0;
 		size_t newPalCount = 0;
 		uint32_t lastTick = 0;
+		// Числа файлов перебираются без загрузки блока данных в DBChunk
+		DBNumberView numbers;
 
 		int errorCode = 0;
 		data.ForEachChunk(errorCode, [&](DBChunk* chunk) {
@@ -211,14 +213,14 @@ static void ListAllPalindromes(std::set<Palindrome>& allPalindromes)
 			constexpr size_t LOWEST_STEP = STEP_OF_INTEREST - 10;
 			if (chunk->GetHighestStep() >= LOWEST_STEP)
 			{
-				if (!chunk->LoadData(data, DBChunkState::FULLDATA))
+				if (!chunk->GetNumbers(data, numbers))
 				{
 					aux::Printc("#12\rError loading database chunk\n");
 					return -1;
 				}
 
 				Number num;
-				for (const auto& item : chunk->GetNumbers())
+				for (const auto& item : numbers)
 				{
 					if (item.step >= LOWEST_STEP)
 					{
@@ -241,6 +243,11 @@ static void ListAllPalindromes(std::set<Palindrome>& allPalindromes)
 						}
 					}
 				}
+				if (numbers.HasError())
+				{
+					aux::Printc("#12\rError loading database chunk\n");
+					return -1;
+				}
 			}
 
 			chunk->UnloadData(DBChunkState::DATAUNLOADED);
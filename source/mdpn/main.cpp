@@ -2,6 +2,7 @@
 #include "pch.h"
 
 #include "chkdbmode.h"
+#include "codecmode.h"
 #include "const.h"
 #include "dbase.h"
 #include "dbchunk.h"
@@ -10,7 +11,10 @@
 #include "largemempages.h"
 #include "log.h"
 #include "mode.h"
+#include "limbnum.h"
 #include "number.h"
+#include "packednum.h"
+#include "packmode.h"
 #include "searchmode.h"
 #include "test.h"
 #include "upddbmode.h"
@@ -452,8 +456,8 @@ class AnalyseDBMode final : public Mode
 public:
 	virtual bool Run() override
 	{
-		// Команда "stats" не имеет параметров
-		if (m_Params.size() != 1)
+		// Команда "stats" не имеет параметров и опций
+		if (m_Params.size() != 1 || !m_Options.empty())
 		{
 			OnInvalidCmdLine();
 			return false;
@@ -582,9 +586,10 @@ static void P196ProblemSave(const P196Progress& data, bool saveAsLatest)
 }
 
 //--------------------------------------------------------------------------------------------------------------------------------
+template<class T>
 static void P196Problem(P196Progress& data)
 {
-	BigNumber num;
+	T num;
 	size_t desiredLength = (data.number.size() + 4999999) / 10000000;
 	desiredLength = std::max(desiredLength + 2, size_t(3)) * 10000000;
 	num.Reserve(desiredLength);
@@ -646,7 +651,45 @@ static void P196Problem(P196Progress& data)
 }
 
 //--------------------------------------------------------------------------------------------------------------------------------
-/*static*/ int P196ProblemMain()
+enum class P196Engine
+{
+	Digits,		// BigNumber (1 цифра в байте, по умолчанию)
+	Packed,		// PackedNumber (2 цифры в байте)
+	Limbs		// LimbNumber (конечности по 8 цифр)
+};
+
+//--------------------------------------------------------------------------------------------------------------------------------
+static P196Engine P196ProblemGetEngine(int argCount, const wchar_t* args[])
+{
+	// По умолчанию используется BigNumber, другой движок задаётся параметром командной строки -packed или -limbs.
+	// Длину, начиная с которой тот или иной движок выгоднее, можно оценить тестом Test.Speed.P196Engines
+	for (int i = 1; i < argCount; ++i)
+	{
+		if (!util::StrInsCmp(args[i], L"-digits"))
+			return P196Engine::Digits;
+		if (!util::StrInsCmp(args[i], L"-packed"))
+			return P196Engine::Packed;
+		if (!util::StrInsCmp(args[i], L"-limbs"))
+			return P196Engine::Limbs;
+	}
+	return P196Engine::Digits;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------
+static unsigned P196ProblemGetThreadC(int argCount, const wchar_t* args[])
+{
+	// Количество потоков для операции RAA задаётся опцией командной строки --threads=N (по умолчанию 1). Опция
+	// разбирается так же, как в режимах программы (см. класс Mode), и имеет тот же вид, что и в режиме поиска
+	std::string value;
+	if (!Mode::Create(argCount, args)->GetOption("threads", &value))
+		return 1;
+
+	const unsigned long threadC = IsNumber(value.c_str()) ? strtoul(value.c_str(), nullptr, 10) : 0;
+	return (threadC > 1) ? static_cast<unsigned>(std::min(threadC, 256ul)) : 1;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------
+/*static*/ int P196ProblemMain(int argCount, const wchar_t* args[])
 {
 	const std::string buildVer = GetAppVersion();
 	aux::Printf("196 Palindrome Quest project. Built on %s\n", buildVer.c_str());
@@ -666,7 +709,27 @@ static void P196Problem(P196Progress& data)
 			SeparateWithCommas(data.lychrel).c_str());
 
 		::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_LOWEST);
-		P196Problem(data);
+
+		// Параллельная операция RAA реализована только в BigNumber, поэтому количество потоков учитывается только
+		// им. Масштабируемость по количеству потоков можно оценить тестом Test.Speed.P196Threads
+		const unsigned threadC = P196ProblemGetThreadC(argCount, args);
+		switch (P196ProblemGetEngine(argCount, args))
+		{
+			case P196Engine::Packed:
+				aux::Print("Using packed BCD number representation\n");
+				P196Problem<PackedNumber>(data);
+				break;
+			case P196Engine::Limbs:
+				aux::Print("Using base 10^8 limb number representation\n");
+				P196Problem<LimbNumber>(data);
+				break;
+			default:
+				if (threadC > 1)
+					aux::Printf("Using %u threads per Reverse-And-Add step\n", threadC);
+				BigNumber::SetRAAThreadC(threadC);
+				P196Problem<BigNumber>(data);
+				BigNumber::SetRAAThreadC(1);
+		}
 	}
 
 	return 0;
@@ -1125,6 +1188,10 @@ void Problem49Main()
 		mode = mode->Expand<UpdateDBMode>();
 	else if (mode->IsCommand("stats"))
 		mode = mode->Expand<AnalyseDBMode>();
+	else if (mode->IsCommand("codecs"))
+		mode = mode->Expand<CodecMode>();
+	else if (mode->IsCommand("pack"))
+		mode = mode->Expand<PackMode>();
 	else if (mode->IsCommand("help"))
 		mode = mode->Expand<HelpMode>();
 
@@ -1137,7 +1204,7 @@ extern int ShrinkDBMain();
 //----------------------------------------------------------------------------------------------------------------------
 int wmain(int argCount, const wchar_t* args[])
 {
-	//return GuardedCall(P196ProblemMain, 1);
+	//return GuardedCall(std::bind(P196ProblemMain, argCount, args), 1);
 	//return GuardedCall(AllLychrelsMain, 1);
 	//return GuardedCall(ListAllPalindromesMain, 1);
 	//return GuardedCall(ShrinkDBMain, 1);
@@ -0,0 +1,112 @@
+﻿//∙MDPN
+#include "pch.h"
+#include "mappedfile.h"
+
+#include <core/filesystem.h>
+#include <core/strutil.h>
+#include <core/winapi.h>
+
+#if !AML_OS_WINDOWS
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   MappedFile
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if AML_OS_WINDOWS
+
+//----------------------------------------------------------------------------------------------------------------------
+struct MappedFileSystem : public util::FileSystem
+{
+	using util::FileSystem::MakeLongPath;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+bool MappedFile::Open(const std::wstring& path)
+{
+	if (IsOpened() || path.empty())
+		return false;
+
+	std::wstring tmpPath;
+	auto pLongPath = MappedFileSystem::MakeLongPath(path, tmpPath);
+	HANDLE fileHandle = ::CreateFileW(pLongPath, GENERIC_READ, FILE_SHARE_READ,
+		nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (::GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart > 0 &&
+		static_cast<unsigned long long>(fileSize.QuadPart) <= SIZE_MAX)
+	{
+		// Отображение остаётся действительным после закрытия обоих дескрипторов, пока не будет вызвана UnmapViewOfFile
+		if (HANDLE mappingHandle = ::CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr))
+		{
+			m_pData = static_cast<const uint8_t*>(::MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+			m_Size = m_pData ? static_cast<size_t>(fileSize.QuadPart) : 0;
+			::CloseHandle(mappingHandle);
+		}
+	}
+
+	::CloseHandle(fileHandle);
+	return IsOpened();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void MappedFile::Close()
+{
+	if (m_pData)
+	{
+		::UnmapViewOfFile(m_pData);
+		m_pData = nullptr;
+		m_Size = 0;
+	}
+}
+
+#else
+
+//----------------------------------------------------------------------------------------------------------------------
+bool MappedFile::Open(const std::wstring& path)
+{
+	if (IsOpened() || path.empty())
+		return false;
+
+	const int fd = open(util::ToAnsi(path).c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (!fstat(fd, &st) && st.st_size > 0 && static_cast<unsigned long long>(st.st_size) <= SIZE_MAX)
+	{
+		// Как и в Windows, отображение остаётся действительным после закрытия дескриптора файла
+		const size_t size = static_cast<size_t>(st.st_size);
+		void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED)
+		{
+			madvise(p, size, MADV_SEQUENTIAL);
+			m_pData = static_cast<const uint8_t*>(p);
+			m_Size = size;
+		}
+	}
+
+	close(fd);
+	return IsOpened();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void MappedFile::Close()
+{
+	if (m_pData)
+	{
+		munmap(const_cast<uint8_t*>(m_pData), m_Size);
+		m_pData = nullptr;
+		m_Size = 0;
+	}
+}
+
+#endif // AML_OS_WINDOWS
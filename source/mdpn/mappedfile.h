@@ -0,0 +1,40 @@
+﻿//∙MDPN
+#pragma once
+
+#include <core/platform.h>
+#include <core/util.h>
+
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   MappedFile - файл, отображённый в память (только для чтения)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class MappedFile final
+{
+	AML_NONCOPYABLE(MappedFile)
+
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+
+	// Отображает в память файл path целиком. Дескрипторы файла закрываются сразу после отображения,
+	// поэтому файл остаётся доступным другим процессам на чтение. Пустой файл отобразить нельзя,
+	// для него (как и при любой другой ошибке) функция вернёт false
+	bool Open(const std::wstring& path);
+	void Close();
+
+	bool IsOpened() const { return m_pData != nullptr; }
+
+	// Возвращает указатель на содержимое файла и его размер в байтах. Обращение к памяти отображения
+	// вызывает чтение соответствующих страниц файла, поэтому читать можно только нужную часть файла
+	const uint8_t* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_Size; }
+
+private:
+	const uint8_t* m_pData = nullptr;	// Адрес отображения или nullptr
+	size_t m_Size = 0;					// Размер файла (и отображения) в байтах
+};
@@ -24,6 +24,24 @@ bool Mode::IsCommand(const char* pCmd, bool optional) const
 	return !util::StrInsCmp(m_Params[0], pCmd);
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool Mode::GetOption(const char* pName, std::string* pValue) const
+{
+	if (pName && pName[0])
+	{
+		for (auto& option : m_Options)
+		{
+			if (!util::StrInsCmp(option.first, pName))
+			{
+				if (pValue)
+					*pValue = option.second;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 bool Mode::Run()
 {
@@ -35,15 +53,53 @@ bool Mode::Run()
 void Mode::SetParams(int argC, const wchar_t* argA[])
 {
 	m_Params.clear();
+	m_Options.clear();
 	if (argC > 1 && argA)
 	{
 		m_Params.reserve(argC - 1);
 		for (int i = 1; i < argC; ++i)
 		{
 			const wchar_t* p = argA[i];
-			m_Params.push_back(util::ToAnsi(p ? p : L""));
+			std::string param = util::ToAnsi(p ? p : L"");
+
+			// Параметры вида --имя[=значение] являются опциями. Они могут стоять в любом месте командной
+			// строки и не учитываются при определении команды (первого параметра командной строки)
+			if (param.size() > 2 && param[0] == '-' && param[1] == '-')
+			{
+				const size_t pos = param.find('=');
+				if (pos == std::string::npos)
+					m_Options.emplace_back(param.substr(2), std::string());
+				else
+					m_Options.emplace_back(param.substr(2, pos - 2), param.substr(pos + 1));
+			}
+			else
+				m_Params.push_back(std::move(param));
+		}
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool Mode::CheckOptions(std::initializer_list<const char*> names) const
+{
+	for (auto& option : m_Options)
+	{
+		bool isKnown = false;
+		for (const char* pName : names)
+		{
+			if (!util::StrInsCmp(option.first, pName))
+			{
+				isKnown = true;
+				break;
+			}
+		}
+
+		if (!isKnown)
+		{
+			OnInvalidCmdLine();
+			return false;
 		}
 	}
+	return true;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
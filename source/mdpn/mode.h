@@ -3,6 +3,7 @@
 
 #include <core/util.h>
 
+#include <initializer_list>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -35,6 +36,7 @@ public:
 		static_assert(std::is_base_of<Mode, T>::value, "Incorrect type");
 		std::unique_ptr<Mode> obj = std::make_unique<T>();
 		std::swap(obj->m_Params, m_Params);
+		std::swap(obj->m_Options, m_Options);
 		return obj;
 	}
 
@@ -42,15 +44,26 @@ public:
 	// до регистра букв) с pCmd или если командная строка пуста и optional == true
 	bool IsCommand(const char* pCmd, bool optional = false) const;
 
+	// Возвращает true, если в командной строке задана опция --<pName>[=значение]
+	// (имя сравнивается с точностью до регистра букв). Значение опции (или пустая
+	// строка, если оно не задано) копируется в pValue, если он отличен от nullptr
+	bool GetOption(const char* pName, std::string* pValue = nullptr) const;
+
 	// Выполняет основную работу
 	virtual bool Run();
 
 protected:
 	void SetParams(int argC, const wchar_t* argA[]);
 
+	// Возвращает true, если все опции командной строки входят в список допустимых для режима names.
+	// Иначе выводит сообщение о некорректной командной строке (OnInvalidCmdLine) и возвращает false
+	bool CheckOptions(std::initializer_list<const char*> names = {}) const;
+
 	void OnCmdNotRecognized() const;
 	void OnInvalidCmdLine() const;
 
-	// Параметры командной строки
+	// Параметры командной строки (кроме опций)
 	std::vector<std::string> m_Params;
+	// Опции командной строки (параметры вида --имя[=значение]): пары имя/значение
+	std::vector<std::pair<std::string, std::string>> m_Options;
 };
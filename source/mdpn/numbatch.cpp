@@ -0,0 +1,262 @@
+﻿//∙MDPN
+#include "pch.h"
+#include "numbatch.h"
+
+#include <core/exception.h>
+
+#include <intrin.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Вспомогательные классы
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Обёртки векторных инструкций для SSSE3- и AVX2-версий операции NumberBatch::RAA. Все операции выполняются над
+// байтами (Max - над беззнаковыми); "маски" - это векторы, каждый байт которых равен 0 или 0xff (результаты сравнений)
+
+//----------------------------------------------------------------------------------------------------------------------
+struct VectorSSE
+{
+	using T = __m128i;
+	static constexpr size_t SIZE = 16;
+
+	static T Load(const uint8_t* p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+	static void Store(uint8_t* p, T v) { _mm_store_si128(reinterpret_cast<__m128i*>(p), v); }
+	static T Set(char v) { return _mm_set1_epi8(v); }
+
+	static T Add(T a, T b) { return _mm_add_epi8(a, b); }
+	static T Sub(T a, T b) { return _mm_sub_epi8(a, b); }
+	static T And(T a, T b) { return _mm_and_si128(a, b); }
+	static T AndNot(T a, T b) { return _mm_andnot_si128(a, b); }
+	static T Or(T a, T b) { return _mm_or_si128(a, b); }
+	static T Max(T a, T b) { return _mm_max_epu8(a, b); }
+	static T CmpEq(T a, T b) { return _mm_cmpeq_epi8(a, b); }
+	static T CmpGt(T a, T b) { return _mm_cmpgt_epi8(a, b); }
+	// Возвращает байты b там, где байты mask равны 0xff, и байты a в остальных позициях
+	static T Blend(T a, T b, T mask) { return _mm_or_si128(_mm_andnot_si128(mask, a), _mm_and_si128(mask, b)); }
+	static uint32_t MoveMask(T v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+struct VectorAVX2
+{
+	using T = __m256i;
+	static constexpr size_t SIZE = 32;
+
+	static T Load(const uint8_t* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+	static void Store(uint8_t* p, T v) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+	static T Set(char v) { return _mm256_set1_epi8(v); }
+
+	static T Add(T a, T b) { return _mm256_add_epi8(a, b); }
+	static T Sub(T a, T b) { return _mm256_sub_epi8(a, b); }
+	static T And(T a, T b) { return _mm256_and_si256(a, b); }
+	static T AndNot(T a, T b) { return _mm256_andnot_si256(a, b); }
+	static T Or(T a, T b) { return _mm256_or_si256(a, b); }
+	static T Max(T a, T b) { return _mm256_max_epu8(a, b); }
+	static T CmpEq(T a, T b) { return _mm256_cmpeq_epi8(a, b); }
+	static T CmpGt(T a, T b) { return _mm256_cmpgt_epi8(a, b); }
+	static T Blend(T a, T b, T mask) { return _mm256_blendv_epi8(a, b, mask); }
+	static uint32_t MoveMask(T v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   NumberBatch
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+NumberBatch::NumberBatch()
+	: m_Rows(new Row[4 * ROW_C])
+{
+	m_pDigits = m_Rows.get();
+	m_pReversed = m_pDigits + ROW_C;
+	m_pDigitsOut = m_pReversed + ROW_C;
+	m_pReversedOut = m_pDigitsOut + ROW_C;
+
+	Clear();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NumberBatch::Clear()
+{
+	memset(&m_Lengths, 0, sizeof(m_Lengths));
+	m_MaxLength = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NumberBatch::SetLane(size_t lane, const Number& num)
+{
+	if (lane >= LANE_C || num.m_Length > MAX_LENGTH)
+		OnError(lane >= LANE_C ? "Invalid lane index" : "Too big number");
+
+	const size_t len = num.m_Length;
+	const uint8_t* pDigits = num.m_DigitA;
+	for (size_t r = 0; r < len; ++r)
+	{
+		m_pDigits[r].laneA[lane] = pDigits[r];
+		m_pReversed[r].laneA[lane] = pDigits[len - r - 1];
+	}
+
+	const size_t oldLen = m_Lengths.laneA[lane];
+	m_Lengths.laneA[lane] = static_cast<uint8_t>(len);
+	if (len > m_MaxLength)
+		m_MaxLength = len;
+	else if (oldLen == m_MaxLength)
+		UpdateMaxLength();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NumberBatch::ClearLane(size_t lane)
+{
+	if (lane >= LANE_C)
+		OnError("Invalid lane index");
+
+	// Цифры за пределами длины числа операция RAA не использует, поэтому их очищать не нужно
+	const size_t len = m_Lengths.laneA[lane];
+	m_Lengths.laneA[lane] = 0;
+	if (len == m_MaxLength)
+		UpdateMaxLength();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NumberBatch::GetLane(size_t lane, Number& num) const
+{
+	const size_t len = GetLength(lane);
+	if (!len)
+	{
+		num.SetZero();
+		return;
+	}
+
+	if (len > num.m_MaxLength)
+		num.Allocate(static_cast<uint32_t>(len));
+	num.m_Length = static_cast<uint32_t>(len);
+
+	for (size_t r = 0; r < len; ++r)
+		num.m_DigitA[r] = m_pDigits[r].laneA[lane];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t NumberBatch::GetActiveMask() const
+{
+	uint32_t mask = 0;
+	for (size_t i = 0; i < LANE_C; ++i)
+		mask |= m_Lengths.laneA[i] ? (1u << i) : 0;
+	return mask;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t NumberBatch::ReverseAndAdd()
+{
+	if (m_MaxLength >= MAX_LENGTH)
+		OnError("Too big number");
+
+	const uint32_t palMask = (BigNumber::GetRAAKernel() != BigNumber::RAAKernel::SSSE3) ?
+		RAA<VectorAVX2>() : RAA<VectorSSE>();
+
+	std::swap(m_pDigits, m_pDigitsOut);
+	std::swap(m_pReversed, m_pReversedOut);
+	// Если число максимальной длины получило новый старший разряд, то строка m_MaxLength не будет нулевой
+	if (!IsEmptyRow(m_pDigits[m_MaxLength]))
+		++m_MaxLength;
+
+	return palMask;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class V>
+uint32_t NumberBatch::RAA()
+{
+	using T = typename V::T;
+
+	const T zero = V::Set(0);
+	const T one = V::Set(1);
+	const T nine = V::Set(9);
+	const T ten = V::Set(10);
+
+	// Строка top всегда находится за пределами всех чисел; в неё может попасть только новый старший разряд
+	const size_t top = m_MaxLength;
+	uint32_t palMask = 0;
+
+	for (size_t part = 0; part < LANE_C; part += V::SIZE)
+	{
+		// Прямой проход: сумма s цифр числа и обратного числа с переносом. Если перенос пришёл в строку,
+		// номер которой равен длине числа, то число удлиняется на 1 цифру (grow). Строки за пределами
+		// чисел могут содержать "мусор", поэтому в них сумма s обнуляется. Суммы s сохраняются в
+		// массиве m_pReversedOut[1...]: обратный проход читает строку r + 1 раньше, чем пишет в неё
+		const T len = V::Load(m_Lengths.laneA + part);
+		T row = zero, carry = zero, grow = zero;
+		for (size_t r = 0; r <= top; ++r)
+		{
+			const T outside = V::CmpEq(V::Max(len, row), row);
+			const T s = V::AndNot(outside, V::Add(V::Load(m_pDigits[r].laneA + part), V::Load(m_pReversed[r].laneA + part)));
+			V::Store(m_pReversedOut[r + 1].laneA + part, s);
+			const T t = V::Sub(s, carry);
+			grow = V::Or(grow, V::And(V::CmpEq(len, row), carry));
+
+			carry = V::CmpGt(t, nine);
+			V::Store(m_pDigitsOut[r].laneA + part, V::Sub(t, V::And(carry, ten)));
+			row = V::Add(row, one);
+		}
+		V::Store(m_pDigitsOut[top + 1].laneA + part, zero);
+		V::Store(m_Lengths.laneA + part, V::Sub(len, grow));
+
+		// Обратный проход. Цифра r обратного числа - это цифра (len - 1 - r) результата, которая равна
+		// (s[r] + перенос в разряд len - 1 - r) % 10, так как s[r] == s[len - 1 - r]. Этот перенос (d)
+		// возникает, если для некоторого j > r s[j] > 9, а все s[i] при r < i < j равны 9. Если число
+		// удлинилось, то обратное число сдвигается на 1 разряд, а его младшей цифрой становится 1
+		T sNext = zero, dNext = zero, tNext = zero;
+		T equal = V::Set(-1);
+		for (size_t r = top + 1; r-- > 0; )
+		{
+			const T s = V::Load(m_pReversedOut[r + 1].laneA + part);
+			const T d = V::Or(V::CmpGt(sNext, nine), V::And(V::CmpEq(sNext, nine), dNext));
+			T t = V::Sub(s, d);
+			t = V::Sub(t, V::And(V::CmpGt(t, nine), ten));
+
+			const T rev = V::Blend(tNext, t, grow);
+			V::Store(m_pReversedOut[r + 1].laneA + part, rev);
+			equal = V::And(equal, V::CmpEq(V::Load(m_pDigitsOut[r + 1].laneA + part), rev));
+
+			sNext = s;
+			dNext = d;
+			tNext = t;
+		}
+		const T rev = V::Blend(tNext, one, grow);
+		V::Store(m_pReversedOut[0].laneA + part, rev);
+		equal = V::And(equal, V::CmpEq(V::Load(m_pDigitsOut[0].laneA + part), rev));
+
+		// Пустые дорожки (длина числа равна 0) палиндромами не считаются
+		equal = V::AndNot(V::CmpEq(len, zero), equal);
+		palMask |= V::MoveMask(equal) << part;
+	}
+
+	return palMask;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NumberBatch::UpdateMaxLength()
+{
+	uint8_t maxLength = 0;
+	for (size_t i = 0; i < LANE_C; ++i)
+		maxLength = std::max(maxLength, m_Lengths.laneA[i]);
+	m_MaxLength = maxLength;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool NumberBatch::IsEmptyRow(const Row& row)
+{
+	const uint64_t* p = reinterpret_cast<const uint64_t*>(row.laneA);
+	uint64_t v = 0;
+	for (size_t i = 0; i < LANE_C / 8; ++i)
+		v |= p[i];
+	return !v;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+AML_NOINLINE void NumberBatch::OnError(const char* pMsg)
+{
+	throw util::ELogic(pMsg ? pMsg : "Unknown error");
+}
@@ -0,0 +1,76 @@
+﻿//∙MDPN
+#pragma once
+
+#include "number.h"
+
+#include <core/platform.h>
+#include <core/util.h>
+
+#include <memory>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   NumberBatch - группа коротких чисел, над которыми операция RAA выполняется одновременно
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Класс хранит до LANE_C чисел в "транспонированном" виде: строка r содержит r-ые цифры (от младшего разряда) всех
+// чисел, по 1 байту на число (дорожку). Одна операция RAA над всеми числами выполняется двумя проходами по строкам,
+// каждый из которых обрабатывает все дорожки одной векторной инструкцией. Прямой проход складывает число с обратным
+// ему и распространяет переносы от младших разрядов к старшим. Для формирования следующего обратного числа не нужно
+// переставлять цифры каждой дорожки (длины чисел разные): до переносов сумма симметрична, поэтому обратное число
+// отличается от неё только переносами, пришедшими в симметричные разряды, а их можно вычислить обратным проходом
+// (от старших строк к младшим). Во время обратного прохода также выполняется проверка результата на палиндром
+
+//----------------------------------------------------------------------------------------------------------------------
+class NumberBatch
+{
+	AML_NONCOPYABLE(NumberBatch)
+
+public:
+	static constexpr size_t LANE_C = 32;		// Количество дорожек (чисел в группе)
+	static constexpr size_t MAX_LENGTH = 255;	// Максимальная длина числа в группе (длины хранятся в байтах)
+
+	NumberBatch();
+
+	// Очищает все дорожки
+	void Clear();
+
+	// Помещает число num в дорожку lane (предыдущее число в ней будет удалено)
+	void SetLane(size_t lane, const Number& num);
+	// Удаляет число из дорожки lane. Пустые дорожки не участвуют в операции RAA
+	void ClearLane(size_t lane);
+	// Копирует число из дорожки lane в num. Если дорожка пуста, то num будет равно 0
+	void GetLane(size_t lane, Number& num) const;
+
+	// Возвращает длину числа в дорожке lane (0, если дорожка пуста)
+	size_t GetLength(size_t lane) const { return m_Lengths.laneA[lane]; }
+	// Возвращает наибольшую длину числа среди всех дорожек
+	size_t GetMaxLength() const { return m_MaxLength; }
+	// Возвращает маску непустых дорожек (бит i соответствует дорожке i)
+	uint32_t GetActiveMask() const;
+
+	// Выполняет операцию RAA над числами всех непустых дорожек. Наибольшая длина числа до операции не должна
+	// превышать MAX_LENGTH - 1. Возвращает маску дорожек, числа в которых после операции стали палиндромами
+	uint32_t ReverseAndAdd();
+
+protected:
+	static constexpr size_t ROW_C = MAX_LENGTH + 2;		// Количество строк в каждом массиве
+
+	// Строки массивов цифр. Значения в строках, начиная с длины числа дорожки, не определены
+	struct Row { alignas(LANE_C) uint8_t laneA[LANE_C]; };
+
+	template<class V> uint32_t RAA();
+	void UpdateMaxLength();
+	static bool IsEmptyRow(const Row& row);
+
+	static void OnError(const char* pMsg = nullptr);
+
+	std::unique_ptr<Row[]> m_Rows;	// Все массивы строк (один блок памяти)
+	Row* m_pDigits = nullptr;		// Цифры чисел (от младших разрядов к старшим)
+	Row* m_pReversed = nullptr;		// Цифры обратных чисел (от младших разрядов к старшим)
+	Row* m_pDigitsOut = nullptr;	// Временные массивы для результата операции RAA
+	Row* m_pReversedOut = nullptr;
+	Row m_Lengths;					// Длины чисел всех дорожек (0 - пустая дорожка)
+	size_t m_MaxLength = 0;			// Наибольшая длина числа среди всех дорожек
+};
@@ -4,6 +4,7 @@
 
 #include <core/array.h>
 #include <core/exception.h>
+#include <core/winapi.h>
 
 #include <intrin.h>
 
@@ -223,7 +224,8 @@ Number& Number::operator =(const Number& rhs)
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-Number& Number::operator =(const FixNumber& rhs)
+template<size_t SIZE>
+Number& Number::operator =(const BasicFixNumber<SIZE>& rhs)
 {
 	uint32_t len = rhs.m_Length;
 	if (len > m_MaxLength)
@@ -647,7 +649,7 @@ AML_NOINLINE void Number::OnError(const char* pMsg)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
-//   FixNumber
+//   BasicFixNumber
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -660,7 +662,45 @@ AML_NOINLINE void Number::OnError(const char* pMsg)
 #endif
 
 //----------------------------------------------------------------------------------------------------------------------
-unsigned FixNumber::GetHash() const
+template<size_t SIZE>
+bool BasicFixNumber<SIZE>::SetPackedDigits(const uint8_t* pDigits, size_t length)
+{
+	static_assert(OBJ_SIZE > 8, "Object is too small for 8-byte reads");
+
+	if (!length || length > MAX_LENGTH)
+		return false;
+
+	// Старшая цифра числа длиннее 1 знака не может быть нолём
+	const size_t top = (pDigits[(length - 1) / 2] >> 4 * ((length - 1) & 1)) & 0xf;
+	if (!top && length > 1)
+		return false;
+
+	// Цифры проверяем словами по 8 байт (последнее слово может перекрываться с предыдущим). Цифра больше 9
+	// имеет установленный 3-й бит и хотя бы один из битов 1 и 2. Цифры за пределами длины числа не проверяются
+	for (size_t i = 0; 2 * i < length; i += 8)
+	{
+		const size_t pos = std::min(i, OBJ_SIZE - 9);
+		uint64_t v;
+		memcpy(&v, pDigits + pos, 8);
+		v = AML_TO_LE64(v);
+		const size_t digitC = length - 2 * pos;
+		if (digitC < 16)
+			v &= (1ull << 4 * digitC) - 1;
+		if ((v >> 3) & ((v >> 2) | (v >> 1)) & 0x1111111111111111)
+			return false;
+	}
+
+	memcpy(m_DigitA + 1, pDigits, OBJ_SIZE - 1);
+	m_Length = static_cast<uint8_t>(length);
+	// При нечётной длине старшие 4 бита последнего байта должны быть равны 0
+	if (length & 1)
+		m_DigitA[1 + length / 2] &= 0xf;
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t SIZE>
+unsigned BasicFixNumber<SIZE>::GetHash() const
 {
 	constexpr uint32_t FNV_SEED = 0x811c9dc5;
 	constexpr uint32_t FNV_PRIME = 0x01000193;
@@ -677,7 +717,27 @@ unsigned FixNumber::GetHash() const
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-FixNumber& FixNumber::operator =(const Number& rhs)
+template<size_t SIZE>
+uint64_t BasicFixNumber<SIZE>::GetHash64() const
+{
+	constexpr uint64_t FNV_SEED = 0xcbf29ce484222325;
+	constexpr uint64_t FNV_PRIME = 0x00000100000001b3;
+
+	// Значимые байты объекта - байт длины и байты упакованных цифр (остальные байты могут содержать "мусор").
+	// Старшие биты хеша FNV-1a плохо зависят от последних байтов, поэтому в конце биты хеша перемешиваются
+	uint64_t hash = FNV_SEED;
+	const size_t byteC = (m_Length + 3) / 2;
+	for (size_t i = 0; i < byteC; ++i)
+		hash = (hash ^ m_DigitA[i]) * FNV_PRIME;
+
+	hash = (hash ^ (hash >> 33)) * 0xff51afd7ed558ccd;
+	hash = (hash ^ (hash >> 33)) * 0xc4ceb9fe1a85ec53;
+	return hash ^ (hash >> 33);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t SIZE>
+BasicFixNumber<SIZE>& BasicFixNumber<SIZE>::operator =(const Number& rhs)
 {
 	if (rhs.m_Length > MAX_LENGTH)
 		Number::OnError("Too big number");
@@ -698,7 +758,8 @@ FixNumber& FixNumber::operator =(const Number& rhs)
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-FixNumber& FixNumber::operator =(const char* pNum)
+template<size_t SIZE>
+BasicFixNumber<SIZE>& BasicFixNumber<SIZE>::operator =(const char* pNum)
 {
 	if (!pNum || !pNum[0])
 		Number::OnError("Empty string");
@@ -734,7 +795,21 @@ FixNumber& FixNumber::operator =(const char* pNum)
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool FixNumber::operator ==(const FixNumber& rhs) const
+template<size_t SIZE>
+template<size_t S>
+BasicFixNumber<SIZE>& BasicFixNumber<SIZE>::operator =(const BasicFixNumber<S>& rhs)
+{
+	if (rhs.m_Length > MAX_LENGTH)
+		Number::OnError("Too big number");
+
+	// Формат упакованных цифр не зависит от размера объекта: копируем байт длины и значимые байты цифр
+	memcpy(m_DigitA, rhs.m_DigitA, (rhs.m_Length + 3) / 2);
+	return *this;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t SIZE>
+bool BasicFixNumber<SIZE>::operator ==(const BasicFixNumber& rhs) const
 {
 	auto pL = reinterpret_cast<const size_t*>(m_DigitA);
 	auto pR = reinterpret_cast<const size_t*>(rhs.m_DigitA);
@@ -745,7 +820,7 @@ bool FixNumber::operator ==(const FixNumber& rhs) const
 			if (OBJ_SIZE & (sizeof(size_t) - 1))
 			{
 				// Этот блок будет использован только в 64-битной конфигурации, когда размер
-				// FixNumber не кратен 8 байтам (проверка оставшихся 1-4 байт массива цифр)
+				// объекта не кратен 8 байтам (проверка оставшихся 1-4 байт массива цифр)
 				const uint32_t mask = FXNUM_ESHIFT(~0u, 8 * (4 - len));
 				auto pL4 = reinterpret_cast<const uint32_t*>(pL);
 				auto pR4 = reinterpret_cast<const uint32_t*>(pR);
@@ -760,7 +835,8 @@ bool FixNumber::operator ==(const FixNumber& rhs) const
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool FixNumber::operator !=(const FixNumber& rhs) const
+template<size_t SIZE>
+bool BasicFixNumber<SIZE>::operator !=(const BasicFixNumber& rhs) const
 {
 	auto pL = reinterpret_cast<const size_t*>(m_DigitA);
 	auto pR = reinterpret_cast<const size_t*>(rhs.m_DigitA);
@@ -771,7 +847,7 @@ bool FixNumber::operator !=(const FixNumber& rhs) const
 			if (OBJ_SIZE & (sizeof(size_t) - 1))
 			{
 				// Этот блок будет использован только в 64-битной конфигурации, когда размер
-				// FixNumber не кратен 8 байтам (проверка оставшихся 1-4 байт массива цифр)
+				// объекта не кратен 8 байтам (проверка оставшихся 1-4 байт массива цифр)
 				const uint32_t mask = FXNUM_ESHIFT(~0u, 8 * (4 - len));
 				auto pL4 = reinterpret_cast<const uint32_t*>(pL);
 				auto pR4 = reinterpret_cast<const uint32_t*>(pR);
@@ -786,7 +862,8 @@ bool FixNumber::operator !=(const FixNumber& rhs) const
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool FixNumber::operator ==(const Number& rhs) const
+template<size_t SIZE>
+bool BasicFixNumber<SIZE>::operator ==(const Number& rhs) const
 {
 	if (m_Length != rhs.m_Length)
 		return false;
@@ -803,7 +880,8 @@ bool FixNumber::operator ==(const Number& rhs) const
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool FixNumber::operator !=(const Number& rhs) const
+template<size_t SIZE>
+bool BasicFixNumber<SIZE>::operator !=(const Number& rhs) const
 {
 	if (m_Length != rhs.m_Length)
 		return true;
@@ -820,7 +898,8 @@ bool FixNumber::operator !=(const Number& rhs) const
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool FixNumber::operator <(const FixNumber& rhs) const
+template<size_t SIZE>
+bool BasicFixNumber<SIZE>::operator <(const BasicFixNumber& rhs) const
 {
 	if (m_Length != rhs.m_Length)
 		return m_Length < rhs.m_Length;
@@ -834,7 +913,8 @@ bool FixNumber::operator <(const FixNumber& rhs) const
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool FixNumber::operator <=(const FixNumber& rhs) const
+template<size_t SIZE>
+bool BasicFixNumber<SIZE>::operator <=(const BasicFixNumber& rhs) const
 {
 	if (m_Length != rhs.m_Length)
 		return m_Length < rhs.m_Length;
@@ -848,7 +928,8 @@ bool FixNumber::operator <=(const FixNumber& rhs) const
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool FixNumber::operator >(const FixNumber& rhs) const
+template<size_t SIZE>
+bool BasicFixNumber<SIZE>::operator >(const BasicFixNumber& rhs) const
 {
 	if (m_Length != rhs.m_Length)
 		return m_Length > rhs.m_Length;
@@ -862,7 +943,8 @@ bool FixNumber::operator >(const FixNumber& rhs) const
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool FixNumber::operator >=(const FixNumber& rhs) const
+template<size_t SIZE>
+bool BasicFixNumber<SIZE>::operator >=(const BasicFixNumber& rhs) const
 {
 	if (m_Length != rhs.m_Length)
 		return m_Length > rhs.m_Length;
@@ -876,7 +958,8 @@ bool FixNumber::operator >=(const FixNumber& rhs) const
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-size_t FixNumber::Unpack(uint8_t* digitA) const
+template<size_t SIZE>
+size_t BasicFixNumber<SIZE>::Unpack(uint8_t* digitA) const
 {
 	uint8_t* p = digitA;
 	const size_t len = m_Length;
@@ -891,6 +974,333 @@ size_t FixNumber::Unpack(uint8_t* digitA) const
 	return len;
 }
 
+// Явное инстанцирование для чисел длиной до 30 и 62 цифр
+template class BasicFixNumber<16>;
+template class BasicFixNumber<32>;
+
+template FixNumber& FixNumber::operator =(const WideFixNumber& rhs);
+template WideFixNumber& WideFixNumber::operator =(const FixNumber& rhs);
+
+template Number& Number::operator =(const FixNumber& rhs);
+template Number& Number::operator =(const WideFixNumber& rhs);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Векторная часть операции RAA (SSSE3, AVX2, AVX-512)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Все реализации используют один и тот же приём: к каждой сумме пары цифр прибавляется 0xf6, поэтому сумма 10 и
+// более переполняет байт и переносит 1 в следующий разряд прямо при 64-битном сложении. Различаются реализации
+// способом переноса между 64-битными словами. Если слов больше двух (AVX2, AVX-512), то для каждого слова мы
+// вычисляем признаки G (в слове возник перенос) и P (все байты слова равны 0xff, т.е. входящий перенос пройдёт
+// через слово насквозь) и получаем маску входящих переносов одним целочисленным сложением: ((G << 1) + P) ^ P
+
+//----------------------------------------------------------------------------------------------------------------------
+static inline uint8_t RAAKernelSSSE3(const uint8_t* pF, const uint8_t* pL, uint8_t* pOut, size_t blockC, uint8_t carry)
+{
+	const __m128i maskBs = _mm_set_epi64x(0x0001020304050607ull, 0x08090a0b0c0d0e0full);
+	const __m128i maskF6 = _mm_set1_epi64x(0xf6f6f6f6f6f6f6f6ull);
+	const __m128i maskF7 = _mm_set1_epi64x(0xf6f6f6f6f6f6f6f7ull);
+	const __m128i maskCr = _mm_set1_epi64x(0x80000000);
+
+	__m128i cr = _mm_add_epi64(_mm_unpacklo_epi64(maskF6, maskF7), _mm_cvtsi32_si128(carry));
+
+	for (; blockC; --blockC)
+	{
+		pL -= 16;
+		// 16 байт левой части массива (младшие 16 разрядов числа) складываем с
+		// "перевёрнутыми" 16 байтами правой части массива (старшие 16 разрядов числа)
+		// и добавляем к сумме значение cr, которое содержит маску 0xf6..f6 и флаг переноса
+		__m128i sum = _mm_add_epi64(_mm_add_epi64(_mm_load_si128(reinterpret_cast<const __m128i*>(pF)), cr),
+			_mm_shuffle_epi8(_mm_lddqu_si128(reinterpret_cast<const __m128i*>(pL)), maskBs));
+		// При возникновении переноса в младших 64 битах, добавляем 1 к старшим 64 битам
+		sum = _mm_add_epi64(sum, _mm_shuffle_epi32(_mm_cmplt_epi32(sum, maskCr), 0x50));
+		// Вычисляем маску переносов в разрядах (0x00 - был, 0xff - не было)
+		const __m128i mask = _mm_cmplt_epi8(sum, _mm_setzero_si128());
+		// Вычитаем 0xf6 из разрядов, в которых не было переноса, и сохраняем результат в выходной массив
+		_mm_store_si128(reinterpret_cast<__m128i*>(pOut), _mm_sub_epi8(sum, _mm_and_si128(mask, maskF6)));
+		// Формируем новое значение cr, учитывая перенос в старших 64 битах
+		cr = _mm_add_epi8(_mm_srli_si128(mask, 15), maskF7);
+		pF += 16; pOut += 16;
+	}
+
+	return _mm_extract_epi16(cr, 0) & 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+static uint8_t RAAKernelAVX2(const uint8_t* pF, const uint8_t* pL, uint8_t* pOut, size_t blockC, uint8_t carry)
+{
+	const __m256i maskBs = _mm256_set_epi64x(0x0001020304050607ull, 0x08090a0b0c0d0e0full,
+		0x0001020304050607ull, 0x08090a0b0c0d0e0full);
+	const __m256i maskF6 = _mm256_set1_epi64x(0xf6f6f6f6f6f6f6f6ull);
+	const __m256i laneBits = _mm256_set_epi64x(8, 4, 2, 1);
+	const __m256i allOnes = _mm256_set1_epi64x(-1);
+
+	unsigned cr = carry;
+	for (size_t i = blockC / 2; i; --i)
+	{
+		pL -= 32;
+		// _mm256_shuffle_epi8 переставляет байты только внутри 128-битных половин,
+		// поэтому для полного "переворота" 32 байт меняем половины местами
+		const __m256i back = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pL)), maskBs), 0x4e);
+		__m256i sum = _mm256_add_epi64(_mm256_add_epi64(
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pF)), maskF6), back);
+
+		// Признаки G (старший бит слова равен 0) и P (слово равно ~0) для 4 слов и маска входящих переносов
+		const unsigned g = ~_mm256_movemask_pd(_mm256_castsi256_pd(sum)) & 0xf;
+		const unsigned p = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(sum, allOnes)));
+		const unsigned c = (((g << 1) | cr) + p) ^ p;
+		// Добавляем 1 к словам, в которые пришёл перенос
+		const __m256i bits = _mm256_and_si256(_mm256_set1_epi64x(c), laneBits);
+		sum = _mm256_sub_epi64(sum, _mm256_cmpeq_epi64(bits, laneBits));
+
+		const __m256i mask = _mm256_cmpgt_epi8(_mm256_setzero_si256(), sum);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pOut), _mm256_sub_epi8(sum, _mm256_and_si256(mask, maskF6)));
+		cr = c >> 4;
+		pF += 32; pOut += 32;
+	}
+
+	_mm256_zeroupper();
+	return (blockC & 1) ? RAAKernelSSSE3(pF, pL, pOut, 1, static_cast<uint8_t>(cr)) : static_cast<uint8_t>(cr);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<bool VBMI>
+static uint8_t RAAKernelAVX512(const uint8_t* pF, const uint8_t* pL, uint8_t* pOut, size_t blockC, uint8_t carry)
+{
+	// С VBMI все 64 байта переворачиваются одной инструкцией vpermb. Без VBMI переворачиваем
+	// байты внутри 128-битных частей и затем переставляем сами части в обратном порядке
+	const __m512i maskRev = VBMI ?
+		_mm512_set_epi64(0x0001020304050607ll, 0x08090a0b0c0d0e0fll, 0x1011121314151617ll, 0x18191a1b1c1d1e1fll,
+			0x2021222324252627ll, 0x28292a2b2c2d2e2fll, 0x3031323334353637ll, 0x38393a3b3c3d3e3fll) :
+		_mm512_set_epi64(0x0001020304050607ll, 0x08090a0b0c0d0e0fll, 0x0001020304050607ll, 0x08090a0b0c0d0e0fll,
+			0x0001020304050607ll, 0x08090a0b0c0d0e0fll, 0x0001020304050607ll, 0x08090a0b0c0d0e0fll);
+	const __m512i maskF6 = _mm512_set1_epi64(0xf6f6f6f6f6f6f6f6ull);
+	const __m512i allOnes = _mm512_set1_epi64(-1);
+	const __m512i zero = _mm512_setzero_si512();
+
+	unsigned cr = carry;
+	for (size_t i = blockC / 4; i; --i)
+	{
+		pL -= 64;
+		__m512i back = _mm512_loadu_si512(pL);
+		if constexpr (VBMI)
+			back = _mm512_permutexvar_epi8(maskRev, back);
+		else
+		{
+			back = _mm512_shuffle_epi8(back, maskRev);
+			back = _mm512_shuffle_i64x2(back, back, 0x1b);
+		}
+		__m512i sum = _mm512_add_epi64(_mm512_add_epi64(_mm512_loadu_si512(pF), maskF6), back);
+
+		// Признаки G и P для 8 слов, маска входящих переносов и добавление 1 к соответствующим словам
+		const unsigned g = _mm512_cmpge_epi64_mask(sum, zero);
+		const unsigned p = _mm512_cmpeq_epi64_mask(sum, allOnes);
+		const unsigned c = (((g << 1) | cr) + p) ^ p;
+		sum = _mm512_mask_sub_epi64(sum, static_cast<__mmask8>(c), sum, allOnes);
+
+		// Вычитаем 0xf6 из разрядов, в которых не было переноса (их старший бит равен 1)
+		const __mmask64 mask = _mm512_cmplt_epi8_mask(sum, zero);
+		_mm512_storeu_si512(pOut, _mm512_mask_sub_epi8(sum, mask, sum, maskF6));
+		cr = c >> 8;
+		pF += 64; pOut += 64;
+	}
+
+	_mm256_zeroupper();
+	return (blockC & 3) ? RAAKernelAVX2(pF, pL, pOut, blockC & 3, static_cast<uint8_t>(cr)) : static_cast<uint8_t>(cr);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   BigNumber::RAAThreads
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Пул потоков для параллельного выполнения векторной части операции RAA над длинными числами. Полные блоки по 16
+// цифр делятся на сегменты (по одному на поток), границы которых выровнены по 64 байта в выходном буфере, чтобы
+// потоки не записывали данные в одни и те же строки кеша. Каждый сегмент складывается с нулевым входящим переносом,
+// после чего вызывающий поток последовательно (от младших сегментов к старшим) распространяет переносы: если в
+// сегмент должен был прийти перенос, то к его результату добавляется 1. Такое добавление почти всегда изменяет
+// только самую младшую цифру сегмента; только если все цифры сегмента равны 9, перенос пройдёт его насквозь
+
+//----------------------------------------------------------------------------------------------------------------------
+class BigNumber::RAAThreads final
+{
+	AML_NONCOPYABLE(RAAThreads)
+
+public:
+	explicit RAAThreads(unsigned threadC);
+	~RAAThreads();
+
+	unsigned GetThreadC() const { return m_ThreadC; }
+
+	// Выполняет векторную часть операции RAA над blockC блоками по 16 цифр аналогично функции RAAKernelFn
+	// (с нулевым входящим переносом), разделяя работу между потоками. Функция возвращает исходящий перенос
+	uint8_t Execute(const uint8_t* pF, const uint8_t* pL, uint8_t* pOut, size_t blockC);
+
+private:
+	// Количество циклов ожидания нового задания, после которых рабочий поток засыпает до его
+	// появления. Между шагами RAA вызывающий поток проверяет число на палиндром, поэтому
+	// короткое активное ожидание позволяет избежать дорогого пробуждения потоков ОС
+	static constexpr unsigned SPIN_C = 4000;
+
+	struct alignas(64) Segment
+	{
+		size_t firstBlock;		// Индекс первого блока сегмента
+		size_t blockC;			// Количество блоков в сегменте
+		uint8_t carry;			// Исходящий перенос сегмента (при нулевом входящем)
+	};
+
+	void DoThread(unsigned index);
+	void DoSegment(unsigned index);
+
+	const unsigned m_ThreadC;					// Общее количество потоков (вместе с вызывающим)
+	std::vector<std::thread> m_Threads;			// Рабочие потоки (m_ThreadC - 1)
+	std::vector<Segment> m_Segments;			// Сегменты текущего задания (по одному на поток)
+	size_t m_SegmentC = 0;						// Количество сегментов в текущем задании
+
+	const uint8_t* m_pF = nullptr;				// Параметры текущего задания
+	const uint8_t* m_pL = nullptr;
+	uint8_t* m_pOut = nullptr;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeCV;
+	std::atomic<unsigned> m_Generation = 0;		// Номер текущего задания
+	std::atomic<unsigned> m_PendingC = 0;		// Количество рабочих потоков, ещё не завершивших задание
+	std::atomic<bool> m_Stop = false;			// Признак завершения работы потоков
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+BigNumber::RAAThreads::RAAThreads(unsigned threadC)
+	: m_ThreadC(threadC)
+	, m_Segments(threadC)
+{
+	// Рабочие потоки выполняются с тем же приоритетом, что и вызывающий
+	// поток (например, в P196ProblemMain он понижен до THREAD_PRIORITY_LOWEST)
+	const int priority = ::GetThreadPriority(::GetCurrentThread());
+
+	m_Threads.reserve(threadC - 1);
+	for (unsigned i = 1; i < threadC; ++i)
+	{
+		m_Threads.emplace_back([this, i]() { DoThread(i); });
+		::SetThreadPriority(m_Threads.back().native_handle(), priority);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+BigNumber::RAAThreads::~RAAThreads()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+		++m_Generation;
+	}
+	m_WakeCV.notify_all();
+
+	for (auto& threadObj : m_Threads)
+		threadObj.join();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t BigNumber::RAAThreads::Execute(const uint8_t* pF, const uint8_t* pL, uint8_t* pOut, size_t blockC)
+{
+	m_pF = pF;
+	m_pL = pL;
+	m_pOut = pOut;
+
+	constexpr size_t minBlockC = PARALLEL_RAA_MIN_LENGTH / 32;
+	m_SegmentC = std::min<size_t>(m_ThreadC, blockC / minBlockC);
+	// Границы сегментов выравниваем по 4 блока (64 байта) относительно адреса выходного буфера. Так как
+	// буфер выровнен по 16 байт, то смещение первой такой границы от начала буфера равно 0-3 блокам
+	const size_t shift = ((64 - (reinterpret_cast<size_t>(pOut) & 63)) & 63) / 16;
+	for (size_t i = 0, first = 0; i < m_SegmentC; ++i)
+	{
+		size_t last = blockC;
+		if (i + 1 < m_SegmentC)
+			last = shift + ((blockC * (i + 1) / m_SegmentC - shift) & ~size_t(3));
+		m_Segments[i].firstBlock = first;
+		m_Segments[i].blockC = last - first;
+		first = last;
+	}
+
+	// Будим рабочие потоки и обрабатываем первый сегмент в вызывающем потоке
+	m_PendingC.store(m_ThreadC - 1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Generation.fetch_add(1, std::memory_order_release);
+	}
+	m_WakeCV.notify_all();
+
+	DoSegment(0);
+	for (unsigned spinC = 0; m_PendingC.load(std::memory_order_acquire); )
+	{
+		// Если рабочие потоки долго не завершают свои сегменты (например, когда потоков
+		// больше, чем свободных ядер), то отдаём остаток кванта времени другим потокам
+		if (++spinC < SPIN_C)
+			_mm_pause();
+		else
+			std::this_thread::yield();
+	}
+
+	// Распространяем переносы между сегментами
+	uint8_t carry = 0;
+	for (size_t i = 0; i < m_SegmentC; ++i)
+	{
+		const Segment& segment = m_Segments[i];
+		if (carry)
+		{
+			uint8_t* p = pOut + 16 * segment.firstBlock;
+			uint8_t* const pEnd = p + 16 * segment.blockC;
+			for (; p < pEnd && *p == 9; ++p)
+				*p = 0;
+			carry = (p == pEnd) ? 1 : 0;
+			if (p < pEnd)
+				++(*p);
+		}
+		carry |= segment.carry;
+	}
+
+	return carry;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void BigNumber::RAAThreads::DoThread(unsigned index)
+{
+	unsigned generation = 0;
+	for (;;)
+	{
+		unsigned spinC = 0;
+		while (m_Generation.load(std::memory_order_acquire) == generation)
+		{
+			if (++spinC < SPIN_C)
+			{
+				_mm_pause();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeCV.wait(lock, [&]() { return m_Generation.load(std::memory_order_relaxed) != generation; });
+		}
+		generation = m_Generation.load(std::memory_order_acquire);
+
+		if (m_Stop)
+			break;
+
+		if (index < m_SegmentC)
+			DoSegment(index);
+		m_PendingC.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void BigNumber::RAAThreads::DoSegment(unsigned index)
+{
+	Segment& segment = m_Segments[index];
+	const size_t offset = 16 * segment.firstBlock;
+	segment.carry = s_RAAKernelFn(m_pF + offset, m_pL - offset, m_pOut + offset, segment.blockC, 0);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   BigNumber
@@ -899,9 +1309,45 @@ size_t FixNumber::Unpack(uint8_t* digitA) const
 
 DEFINE_NUMBER_OPS(BigNumber)
 
+//----------------------------------------------------------------------------------------------------------------------
+static inline size_t GetRAALowWord(const uint8_t* digitA, size_t len)
+{
+	// Возвращает машинное слово с младшими цифрами результата операции RAA над числом
+	// digitA длиной len цифр (len >= размера слова). Младшие цифры не зависят от переносов
+	// из старших разрядов, поэтому их можно получить отдельно от остальной части результата
+	const size_t back = *reinterpret_cast<const size_t*>(digitA);
+	const size_t front = *reinterpret_cast<const size_t*>(digitA + len - sizeof(size_t));
+
+	#if AML_64BIT
+		const size_t sum = util::ByteSwap64(front) + back + 0xf6f6f6f6f6f6f6f6ull;
+		return (sum & 0x0f0f0f0f0f0f0f0full) - ((sum & 0x6060606060606060ull) >> 4);
+	#else
+		const size_t sum = util::ByteSwap32(front) + back + 0xf6f6f6f6;
+		return (sum & 0x0f0f0f0f) - ((sum & 0x60606060) >> 4);
+	#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+static inline size_t GetMirroredHighWord(const uint8_t* digitA, size_t len)
+{
+	// Возвращает машинное слово со старшими цифрами числа digitA, расположенными в обратном
+	// порядке. Для палиндрома оно совпадает со словом, содержащим младшие цифры числа
+	const size_t front = *reinterpret_cast<const size_t*>(digitA + len - sizeof(size_t));
+
+	#if AML_64BIT
+		return util::ByteSwap64(front);
+	#else
+		return util::ByteSwap32(front);
+	#endif
+}
+
 const size_t BigNumber::raaMask[8] = { 0, 0xff, 0xffff, 0xffffff,
 	0xffffffff, ~size_t(0) >> 24, ~size_t(0) >> 16, ~size_t(0) >> 8 };
 
+BigNumber::RAAKernel BigNumber::s_RAAKernel = BigNumber::GetBestRAAKernel();
+BigNumber::RAAKernelFn BigNumber::s_RAAKernelFn = BigNumber::GetRAAKernelFn(BigNumber::s_RAAKernel);
+BigNumber::RAAThreads* BigNumber::s_pRAAThreads = nullptr;
+
 //----------------------------------------------------------------------------------------------------------------------
 BigNumber::BigNumber(const BigNumber& that)
 	: Number(that)
@@ -1045,6 +1491,113 @@ BigNumber BigNumber::GetReversed() const
 	return num;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool BigNumber::SetRAAKernel(RAAKernel kernel)
+{
+	if (!IsRAAKernelSupported(kernel))
+		return false;
+
+	s_RAAKernel = kernel;
+	s_RAAKernelFn = GetRAAKernelFn(kernel);
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned BigNumber::GetRAAThreadC()
+{
+	return s_pRAAThreads ? s_pRAAThreads->GetThreadC() : 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void BigNumber::SetRAAThreadC(unsigned threadC)
+{
+	if (threadC != GetRAAThreadC())
+	{
+		delete s_pRAAThreads;
+		s_pRAAThreads = (threadC > 1) ? new RAAThreads(threadC) : nullptr;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool BigNumber::IsRAAKernelSupported(RAAKernel kernel)
+{
+	// Поддержка SSSE3 проверяется при запуске программы (см. TestFacility::CheckRequirements)
+	if (kernel == RAAKernel::SSSE3)
+		return true;
+
+	int cpuInfoA[4];
+	__cpuid(cpuInfoA, 0);
+	if (cpuInfoA[0] < 0x07)
+		return false;
+
+	// Для AVX необходима поддержка инструкции XGETBV (OSXSAVE) и
+	// сохранения ОС состояния регистров XMM и YMM (биты 1 и 2 XCR0)
+	__cpuidex(cpuInfoA, 0x01, 0);
+	if ((cpuInfoA[2] & 0x18000000) != 0x18000000)
+		return false;
+	const uint64_t xcr0 = _xgetbv(0);
+	if ((xcr0 & 0x06) != 0x06)
+		return false;
+
+	__cpuidex(cpuInfoA, 0x07, 0);
+	const bool AVX2 = (cpuInfoA[1] & 0x0020) != 0;
+	if (kernel == RAAKernel::AVX2)
+		return AVX2;
+
+	// Для AVX-512 ОС также должна сохранять регистры масок и ZMM (биты 5-7 XCR0)
+	const bool AVX512F = (cpuInfoA[1] & 0x00010000) != 0;
+	const bool AVX512BW = (cpuInfoA[1] & 0x40000000) != 0;
+	const bool AVX512VBMI = (cpuInfoA[2] & 0x0002) != 0;
+	if (!AVX2 || !AVX512F || !AVX512BW || (xcr0 & 0xe0) != 0xe0)
+		return false;
+
+	return kernel == RAAKernel::AVX512BW || (kernel == RAAKernel::AVX512VBMI && AVX512VBMI);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+const char* BigNumber::GetRAAKernelName(RAAKernel kernel)
+{
+	switch (kernel)
+	{
+		case RAAKernel::SSSE3:
+			return "SSSE3";
+		case RAAKernel::AVX2:
+			return "AVX2";
+		case RAAKernel::AVX512BW:
+			return "AVX-512BW";
+		case RAAKernel::AVX512VBMI:
+			return "AVX-512VBMI";
+	}
+	return "Unknown";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+BigNumber::RAAKernel BigNumber::GetBestRAAKernel()
+{
+	for (auto kernel : { RAAKernel::AVX512VBMI, RAAKernel::AVX512BW, RAAKernel::AVX2 })
+	{
+		if (IsRAAKernelSupported(kernel))
+			return kernel;
+	}
+	return RAAKernel::SSSE3;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+BigNumber::RAAKernelFn BigNumber::GetRAAKernelFn(RAAKernel kernel)
+{
+	switch (kernel)
+	{
+		case RAAKernel::AVX2:
+			return RAAKernelAVX2;
+		case RAAKernel::AVX512BW:
+			return RAAKernelAVX512<false>;
+		case RAAKernel::AVX512VBMI:
+			return RAAKernelAVX512<true>;
+		default:
+			return RAAKernelSSSE3;
+	}
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 AML_NOINLINE uint8_t* BigNumber::AllocateRAABuffer(size_t maxLength)
 {
@@ -1070,11 +1623,6 @@ unsigned BigNumber::RAA(unsigned stepC, bool stopOnPalindrome)
 	alignas(16) uint8_t localBuffer[(LOCAL_RAA_BUFFER_SIZE + 7) & ~size_t(7)];
 	uint8_t* pDig2 = (maxLength <= LOCAL_RAA_BUFFER_SIZE) ? localBuffer : AllocateRAABuffer(maxLength);
 
-	const __m128i maskBs = _mm_set_epi64x(0x0001020304050607ull, 0x08090a0b0c0d0e0full);
-	const __m128i maskF6 = _mm_set1_epi64x(0xf6f6f6f6f6f6f6f6ull);
-	const __m128i maskF7 = _mm_set1_epi64x(0xf6f6f6f6f6f6f6f7ull);
-	const __m128i maskCr = _mm_set1_epi64x(0x80000000);
-
 	unsigned doneC = 0;
 	for (unsigned step = 1; step <= stepC; ++step)
 	{
@@ -1082,31 +1630,25 @@ unsigned BigNumber::RAA(unsigned stepC, bool stopOnPalindrome)
 		const uint64_t* pL = reinterpret_cast<uint64_t*>(pDig1 + m_Length);
 		uint64_t* pOut = reinterpret_cast<uint64_t*>(pDig2);
 
+		// Младшие цифры результата вычисляем заранее (до сложения), пока исходные данные находятся в кеше.
+		// После сложения они сравниваются со старшими цифрами, которые были записаны последними, поэтому
+		// для отсева непалиндромов не требуется повторно читать из памяти начало длинного числа
+		const bool fusedCheck = stopOnPalindrome && m_Length >= 2 * sizeof(size_t);
+		const size_t lowWord = fusedCheck ? GetRAALowWord(pDig1, m_Length) : 0;
+
 		uint8_t carry = 0;
-		// Алгоритм RAA использует инструкции SSSE3
-		if (size_t i = m_Length / 16)
+		// Все полные блоки по 16 цифр обрабатываются векторной частью алгоритма. Для коротких чисел
+		// (1 блок) всегда используем встроенную SSSE3-версию: широкие регистры здесь не дадут выигрыша.
+		// Для очень длинных чисел (если задано больше 1 потока) работа делится между потоками пула
+		if (const size_t blockC = m_Length / 16)
 		{
-			__m128i cr = _mm_unpacklo_epi64(maskF6, maskF7);
-
-			do {
-				pL -= 2;
-				// 16 байт левой части массива (младшие 16 разрядов числа) складываем с
-				// "перевёрнутыми" 16 байтами правой части массива (старшие 16 разрядов числа)
-				// и добавляем к сумме значение cr, которое содержит маску 0xf6..f6 и флаг переноса
-				__m128i sum = _mm_add_epi64(_mm_add_epi64(_mm_load_si128(reinterpret_cast<const __m128i*>(pF)), cr),
-					_mm_shuffle_epi8(_mm_lddqu_si128(reinterpret_cast<const __m128i*>(pL)), maskBs));
-				// При возникновении переноса в младших 64 битах, добавляем 1 к старшим 64 битам
-				sum = _mm_add_epi64(sum, _mm_shuffle_epi32(_mm_cmplt_epi32(sum, maskCr), 0x50));
-				// Вычисляем маску переносов в разрядах (0x00 - был, 0xff - не было)
-				const __m128i mask = _mm_cmplt_epi8(sum, _mm_setzero_si128());
-				// Вычитаем 0xf6 из разрядов, в которых не было переноса, и сохраняем результат в выходной массив
-				_mm_store_si128(reinterpret_cast<__m128i*>(pOut), _mm_sub_epi8(sum, _mm_and_si128(mask, maskF6)));
-				// Формируем новое значение cr, учитывая перенос в старших 64 битах
-				cr = _mm_add_epi8(_mm_srli_si128(mask, 15), maskF7);
-				pF += 2; pOut += 2;
-			} while (--i);
-
-			carry = _mm_extract_epi16(cr, 0) & 1;
+			if (blockC < 2)
+				carry = RAAKernelSSSE3(pDig1, pDig1 + m_Length, pDig2, blockC, 0);
+			else if (s_pRAAThreads && m_Length >= PARALLEL_RAA_MIN_LENGTH)
+				carry = s_pRAAThreads->Execute(pDig1, pDig1 + m_Length, pDig2, blockC);
+			else
+				carry = s_RAAKernelFn(pDig1, pDig1 + m_Length, pDig2, blockC, 0);
+			pF += 2 * blockC; pL -= 2 * blockC; pOut += 2 * blockC;
 		}
 
 		#if AML_64BIT
@@ -1180,6 +1722,8 @@ unsigned BigNumber::RAA(unsigned stepC, bool stopOnPalindrome)
 		pDig1 = pDig2;
 		pDig2 = t;
 
+		if (fusedCheck && lowWord != GetMirroredHighWord(pDig1, m_Length))
+			continue;
 		if (stopOnPalindrome && IsPalindrome(pDig1, m_Length))
 		{
 			doneC = step;
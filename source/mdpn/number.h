@@ -7,7 +7,15 @@
 #include <algorithm>
 #include <string>
 
-class FixNumber;
+template<size_t SIZE> class BasicFixNumber;
+class LimbNumber;
+class NumberBatch;
+class PackedNumber;
+template<size_t N> class ShortNumber;
+
+// Числа фиксированной максимальной длины: 30 цифр (16 байт) и 62 цифры (32 байта)
+using FixNumber = BasicFixNumber<16>;
+using WideFixNumber = BasicFixNumber<32>;
 
 //----------------------------------------------------------------------------------------------------------------------
 template<class T>
@@ -26,7 +34,11 @@ public:
 //----------------------------------------------------------------------------------------------------------------------
 class Number
 {
-	friend class FixNumber;
+	template<size_t SIZE> friend class BasicFixNumber;
+	friend class LimbNumber;
+	friend class NumberBatch;
+	friend class PackedNumber;
+	template<size_t N> friend class ShortNumber;
 
 public:
 	Number() = default;
@@ -79,7 +91,7 @@ public:
 	Number& operator =(const std::string& num) { Set(num); return *this; }
 
 	Number& operator =(const Number& rhs);
-	Number& operator =(const FixNumber& rhs);
+	template<size_t SIZE> Number& operator =(const BasicFixNumber<SIZE>& rhs);
 	Number& operator =(Number&& rhs);
 
 	Number operator +(unsigned rhs) const;
@@ -141,48 +153,72 @@ protected:
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
-//   FixNumber - минимальная версия класса числа с фиксированной максимальной длиной
+//   BasicFixNumber - минимальная версия класса числа с фиксированной максимальной длиной
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Объект размером SIZE байт хранит длину числа (1 байт) и его цифры, упакованные по 2 в байт. Класс FixNumber
+// (до 30 цифр) используется для чисел-кандидатов и ключей наборов отсева, класс WideFixNumber (до 62 цифр) -
+// для ключей отсева в диапазонах, где длина отсева (длина чисел + 4) превышает 30 цифр
+
 //----------------------------------------------------------------------------------------------------------------------
-class FixNumber
+template<size_t SIZE>
+class BasicFixNumber
 {
+	static_assert(SIZE >= 8 && SIZE <= 128 && !(SIZE & 3), "Invalid object size");
+
 	friend class Number;
+	template<size_t S> friend class BasicFixNumber;
+	template<size_t N> friend class ShortNumber;
 
 public:
-	FixNumber() : m_LengthAnd1stDigit(Z_DIGIT) {}
-	FixNumber(const Number& that) : m_LengthAnd1stDigit(Z_DIGIT) { *this = that; }
-	FixNumber(const char* pNum) : m_LengthAnd1stDigit(Z_DIGIT) { *this = pNum; }
+	static constexpr size_t OBJ_SIZE = SIZE;					// Размер объекта в байтах
+	static constexpr size_t MAX_LENGTH = (OBJ_SIZE - 1) * 2;	// Макс. длина числа (2 цифры на байт)
+
+	BasicFixNumber() : m_LengthAnd1stDigit(Z_DIGIT) {}
+	BasicFixNumber(const Number& that) : m_LengthAnd1stDigit(Z_DIGIT) { *this = that; }
+	BasicFixNumber(const char* pNum) : m_LengthAnd1stDigit(Z_DIGIT) { *this = pNum; }
+	// Преобразует число другого размера. Если длина числа больше MAX_LENGTH, то будет выброшено исключение
+	template<size_t S>
+	explicit BasicFixNumber(const BasicFixNumber<S>& that) : m_LengthAnd1stDigit(Z_DIGIT) { *this = that; }
 
 	void SetZero() { m_LengthAnd1stDigit = Z_DIGIT; }
 	bool IsZero() const { return m_LengthAnd1stDigit == Z_DIGIT; }
 	operator bool() const { return m_LengthAnd1stDigit != Z_DIGIT; }
 
 	size_t GetLength() const { return m_Length; }
-	using Hasher = NumberHash<FixNumber>;
+	// Возвращает указатель на упакованные цифры числа: младшая цифра - в младших 4 битах первого байта.
+	// Значимыми являются (GetLength() + 1) / 2 байт, значения остальных байт не определены
+	const uint8_t* GetPackedDigits() const { return m_DigitA + 1; }
+	// Задаёт число по его длине и упакованным цифрам (формат как у GetPackedDigits). Массив pDigits должен содержать
+	// OBJ_SIZE - 1 байт, цифры за пределами длины игнорируются. Если цифры некорректны, то число не меняется,
+	// а функция возвращает false
+	bool SetPackedDigits(const uint8_t* pDigits, size_t length);
+	using Hasher = NumberHash<BasicFixNumber>;
 	unsigned GetHash() const;
+	// Возвращает 64-битный хеш числа. Все его биты зависят от всех цифр числа, поэтому хеш подходит для
+	// контейнеров, хранящих вместо чисел их "отпечатки" (части хеша), например, ConcurrentNumberFilter
+	uint64_t GetHash64() const;
 
-	FixNumber& operator =(const Number& rhs);
-	FixNumber& operator =(const char* pNum);
+	BasicFixNumber& operator =(const Number& rhs);
+	BasicFixNumber& operator =(const char* pNum);
+	template<size_t S> BasicFixNumber& operator =(const BasicFixNumber<S>& rhs);
 
-	bool operator ==(const FixNumber& rhs) const;
-	bool operator !=(const FixNumber& rhs) const;
+	bool operator ==(const BasicFixNumber& rhs) const;
+	bool operator !=(const BasicFixNumber& rhs) const;
 	bool operator ==(const Number& rhs) const;
 	bool operator !=(const Number& rhs) const;
 
-	friend bool operator ==(const Number& lhs, const FixNumber& rhs) { return rhs == lhs; }
-	friend bool operator !=(const Number& lhs, const FixNumber& rhs) { return rhs != lhs; }
+	friend bool operator ==(const Number& lhs, const BasicFixNumber& rhs) { return rhs == lhs; }
+	friend bool operator !=(const Number& lhs, const BasicFixNumber& rhs) { return rhs != lhs; }
 
-	bool operator <(const FixNumber& rhs) const;
-	bool operator <=(const FixNumber& rhs) const;
-	bool operator >(const FixNumber& rhs) const;
-	bool operator >=(const FixNumber& rhs) const;
+	bool operator <(const BasicFixNumber& rhs) const;
+	bool operator <=(const BasicFixNumber& rhs) const;
+	bool operator >(const BasicFixNumber& rhs) const;
+	bool operator >=(const BasicFixNumber& rhs) const;
 
 protected:
 	static constexpr uint16_t Z_DIGIT = AML_TO_LE16(1);
-	static constexpr size_t OBJ_SIZE = 4 * sizeof(uint32_t);	// 16 байт на весь объект
-	static constexpr size_t MAX_LENGTH = (OBJ_SIZE - 1) * 2;	// Макс. 30 цифр (2 цифры на байт)
 
 	size_t Unpack(uint8_t* digitA) const;
 
@@ -206,6 +242,9 @@ protected:
 class BigNumber : public Number
 {
 public:
+	// Реализации векторной части операции RAA (по используемому набору инструкций)
+	enum class RAAKernel { SSSE3, AVX2, AVX512BW, AVX512VBMI };
+
 	BigNumber() = default;
 	BigNumber(unsigned num) { Set(num); }
 	BigNumber(unsigned long long num) { Set(num); }
@@ -246,6 +285,26 @@ public:
 	// Возвращает обратное число
 	BigNumber GetReversed() const;
 
+	// Возвращает текущую реализацию векторной части операции RAA. При запуске программы (однократно)
+	// выбирается наиболее производительная из реализаций, поддерживаемых процессором и ОС
+	static RAAKernel GetRAAKernel() { return s_RAAKernel; }
+	// Устанавливает реализацию векторной части операции RAA. Если она не поддерживается, то функция вернёт
+	// false. NB: функция не является потокобезопасной и предназначена в первую очередь для тестирования
+	static bool SetRAAKernel(RAAKernel kernel);
+	// Возвращает true, если указанная реализация поддерживается процессором и ОС
+	static bool IsRAAKernelSupported(RAAKernel kernel);
+	// Возвращает название реализации (например, "AVX2")
+	static const char* GetRAAKernelName(RAAKernel kernel);
+
+	// Возвращает количество потоков, используемых операцией RAA над длинными числами (по умолчанию 1)
+	static unsigned GetRAAThreadC();
+	// Устанавливает количество потоков для операции RAA над длинными числами (от PARALLEL_RAA_MIN_LENGTH цифр).
+	// Если threadC больше 1, то каждый шаг RAA делится на сегменты, которые обрабатываются параллельно вызывающим
+	// потоком и пулом из (threadC - 1) рабочих потоков, создаваемых этой функцией. Если threadC <= 1, то пул потоков
+	// будет уничтожен. NB: функция не является потокобезопасной, а параллельный режим одновременно может быть
+	// использован только одним потоком (так как пул потоков общий), поэтому он предназначен для задач вроде P196
+	static void SetRAAThreadC(unsigned threadC);
+
 	BigNumber& operator =(unsigned num) { Set(num); return *this; }
 	BigNumber& operator =(unsigned long long num) { Set(num); return *this; }
 	BigNumber& operator =(const char* pNum) { Set(pNum); return *this; }
@@ -253,7 +312,8 @@ public:
 
 	BigNumber& operator =(const BigNumber& rhs) { return (BigNumber&) Number::operator =(rhs); }
 	BigNumber& operator =(const Number& rhs) { return (BigNumber&) Number::operator =(rhs); }
-	BigNumber& operator =(const FixNumber& rhs) { return (BigNumber&) Number::operator =(rhs); }
+	template<size_t SIZE>
+	BigNumber& operator =(const BasicFixNumber<SIZE>& rhs) { return (BigNumber&) Number::operator =(rhs); }
 	BigNumber& operator =(BigNumber&& rhs) { return (BigNumber&) Number::operator =(std::move(rhs)); }
 	BigNumber& operator =(Number&& rhs) { return (BigNumber&) Number::operator =(std::move(rhs)); }
 
@@ -278,12 +338,30 @@ public:
 	// Уменьшает число на единицу, если число > 0
 	BigNumber& operator --() { return (BigNumber&) Number::operator --(); }
 
+	// Минимальная длина числа, для которой операция RAA будет выполняться параллельно (если задано
+	// больше 1 потока). Каждый сегмент будет содержать не менее PARALLEL_RAA_MIN_LENGTH / 2 цифр
+	static constexpr size_t PARALLEL_RAA_MIN_LENGTH = 131072;
+
 protected:
+	class RAAThreads;
+
 	// Размер локального буфера для RAATillPalindrome (выделяется на стеке)
 	static constexpr size_t LOCAL_RAA_BUFFER_SIZE = 640;
 	// Массив масок для операции RAA
 	static const size_t raaMask[8];
 
+	// Функция векторной части операции RAA. Складывает blockC блоков по 16 цифр, начиная с младшего
+	// разряда pF, с перевёрнутыми цифрами, расположенными перед pL (старшими разрядами числа), учитывая
+	// входящий перенос carry. Результат записывается в pOut, функция возвращает исходящий перенос
+	using RAAKernelFn = uint8_t (*)(const uint8_t* pF, const uint8_t* pL, uint8_t* pOut, size_t blockC, uint8_t carry);
+
+	static RAAKernel GetBestRAAKernel();
+	static RAAKernelFn GetRAAKernelFn(RAAKernel kernel);
+
+	static RAAKernel s_RAAKernel;		// Текущая реализация векторной части операции RAA
+	static RAAKernelFn s_RAAKernelFn;	// Функция, соответствующая реализации s_RAAKernel
+	static RAAThreads* s_pRAAThreads;	// Пул потоков для параллельной операции RAA (или nullptr)
+
 	uint8_t* AllocateRAABuffer(size_t maxLength);
 
 	// Если stopOnPalindrome равен false, то функция выполнит ровно stepC операций RAA и вернёт 0. Если
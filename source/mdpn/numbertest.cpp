@@ -2,6 +2,9 @@
 #include "pch.h"
 #include "numbertest.h"
 
+#include "limbnum.h"
+#include "numbatch.h"
+#include "packednum.h"
 #include "ttime.h"
 #include "util.h"
 
@@ -612,6 +615,10 @@ bool TestFixNumber::Execute()
 		return false;
 	if (!IsCancelled() && !TestGetHash())
 		return false;
+	if (!IsCancelled() && !TestWideNumber())
+		return false;
+	if (!IsCancelled() && !TestPackedDigits())
+		return false;
 
 	PrintFooter();
 	return true;
@@ -739,6 +746,97 @@ bool TestFixNumber::TestGetHash()
 	return true;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool TestFixNumber::TestWideNumber()
+{
+	// Тестируем класс WideFixNumber (до 62 цифр) и преобразования между ним и FixNumber. Хеши числа
+	// не должны зависеть от размера объекта: наборы отсева используют оба класса для одних и тех же чисел
+
+	Number num, num2;
+	WideFixNumber w, w2;
+	auto fn = [&](char* p, size_t len) {
+		num.Set(p);
+		w = p;
+		w2 = num;
+		num2 = w;
+		if (w != w2 || !(w == num) || num2 != num || w.GetLength() != len || w.GetHash() != GetHash(num))
+			return false;
+
+		if (len > FixNumber::MAX_LENGTH)
+		{
+			try
+			{
+				FixNumber f(w);
+				return false;
+			}
+			catch (const util::ELogic&)
+			{
+				return true;
+			}
+		}
+
+		const FixNumber f(p);
+		w2.SetZero();
+		w2 = f;
+		return w2 == w && FixNumber(w) == f && f.GetHash() == w.GetHash() && f.GetHash64() == w.GetHash64();
+	};
+	if (!ForRandomNumbers(1, WideFixNumber::MAX_LENGTH, 50, fn))
+		return OnError(8);
+
+	auto cmpFn = [&](char* p, size_t) {
+		num2 = num;
+		num.Set(p);
+		w2 = w;
+		w = num;
+		const int diff = (num == num2) ? 0 : (num < num2) ? -1 : 1;
+		return (w == w2) == (diff == 0) && (w < w2) == (diff < 0) && (w >= w2) == (diff >= 0);
+	};
+	if (!ForRandomNumbers(25, WideFixNumber::MAX_LENGTH, 50, cmpFn))
+		return OnError(9);
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool TestFixNumber::TestPackedDigits()
+{
+	// Тестируем функции GetPackedDigits и SetPackedDigits
+
+	FixNumber f, f2;
+	uint8_t buffer[FixNumber::OBJ_SIZE - 1];
+	auto fn = [&](char* p, size_t) {
+		f = p;
+		const size_t length = f.GetLength();
+		if (!f2.SetPackedDigits(f.GetPackedDigits(), length) || f2 != f)
+			return false;
+		// Цифры за пределами длины числа должны игнорироваться
+		memcpy(buffer, f.GetPackedDigits(), sizeof(buffer));
+		for (size_t i = length; i < FixNumber::MAX_LENGTH; ++i)
+			buffer[i / 2] |= (i & 1) ? 0xf0 : 0x0f;
+		f2.SetZero();
+		if (!f2.SetPackedDigits(buffer, length) || f2 != f || f2.GetHash() != f.GetHash())
+			return false;
+		// Некорректная цифра в любом разряде должна приводить к ошибке (число при этом не меняется)
+		const size_t pos = Rand() % length;
+		buffer[pos / 2] |= (pos & 1) ? 0xa0 : 0x0a;
+		return !f2.SetPackedDigits(buffer, length) && f2 == f;
+	};
+	if (!ForRandomNumbers(1, FixNumber::MAX_LENGTH, 100, fn))
+		return OnError(10);
+
+	// Недопустимая длина и ведущий ноль
+	f = "123";
+	AML_FILLA(buffer, 0, sizeof(buffer));
+	buffer[0] = 0x05;
+	if (f.SetPackedDigits(buffer, 0) || f.SetPackedDigits(buffer, FixNumber::MAX_LENGTH + 1) ||
+		f.SetPackedDigits(buffer, 2) || f != FixNumber("123") || !f.SetPackedDigits(buffer, 1) || f != FixNumber("5"))
+	{
+		return OnError(11);
+	}
+
+	return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   TestBigNumber
@@ -764,6 +862,10 @@ bool TestBigNumber::Execute()
 		return false;
 	if (!IsCancelled() && !TestRAATillLength())
 		return false;
+	if (!IsCancelled() && !TestRAAKernels())
+		return false;
+	if (!IsCancelled() && !TestParallelRAA())
+		return false;
 
 	PrintFooter();
 	return true;
@@ -1031,6 +1133,111 @@ bool TestBigNumber::TestRAATillLength()
 	return true;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool TestBigNumber::TestRAAKernels()
+{
+	// Тестируем все поддерживаемые процессором варианты векторной части операции RAA, сравнивая
+	// их результаты с результатами SSSE3-версии. Часть цифр чисел заменяем на 8 и 9, чтобы чаще
+	// возникали длинные цепочки переносов, пересекающие границы 64-битных слов и блоков
+
+	using RAAKernel = BigNumber::RAAKernel;
+	const RAAKernel savedKernel = BigNumber::GetRAAKernel();
+	const RAAKernel kernels[] = { RAAKernel::AVX2, RAAKernel::AVX512BW, RAAKernel::AVX512VBMI };
+
+	BigNumber num, raa;
+	auto fn = [&](char* p, size_t len) {
+		const unsigned fill = m_Rg.UInt(4);
+		for (size_t i = 1; i < len; ++i)
+		{
+			if (m_Rg.UInt(4) < fill)
+				p[i] = '8' + (m_Rg.UInt() & 1);
+		}
+
+		BigNumber::SetRAAKernel(RAAKernel::SSSE3);
+		num = p;
+		num.ReverseAndAdd(3);
+
+		for (auto kernel : kernels)
+		{
+			if (BigNumber::SetRAAKernel(kernel))
+			{
+				raa = p;
+				raa.ReverseAndAdd(3);
+				if (raa != num)
+					return false;
+			}
+		}
+		return true;
+	};
+	const bool isOk = ForRandomNumbers(1, 300, 10, fn);
+	BigNumber::SetRAAKernel(savedKernel);
+	if (!isOk)
+		return OnError(18);
+
+	auto longFn = [&](RAAKernel kernel) {
+		if (!BigNumber::SetRAAKernel(kernel))
+			return true;
+		num.Set(196u);
+		unsigned stepDoneC = 0;
+		return !num.RAATillPalindrome(10000, stepDoneC) && stepDoneC == 10000 &&
+			num.GetLength() == 4159 && num.GetHash() == 0x5a9ae6eb;
+	};
+	bool isLongOk = true;
+	num.Reserve(5000);
+	for (auto kernel : kernels)
+		isLongOk = isLongOk && longFn(kernel);
+	BigNumber::SetRAAKernel(savedKernel);
+	if (!isLongOk)
+		return OnError(19);
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool TestBigNumber::TestParallelRAA()
+{
+	// Сравниваем результаты параллельной операции RAA с однопоточной для чисел длиной от PARALLEL_RAA_MIN_LENGTH
+	// цифр. Кроме случайных чисел проверяем числа, у которых суммы симметричных цифр равны 9, а сумма крайних цифр
+	// равна 10: при сложении такого числа с обратным перенос проходит насквозь через все сегменты
+
+	const unsigned savedThreadC = BigNumber::GetRAAThreadC();
+
+	std::string str;
+	BigNumber num, raa;
+	bool isOk = true;
+	for (unsigned i = 0; isOk && i < 30; ++i)
+	{
+		const size_t len = BigNumber::PARALLEL_RAA_MIN_LENGTH + m_Rg.UInt(300000);
+		str.assign(len, '0');
+		for (size_t j = 0; j < len; ++j)
+			str[j] = '0' + m_Rg.UInt(10);
+
+		if (i & 1)
+		{
+			for (size_t j = 0; j < len / 2; ++j)
+				str[len - j - 1] = '9' - (str[j] - '0');
+			str[0] = '5';
+			str[len - 1] = '5';
+			if (len & 1)
+				str[len / 2] = '9';
+		}
+		else if (str[0] == '0')
+			str[0] = '1';
+
+		BigNumber::SetRAAThreadC(1);
+		num = str;
+		num.ReverseAndAdd(3);
+
+		BigNumber::SetRAAThreadC(2 + i % 7);
+		raa = str;
+		raa.ReverseAndAdd(3);
+		isOk = raa == num;
+	}
+
+	BigNumber::SetRAAThreadC(savedThreadC);
+	return isOk ? true : OnError(20);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   TestBigNumberSkipRAADups
@@ -1291,6 +1498,407 @@ bool TestBigNumberSkipRAADups::NumSet::Insert(const Number& num)
 	return exists;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   TestLongNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool TestLongNumber::TestClass()
+{
+	PrintHeader();
+
+	if (!IsCancelled() && !TestSetAsString<T>())
+		return false;
+	if (!IsCancelled() && !TestReverseAndAdd<T>())
+		return false;
+	if (!IsCancelled() && !TestRAATillPalindrome<T>())
+		return false;
+	if (!IsCancelled() && !TestRAATillLength<T>())
+		return false;
+
+	PrintFooter();
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool TestLongNumber::TestSetAsString()
+{
+	// Тестируем преобразования из строки, Number и 64-битного целого и обратно
+
+	T num;
+	BigNumber big;
+	auto fn = [&](const char* p, size_t) {
+		num.Set(p);
+		big.Set(p);
+		if (num.AsString() != big.AsString() || num.AsNumber() != big || num.GetHash() != big.GetHash())
+			return false;
+		num.Set(big);
+		return num.AsString() == big.AsString() && num.GetLength() == big.GetLength();
+	};
+	if (!ForRandomNumbers(1, 80, 50, fn))
+		return OnError(1);
+
+	for (int i = 0; i < 500; ++i)
+	{
+		const uint64_t n = (static_cast<uint64_t>(Rand()) << 32) | m_Rg.UInt();
+		num.Set(n);
+		if (num.AsNumber().AsI64() != n)
+			return OnError(2);
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool TestLongNumber::TestReverseAndAdd()
+{
+	// Тестируем функцию ReverseAndAdd, сравнивая результат с BigNumber. Часть цифр заменяем на 8 и 9, чтобы
+	// чаще возникали цепочки переносов, пересекающие границы слов. Длины чисел выбираем достаточно большими,
+	// чтобы проверить как векторную, так и скалярную часть алгоритма
+
+	T num;
+	BigNumber big;
+	auto fn = [&](char* p, size_t len) {
+		const unsigned fill = m_Rg.UInt(4);
+		for (size_t i = 1; i < len; ++i)
+		{
+			if (m_Rg.UInt(4) < fill)
+				p[i] = '8' + (m_Rg.UInt() & 1);
+		}
+
+		num.Set(p);
+		big.Set(p);
+		const unsigned stepC = 1 + m_Rg.UInt(5);
+		num.ReverseAndAdd(stepC);
+		big.ReverseAndAdd(stepC);
+		return num.AsNumber() == big && num.IsPalindrome() == big.IsPalindrome();
+	};
+	if (!ForRandomNumbers(1, 300, 10, fn) || !ForRandomNumbers(1000, 1040, 3, fn))
+		return OnError(3);
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool TestLongNumber::TestRAATillPalindrome()
+{
+	// Тестируем функцию RAATillPalindrome
+
+	T num;
+	BigNumber big;
+	auto fn = [&](const char* p, size_t) {
+		num.Set(p);
+		big.Set(p);
+		unsigned doneC1, doneC2;
+		const unsigned stepC = 45 + m_Rg.UInt(11);
+		const bool isPalindrome = num.RAATillPalindrome(stepC, doneC1);
+		return isPalindrome == big.RAATillPalindrome(stepC, doneC2) && doneC1 == doneC2 && num.AsNumber() == big;
+	};
+	if (!ForRandomNumbers(1, 40, 100, fn))
+		return OnError(4);
+
+	auto longFn = [&](unsigned n, size_t len, unsigned hash)
+	{
+		num.Set(n);
+		unsigned stepDoneC = 0;
+		return !num.RAATillPalindrome(10000, stepDoneC) && stepDoneC == 10000 &&
+			num.GetLength() == len && num.GetHash() == hash;
+	};
+	num.Reserve(5000);
+	// Проверим корректность вычислений для первых 3 базовых чисел Лишрел при 10 тыс. шагах
+	if (!longFn(196, 4159, 0x5a9ae6eb) || !longFn(879, 4155, 0x4c07af64) || !longFn(1997, 4160, 0x982671f9))
+		return OnError(5);
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool TestLongNumber::TestRAATillLength()
+{
+	// Тестируем функцию RAATillLength
+
+	T num;
+	BigNumber big;
+	auto fn = [&](const char* p, size_t len) {
+		num.Set(p);
+		big.Set(p);
+		unsigned doneC1, doneC2;
+		const size_t newLen = ((len > 3) ? len - 3 : 0) + m_Rg.UInt(29);
+		const bool isPalindrome = num.RAATillLength(newLen, doneC1);
+		return isPalindrome == big.RAATillLength(newLen, doneC2) && doneC1 == doneC2 && num.AsNumber() == big;
+	};
+	if (!ForRandomNumbers(1, 40, 100, fn))
+		return OnError(6);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   TestPackedNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+bool TestPackedNumber::Execute()
+{
+	return TestClass<PackedNumber>();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   TestLimbNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+bool TestLimbNumber::Execute()
+{
+	return TestClass<LimbNumber>();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   TestNumberBatch
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+bool TestNumberBatch::Execute()
+{
+	PrintHeader();
+
+	if (!IsCancelled() && !TestSetGetLane())
+		return false;
+	if (!IsCancelled() && !TestReverseAndAdd())
+		return false;
+
+	PrintFooter();
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool TestNumberBatch::TestSetGetLane()
+{
+	// Помещаем случайные числа в случайные дорожки и проверяем, что числа, их длины
+	// и наибольшая длина не изменились после записи в другие дорожки и их очистки
+
+	NumberBatch batch;
+	BigNumber numA[NumberBatch::LANE_C], num;
+	bool activeA[NumberBatch::LANE_C] = {};
+	for (unsigned i = 0; i < 10000; ++i)
+	{
+		const size_t lane = m_Rg.UInt(NumberBatch::LANE_C);
+		activeA[lane] = m_Rg.UInt(4) != 0;
+		if (!activeA[lane])
+		{
+			numA[lane].SetZero();
+			batch.ClearLane(lane);
+		}
+		else
+		{
+			numA[lane] = Rand();
+			numA[lane].ReverseAndAdd(m_Rg.UInt(100));
+			batch.SetLane(lane, numA[lane]);
+		}
+
+		size_t maxLength = 0;
+		uint32_t activeMask = 0;
+		for (size_t j = 0; j < NumberBatch::LANE_C; ++j)
+		{
+			const size_t len = activeA[j] ? numA[j].GetLength() : 0;
+			maxLength = std::max(maxLength, len);
+			activeMask |= activeA[j] ? (1u << j) : 0;
+
+			batch.GetLane(j, num);
+			if (batch.GetLength(j) != len || num != numA[j])
+				return OnError(1);
+		}
+		if (batch.GetMaxLength() != maxLength || batch.GetActiveMask() != activeMask)
+			return OnError(2);
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool TestNumberBatch::TestReverseAndAdd()
+{
+	// Выполняем операции RAA над группой чисел разной длины, сравнивая результаты с BigNumber. Числа в случайных
+	// дорожках периодически заменяются новыми. Часть чисел состоит из цифр 0 и 9 (чтобы чаще возникали длинные
+	// цепочки переносов), часть - из цифр, суммы симметричных пар которых меньше 10 (такие числа за 1 шаг
+	// становятся палиндромами). Тестируем обе версии операции RAA (SSSE3 и AVX2, если она поддерживается)
+
+	using RAAKernel = BigNumber::RAAKernel;
+	const RAAKernel savedKernel = BigNumber::GetRAAKernel();
+
+	std::string str;
+	BigNumber numA[NumberBatch::LANE_C], num;
+	bool isOk = true;
+	for (auto kernel : { RAAKernel::SSSE3, RAAKernel::AVX2 })
+	{
+		if (!BigNumber::SetRAAKernel(kernel))
+			continue;
+
+		NumberBatch batch;
+		for (unsigned step = 0; isOk && step < 5000; ++step)
+		{
+			for (size_t lane = 0; lane < NumberBatch::LANE_C; ++lane)
+			{
+				if (step && numA[lane].GetLength() < 200 && m_Rg.UInt(100))
+					continue;
+
+				const size_t len = 1 + m_Rg.UInt(60);
+				str.assign(len, '0');
+				const unsigned type = m_Rg.UInt(3);
+				for (size_t i = 0; i < len; ++i)
+					str[i] = (type == 1) ? '0' + 9 * m_Rg.UInt(2) : '0' + m_Rg.UInt(10);
+				if (str[0] == '0')
+					str[0] = '1';
+				if (type == 2)
+				{
+					for (size_t i = 0; i < len / 2; ++i)
+						str[len - i - 1] = '0' + m_Rg.UInt(10 - (str[i] - '0'));
+					if (len & 1)
+						str[len / 2] = '0' + m_Rg.UInt(5);
+				}
+
+				numA[lane] = str;
+				batch.SetLane(lane, numA[lane]);
+			}
+
+			const uint32_t palMask = batch.ReverseAndAdd();
+			for (size_t lane = 0; isOk && lane < NumberBatch::LANE_C; ++lane)
+			{
+				numA[lane].ReverseAndAdd(1);
+				batch.GetLane(lane, num);
+				const bool isPalindrome = (palMask & (1u << lane)) != 0;
+				isOk = num == numA[lane] && isPalindrome == numA[lane].IsPalindrome();
+			}
+		}
+	}
+
+	BigNumber::SetRAAKernel(savedKernel);
+	return isOk ? true : OnError(3);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   TestShortNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+bool TestShortNumber::Execute()
+{
+	PrintHeader();
+
+	if (!IsCancelled() && (!TestSetGet<32>() || !TestSetGet<64>()))
+		return false;
+	if (!IsCancelled() && (!TestRAA<32>() || !TestRAA<64>()))
+		return false;
+
+	PrintFooter();
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+bool TestShortNumber::TestSetGet()
+{
+	// Тестируем преобразования из FixNumber и Number и обратно, а также функцию IsPalindrome
+
+	ShortNumber<N> num, num2;
+	BigNumber big;
+	FixNumber fix, fix2;
+	WideFixNumber wide, wide2;
+	auto fn = [&](char* p, size_t len) {
+		if (m_Rg.UInt(4) == 0)
+		{
+			for (size_t i = 0; i < len / 2; ++i)
+				p[len - i - 1] = p[i];
+		}
+
+		big.Set(p);
+		fix = p;
+		num = fix;
+		num2 = big;
+		num.Get(fix2);
+		return num == num2 && num.AsNumber() == big && fix2 == fix && num.GetLength() == len &&
+			num.IsPalindrome() == big.IsPalindrome();
+	};
+	if (!ForRandomNumbers(1, 30, 100, fn))
+		return OnError(1);
+
+	auto wideFn = [&](char* p, size_t len) {
+		big.Set(p);
+		wide = p;
+		num = wide;
+		num2 = big;
+		num.Get(wide2);
+		return num == num2 && num.AsNumber() == big && wide2 == wide && num.GetLength() == len;
+	};
+	if (!ForRandomNumbers(1, std::min(N, WideFixNumber::MAX_LENGTH), 100, wideFn))
+		return OnError(2);
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+bool TestShortNumber::TestRAA()
+{
+	// Тестируем функции ReverseAndAdd, RAATillPalindrome и RAATillLength, сравнивая результаты с BigNumber.
+	// Количество операций (и длину) выбираем так, чтобы длина числа гарантированно не превысила N цифр
+
+	ShortNumber<N> num;
+	BigNumber big;
+	auto fn = [&](char* p, size_t len) {
+		const unsigned fill = m_Rg.UInt(4);
+		for (size_t i = 1; i < len; ++i)
+		{
+			if (m_Rg.UInt(4) < fill)
+				p[i] = '8' + (m_Rg.UInt() & 1);
+		}
+
+		big.Set(p);
+		num = big;
+		unsigned stepC = 1 + m_Rg.UInt(static_cast<unsigned>(N - len));
+		num.ReverseAndAdd(stepC);
+		big.ReverseAndAdd(stepC);
+		if (num.AsNumber() != big || num.IsPalindrome() != big.IsPalindrome())
+			return false;
+
+		big.Set(p);
+		num = big;
+		unsigned doneC1, doneC2;
+		stepC = 1 + m_Rg.UInt(static_cast<unsigned>(N - len));
+		bool isPalindrome = num.RAATillPalindrome(stepC, doneC1);
+		if (isPalindrome != big.RAATillPalindrome(stepC, doneC2) || doneC1 != doneC2 || num.AsNumber() != big)
+			return false;
+
+		big.Set(p);
+		num = big;
+		const size_t length = ((len > 3) ? len - 3 : 0) + m_Rg.UInt(12);
+		const size_t bound = ShortNumber<N>::GetRAALengthBound(len, length);
+		if (bound > N)
+			return true;
+		isPalindrome = num.RAATillLength(length, doneC1);
+		return isPalindrome == big.RAATillLength(length, doneC2) && doneC1 == doneC2 &&
+			num.AsNumber() == big && num.GetLength() <= bound;
+	};
+	if (!ForRandomNumbers(1, N - 1, 100, fn))
+		return OnError(3);
+
+	return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   SpeedTestP196RAA
@@ -1378,6 +1986,158 @@ bool SpeedTestP196RAA::Execute()
 	return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   SpeedTestP196Engines
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Тест SpeedTestP196Engines измеряет среднее время одной операции RAA над случайными числами разной длины (от 10
+// тыс. до 40 млн. цифр) для каждого из классов BigNumber, PackedNumber и LimbNumber, и находит для каждого из двух
+// последних классов наименьшую длину, начиная с которой он оказывается быстрее BigNumber. Длины, при которых число
+// перестаёт помещаться в кеш процессора, зависят от конкретной системы, поэтому такое сравнение полезно для выбора
+// движка в P196ProblemMain
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SpeedTestP196Engines::Execute()
+{
+	::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+	m_VerboseOutput = true;
+	PrintHeader();
+
+	const size_t lengths[] = { 10000, 100000, 1000000, 2000000, 5000000, 10000000, 20000000, 40000000 };
+	size_t packedCrossover = 0, limbsCrossover = 0;
+
+	math::RandGen rg(196);
+	for (size_t len : lengths)
+	{
+		std::string num(len, '0');
+		num[0] = '1' + rg.UInt(9);
+		for (size_t i = 1; i < len; ++i)
+			num[i] = '0' + rg.UInt(10);
+
+		// Количество операций выбираем так, чтобы на каждый замер уходило примерно одинаковое время
+		const unsigned stepC = static_cast<unsigned>(std::max<size_t>(2000000000 / len, 20));
+		const double digitsTime = MeasureRAA<BigNumber>(num, stepC);
+		const double packedTime = MeasureRAA<PackedNumber>(num, stepC);
+		const double limbsTime = MeasureRAA<LimbNumber>(num, stepC);
+
+		if (!packedCrossover && packedTime < digitsTime)
+			packedCrossover = len;
+		if (!limbsCrossover && limbsTime < digitsTime)
+			limbsCrossover = len;
+
+		aux::Printf("  Length #15#%10s#7: digits %9.2f us, packed %9.2f us, limbs %9.2f us\n",
+			SeparateWithCommas(len).c_str(), digitsTime, packedTime, limbsTime);
+
+		if (IsCancelled())
+			return true;
+	}
+
+	auto printCrossover = [](const char* pName, size_t len) {
+		if (len)
+			aux::Printf("  %s is faster than BigNumber starting at #15%s#7 digits\n", pName, SeparateWithCommas(len).c_str());
+		else
+			aux::Printf("  %s is slower than BigNumber at all tested lengths\n", pName);
+	};
+	printCrossover("PackedNumber", packedCrossover);
+	printCrossover("LimbNumber", limbsCrossover);
+
+	PrintFooter();
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+double SpeedTestP196Engines::MeasureRAA(const std::string& num, unsigned stepC)
+{
+	// Операции выполняем сериями, каждый раз заново устанавливая исходное значение
+	// числа, чтобы за время замера его длина увеличилась не более, чем на 1%
+	const unsigned batchC = static_cast<unsigned>(std::min<size_t>(stepC, num.size() / 50 + 1));
+
+	T n;
+	n.Reserve(num.size() + batchC + 64);
+
+	LARGE_INTEGER t1, t2, f;
+	uint64_t totalTime = 0;
+	for (unsigned doneC = 0; doneC < stepC; doneC += batchC)
+	{
+		n.Set(num);
+		::QueryPerformanceCounter(&t1);
+		n.ReverseAndAdd(batchC);
+		::QueryPerformanceCounter(&t2);
+		totalTime += t2.QuadPart - t1.QuadPart;
+	}
+	::QueryPerformanceFrequency(&f);
+
+	const unsigned totalStepC = (stepC + batchC - 1) / batchC * batchC;
+	return 1.0e+6 * totalTime / std::max(f.QuadPart, 1ll) / totalStepC;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   SpeedTestP196Threads
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Тест SpeedTestP196Threads измеряет среднее время одной операции RAA (класс BigNumber) над случайными числами
+// длиной от 1 до 40 млн. цифр при разном количестве потоков: от 1 до количества логических ядер процессора. Для
+// каждого количества потоков выводится ускорение относительно однопоточного варианта. Так как при таких длинах
+// скорость RAA в основном ограничена пропускной способностью памяти, ускорение обычно заметно меньше линейного
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SpeedTestP196Threads::Execute()
+{
+	::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+	m_VerboseOutput = true;
+	PrintHeader();
+
+	const unsigned savedThreadC = BigNumber::GetRAAThreadC();
+	const unsigned maxThreadC = std::max(std::thread::hardware_concurrency(), 1u);
+
+	std::vector<unsigned> threadCounts;
+	for (unsigned threadC = 1; threadC < maxThreadC; threadC *= 2)
+		threadCounts.push_back(threadC);
+	threadCounts.push_back(maxThreadC);
+
+	const size_t lengths[] = { 1000000, 5000000, 10000000, 40000000 };
+
+	math::RandGen rg(196);
+	for (size_t len : lengths)
+	{
+		std::string num(len, '0');
+		num[0] = '1' + rg.UInt(9);
+		for (size_t i = 1; i < len; ++i)
+			num[i] = '0' + rg.UInt(10);
+
+		aux::Printf("  Length #15#%s#7:\n", SeparateWithCommas(len).c_str());
+
+		double singleTime = 0;
+		const unsigned stepC = static_cast<unsigned>(std::max<size_t>(2000000000 / len, 20));
+		for (unsigned threadC : threadCounts)
+		{
+			BigNumber::SetRAAThreadC(threadC);
+			const double time = SpeedTestP196Engines::MeasureRAA<BigNumber>(num, stepC);
+			if (threadC == 1)
+				singleTime = time;
+
+			aux::Printf("    %2u thread(s): %9.2f us, speedup #15%.2fx#7\n", threadC, time, singleTime / time);
+
+			if (IsCancelled())
+			{
+				BigNumber::SetRAAThreadC(savedThreadC);
+				return true;
+			}
+		}
+	}
+
+	BigNumber::SetRAAThreadC(savedThreadC);
+	PrintFooter();
+	return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   SpeedTestRAA
@@ -1453,7 +2213,8 @@ bool SpeedTestRAA::Execute()
 //----------------------------------------------------------------------------------------------------------------------
 std::string SpeedTestRAA::GetPrintedHeader() const
 {
-	return "Running RAA speedtest (long number sequence)";
+	return util::Format("Running RAA speedtest (long number sequence, %s)",
+		BigNumber::GetRAAKernelName(BigNumber::GetRAAKernel()));
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -77,6 +77,8 @@ private:
 	bool TestCtorSet();
 	bool TestComparison();
 	bool TestGetHash();
+	bool TestWideNumber();
+	bool TestPackedDigits();
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -105,6 +107,8 @@ private:
 	bool TestReverseAndAdd();
 	bool TestRAATillPalindrome();
 	bool TestRAATillLength();
+	bool TestRAAKernels();
+	bool TestParallelRAA();
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -153,6 +157,110 @@ private:
 	uint8_t* m_NumA = nullptr;	// Числа набора: 1 бит - 1 число, отсчёт от 0
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   TestLongNumber - базовый класс тестов альтернативных представлений длинных чисел (PackedNumber, LimbNumber)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class TestLongNumber : public TestNumber
+{
+protected:
+	// Проверяет корректность работы класса T, сравнивая результаты его функций с BigNumber
+	template<class T> bool TestClass();
+
+private:
+	template<class T> bool TestSetAsString();
+	template<class T> bool TestReverseAndAdd();
+	template<class T> bool TestRAATillPalindrome();
+	template<class T> bool TestRAATillLength();
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Test.Validity.PackedNumber - тест корректности работы класса PackedNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class TestPackedNumber : public TestLongNumber
+{
+public:
+	static std::string GetId() { return "Test.Validity.PackedNumber"; }
+	static std::string GetPrerequisites() { return "Test.Validity.BigNumber"; }
+
+	virtual bool Execute() override;
+
+protected:
+	virtual std::string GetPrintedName() const override { return "PackedNumber"; }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Test.Validity.LimbNumber - тест корректности работы класса LimbNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class TestLimbNumber : public TestLongNumber
+{
+public:
+	static std::string GetId() { return "Test.Validity.LimbNumber"; }
+	static std::string GetPrerequisites() { return "Test.Validity.BigNumber"; }
+
+	virtual bool Execute() override;
+
+protected:
+	virtual std::string GetPrintedName() const override { return "LimbNumber"; }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Test.Validity.NumberBatch - тест корректности работы класса NumberBatch
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class TestNumberBatch : public TestNumber
+{
+public:
+	static std::string GetId() { return "Test.Validity.NumberBatch"; }
+	static std::string GetPrerequisites() { return "Test.Validity.BigNumber"; }
+
+	virtual bool Execute() override;
+
+protected:
+	virtual std::string GetPrintedName() const override { return "NumberBatch"; }
+
+private:
+	bool TestSetGetLane();
+	bool TestReverseAndAdd();
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Test.Validity.ShortNumber - тест корректности работы класса ShortNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class TestShortNumber : public TestNumber
+{
+public:
+	static std::string GetId() { return "Test.Validity.ShortNumber"; }
+	static std::string GetPrerequisites() { return "Test.Validity.FixNumber, Test.Validity.BigNumber"; }
+
+	virtual bool Execute() override;
+
+protected:
+	virtual std::string GetPrintedName() const override { return "ShortNumber"; }
+
+private:
+	template<size_t N> bool TestSetGet();
+	template<size_t N> bool TestRAA();
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   Test.Speed.P196RAA - измерение времени работы цикла Reverse-And-Add до достижения числом 196 длины в 1M цифр
@@ -171,6 +279,45 @@ protected:
 	virtual std::string GetPrintedName() const override { return "P196RAA-1M"; }
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Test.Speed.P196Engines - сравнение скорости операции RAA для разных представлений длинных чисел
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class SpeedTestP196Engines : public Test
+{
+public:
+	static std::string GetId() { return "Test.Speed.P196Engines"; }
+
+	virtual bool Execute() override;
+
+	// Возвращает среднее время одной операции RAA (в микросекундах) над числом num
+	template<class T> static double MeasureRAA(const std::string& num, unsigned stepC);
+
+protected:
+	virtual std::string GetPrintedName() const override { return "P196Engines"; }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Test.Speed.P196Threads - измерение масштабируемости операции RAA над длинными числами по количеству потоков
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class SpeedTestP196Threads : public Test
+{
+public:
+	static std::string GetId() { return "Test.Speed.P196Threads"; }
+
+	virtual bool Execute() override;
+
+protected:
+	virtual std::string GetPrintedName() const override { return "P196Threads"; }
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   Test.Speed.RAA - измерение скорости работы цикла Reverse-And-Add
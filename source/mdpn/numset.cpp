@@ -5,339 +5,1418 @@
 #include "largemempages.h"
 
 #include <core/exception.h>
-#include <core/winapi.h>
+#include <core/file.h>
+
+#include <intrin.h>
+#include <string.h>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   BloomFilter
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+void BloomFilter::Allocate(size_t largePageSize, int numaNode)
+{
+	// Выделенная память заполнена нулями, т.е. фильтр пуст
+	Free();
+	m_pBlockA = static_cast<Block*>(LargeMemPages::Allocate(sizeof(Block) * BLOCK_C, largePageSize, numaNode));
+	m_Count.store(0, std::memory_order_relaxed);
+}
 
 //----------------------------------------------------------------------------------------------------------------------
-NumberSet::NumberSet(bool useLargePages)
-	: m_HBits(HASH_BITS - 3)
+void BloomFilter::Free()
 {
-	static_assert(CLEAR_GAIN >= 2 && CLEAR_GAIN < EIGHTH_CHUNK_C, "Incorrect CLEAR_GAIN value");
-	// В целях увеличения скорости работы функции Purge за выбор части отвечают биты 12-14. Ещё 3
-	// бита нужны для роста таблицы. Таким образом, длина хеша должна быть не менее 12+3+3=18 бит
-	static_assert(HASH_BITS >= 18 && HASH_BITS <= 30, "HASH_BITS must be >= 18");
+	if (m_pBlockA)
+	{
+		LargeMemPages::Free(m_pBlockA, sizeof(Block) * BLOCK_C);
+		m_pBlockA = nullptr;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void BloomFilter::Clear()
+{
+	if (m_pBlockA && m_Count.load(std::memory_order_relaxed))
+	{
+		memset(static_cast<void*>(m_pBlockA), 0, sizeof(Block) * BLOCK_C);
+		m_Count.store(0, std::memory_order_relaxed);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline bool BloomFilter::MayContain(uint64_t hash) const
+{
+	return !IsActive() || MayContain(m_pBlockA, BLOCK_C, hash);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline void BloomFilter::Prefetch(uint64_t hash) const
+{
+	if (m_pBlockA)
+		Prefetch(m_pBlockA, BLOCK_C, hash);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline void BloomFilter::Insert(uint64_t hash)
+{
+	if (IsActive())
+	{
+		Insert(m_pBlockA, BLOCK_C, hash);
+		m_Count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline bool BloomFilter::MayContain(const Block* pBlockA, size_t blockC, uint64_t hash)
+{
+	// Проверяются все 8 слов блока без ветвлений: блок занимает одну линию кеша, а цикл векторизуется
+	const uint64_t mixed = Mix(hash);
+	const Block& block = pBlockA[GetBlockIndex(mixed, blockC)];
+	uint64_t missing = 0;
+	for (size_t i = 0; i < 8; ++i)
+		missing |= GetBit(mixed, i) & ~block.wordA[i].load(std::memory_order_relaxed);
+	return !missing;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline void BloomFilter::Prefetch(const Block* pBlockA, size_t blockC, uint64_t hash)
+{
+	_mm_prefetch(reinterpret_cast<const char*>(&pBlockA[GetBlockIndex(Mix(hash), blockC)]), _MM_HINT_T0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline void BloomFilter::Insert(Block* pBlockA, size_t blockC, uint64_t hash)
+{
+	// Биты, которые уже установлены, не записываются: это избавляет от лишних
+	// атомарных операций и от борьбы потоков за линии кеша популярных блоков
+	const uint64_t mixed = Mix(hash);
+	Block& block = pBlockA[GetBlockIndex(mixed, blockC)];
+	for (size_t i = 0; i < 8; ++i)
+	{
+		const uint64_t bit = GetBit(mixed, i);
+		if (!(block.wordA[i].load(std::memory_order_relaxed) & bit))
+			block.wordA[i].fetch_or(bit, std::memory_order_relaxed);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline uint64_t BloomFilter::Mix(uint64_t hash)
+{
+	// Хеши наборов - это 32-битные хеши FNV-1a, поэтому биты перемешиваются полностью (финализатор MurmurHash3)
+	hash = (hash ^ (hash >> 33)) * 0xff51afd7ed558ccd;
+	hash = (hash ^ (hash >> 33)) * 0xc4ceb9fe1a85ec53;
+	return hash ^ (hash >> 33);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline uint64_t BloomFilter::GetBit(uint64_t mixed, size_t word)
+{
+	// Номер бита в каждом слове - старшие 6 бит произведения младших 32 бит хеша на свою нечётную константу
+	static constexpr uint32_t SALT[8] = {
+		0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31 };
+	return uint64_t(1) << ((static_cast<uint32_t>(mixed) * SALT[word]) >> 26);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   BasicNumberSet
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+BasicNumberSet<T>::BasicNumberSet(bool useLargePages, bool usePrefilter)
+{
+	static_assert(CLEAR_GAIN >= 2 && CLEAR_GAIN < PART_CHUNK_C, "Incorrect CLEAR_GAIN value");
+	// Младший байт номера блока должен однозначно определять блок части, а все
+	// блоки части должны помещаться в 7/8 таблицы части максимального размера
+	static_assert(PART_CHUNK_C < 256, "PART_CHUNK_C must be < 256");
+	static_assert(PART_CHUNK_C * CHUNK_SIZE < (size_t(1) << PART_BITS) / 8 * 7, "PART_CHUNK_C is too big");
+	// Для выбора группы используются биты 32-51 перемешанного хеша, т.е. не более 20 бит
+	static_assert(PART_BITS >= MIN_PART_BITS && PART_BITS <= 24, "Incorrect HASH_BITS value");
+	// Функция Purge не сбрасывает биты фильтра Блума, так как удаление начинается после его отключения
+	static_assert(PART_CHUNK_C * CHUNK_SIZE > BloomFilter::MAX_COUNT, "BloomFilter::MAX_COUNT is too big");
 
 	if (useLargePages)
 	{
 		const size_t pageSize = LargeMemPages::GetLargePageSize();
 		m_LPageSize = LargeMemPages::IsEnabled() ? pageSize : 0;
-		m_HBits = m_LPageSize ? HASH_BITS : HASH_BITS - 3;
 	}
+	if (usePrefilter)
+		m_Prefilter.Allocate(m_LPageSize);
 
-	// Выделяем память под весь массив без инициализации элементов
-	m_TableA = AllocateMem(size_t(1) << HASH_BITS);
-	// Инициализируем 1/8 часть элементов массива
-	const size_t itemC = size_t(1) << m_HBits;
-	for (size_t i = 0; i < itemC; ++i)
-		m_TableA[i].Reset();
+	// При использовании больших страниц таблицы частей сразу создаются максимального
+	// размера, в противном случае их размер увеличивается по мере добавления чисел
+	for (Part& part : m_PartA)
+		AllocatePart(part, m_LPageSize ? PART_BITS : MIN_PART_BITS);
+}
 
-	m_ChunkA = new Item*[8 * EIGHTH_CHUNK_C];
-	AML_FILLA(m_ChunkA, 0, 8 * EIGHTH_CHUNK_C);
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+BasicNumberSet<T>::~BasicNumberSet()
+{
+	for (Part& part : m_PartA)
+		FreePart(part);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+void BasicNumberSet<T>::Clear(bool freeMem)
+{
+	for (Part& part : m_PartA)
+	{
+		if (freeMem && !m_LPageSize && part.bits != MIN_PART_BITS)
+		{
+			FreePart(part);
+			AllocatePart(part, MIN_PART_BITS);
+		} else
+			memset(part.pCtrlA, EMPTY, part.GetSlotC());
+
+		part.itemC = part.deletedC = 0;
+		part.firstChunk = 0;
+	}
+	m_Count = 0;
+	m_Prefilter.Clear();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+size_t BasicNumberSet<T>::GetMemSize() const
+{
+	size_t slotC = 0;
+	for (const Part& part : m_PartA)
+		slotC += part.GetSlotC();
+	return (sizeof(T) + 2) * slotC + m_Prefilter.GetMemSize();
+}
 
-	for (int i = 0; i < 8; ++i)
-		m_NextA[i] = 0;
-	for (int i = 0; i < 8; ++i)
-		m_RCountA[i] = 0;
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool BasicNumberSet<T>::Exists(const Number& num) const
+{
+	return Find(num);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-NumberSet::~NumberSet()
+template<class T>
+bool BasicNumberSet<T>::Exists(const T& num) const
 {
-	for (size_t i = 0; i < 8 * EIGHTH_CHUNK_C; ++i)
-		FreeMem(m_ChunkA[i]);
-	delete[] m_ChunkA;
-	FreeMem(m_TableA);
+	return Find(num);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void NumberSet::Clear(bool freeMem)
+template<class T>
+bool BasicNumberSet<T>::Insert(const T& num)
 {
-	for (size_t eighth = 0; eighth < 8; ++eighth)
+	if (num.IsZero())
+		return true;
+
+	// Ограничение на суммарное количество элементов - не более, чем 8 * CLEAR_GAIN полных блоков
+	if (m_Count >= 8 * CLEAR_GAIN * CHUNK_SIZE)
+	{
+		size_t maxPart = 0;
+		for (size_t i = 1; i < 8; ++i)
+		{
+			if (m_PartA[i].itemC > m_PartA[maxPart].itemC)
+				maxPart = i;
+		}
+		Purge(maxPart);
+	}
+
+	const unsigned numHash = num.GetHash();
+	const uint64_t hash = MixHash(numHash);
+	const size_t partIndex = GetPartIndex(hash);
+	Part& part = m_PartA[partIndex];
+	if (part.itemC >= PART_CHUNK_C * CHUNK_SIZE)
+		Purge(partIndex);
+
+	// Ищем число и одновременно запоминаем первый свободный (пустой или удалённый) слот
+	// последовательности пробирования: если числа в наборе нет, то оно будет помещено в этот слот
+	const __m128i ctrl = _mm_set1_epi8(static_cast<char>(GetCtrl(hash)));
+	const size_t groupMask = part.GetSlotC() / GROUP_SIZE - 1;
+	size_t freeSlot = ~size_t(0);
+	size_t group = GetGroup(part, hash);
+	for (size_t step = 1;; ++step)
 	{
-		Item** eighthChunkA = &m_ChunkA[eighth * EIGHTH_CHUNK_C];
-		for (size_t i = freeMem ? 0 : CLEAR_GAIN; i < EIGHTH_CHUNK_C; ++i)
-			FreeMem(eighthChunkA[i]);
+		const __m128i ctrlA = _mm_load_si128(reinterpret_cast<const __m128i*>(part.pCtrlA + group * GROUP_SIZE));
+		for (unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(ctrlA, ctrl)); mask; mask &= mask - 1)
+		{
+			if (part.pNumA[group * GROUP_SIZE + _tzcnt_u32(mask)] == num)
+				return false;
+		}
+
+		const unsigned freeMask = ~_mm_movemask_epi8(ctrlA) & 0xffff;
+		if (freeMask && freeSlot == ~size_t(0))
+			freeSlot = group * GROUP_SIZE + _tzcnt_u32(freeMask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(ctrlA, _mm_setzero_si128())))
+			break;
+
+		group = (group + step) & groupMask;
 	}
-	if (freeMem && !m_LPageSize)
+
+	// Если число займёт пустой слот и при этом занятых и удалённых слотов станет больше 7/8 таблицы части, то
+	// таблица увеличивается вдвое или, если она уже достаточно велика, то в ней освобождаются удалённые слоты
+	if (part.pCtrlA[freeSlot] == EMPTY && part.itemC + part.deletedC >= part.GetMaxUsedC())
 	{
-		FreeMem(m_TableA);
-		m_HBits = HASH_BITS - 3;
-		m_TableA = AllocateMem(size_t(1) << HASH_BITS);
+		if (part.bits < PART_BITS && part.itemC >= part.GetSlotC() / 2)
+			Rehash(part, part.bits + 1);
+		else
+			DropDeleted(part);
+
+		freeSlot = FindFreeSlot(part, hash);
 	}
 
-	const size_t itemC = size_t(1) << m_HBits;
-	for (size_t i = 0; i < itemC; ++i)
-		m_TableA[i].Reset();
-	for (int i = 0; i < 8; ++i)
-		m_NextA[i] = 0;
-	for (int i = 0; i < 8; ++i)
-		m_RCountA[i] = 0;
-	m_TCount = m_CCount = m_RCount = 0;
-	m_Purge = 0;
+	if (part.pCtrlA[freeSlot] == DELETED)
+		--part.deletedC;
+	part.pCtrlA[freeSlot] = GetCtrl(hash);
+	part.pChunkA[freeSlot] = static_cast<uint8_t>(part.firstChunk + part.itemC / CHUNK_SIZE);
+	part.pNumA[freeSlot] = num;
+	++part.itemC;
+	++m_Count;
+	m_Prefilter.Insert(numHash);
+	return true;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool NumberSet::Exists(const Number& num) const
+template<class T>
+template<class U>
+inline bool BasicNumberSet<T>::Find(const U& num) const
 {
-	const Item* p = &m_TableA[GetHash(num)];
-	if (p->num.IsZero())
+	const unsigned numHash = num.GetHash();
+	if (!m_Prefilter.MayContain(numHash))
 		return false;
 
-	for (; p->num != num; p = GetItem(p->next))
+	const uint64_t hash = MixHash(numHash);
+	const Part& part = m_PartA[GetPartIndex(hash)];
+
+	const __m128i ctrl = _mm_set1_epi8(static_cast<char>(GetCtrl(hash)));
+	const size_t groupMask = part.GetSlotC() / GROUP_SIZE - 1;
+	size_t group = GetGroup(part, hash);
+	for (size_t step = 1;; ++step)
 	{
-		if (p->next == Item::LAST)
+		const __m128i ctrlA = _mm_load_si128(reinterpret_cast<const __m128i*>(part.pCtrlA + group * GROUP_SIZE));
+		for (unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(ctrlA, ctrl)); mask; mask &= mask - 1)
+		{
+			if (part.pNumA[group * GROUP_SIZE + _tzcnt_u32(mask)] == num)
+				return true;
+		}
+
+		// Группа с пустым слотом завершает последовательность пробирования
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(ctrlA, _mm_setzero_si128())))
 			return false;
+
+		group = (group + step) & groupMask;
 	}
-	return true;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool NumberSet::Exists(const FixNumber& num) const
+template<class T>
+size_t BasicNumberSet<T>::FindFreeSlot(const Part& part, uint64_t hash)
 {
-	const Item* p = &m_TableA[GetHash(num)];
-	if (p->num.IsZero())
-		return false;
+	const size_t groupMask = part.GetSlotC() / GROUP_SIZE - 1;
+	size_t group = GetGroup(part, hash);
+	for (size_t step = 1;; ++step)
+	{
+		// Свободные слоты (пустые и удалённые) - это слоты со сброшенным старшим битом байта состояния
+		const __m128i ctrlA = _mm_load_si128(reinterpret_cast<const __m128i*>(part.pCtrlA + group * GROUP_SIZE));
+		if (const unsigned freeMask = ~_mm_movemask_epi8(ctrlA) & 0xffff)
+			return group * GROUP_SIZE + _tzcnt_u32(freeMask);
+
+		group = (group + step) & groupMask;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+void BasicNumberSet<T>::Purge(size_t partIndex)
+{
+	// Помечаем удалёнными все занятые слоты, числа которых относятся к первому блоку части. Одновременно
+	// в части бывает не более PART_CHUNK_C блоков, поэтому младший байт номера однозначно определяет блок
+	Part& part = m_PartA[partIndex];
+	const __m128i chunk = _mm_set1_epi8(static_cast<char>(part.firstChunk));
+	const __m128i deleted = _mm_set1_epi8(DELETED);
+	const __m128i zero = _mm_setzero_si128();
 
-	for (; p->num != num; p = GetItem(p->next))
+	size_t removedC = 0;
+	const size_t slotC = part.GetSlotC();
+	for (size_t i = 0; i < slotC; i += GROUP_SIZE)
 	{
-		if (p->next == Item::LAST)
-			return false;
+		// Занятые слоты - это слоты, байт состояния которых отрицателен (установлен старший бит)
+		__m128i* pCtrl = reinterpret_cast<__m128i*>(part.pCtrlA + i);
+		const __m128i ctrlA = _mm_load_si128(pCtrl);
+		const __m128i chunkA = _mm_load_si128(reinterpret_cast<const __m128i*>(part.pChunkA + i));
+		const __m128i mask = _mm_and_si128(_mm_cmplt_epi8(ctrlA, zero), _mm_cmpeq_epi8(chunkA, chunk));
+		if (unsigned bits = _mm_movemask_epi8(mask))
+		{
+			_mm_store_si128(pCtrl, _mm_or_si128(_mm_andnot_si128(mask, ctrlA), _mm_and_si128(mask, deleted)));
+			for (; bits; bits &= bits - 1)
+				++removedC;
+		}
 	}
-	return true;
+
+	++part.firstChunk;
+	part.itemC -= removedC;
+	part.deletedC += removedC;
+	m_Count -= removedC;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool NumberSet::Insert(const FixNumber& num)
+template<class T>
+void BasicNumberSet<T>::Rehash(Part& part, unsigned bits)
 {
-	if (num.IsZero())
-		return true;
+	Part newPart;
+	AllocatePart(newPart, bits);
 
-	// Ограничение на суммарное количество элементов - не более, чем 8 * CLEAR_GAIN полных блоков
-	if (m_CCount >= 8 * CLEAR_GAIN * CHUNK_SIZE)
+	const size_t slotC = part.GetSlotC();
+	for (size_t i = 0; i < slotC; ++i)
 	{
-		size_t eighth = 0;
-		size_t maxC = m_NextA[0];
-		for (size_t i = 1; i < 8; ++i)
+		if (part.pCtrlA[i] & FULL)
+		{
+			// Байт состояния не зависит от размера таблицы, поэтому копируется как есть
+			const size_t slot = FindFreeSlot(newPart, MixHash(part.pNumA[i].GetHash()));
+			newPart.pCtrlA[slot] = part.pCtrlA[i];
+			newPart.pChunkA[slot] = part.pChunkA[i];
+			newPart.pNumA[slot] = part.pNumA[i];
+		}
+	}
+
+	newPart.itemC = part.itemC;
+	newPart.firstChunk = part.firstChunk;
+	FreePart(part);
+	part = newPart;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+void BasicNumberSet<T>::DropDeleted(Part& part)
+{
+	// Освобождаем удалённые слоты, а занятые помечаем как удалённые: теперь удалённые
+	// слоты означают слоты с числами, которые ещё не перемещены на свои новые места
+	const size_t slotC = part.GetSlotC();
+	for (size_t i = 0; i < slotC; ++i)
+		part.pCtrlA[i] = (part.pCtrlA[i] & FULL) ? DELETED : EMPTY;
+
+	for (size_t i = 0; i < slotC; ++i)
+	{
+		if (part.pCtrlA[i] != DELETED)
+			continue;
+
+		// Если первый свободный слот последовательности пробирования числа находится в той же
+		// группе, что и само число, то число остаётся на месте. Иначе оно переносится в этот слот,
+		// а если слот был занят ещё не перемещённым числом, то числа меняются местами и слот i
+		// обрабатывается повторно (уже с другим числом)
+		const uint64_t hash = MixHash(part.pNumA[i].GetHash());
+		const size_t slot = FindFreeSlot(part, hash);
+		if (slot / GROUP_SIZE == i / GROUP_SIZE)
+		{
+			part.pCtrlA[i] = GetCtrl(hash);
+			continue;
+		}
+
+		const bool isEmpty = part.pCtrlA[slot] == EMPTY;
+		part.pCtrlA[slot] = GetCtrl(hash);
+		if (isEmpty)
+		{
+			part.pCtrlA[i] = EMPTY;
+			part.pNumA[slot] = part.pNumA[i];
+			part.pChunkA[slot] = part.pChunkA[i];
+		} else
+		{
+			std::swap(part.pNumA[slot], part.pNumA[i]);
+			std::swap(part.pChunkA[slot], part.pChunkA[i]);
+			--i;
+		}
+	}
+	part.deletedC = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+AML_NOINLINE void BasicNumberSet<T>::AllocatePart(Part& part, unsigned bits)
+{
+	// Числа, байты состояния и младшие байты номеров блоков размещаются в одном блоке памяти (sizeof(T) + 2 байт
+	// на слот). Память, выделенная функцией LargeMemPages::Allocate, обнулена, т.е. все слоты новой таблицы пусты
+	const size_t slotC = size_t(1) << bits;
+	uint8_t* p = static_cast<uint8_t*>(LargeMemPages::Allocate((sizeof(T) + 2) * slotC, m_LPageSize));
+
+	part.pNumA = reinterpret_cast<T*>(p);
+	part.pCtrlA = p + sizeof(T) * slotC;
+	part.pChunkA = part.pCtrlA + slotC;
+	part.bits = bits;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+void BasicNumberSet<T>::FreePart(Part& part)
+{
+	LargeMemPages::Free(part.pNumA, (sizeof(T) + 2) * part.GetSlotC());
+	part.pNumA = nullptr;
+	part.pCtrlA = part.pChunkA = nullptr;
+}
+
+// Явное инстанцирование для чисел длиной до 30 и 62 цифр
+template class BasicNumberSet<FixNumber>;
+template class BasicNumberSet<WideFixNumber>;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   ConcurrentSetBase
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+ConcurrentSetBase::ConcurrentSetBase(bool useLargePages, int numaNode, bool usePrefilter)
+	: m_SlotA(new Slot[MAX_THREAD_C])
+	, m_NumaNode(numaNode)
+	, m_UsePrefilter(usePrefilter)
+{
+	if (useLargePages)
+	{
+		const size_t pageSize = LargeMemPages::GetLargePageSize();
+		m_LPageSize = LargeMemPages::IsEnabled() ? pageSize : 0;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+ConcurrentSetBase::EpochGuard::EpochGuard(const ConcurrentSetBase& set)
+	: m_Index(GetThreadSlotIndex())
+	, m_Slot(set.m_SlotA[m_Index])
+{
+	// Эпоха объявляется до чтения номера текущего поколения шарда (см. функцию CanReclaim)
+	m_Slot.epoch.store(set.m_Epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t ConcurrentSetBase::GetThreadSlotIndex()
+{
+	// Индексы слотов общие для всех наборов: поток получает индекс при первом обращении к
+	// любому из наборов и освобождает его при завершении (в деструкторе объекта Owner)
+	static std::atomic<uint64_t> usedA[MAX_THREAD_C / 64];
+
+	struct Owner {
+		size_t index = MAX_THREAD_C;
+
+		Owner()
 		{
-			if (m_NextA[i] > maxC)
+			for (size_t i = 0; i < MAX_THREAD_C && index == MAX_THREAD_C; ++i)
 			{
-				maxC = m_NextA[i];
-				eighth = i;
+				const uint64_t bit = uint64_t(1) << (i & 63);
+				if (!(usedA[i / 64].fetch_or(bit, std::memory_order_acquire) & bit))
+					index = i;
 			}
 		}
-		Purge(eighth);
+
+		~Owner()
+		{
+			if (index < MAX_THREAD_C)
+				usedA[index / 64].fetch_and(~(uint64_t(1) << (index & 63)), std::memory_order_release);
+		}
+	};
+
+	static thread_local Owner owner;
+	if (owner.index >= MAX_THREAD_C)
+		throw util::ELogic("Too many threads use concurrent number sets");
+
+	return owner.index;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class G>
+bool ConcurrentSetBase::Rotate(Shard<G>& shard, uint32_t current, size_t ownSlotIndex)
+{
+	// Если поколение уже сменил другой поток, то повторим попытку добавления в новое. Если
+	// смену выполняет другой поток прямо сейчас, то не ждём его (число не будет добавлено)
+	if (shard.current.load(std::memory_order_acquire) != current)
+		return true;
+	if (shard.isRotating.exchange(true, std::memory_order_acquire))
+		return false;
+
+	bool result = shard.current.load(std::memory_order_acquire) != current;
+	if (!result)
+	{
+		// Следующее поколение либо ещё не использовалось (и его память выделяется только сейчас), либо было
+		// выведено из употребления при предыдущей смене
+		G& next = shard.genA[(current + 1) % GEN_C];
+		if (!next.IsAllocated())
+		{
+			next.Allocate(m_LPageSize, m_NumaNode);
+			result = true;
+		}
+		else if (!next.retiredEpoch || CanReclaim(next.retiredEpoch, ownSlotIndex))
+		{
+			if (next.retiredEpoch)
+				next.Reset();
+			result = true;
+		}
+
+		if (result)
+		{
+			// После смены поколения предыдущее становится недоступным для новых операций. Эпоха увеличивается
+			// после этого, поэтому поток, объявивший эпоху позднее, уже не сможет обратиться к этому поколению
+			shard.current.store(current + 1, std::memory_order_seq_cst);
+			if (current > 1)
+				shard.genA[(current - 1) % GEN_C].retiredEpoch = m_Epoch.fetch_add(1, std::memory_order_seq_cst);
+		}
 	}
 
-	// Если использовано более 1/2 элементов хеш-таблицы, но задействованы
-	// ещё не все биты хеша, то увеличиваем размер её используемой части
-	if (m_HBits < HASH_BITS && m_TCount > size_t(1) << (m_HBits - 1))
-		RaiseTable();
+	shard.isRotating.store(false, std::memory_order_release);
+	return result;
+}
 
-	const unsigned hash = GetHash(num);
-	Item* p = &m_TableA[hash];
-	if (p->num.IsZero())
+//----------------------------------------------------------------------------------------------------------------------
+bool ConcurrentSetBase::CanReclaim(uint64_t epoch, size_t ownSlotIndex) const
+{
+	// Поток, объявивший эпоху не позднее epoch, мог прочитать номер поколения до его вывода из употребления.
+	// Вызывающий поток (ownSlotIndex) читал только текущее и предыдущее поколения, поэтому он не учитывается
+	for (size_t i = 0; i < MAX_THREAD_C; ++i)
 	{
-		++m_TCount;
-		p->num = num;
-		return true;
+		const uint64_t slotEpoch = m_SlotA[i].epoch.load(std::memory_order_seq_cst);
+		if (slotEpoch && slotEpoch <= epoch && i != ownSlotIndex)
+			return false;
 	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   BasicConcurrentNumberSet
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+static inline void MatchCtrlGroup(const std::atomic<uint8_t>* pCtrl, uint8_t ctrl, unsigned& matchMask,
+	unsigned& emptyMask)
+{
+	// Байты состояния группы загружаются одной векторной инструкцией. Другие потоки могут в это время изменять
+	// отдельные байты, но каждый байт читается целиком, а совпавшие слоты затем перечитываются атомарно
+	const __m128i ctrlA = _mm_load_si128(reinterpret_cast<const __m128i*>(pCtrl));
+	matchMask = _mm_movemask_epi8(_mm_cmpeq_epi8(ctrlA, _mm_set1_epi8(static_cast<char>(ctrl))));
+	emptyMask = _mm_movemask_epi8(_mm_cmpeq_epi8(ctrlA, _mm_setzero_si128()));
+}
 
-	const size_t eighth = (hash >> 12) & 7;
-	if (m_Purge & (1 << eighth))
-		Purge(eighth);
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+BasicConcurrentNumberSet<T>::BasicConcurrentNumberSet(bool useLargePages, int numaNode, bool usePrefilter)
+	: ConcurrentSetBase(useLargePages, numaNode, usePrefilter)
+	, m_ShardA(new Shard<Generation>[SHARD_C])
+{
+	static_assert(sizeof(BloomFilter::Block) * BLOOM_BLOCK_C + SLOT_C * (1 + sizeof(Entry)) <= GEN_MEM_SIZE,
+		"Generation is too large");
+	static_assert(SLOT_C % alignof(Entry) == 0, "Entries are misaligned");
+	static_assert(ITEM_C < ~0u, "Too many items");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+BasicConcurrentNumberSet<T>::~BasicConcurrentNumberSet()
+{
+	for (size_t i = 0; i < SHARD_C; ++i)
+	{
+		for (Generation& gen : m_ShardA[i].genA)
+			gen.Free();
+	}
+}
 
-	for (; p->num != num; p = GetItem(p->next))
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+void BasicConcurrentNumberSet<T>::Clear(bool freeMem)
+{
+	for (size_t i = 0; i < SHARD_C; ++i)
 	{
-		if (p->next == Item::LAST)
+		Shard<Generation>& shard = m_ShardA[i];
+		for (Generation& gen : shard.genA)
 		{
-			p->next = GetNext(eighth);
-			p = GetItem(p->next);
-			p->num = num;
-			p->next = Item::LAST;
-			return true;
+			if (freeMem)
+				gen.Free();
+			else if (gen.IsAllocated())
+				gen.Reset();
 		}
+		shard.current = 0;
 	}
-	return false;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void NumberSet::RaiseTable()
+template<class T>
+size_t BasicConcurrentNumberSet<T>::GetSize() const
+{
+	size_t size = 0;
+	for (size_t i = 0; i < SHARD_C; ++i)
+	{
+		const Shard<Generation>& shard = m_ShardA[i];
+		const uint32_t current = shard.current.load(std::memory_order_acquire);
+		for (const Generation* pGen : { shard.GetGen(current), shard.GetPrevGen(current) })
+			size += pGen ? std::min<size_t>(pGen->itemC.load(std::memory_order_relaxed), ITEM_C) : 0;
+	}
+	return size;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+size_t BasicConcurrentNumberSet<T>::GetMemSize() const
+{
+	size_t size = 0;
+	for (size_t i = 0; i < SHARD_C; ++i)
+	{
+		for (const Generation& gen : m_ShardA[i].genA)
+			size += gen.IsAllocated() ? GEN_MEM_SIZE : 0;
+	}
+	return size;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool BasicConcurrentNumberSet<T>::Exists(const T& num, uint64_t order) const
 {
-	if (m_HBits == HASH_BITS)
-		return;
+	const unsigned numHash = num.GetHash();
+	const uint64_t hash = MixHash(numHash);
+	const Shard<Generation>& shard = m_ShardA[GetShardIndex(hash)];
+	EpochGuard guard(*this);
+	const uint32_t current = shard.current.load(std::memory_order_acquire);
+
+	const Generation* pGen = shard.GetGen(current);
+	const Generation* pPrevGen = shard.GetPrevGen(current);
+	const Entry* p = (pGen && MayContain(*pGen, numHash)) ? Find(pGen, num, hash) : nullptr;
+	if (!p && pPrevGen && MayContain(*pPrevGen, numHash))
+		p = Find(pPrevGen, num, hash);
+
+	return p && p->order.load(std::memory_order_relaxed) < order;
+}
 
-	// Инициализируем новые задействуемые элементы
-	const size_t count = size_t(1) << m_HBits++;
-	for (size_t i = count; i < count << 1; ++i)
-		m_TableA[i].Reset();
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+size_t BasicConcurrentNumberSet<T>::ExistsBatch(const T* pNumA, size_t count, uint64_t order, bool* pResultA) const
+{
+	// Поиск в поколении требует 2 зависимых обращения к памяти: к байтам состояния группы и к числу слота с
+	// совпавшими битами хеша (последовательности пробирования обычно состоят из одной группы). Для группы из
+	// BATCH_C чисел сначала загружаются в кеш блоки фильтров Блума текущих и предыдущих поколений, затем группы
+	// тех поколений, фильтры которых пропустили число (остальные поколения исключаются из поиска), затем числа
+	// первых совпавших слотов текущих поколений, и только после этого выполняется поиск, поэтому задержки
+	// перекрываются
+	const Generation* genA[BATCH_C][2];		// Текущее и предыдущее поколения (nullptr - поиск в поколении не нужен)
+	unsigned numHashA[BATCH_C];
+	uint64_t hashA[BATCH_C];
+	size_t rejectC = 0;
 
-	// Пробегаемся по всем задействованным элементам таблицы
-	// и разносим все числа их цепочек по 2 разным хешам
-	for (size_t i = 0; i < count; ++i)
+	for (size_t first = 0; first < count; first += BATCH_C)
 	{
-		// Если число в таблице равно 0, то значит
-		// цепи элементов нет, пропускаем этот хеш
-		Item* pTail1 = &m_TableA[i];
-		if (pTail1->num.IsZero())
-			continue;
+		const size_t n = std::min(count - first, BATCH_C);
+		const T* pNums = pNumA + first;
+		bool* pResults = pResultA + first;
 
-		Item* pTail2 = pTail1 + count;
-		if (GetHash(pTail1->num) != i)
+		EpochGuard guard(*this);
+		for (size_t i = 0; i < n; ++i)
 		{
-			pTail2->num = pTail1->num;
-			pTail1->num.SetZero();
+			numHashA[i] = pNums[i].GetHash();
+			hashA[i] = MixHash(numHashA[i]);
+			const Shard<Generation>& shard = m_ShardA[GetShardIndex(hashA[i])];
+			const uint32_t current = shard.current.load(std::memory_order_acquire);
+			genA[i][0] = shard.GetGen(current);
+			genA[i][1] = shard.GetPrevGen(current);
+
+			for (const Generation* pGen : genA[i])
+			{
+				if (pGen && m_UsePrefilter)
+					BloomFilter::Prefetch(pGen->pBloomA, BLOOM_BLOCK_C, numHashA[i]);
+			}
 		}
-		uint32_t current = pTail1->next;
-		pTail1->next = Item::LAST;
+		for (size_t i = 0; i < n; ++i)
+		{
+			bool isRejected = false;
+			for (const Generation*& pGen : genA[i])
+			{
+				if (pGen && !MayContain(*pGen, numHashA[i]))
+				{
+					pGen = nullptr;
+					isRejected = true;
+				}
+			}
+			rejectC += (isRejected && !genA[i][0] && !genA[i][1]) ? 1 : 0;
 
-		while (current != Item::LAST)
+			const size_t slot = GetGroup(hashA[i]) * GROUP_SIZE;
+			for (const Generation* pGen : genA[i])
+			{
+				if (pGen)
+					_mm_prefetch(reinterpret_cast<const char*>(&pGen->pCtrlA[slot]), _MM_HINT_T0);
+			}
+		}
+		for (size_t i = 0; i < n; ++i)
 		{
-			Item* p = GetItem(current);
-			Item*& pTail = (GetHash(p->num) == i) ? pTail1 : pTail2;
-			if (pTail->num.IsZero())
+			const Generation* pGen = genA[i][0];
+			if (!pGen)
+				continue;
+
+			const size_t slot = GetGroup(hashA[i]) * GROUP_SIZE;
+			unsigned matchMask, emptyMask;
+			MatchCtrlGroup(&pGen->pCtrlA[slot], GetCtrl(hashA[i]), matchMask, emptyMask);
+			if (matchMask)
 			{
-				++m_TCount;
-				++m_RCount;
-				++m_RCountA[(i >> 12) & 7];
-				pTail->num = p->num;
-			} else
+				const Entry* pEntry = &pGen->pEntryA[slot + _tzcnt_u32(matchMask)];
+				_mm_prefetch(reinterpret_cast<const char*>(pEntry), _MM_HINT_T0);
+			}
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			const Entry* p = Find(genA[i][0], pNums[i], hashA[i]);
+			if (!p)
+				p = Find(genA[i][1], pNums[i], hashA[i]);
+			pResults[i] = p && p->order.load(std::memory_order_relaxed) < order;
+		}
+	}
+	return rejectC;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool BasicConcurrentNumberSet<T>::Insert(const T& num, uint64_t order)
+{
+	if (num.IsZero())
+		return true;
+
+	const unsigned numHash = num.GetHash();
+	const uint64_t hash = MixHash(numHash);
+	Shard<Generation>& shard = m_ShardA[GetShardIndex(hash)];
+
+	EpochGuard guard(*this);
+	// Вторая попытка делается только после смены поколения (если текущее было заполнено или его ещё не было)
+	for (int attempt = 0; attempt < 2; ++attempt)
+	{
+		const uint32_t current = shard.current.load(std::memory_order_acquire);
+		Generation& gen = shard.genA[current % GEN_C];
+		const Generation* pPrevGen = shard.GetPrevGen(current);
+
+		Entry* pFound = (current && MayContain(gen, numHash)) ? Find(&gen, num, hash) : nullptr;
+		if (!pFound && pPrevGen && MayContain(*pPrevGen, numHash))
+			pFound = Find(pPrevGen, num, hash);
+
+		if (!pFound)
+		{
+			// Слот распределяется до его поиска в таблице: так занятых слотов гарантированно остаётся не больше ITEM_C
+			uint32_t index = current ? gen.itemC.load(std::memory_order_relaxed) : ITEM_C;
+			if (index < ITEM_C)
+				index = gen.itemC.fetch_add(1, std::memory_order_relaxed);
+			if (index >= ITEM_C)
 			{
-				pTail->next = current;
-				pTail = p;
+				if (!Rotate(shard, current, guard.GetSlotIndex()))
+					return false;
+				continue;
 			}
-			current = p->next;
-			p->next = Item::LAST;
+
+			// Число добавляется в фильтр Блума до того, как станет доступно в поколении: иначе поток, нашедший
+			// его в поколении, мог бы не найти его в фильтре при следующем поиске
+			if (m_UsePrefilter)
+				BloomFilter::Insert(gen.pBloomA, BLOOM_BLOCK_C, numHash);
+			if (Place(gen, num, hash, order, pFound))
+				return true;
 		}
+
+		// Число уже есть в наборе: уменьшаем его порядковый номер, если он больше order
+		uint64_t foundOrder = pFound->order.load(std::memory_order_relaxed);
+		while (order < foundOrder && !pFound->order.compare_exchange_weak(foundOrder, order, std::memory_order_relaxed))
+			;
+		return false;
 	}
+	return false;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void NumberSet::Purge(size_t eighth)
+template<class T>
+bool BasicConcurrentNumberSet<T>::Save(util::File& file, uint64_t maxOrder, size_t& itemC) const
 {
-	// Обходим все числа первого блока сокращаемой части eighth, именно этот блок чисел
-	// нам будет нужно удалить. Для каждого элемента ищем в его цепочке конечный элемент
-	// или элемент, ссылающийся на число в другом блоке, и заменяем им текущий элемент
-	const size_t last = (eighth * EIGHTH_CHUNK_C + 1) * CHUNK_SIZE;
-	Item* pChunk = m_ChunkA[eighth * EIGHTH_CHUNK_C];
-	for (size_t i = 0; i < CHUNK_SIZE; ++i)
+	// Числа шарда сначала копируются в буфер, а затем записываются в файл. На время копирования объявлена
+	// эпоха, поэтому просматриваемые поколения не могут быть очищены (но и не могут смениться другими)
+	std::vector<T> buffer;
+	itemC = 0;
+
+	for (size_t i = 0; i < SHARD_C; ++i)
 	{
-		Item* p = &pChunk[i];
-		while (p->next < last)
-			p = &pChunk[p->next & (CHUNK_SIZE - 1)];
-		pChunk[i] = *p;
+		const Shard<Generation>& shard = m_ShardA[i];
+		buffer.clear();
+		{
+			EpochGuard guard(*this);
+			const uint32_t current = shard.current.load(std::memory_order_acquire);
+			for (uint32_t g = (current > 1) ? current - 1 : 1; g <= current; ++g)
+			{
+				// Записываются только заполненные слоты: в слот BUSY число ещё не записано
+				const Generation& gen = shard.genA[g % GEN_C];
+				for (size_t j = 0; j < SLOT_C; ++j)
+				{
+					const Entry& entry = gen.pEntryA[j];
+					if ((gen.pCtrlA[j].load(std::memory_order_acquire) & FULL) &&
+						entry.order.load(std::memory_order_relaxed) < maxOrder)
+					{
+						buffer.push_back(entry.num);
+					}
+				}
+			}
+		}
+
+		if (!buffer.empty() && !file.Write(buffer.data(), RECORD_SIZE * buffer.size()))
+			return false;
+		itemC += buffer.size();
 	}
-	// Теперь обходим все элементы хеш-таблицы, соответствующие сокращаемой части eighth. Если элемент
-	// конечный, то мы ничего не меняем. Если он ссылается на число из первого блока, то копируем это
-	// число из блока в элемент таблицы. Затем корректируем в элементе ссылку на следующий элемент
-	const size_t itemC = size_t(1) << (m_HBits - 15);
-	for (size_t i = 0; i < itemC; ++i)
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool BasicConcurrentNumberSet<T>::Load(util::File& file, size_t itemC)
+{
+	constexpr size_t BUFFER_C = 1 << 16;
+	std::unique_ptr<T[]> buffer(new T[BUFFER_C]);
+
+	while (itemC)
 	{
-		Item* tabA = &m_TableA[(8 * i + eighth) << 12];
-		for (size_t j = 0; j < 1 << 12; ++j)
+		const size_t count = std::min(itemC, BUFFER_C);
+		if (!file.Read(buffer.get(), RECORD_SIZE * count))
+			return false;
+
+		for (size_t i = 0; i < count; ++i)
+			Insert(buffer[i], 0);
+		itemC -= count;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+inline bool BasicConcurrentNumberSet<T>::MayContain(const Generation& gen, unsigned numHash) const
+{
+	return !m_UsePrefilter || BloomFilter::MayContain(gen.pBloomA, BLOOM_BLOCK_C, numHash);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+typename BasicConcurrentNumberSet<T>::Entry* BasicConcurrentNumberSet<T>::Find(const Generation* pGen, const T& num,
+	uint64_t hash)
+{
+	if (!pGen)
+		return nullptr;
+
+	const uint8_t ctrl = GetCtrl(hash);
+	for (size_t group = GetGroup(hash);; group = GetNextGroup(group))
+	{
+		unsigned matchMask, emptyMask;
+		MatchCtrlGroup(&pGen->pCtrlA[group * GROUP_SIZE], ctrl, matchMask, emptyMask);
+		if (Entry* p = FindInGroup(*pGen, group, matchMask, ctrl, num))
+			return p;
+
+		// Группа с пустым слотом завершает последовательность пробирования. Пустые слоты не меньше 1/8
+		// таблицы (см. ITEM_C), поэтому перебор групп всегда завершается
+		if (emptyMask)
+			return nullptr;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+inline typename BasicConcurrentNumberSet<T>::Entry* BasicConcurrentNumberSet<T>::FindInGroup(const Generation& gen,
+	size_t group, unsigned matchMask, uint8_t ctrl, const T& num)
+{
+	for (; matchMask; matchMask &= matchMask - 1)
+	{
+		// Загрузка байта состояния (acquire) синхронизируется с его записью потоком, добавившим число. Байт
+		// заполненного слота не изменяется до очистки поколения, поэтому он по-прежнему равен ctrl
+		const size_t slot = group * GROUP_SIZE + _tzcnt_u32(matchMask);
+		if (gen.pCtrlA[slot].load(std::memory_order_acquire) == ctrl && gen.pEntryA[slot].num == num)
+			return &gen.pEntryA[slot];
+	}
+	return nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool BasicConcurrentNumberSet<T>::Place(Generation& gen, const T& num, uint64_t hash, uint64_t order, Entry*& pFound)
+{
+	// Поток занимает пустой слот операцией CAS (EMPTY -> BUSY), записывает в него число и только затем записывает
+	// байт состояния числа (release), после чего число становится доступно другим потокам. Группы проверяются
+	// заново: это же число мог добавить другой поток после поиска в функции Insert
+	const uint8_t ctrl = GetCtrl(hash);
+	for (size_t group = GetGroup(hash);; group = GetNextGroup(group))
+	{
+		unsigned matchMask, emptyMask;
+		MatchCtrlGroup(&gen.pCtrlA[group * GROUP_SIZE], ctrl, matchMask, emptyMask);
+		if ((pFound = FindInGroup(gen, group, matchMask, ctrl, num)) != nullptr)
+			return false;
+
+		for (; emptyMask; emptyMask &= emptyMask - 1)
 		{
-			uint32_t next = tabA[j].next;
-			if (next < last)
+			const size_t slot = group * GROUP_SIZE + _tzcnt_u32(emptyMask);
+			uint8_t slotCtrl = EMPTY;
+			if (gen.pCtrlA[slot].compare_exchange_strong(slotCtrl, BUSY, std::memory_order_acquire))
+			{
+				Entry& entry = gen.pEntryA[slot];
+				entry.num = num;
+				entry.order.store(order, std::memory_order_relaxed);
+				gen.pCtrlA[slot].store(ctrl, std::memory_order_release);
+				return true;
+			}
+
+			// Слот успел занять другой поток. Если он добавлял это же число, но ещё не записал его (слот BUSY),
+			// то в поколении окажутся 2 копии числа (см. описание класса)
+			if (slotCtrl == ctrl && gen.pEntryA[slot].num == num)
 			{
-				Item* p = &pChunk[next & (CHUNK_SIZE - 1)];
-				tabA[j].num = p->num;
-				next = p->next;
+				pFound = &gen.pEntryA[slot];
+				return false;
 			}
-			uint32_t n = next - CHUNK_SIZE;
-			tabA[j].next = (next == Item::LAST) ? next : n;
 		}
 	}
-	// Теперь корректируем ссылки в остальных блоках
-	size_t totalC = m_NextA[eighth];
-	for (size_t chunk = 1; totalC > CHUNK_SIZE; ++chunk)
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+void BasicConcurrentNumberSet<T>::Generation::Allocate(size_t largePageSize, int numaNode)
+{
+	// Выделенная память заполнена нулями, т.е. фильтр Блума и все слоты пусты. Массивы поколения размещаются в
+	// одном блоке размером GEN_MEM_SIZE, который (в отличие от каждого из массивов) кратен размеру большой страницы
+	pBloomA = static_cast<BloomFilter::Block*>(LargeMemPages::Allocate(GEN_MEM_SIZE, largePageSize, numaNode));
+	pCtrlA = reinterpret_cast<std::atomic<uint8_t>*>(pBloomA + BLOOM_BLOCK_C);
+	pEntryA = reinterpret_cast<Entry*>(pCtrlA + SLOT_C);
+	itemC.store(0, std::memory_order_relaxed);
+	retiredEpoch = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+void BasicConcurrentNumberSet<T>::Generation::Reset()
+{
+	// Фильтр Блума и байты состояния идут подряд и очищаются вместе. Числа в слотах не очищаются: пустой слот
+	// определяется только байтом состояния
+	memset(static_cast<void*>(pBloomA), EMPTY, sizeof(BloomFilter::Block) * BLOOM_BLOCK_C + SLOT_C);
+	itemC.store(0, std::memory_order_relaxed);
+	retiredEpoch = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+void BasicConcurrentNumberSet<T>::Generation::Free()
+{
+	LargeMemPages::Free(pBloomA, GEN_MEM_SIZE);
+	pBloomA = nullptr;
+	pCtrlA = nullptr;
+	pEntryA = nullptr;
+	itemC.store(0, std::memory_order_relaxed);
+	retiredEpoch = 0;
+}
+
+// Явное инстанцирование для чисел длиной до 30 и 62 цифр
+template class BasicConcurrentNumberSet<FixNumber>;
+template class BasicConcurrentNumberSet<WideFixNumber>;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   ConcurrentNumberFilter
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+ConcurrentNumberFilter::ConcurrentNumberFilter(bool useLargePages, int numaNode, bool usePrefilter)
+	: ConcurrentSetBase(useLargePages, numaNode, usePrefilter)
+	, m_ShardA(new Shard<Generation>[SHARD_C])
+{
+	// Шард и первая корзина выбираются по старшим битам хеша, а отпечаток - это младшие биты
+	static_assert(SHARD_BITS + BUCKET_BITS + FINGERPRINT_BITS <= 64, "Hash is too short");
+	static_assert(ITEM_C < ~0u, "Too many items");
+	static_assert(sizeof(BloomFilter::Block) * BLOOM_BLOCK_C + sizeof(Bucket) * BUCKET_C <= GEN_MEM_SIZE,
+		"Generation is too large");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+ConcurrentNumberFilter::~ConcurrentNumberFilter()
+{
+	for (size_t i = 0; i < SHARD_C; ++i)
+	{
+		for (Generation& gen : m_ShardA[i].genA)
+			gen.Free();
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ConcurrentNumberFilter::Clear(bool freeMem)
+{
+	for (size_t i = 0; i < SHARD_C; ++i)
 	{
-		totalC -= CHUNK_SIZE;
-		pChunk = m_ChunkA[eighth * EIGHTH_CHUNK_C + chunk];
-		size_t chunkSize = (totalC < CHUNK_SIZE) ? totalC : CHUNK_SIZE;
-		for (size_t i = 0; i < chunkSize; ++i)
+		Shard<Generation>& shard = m_ShardA[i];
+		for (Generation& gen : shard.genA)
 		{
-			uint32_t next = pChunk[i].next;
-			uint32_t n = next - CHUNK_SIZE;
-			pChunk[i].next = (next == Item::LAST) ? next : n;
+			if (freeMem)
+				gen.Free();
+			else if (gen.IsAllocated())
+				gen.Reset();
 		}
+		shard.current = 0;
 	}
+}
 
-	m_CCount -= CHUNK_SIZE;
-	m_NextA[eighth] -= CHUNK_SIZE;
-	m_Purge &= ~(1 << eighth);
+//----------------------------------------------------------------------------------------------------------------------
+size_t ConcurrentNumberFilter::GetSize() const
+{
+	size_t size = 0;
+	for (size_t i = 0; i < SHARD_C; ++i)
+	{
+		const Shard<Generation>& shard = m_ShardA[i];
+		const uint32_t current = shard.current.load(std::memory_order_acquire);
+		for (const Generation* pGen : { shard.GetGen(current), shard.GetPrevGen(current) })
+			size += pGen ? std::min<size_t>(pGen->itemC.load(std::memory_order_relaxed), ITEM_C) : 0;
+	}
+	return size;
+}
 
-	// Если счётчик RCount для этой части был >0, то после удаления блока все
-	// её перенесённые элементы будут освобождены и счётчик нужно обнулить
-	m_RCount -= m_RCountA[eighth];
-	m_RCountA[eighth] = 0;
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool ConcurrentNumberFilter::Exists(const T& num) const
+{
+	return Find(num, 0, true);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool ConcurrentNumberFilter::Exists(const T& num, uint64_t order) const
+{
+	return Find(num, order, false);
+}
 
-	// Если часть использовала CLEAR_GAIN + 1 блоков или меньше, то помещаем удалённый
-	// блок за последним используемым. Если блоков было больше, то освобождаем память
-	Item** chunkA = &m_ChunkA[eighth * EIGHTH_CHUNK_C];
-	if (CLEAR_GAIN + 1 < EIGHTH_CHUNK_C && chunkA[CLEAR_GAIN + 1])
-		FreeMem(chunkA[0]);
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+size_t ConcurrentNumberFilter::ExistsBatch(const T* pNumA, size_t count, uint64_t order, bool* pResultA) const
+{
+	// Обе корзины числа не зависят от содержимого фильтра, поэтому для группы из BATCH_C чисел сначала загружаются
+	// в кеш блоки фильтров Блума текущих и предыдущих поколений, затем корзины текущих поколений, фильтры которых
+	// пропустили число, и только после этого выполняется поиск (как в функции Find)
+	Key keyA[BATCH_C];
+	const Generation* genA[BATCH_C][2];		// Текущее и предыдущее поколения (nullptr - поиск в поколении не нужен)
+	size_t rejectC = 0;
 
-	Item* pSpareBlock = chunkA[0];
-	// Сдвигаем все оставшиеся блоки к началу
-	for (size_t i = 1; i < EIGHTH_CHUNK_C; ++i)
+	for (size_t first = 0; first < count; first += BATCH_C)
 	{
-		chunkA[i - 1] = chunkA[i];
-		if (!chunkA[i])
+		const size_t n = std::min(count - first, BATCH_C);
+		bool* pResults = pResultA + first;
+
+		EpochGuard guard(*this);
+		for (size_t i = 0; i < n; ++i)
 		{
-			chunkA[i - 1] = pSpareBlock;
-			pSpareBlock = nullptr;
-			break;
+			keyA[i] = Key(pNumA[first + i]);
+			const Shard<Generation>& shard = m_ShardA[keyA[i].shard];
+			const uint32_t current = shard.current.load(std::memory_order_acquire);
+			genA[i][0] = shard.GetGen(current);
+			genA[i][1] = shard.GetPrevGen(current);
+
+			for (const Generation* pGen : genA[i])
+			{
+				if (pGen && m_UsePrefilter)
+					BloomFilter::Prefetch(pGen->pBloomA, BLOOM_BLOCK_C, keyA[i].GetPrefilterHash());
+			}
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			bool isRejected = false;
+			for (const Generation*& pGen : genA[i])
+			{
+				if (pGen && !MayContain(*pGen, keyA[i]))
+				{
+					pGen = nullptr;
+					isRejected = true;
+				}
+			}
+			rejectC += (isRejected && !genA[i][0] && !genA[i][1]) ? 1 : 0;
+
+			if (const Generation* pGen = genA[i][0])
+			{
+				_mm_prefetch(reinterpret_cast<const char*>(&pGen->pBucketA[keyA[i].bucketA[0]]), _MM_HINT_T0);
+				_mm_prefetch(reinterpret_cast<const char*>(&pGen->pBucketA[keyA[i].bucketA[1]]), _MM_HINT_T0);
+			}
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			const std::atomic<uint64_t>* p = Find(genA[i][0], keyA[i]);
+			if (!p)
+				p = Find(genA[i][1], keyA[i]);
+			pResults[i] = p && IsBefore(p->load(std::memory_order_relaxed), order);
 		}
 	}
-	chunkA[EIGHTH_CHUNK_C - 1] = pSpareBlock;
+	return rejectC;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-uint32_t NumberSet::GetNext(size_t eighth)
+template<class T>
+bool ConcurrentNumberFilter::Insert(const T& num, uint64_t order)
 {
-	size_t next = m_NextA[eighth]++;
-	++m_CCount;
+	return num.IsZero() || Insert(Key(num), order);
+}
 
-	Item*& pChunk = m_ChunkA[next / CHUNK_SIZE + eighth * EIGHTH_CHUNK_C];
-	if (!pChunk)
-		pChunk = AllocateMem(CHUNK_SIZE);
+//----------------------------------------------------------------------------------------------------------------------
+bool ConcurrentNumberFilter::Save(util::File& file, uint64_t maxOrder, size_t& itemC) const
+{
+	// Запись - это отпечаток в старших FINGERPRINT_BITS битах, а в младших - номера шарда и корзины, в которой
+	// находится отпечаток. Вторую корзину можно вычислить по отпечатку (см. функцию GetBucketOffset)
+	static_assert(SHARD_BITS + BUCKET_BITS <= ORDER_BITS, "Record is too short");
+
+	// См. комментарий в функции ConcurrentNumberSet::Save
+	std::vector<uint64_t> buffer;
+	itemC = 0;
 
-	if (next >= EIGHTH_CHUNK_C * CHUNK_SIZE - 1)
-		m_Purge |= 1 << eighth;
+	for (size_t i = 0; i < SHARD_C; ++i)
+	{
+		const Shard<Generation>& shard = m_ShardA[i];
+		buffer.clear();
+		{
+			EpochGuard guard(*this);
+			const uint32_t current = shard.current.load(std::memory_order_acquire);
+			for (uint32_t g = (current > 1) ? current - 1 : 1; g <= current; ++g)
+			{
+				const Generation& gen = shard.genA[g % GEN_C];
+				for (size_t b = 0; b < BUCKET_C; ++b)
+				{
+					for (size_t j = 0; j < SLOT_C; ++j)
+					{
+						const uint64_t slot = gen.pBucketA[b].slotA[j].load(std::memory_order_relaxed);
+						if (!slot)
+							break;
+						if (IsBefore(slot, maxOrder))
+							buffer.push_back((slot & ~ORDER_MASK) | (i << BUCKET_BITS) | b);
+					}
+				}
+			}
+		}
 
-	next += eighth * EIGHTH_CHUNK_C * CHUNK_SIZE;
-	return static_cast<uint32_t>(next);
+		if (!buffer.empty() && !file.Write(buffer.data(), RECORD_SIZE * buffer.size()))
+			return false;
+		itemC += buffer.size();
+	}
+	return true;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-template<class T> inline unsigned NumberSet::GetHash(const T& num) const
+bool ConcurrentNumberFilter::Load(util::File& file, size_t itemC)
 {
-	const unsigned hash = num.GetHash();
-	const unsigned hashMask = ~(~0 << m_HBits);
-	return (hash ^ (hash >> HASH_BITS)) & hashMask;
+	constexpr size_t BUFFER_C = 1 << 16;
+	std::unique_ptr<uint64_t[]> buffer(new uint64_t[BUFFER_C]);
+
+	while (itemC)
+	{
+		const size_t count = std::min(itemC, BUFFER_C);
+		if (!file.Read(buffer.get(), RECORD_SIZE * count))
+			return false;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (buffer[i] & ~ORDER_MASK)
+				Insert(Key(buffer[i]), 0);
+		}
+		itemC -= count;
+	}
+	return true;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-AML_NOINLINE NumberSet::Item* NumberSet::AllocateMem(size_t itemC)
+bool ConcurrentNumberFilter::Insert(const Key& key, uint64_t order)
 {
-	const size_t sizeInBytes = sizeof(Item) * itemC;
-	// Для выделения памяти большими страницами размер sizeInBytes должен
-	// быть кратен размеру большой страницы, которая обычно равна 2048KiB
-	if (m_LPageSize && !(sizeInBytes & (m_LPageSize - 1)))
+	Shard<Generation>& shard = m_ShardA[key.shard];
+	const uint64_t value = key.fingerprint | (order & ORDER_MASK);
+
+	EpochGuard guard(*this);
+	// Вторая попытка делается только после смены поколения (если текущее было заполнено или его ещё не было)
+	for (int attempt = 0; attempt < 2; ++attempt)
 	{
-		if (void* p = ::VirtualAlloc(nullptr, sizeInBytes, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE))
-			return reinterpret_cast<Item*>(p);
+		const uint32_t current = shard.current.load(std::memory_order_acquire);
+		Generation& gen = shard.genA[current % GEN_C];
+		const Generation* pPrevGen = shard.GetPrevGen(current);
+
+		std::atomic<uint64_t>* pFound = (current && MayContain(gen, key)) ? Find(&gen, key) : nullptr;
+		if (!pFound && pPrevGen && MayContain(*pPrevGen, key))
+			pFound = Find(pPrevGen, key);
+
+		if (!pFound)
+		{
+			uint32_t index = current ? gen.itemC.load(std::memory_order_relaxed) : ITEM_C;
+			if (index < ITEM_C)
+				index = gen.itemC.fetch_add(1, std::memory_order_relaxed);
+			if (index >= ITEM_C)
+			{
+				if (!Rotate(shard, current, guard.GetSlotIndex()))
+					return false;
+				continue;
+			}
+
+			// Если обе корзины заполнены, то число не добавляется (но остаётся в фильтре Блума, что допустимо)
+			if (m_UsePrefilter)
+				BloomFilter::Insert(gen.pBloomA, BLOOM_BLOCK_C, key.GetPrefilterHash());
+			if (Place(gen, key, value, pFound))
+				return true;
+			if (!pFound)
+				return false;
+		}
+
+		// Число уже есть в фильтре: уменьшаем его порядковый номер, если он больше order
+		uint64_t slot = pFound->load(std::memory_order_relaxed);
+		while (IsBefore(order, slot) && !pFound->compare_exchange_weak(slot, value, std::memory_order_relaxed))
+			;
+		return false;
 	}
-	if (void* p = ::VirtualAlloc(nullptr, sizeInBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE))
-		return reinterpret_cast<Item*>(p);
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+ConcurrentNumberFilter::Key::Key(const T& num)
+{
+	const uint64_t hash = num.GetHash64();
+	shard = static_cast<size_t>(hash >> (64 - SHARD_BITS));
+	bucketA[0] = static_cast<size_t>(hash >> (64 - SHARD_BITS - BUCKET_BITS)) & (BUCKET_C - 1);
+	fingerprint = hash << ORDER_BITS;
+	fingerprint += fingerprint ? 0 : uint64_t(1) << ORDER_BITS;
+
+	bucketA[1] = bucketA[0] ^ GetBucketOffset(fingerprint);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+ConcurrentNumberFilter::Key::Key(uint64_t record)
+{
+	// Отпечаток мог находиться в любой из 2 корзин, но их порядок в функциях Find и Place не важен
+	shard = static_cast<size_t>((record & ORDER_MASK) >> BUCKET_BITS) & (SHARD_C - 1);
+	bucketA[0] = static_cast<size_t>(record) & (BUCKET_C - 1);
+	bucketA[1] = bucketA[0] ^ GetBucketOffset(record & ~ORDER_MASK);
+	fingerprint = record & ~ORDER_MASK;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline bool ConcurrentNumberFilter::MayContain(const Generation& gen, const Key& key) const
+{
+	return !m_UsePrefilter || BloomFilter::MayContain(gen.pBloomA, BLOOM_BLOCK_C, key.GetPrefilterHash());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::atomic<uint64_t>* ConcurrentNumberFilter::Find(const Generation* pGen, const Key& key)
+{
+	if (!pGen)
+		return nullptr;
 
-	throw util::ERuntime("Failed to allocate memory");
+	// Слоты корзины заполняются по порядку и никогда не освобождаются (до очистки всего
+	// поколения), поэтому пустой слот означает, что дальше в этой корзине числа быть не может
+	for (size_t b = 0; b < 2; ++b)
+	{
+		Bucket& bucket = pGen->pBucketA[key.bucketA[b]];
+		for (size_t i = 0; i < SLOT_C; ++i)
+		{
+			const uint64_t slot = bucket.slotA[i].load(std::memory_order_relaxed);
+			if (!slot)
+				break;
+			if ((slot & ~ORDER_MASK) == key.fingerprint)
+				return &bucket.slotA[i];
+		}
+	}
+	return nullptr;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void NumberSet::FreeMem(Item*& pBlock)
+bool ConcurrentNumberFilter::Place(Generation& gen, const Key& key, uint64_t value, std::atomic<uint64_t>*& pFound)
 {
-	if (pBlock)
+	// Отпечаток помещается в менее заполненную из 2 корзин: это снижает долю чисел, которые не удаётся
+	// добавить, в несколько раз по сравнению с заполнением сначала одной корзины, а затем другой
+	Bucket* bucketA[2] = { &gen.pBucketA[key.bucketA[0]], &gen.pBucketA[key.bucketA[1]] };
+	size_t usedA[2] = {};
+	for (size_t b = 0; b < 2; ++b)
+	{
+		while (usedA[b] < SLOT_C && bucketA[b]->slotA[usedA[b]].load(std::memory_order_relaxed))
+			++usedA[b];
+	}
+
+	for (;;)
 	{
-		::VirtualFree(pBlock, 0, MEM_RELEASE);
-		pBlock = nullptr;
+		const size_t b = (usedA[1] < usedA[0]) ? 1 : 0;
+		if (usedA[b] == SLOT_C)
+		{
+			pFound = nullptr;
+			return false;
+		}
+
+		// Если слот успел занять другой поток, то проверяем его отпечаток: это же число могло быть добавлено
+		// одновременно с нами. Если другой поток добавил его в другую корзину, то в фильтре окажутся 2 копии
+		// числа, что не нарушает работу фильтра (функция Exists может не учесть меньший порядковый номер)
+		uint64_t slot = 0;
+		if (bucketA[b]->slotA[usedA[b]].compare_exchange_strong(slot, value, std::memory_order_relaxed))
+			return true;
+		if ((slot & ~ORDER_MASK) == key.fingerprint)
+		{
+			pFound = &bucketA[b]->slotA[usedA[b]];
+			return false;
+		}
+		++usedA[b];
 	}
 }
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool ConcurrentNumberFilter::Find(const T& num, uint64_t order, bool anyOrder) const
+{
+	const Key key(num);
+	const Shard<Generation>& shard = m_ShardA[key.shard];
+	EpochGuard guard(*this);
+	const uint32_t current = shard.current.load(std::memory_order_acquire);
+	const Generation* pGen = shard.GetGen(current);
+	const Generation* pPrevGen = shard.GetPrevGen(current);
+	const std::atomic<uint64_t>* p = (pGen && MayContain(*pGen, key)) ? Find(pGen, key) : nullptr;
+	if (!p && pPrevGen && MayContain(*pPrevGen, key))
+		p = Find(pPrevGen, key);
+
+	return p && (anyOrder || IsBefore(p->load(std::memory_order_relaxed), order));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline bool ConcurrentNumberFilter::IsBefore(uint64_t order1, uint64_t order2)
+{
+	const uint64_t diff = (order2 - order1) & ORDER_MASK;
+	return diff && diff < (uint64_t(1) << (ORDER_BITS - 1));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline size_t ConcurrentNumberFilter::GetBucketOffset(uint64_t fingerprint)
+{
+	// Вторая корзина зависит от отпечатка (а не от других бит хеша, которых уже не осталось) и всегда отличается
+	// от первой, иначе у числа было бы вдвое меньше слотов. Операция XOR симметрична: по любой из корзин числа
+	// и его отпечатку можно вычислить другую корзину
+	const size_t offset = static_cast<size_t>((fingerprint * 0x9e3779b97f4a7c15ull) >> (64 - BUCKET_BITS));
+	return offset ? offset : 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ConcurrentNumberFilter::Generation::Allocate(size_t largePageSize, int numaNode)
+{
+	// Выделенная память заполнена нулями, т.е. фильтр Блума и все слоты пусты. Блок памяти имеет размер
+	// GEN_MEM_SIZE (как у ConcurrentNumberSet), так как он должен быть кратен размеру большой страницы
+	pBloomA = static_cast<BloomFilter::Block*>(LargeMemPages::Allocate(GEN_MEM_SIZE, largePageSize, numaNode));
+	pBucketA = reinterpret_cast<Bucket*>(pBloomA + BLOOM_BLOCK_C);
+	itemC.store(0, std::memory_order_relaxed);
+	retiredEpoch = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ConcurrentNumberFilter::Generation::Reset()
+{
+	memset(static_cast<void*>(pBloomA), 0, sizeof(BloomFilter::Block) * BLOOM_BLOCK_C + sizeof(Bucket) * BUCKET_C);
+	itemC.store(0, std::memory_order_relaxed);
+	retiredEpoch = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ConcurrentNumberFilter::Generation::Free()
+{
+	LargeMemPages::Free(pBloomA, GEN_MEM_SIZE);
+	pBloomA = nullptr;
+	pBucketA = nullptr;
+	itemC.store(0, std::memory_order_relaxed);
+	retiredEpoch = 0;
+}
+
+// Явное инстанцирование для чисел длиной до 30 и 62 цифр
+template bool ConcurrentNumberFilter::Exists(const FixNumber& num) const;
+template bool ConcurrentNumberFilter::Exists(const WideFixNumber& num) const;
+template bool ConcurrentNumberFilter::Exists(const FixNumber& num, uint64_t order) const;
+template bool ConcurrentNumberFilter::Exists(const WideFixNumber& num, uint64_t order) const;
+template size_t ConcurrentNumberFilter::ExistsBatch(const FixNumber* pNumA, size_t count, uint64_t order,
+	bool* pResultA) const;
+template size_t ConcurrentNumberFilter::ExistsBatch(const WideFixNumber* pNumA, size_t count, uint64_t order,
+	bool* pResultA) const;
+template bool ConcurrentNumberFilter::Insert(const FixNumber& num, uint64_t order);
+template bool ConcurrentNumberFilter::Insert(const WideFixNumber& num, uint64_t order);
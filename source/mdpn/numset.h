@@ -3,86 +3,541 @@
 
 #include "number.h"
 
+#include <core/forward.h>
 #include <core/util.h>
 
+#include <atomic>
+#include <memory>
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
-//   NumberSet - хеш-таблица (набор) чисел FixNumber
+//   BloomFilter - блочный фильтр Блума, через который проходят поиски в наборах чисел
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Фильтр размером 4 MiB помещается в кеш L3 и позволяет отклонить поиск отсутствующего в наборе числа без обращения
+// к таблицам набора в основной памяти. Каждому числу соответствует один блок (линия кеша) из 8 слов по 64 бита, в
+// каждом слове блока для числа устанавливается 1 бит. Удалить число из фильтра нельзя: удалённые из набора числа
+// оставляют свои биты, что только увеличивает долю ложных срабатываний. Когда в фильтр добавлено больше MAX_COUNT
+// чисел, ложных срабатываний становится слишком много, и фильтр отключается (пропускает все поиски) до очистки.
+// Функции MayContain и Insert могут выполняться одновременно из нескольких потоков. Если поток добавляет число
+// в тот момент, когда фильтр отключается, то другой поток может ещё не увидеть отключения и не найти это число
+// (как и число, добавляемое в набор одновременно с поиском).
+// Наборы ConcurrentSetBase не используют объект BloomFilter, а хранят фильтр в каждом поколении и работают с ним
+// статическими функциями класса. Размер такого фильтра рассчитан на все числа поколения, поэтому он не отключается,
+// а очищается вместе с поколением
+
 //----------------------------------------------------------------------------------------------------------------------
-class NumberSet
+class BloomFilter
 {
-	AML_NONCOPYABLE(NumberSet)
+	AML_NONCOPYABLE(BloomFilter)
 
 public:
-	explicit NumberSet(bool useLargePages = false);
-	~NumberSet();
+	static constexpr size_t BLOCK_BITS = 16;				// Кол-во бит номера блока (16 - 4 MiB)
+	static constexpr size_t BLOCK_C = 1 << BLOCK_BITS;		// Количество блоков
+	// Количество чисел, после добавления которого фильтр отключается. При 8 битах фильтра на число
+	// ложные срабатывания (к этому моменту) составляют ~2.5% поисков отсутствующих чисел
+	static constexpr size_t MAX_COUNT = BLOCK_C * 512 / 8;
+
+	struct alignas(64) Block {
+		std::atomic<uint64_t> wordA[8];
+	};
+
+	BloomFilter() = default;
+	~BloomFilter() { Free(); }
+
+	// Выделяет память фильтра (см. LargeMemPages::Allocate). До этого фильтр отключён
+	void Allocate(size_t largePageSize, int numaNode = -1);
+	void Free();
+	// Очищает и снова включает фильтр. В отличие от остальных функций не может выполняться одновременно с ними
+	void Clear();
+
+	// Возвращает true, если фильтр включён
+	bool IsActive() const { return m_pBlockA && m_Count.load(std::memory_order_relaxed) <= MAX_COUNT; }
+	// Возвращает объём памяти (в байтах), занимаемой фильтром
+	size_t GetMemSize() const { return m_pBlockA ? sizeof(Block) * BLOCK_C : 0; }
+
+	// Возвращает false, если числа с хешем hash гарантированно нет в наборе, и true, если
+	// оно, возможно, есть в наборе или если фильтр отключён
+	bool MayContain(uint64_t hash) const;
+	// Загружает в кеш блок фильтра для хеша hash (перед вызовом MayContain)
+	void Prefetch(uint64_t hash) const;
+	// Добавляет в фильтр хеш hash нового числа набора
+	void Insert(uint64_t hash);
+
+	// Аналоги функций MayContain, Prefetch и Insert для фильтра из blockC блоков pBlockA, размещённого в памяти
+	// вызывающего (заполненной нулями). Такой фильтр никогда не отключается
+	static bool MayContain(const Block* pBlockA, size_t blockC, uint64_t hash);
+	static void Prefetch(const Block* pBlockA, size_t blockC, uint64_t hash);
+	static void Insert(Block* pBlockA, size_t blockC, uint64_t hash);
+
+protected:
+	// Перемешивает биты хеша числа: старшие 32 бита результата выбирают блок, а младшие 32 бита - биты в
+	// словах блока (см. GetBit)
+	static uint64_t Mix(uint64_t hash);
+	static uint64_t GetBit(uint64_t mixed, size_t word);
+	static size_t GetBlockIndex(uint64_t mixed, size_t blockC)
+	{
+		return static_cast<size_t>(((mixed >> 32) * blockC) >> 32);
+	}
+
+	Block* m_pBlockA = nullptr;						// Блоки (BLOCK_C, nullptr - фильтр не используется)
+	// Количество добавленных чисел. Счётчик изменяется только при добавлении, поэтому он находится
+	// на отдельной линии кеша, чтобы не вытеснять из кешей других потоков указатель на блоки
+	alignas(64) std::atomic<size_t> m_Count = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   BasicNumberSet - хеш-таблица (набор) чисел BasicFixNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Набор разбит на 8 частей по старшим битам хеша, каждая часть - это хеш-таблица с открытой адресацией. Слоты таблицы
+// объединены в группы по GROUP_SIZE: для каждого слота хранится байт состояния (пустой, удалённый или занятый; для
+// занятого слота в младших 7 битах хранятся ещё 7 бит хеша числа), поэтому поиск в группе выполняется одним сравнением
+// 16 байт состояний векторной инструкцией, а сами числа сравниваются только для слотов с совпавшими битами хеша. Группы
+// перебираются квадратичным пробированием до первой группы, в которой есть пустой слот.
+// Числа каждой части условно распределяются по блокам из CHUNK_SIZE последовательно добавленных чисел, для каждого
+// слота хранится младший байт номера блока его числа. Удаление первого блока части (функция Purge) помечает удалёнными
+// все слоты этого блока, а когда пустых слотов в таблице части становится мало, удалённые слоты освобождаются
+// перестановкой чисел на месте (без выделения дополнительной памяти).
+// Тип T - это FixNumber (набор NumberSet) или WideFixNumber (набор WideNumberSet для чисел длиной более 30 цифр).
+// Слот WideNumberSet занимает 34 байта вместо 18, поэтому при том же количестве чисел он расходует в ~1.9 раза
+// больше памяти.
+// Перед поиском в таблице части число проверяется фильтром Блума (если он используется): пока набор невелик, фильтр
+// отклоняет большинство поисков отсутствующих чисел без обращения к таблице. Функция Purge биты фильтра не
+// сбрасывает: к моменту первого удаления блока в наборе уже больше BloomFilter::MAX_COUNT чисел, и фильтр отключён
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+class BasicNumberSet
+{
+	AML_NONCOPYABLE(BasicNumberSet)
+
+public:
+	// Если usePrefilter равно true, то поиски проходят через фильтр Блума (см. описание класса)
+	explicit BasicNumberSet(bool useLargePages = false, bool usePrefilter = true);
+	~BasicNumberSet();
 
 	void Clear(bool freeMem = true);
 	// Возвращает количество задействованных элементов набора
-	size_t GetSize() const { return m_TCount + m_CCount - m_RCount; }
+	size_t GetSize() const { return m_Count; }
+	// Возвращает объём памяти (в байтах), задействованной набором в данный момент
+	size_t GetMemSize() const;
 	// Возвращает true, если большие страницы памяти используются
 	bool IsLargePageEnabled() const { return m_LPageSize != 0; }
 
 	// Возвращает true, если число num содержится в наборе
 	bool Exists(const Number& num) const;
-	bool Exists(const FixNumber& num) const;
+	bool Exists(const T& num) const;
 
 	// Добавляет число num в набор, если его в наборе ещё нет. Возвращает true, если число было добавлено, и
 	// false, если такое число в наборе уже есть. Число 0 никогда не добавляется, это связано с особенностью
 	// работы контейнера. Весь набор чисел разбит на 8 частей. Если размер всего набора достиг своего макс.
 	// значения, то будет удалён первый блок самой крупной части элементов. Если размер какой-либо из частей
-	// достиг 1/5 (при CLEAR_GAIN == 10) максимального размера набора, то будет удалён первый блок этой
-	// части. Новое число всегда добавляется после удаления элементов (если они удалялись)
-	bool Insert(const Number& num) { return Insert(FixNumber(num)); }
-	bool Insert(const FixNumber& num);
+	// достиг PART_CHUNK_C блоков, то будет удалён первый блок этой части. Новое число всегда добавляется
+	// после удаления элементов (если они удалялись)
+	bool Insert(const Number& num) { return Insert(T(num)); }
+	bool Insert(const T& num);
 
 protected:
-	static constexpr size_t HASH_BITS = 25;			// Кол-во бит хеша, определяет размер набора (25 -> 2400 MiB)
-	static constexpr size_t EIGHTH_CHUNK_C = 16;	// Кол-во блоков по CHUNK_SIZE элементов для одной части
+	static constexpr size_t HASH_BITS = 27;				// Кол-во бит номера слота, задаёт размер набора (27 - 2304 MiB)
+	static constexpr size_t PART_BITS = HASH_BITS - 3;	// Макс. количество бит номера слота в одной части
+	static constexpr size_t MIN_PART_BITS = 16;			// Начальное количество бит номера слота в одной части
+	static constexpr size_t GROUP_SIZE = 16;			// Количество слотов в группе
+	static constexpr size_t CHUNK_SIZE = 1 << (HASH_BITS - 7);
 
-	// Количество блоков в расчёте на одну часть, при котором происходит удаление элементов. Значение должно
-	// лежать в пределах от 2 до (EIGHTH_CHUNK_C - 1). Чем оно будет выше, тем выше будет среднее количество
-	// элементов на один хеш. Более высокие значения позволяют задействовать больше памяти и увеличить
-	// ёмкость набора, но вместе с этим замедляют работу функции Exists
-	static constexpr size_t CLEAR_GAIN = 10;
+	// Количество блоков в расчёте на одну часть, при котором происходит удаление элементов по ограничению
+	// на размер всего набора, и максимальное количество блоков одной части. Занятые слоты вместе с удалёнными
+	// не должны превышать 7/8 таблицы части: при больших значениях резко растёт длина цепочек пробирования.
+	// При значениях 12 и 13 таблицы частей заполнены в среднем на 75% (не более, чем на 81%), что оставляет
+	// место для слотов как минимум одного удалённого блока между освобождениями удалённых слотов
+	static constexpr size_t CLEAR_GAIN = 12;
+	static constexpr size_t PART_CHUNK_C = 13;
 
-	// При значениях EIGHTH_CHUNK_C (16), CLEAR_GAIN (10) и CHUNK_SIZE (HB-5), на каждый хеш приходится в
-	// среднем по 3.5 элемента. Это обеспечивает наилучший баланс между скоростью работы функции Exists и
-	// размером хеш-таблицы (26.7% от максимального объёма расходуемой памяти). Значение (HB-6) немного
-	// увеличивает скорость работы (в среднем 2.25 элемента на хеш), значение (HB-4) приводит к
-	// значительному снижению скорости работы (в среднем 6 элементов на хеш)
-	static constexpr size_t CHUNK_SIZE = 1 << (HASH_BITS - 5);
+	// Байты состояния слотов. Значение EMPTY равно 0, поэтому память, выделенная ОС, соответствует пустой таблице
+	static constexpr uint8_t EMPTY = 0;
+	static constexpr uint8_t DELETED = 1;
+	static constexpr uint8_t FULL = 0x80;
 
-	struct Item {
-		static constexpr uint32_t LAST = ~0u;
+	struct Part {
+		uint8_t* pCtrlA = nullptr;	// Байты состояния слотов (выровнены по границе группы)
+		uint8_t* pChunkA = nullptr;	// Младшие байты номеров блоков чисел в слотах
+		T* pNumA = nullptr;			// Числа в слотах
+		unsigned bits = 0;			// Количество бит номера слота (размер таблицы - 2 ^ bits слотов)
+		size_t itemC = 0;			// Количество занятых слотов (оно же количество элементов во всех блоках части)
+		size_t deletedC = 0;		// Количество удалённых слотов
+		size_t firstChunk = 0;		// Номер первого блока части
 
-		FixNumber num;			// Число (0 если элемент не задействован)
-		uint32_t next = LAST;	// Индекс следующего числа в m_ChunkA (LAST если этот элемент последний)
-
-		void Reset() { num.SetZero(); next = LAST; }
+		size_t GetSlotC() const { return size_t(1) << bits; }
+		size_t GetMaxUsedC() const { return GetSlotC() - GetSlotC() / 8; }
 	};
 
-	void RaiseTable();
-	void Purge(size_t eighth);
-	uint32_t GetNext(size_t eighth);
-	template<class T> unsigned GetHash(const T& num) const;
-
-	Item* AllocateMem(size_t itemC);
-	void FreeMem(Item*& pBlock);
-
-	Item* GetItem(uint32_t i) const { return &m_ChunkA[i / CHUNK_SIZE][i & (CHUNK_SIZE - 1)]; }
-
-	Item* m_TableA = nullptr;	// Хеш-таблица (первые элементы цепочек или "0")
-	Item** m_ChunkA = nullptr;	// Массив блоков по CHUNK_SIZE распределяемых элементов
-	size_t m_NextA[8];			// Текущие индексы новых элементов каждой из частей
-	size_t m_TCount = 0;		// Количество задействованных элементов в m_TableA
-	size_t m_CCount = 0;		// Суммарное количество задействованных элементов m_ChunkA
-	size_t m_RCount = 0;		// Суммарное кол-во элементов, перенесённых из блоков в m_TableA
-	size_t m_RCountA[8];		// Кол-во эл-в, перенесённых из блоков в m_TableA для каждой из частей
-	unsigned m_HBits = 0;		// Количество используемых бит хеша в данный момент
-	unsigned m_Purge = 0;		// Части (мл. 8 бит), достигшие крит. размера
+	template<class U> bool Find(const U& num) const;
+	static size_t FindFreeSlot(const Part& part, uint64_t hash);
+
+	void Purge(size_t part);
+	void Rehash(Part& part, unsigned bits);
+	void DropDeleted(Part& part);
+
+	void AllocatePart(Part& part, unsigned bits);
+	void FreePart(Part& part);
+
+	// Перемешивает биты 32-битного хеша числа: старшие 3 бита результата выбирают часть, биты 32-51 - группу
+	// в таблице части, а биты 54-60 сохраняются в байте состояния слота
+	static uint64_t MixHash(unsigned hash) { return hash * 0x9e3779b97f4a7c15ull; }
+	static size_t GetPartIndex(uint64_t hash) { return static_cast<size_t>(hash >> 61); }
+	static size_t GetGroup(const Part& p, uint64_t hash) { return (hash >> 32) & (p.GetSlotC() / GROUP_SIZE - 1); }
+	static uint8_t GetCtrl(uint64_t hash) { return static_cast<uint8_t>(FULL | ((hash >> 54) & 0x7f)); }
+
+	Part m_PartA[8];			// Части набора
+	size_t m_Count = 0;			// Суммарное количество элементов всех частей
 	size_t m_LPageSize = 0;		// Размер большой страницы памяти (0, если используются обычные 4K страницы)
+	BloomFilter m_Prefilter;	// Фильтр Блума для поисков (память не выделена, если он не используется)
+};
+
+using NumberSet = BasicNumberSet<FixNumber>;
+using WideNumberSet = BasicNumberSet<WideFixNumber>;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   ConcurrentSetBase - общая часть наборов чисел с одновременным доступом из нескольких потоков
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Наборы ConcurrentNumberSet и ConcurrentNumberFilter разбиты на SHARD_C частей (шардов) по старшим битам хеша.
+// Каждый шард состоит из GEN_C поколений фиксированного размера. Числа добавляются в текущее поколение, а ищутся в
+// текущем и предыдущем. Когда текущее поколение заполняется, шард переходит к следующему: самое старое поколение
+// очищается и становится текущим, т.е. удаляются сразу все числа самого старого поколения.
+// Смена поколений заменяет удаление блоков функцией NumberSet::Purge, но удаляет числа более крупными порциями:
+// NumberSet при заполнении части удаляет её первый блок (~1/CLEAR_GAIN чисел части), а шард при смене поколения
+// теряет половину чисел, доступных для поиска. Поэтому в заполненном шарде доступны от 1 до 2 поколений чисел (в
+// среднем 1.5), а третье поколение хранится только до тех пор, пока его нельзя очистить (см. ниже).
+// Память поколения (GEN_MEM_SIZE) выделяется при первом переходе шарда к нему, поэтому набор занимает память по мере
+// заполнения, но не больше SHARD_C * GEN_C * GEN_MEM_SIZE = 2304 MiB (как NumberSet).
+// Очищать поколение можно только тогда, когда его гарантированно не читает ни один поток. Для этого используется
+// схема эпох (epoch-based reclamation): на время каждой операции поток объявляет текущую эпоху набора в своём
+// слоте, а поколение, выведенное из употребления в эпоху e, может быть очищено, только если ни в одном из слотов
+// не объявлена эпоха e или более ранняя. Если текущее поколение заполнено, а очистить самое старое пока нельзя,
+// то число не добавляется (для набора отсева это допустимо).
+// Каждое поколение содержит свой фильтр Блума (если он используется), размер которого рассчитан на все числа
+// поколения: фильтр не отключается и очищается вместе с поколением. Поиск в поколении выполняется, только если
+// число пропустил его фильтр. Фильтр занимает малую часть памяти поколения (1/26 для ConcurrentNumberSet и 1/9 для
+// ConcurrentNumberFilter), поэтому его блоки чаще находятся в кеше процессора, чем слоты поколения
+
+//----------------------------------------------------------------------------------------------------------------------
+class ConcurrentSetBase
+{
+public:
+	// Максимальное количество потоков, одновременно использующих наборы ConcurrentSetBase (кратно 64). Рассчитано
+	// на 1024 рабочих потока режима поиска и служебные потоки (см. SearchModeClasses::WorkThreads::MAX_THREAD_C)
+	static constexpr size_t MAX_THREAD_C = 1088;
+
+	// Возвращает true, если большие страницы памяти используются
+	bool IsLargePageEnabled() const { return m_LPageSize != 0; }
+
+protected:
+	static constexpr size_t SHARD_BITS = 6;				// Количество бит хеша для выбора шарда
+	static constexpr size_t SHARD_C = 1 << SHARD_BITS;	// Количество шардов
+	static constexpr size_t GEN_C = 3;					// Количество поколений шарда
+	// Макс. объём памяти одного поколения (кратен размеру большой страницы памяти)
+	static constexpr size_t GEN_MEM_SIZE = 12 << 20;
+	// Количество чисел, поиск которых функции ExistsBatch выполняют совместно
+	static constexpr size_t BATCH_C = 16;
+
+	// Шард из поколений типа G. Тип G должен содержать поле retiredEpoch (эпоха, в которой поколение было
+	// выведено из употребления) и функции IsAllocated, Allocate(largePageSize, numaNode), Reset и Free
+	template<class G>
+	struct alignas(64) Shard {
+		G genA[GEN_C];
+		// Номер текущего поколения (индекс в genA - по модулю GEN_C). Поколения нумеруются с 1, значение 0
+		// означает, что в шард ещё не добавлялись числа и память поколений не выделена
+		std::atomic<uint32_t> current = 0;
+		std::atomic<bool> isRotating = false;		// true, если какой-то поток выполняет смену поколения
+
+		// Возвращают поколение с номером n и предыдущее ему (nullptr, если такого поколения ещё не было)
+		const G* GetGen(uint32_t n) const { return n ? &genA[n % GEN_C] : nullptr; }
+		const G* GetPrevGen(uint32_t n) const { return (n > 1) ? &genA[(n - 1) % GEN_C] : nullptr; }
+	};
+
+	// Слот потока, в котором на время операции объявляется текущая эпоха (0 - поток вне операции)
+	struct alignas(64) Slot {
+		std::atomic<uint64_t> epoch = 0;
+	};
+
+	// Объявляет эпоху в слоте вызывающего потока на время своего существования
+	class EpochGuard {
+	public:
+		EpochGuard(const ConcurrentSetBase& set);
+		~EpochGuard() { m_Slot.epoch.store(0, std::memory_order_release); }
+
+		size_t GetSlotIndex() const { return m_Index; }
+
+	private:
+		size_t m_Index;
+		Slot& m_Slot;
+	};
+
+	ConcurrentSetBase(bool useLargePages, int numaNode, bool usePrefilter);
+
+	static size_t GetThreadSlotIndex();
+
+	// Переводит шард к следующему поколению (выделяя при необходимости его память), если текущим всё ещё является
+	// поколение current. Возвращает true, если после вызова можно повторить попытку добавления числа в новое поколение
+	template<class G> bool Rotate(Shard<G>& shard, uint32_t current, size_t ownSlotIndex);
+	bool CanReclaim(uint64_t epoch, size_t ownSlotIndex) const;
+
+	std::unique_ptr<Slot[]> m_SlotA;				// Слоты потоков (MAX_THREAD_C)
+	std::atomic<uint64_t> m_Epoch = 1;				// Текущая эпоха
+	size_t m_LPageSize = 0;							// Размер большой страницы памяти (0 - обычные 4K страницы)
+	int m_NumaNode = -1;							// Узел NUMA для памяти поколений (см. LargeMemPages::Allocate)
+	bool m_UsePrefilter;							// true, если поиски проходят через фильтры Блума поколений
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   BasicConcurrentNumberSet - набор чисел BasicFixNumber с одновременным доступом из нескольких потоков
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Каждое поколение шарда - это хеш-таблица с открытой адресацией фиксированного размера (см. описание класса
+// ConcurrentSetBase), устроенная так же, как таблицы частей NumberSet: слоты объединены в группы по GROUP_SIZE, и
+// поиск в группе выполняется одним сравнением 16 байт состояний векторной инструкцией. Но количество групп - не
+// степень 2, поэтому группы перебираются линейно, и удалённых слотов нет: числа удаляются только сменой поколения.
+// Функции Exists не требуют блокировок и выполняются за ограниченное число шагов (wait-free), функция Insert
+// занимает пустой слот операцией CAS (lock-free). Если одно и то же число одновременно добавляют 2 потока, то в
+// поколении могут оказаться 2 копии числа, что не нарушает работу набора (функция Exists может не учесть меньший
+// порядковый номер). Тип T - это FixNumber (набор ConcurrentNumberSet) или WideFixNumber (набор
+// WideConcurrentNumberSet для чисел длиной более 30 цифр)
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+class BasicConcurrentNumberSet : public ConcurrentSetBase
+{
+	AML_NONCOPYABLE(BasicConcurrentNumberSet)
+
+public:
+	// Память всех поколений набора размещается на узле NUMA numaNode. Если он равен -1, то используется узел,
+	// заданный функцией LargeMemPages::SetNumaNode (если он был задан). Если usePrefilter равно true, то
+	// поиски проходят через фильтр Блума (см. описание класса ConcurrentSetBase)
+	explicit BasicConcurrentNumberSet(bool useLargePages = false, int numaNode = -1, bool usePrefilter = true);
+	~BasicConcurrentNumberSet();
+
+	// Очищает набор. В отличие от остальных функций не может выполняться одновременно с ними
+	void Clear(bool freeMem = true);
+	// Возвращает количество элементов в текущих и предыдущих поколениях всех шардов. Во время
+	// одновременного добавления чисел другими потоками значение будет приблизительным
+	size_t GetSize() const;
+	// Возвращает объём памяти (в байтах), задействованной набором в данный момент. Не может
+	// выполняться одновременно с добавлением чисел
+	size_t GetMemSize() const;
+
+	// Возвращает true, если число num содержится в наборе и было добавлено с порядковым номером,
+	// меньшим order. Функция без параметра order учитывает числа с любыми порядковыми номерами
+	bool Exists(const T& num) const { return Exists(num, ~0ull); }
+	bool Exists(const T& num, uint64_t order) const;
+	// Выполняет функцию Exists(num, order) для count чисел массива pNumA и записывает результаты в pResultA.
+	// Обращения к памяти для нескольких чисел выполняются одновременно (с предвыборкой), поэтому для большого
+	// количества чисел функция работает быстрее, чем отдельные вызовы Exists. Возвращает количество чисел,
+	// отклонённых фильтрами Блума поколений (без обращения к слотам поколений)
+	size_t ExistsBatch(const T* pNumA, size_t count, uint64_t order, bool* pResultA) const;
+
+	// Добавляет число num с порядковым номером order. Возвращает true, если число было добавлено, и false, если
+	// оно уже есть в наборе (тогда его порядковый номер уменьшается до order, если он был больше) или если оно
+	// не может быть добавлено в данный момент (см. выше). Число 0 никогда не добавляется
+	bool Insert(const T& num, uint64_t order = 0);
+
+	// Размер записи одного числа в файле (функции Save и Load)
+	static constexpr size_t RECORD_SIZE = sizeof(T);
+
+	// Записывает в файл file все числа набора, добавленные с порядковыми номерами, меньшими maxOrder, и возвращает
+	// их количество в itemC. Может выполняться одновременно с остальными функциями (кроме Clear), но числа,
+	// добавленные во время записи, могут быть не записаны
+	bool Save(util::File& file, uint64_t maxOrder, size_t& itemC) const;
+	// Добавляет в набор itemC чисел, записанных в файл file функцией Save, с порядковым номером 0
+	bool Load(util::File& file, size_t itemC);
+
+protected:
+	static constexpr size_t GROUP_SIZE = 16;			// Количество слотов в группе
+
+	struct Entry {
+		T num;								// Число
+		std::atomic<uint64_t> order;		// Порядковый номер числа
+	};
+
+	// Количество групп и слотов в поколении: на каждый слот приходятся байт состояния, байт фильтра Блума и
+	// элемент Entry (~480 тыс. слотов для FixNumber и ~300 тыс. для WideFixNumber)
+	static constexpr size_t GROUP_C = GEN_MEM_SIZE / (GROUP_SIZE * (2 + sizeof(Entry)));
+	static constexpr size_t SLOT_C = GROUP_C * GROUP_SIZE;
+	// Количество блоков фильтра Блума поколения (8 бит на слот, т.е. ~9 бит на число поколения)
+	static constexpr size_t BLOOM_BLOCK_C = SLOT_C / 64;
+	// Количество чисел в поколении. Как и в NumberSet, занятые слоты не должны превышать 7/8 таблицы: при
+	// больших значениях резко растёт длина последовательностей пробирования
+	static constexpr size_t ITEM_C = SLOT_C - SLOT_C / 8;
+
+	// Байты состояния слотов. Значение EMPTY равно 0, поэтому память, выделенная ОС, соответствует пустой
+	// таблице. Слот BUSY уже занят потоком, добавляющим число, но число в него ещё не записано
+	static constexpr uint8_t EMPTY = 0;
+	static constexpr uint8_t BUSY = 1;
+	static constexpr uint8_t FULL = 0x80;
+
+	// Блоки фильтра Блума, байты состояния и числа в слотах размещаются друг за другом в одном блоке памяти
+	struct Generation {
+		BloomFilter::Block* pBloomA = nullptr;		// Блоки фильтра Блума (BLOOM_BLOCK_C)
+		std::atomic<uint8_t>* pCtrlA = nullptr;		// Байты состояния слотов (SLOT_C)
+		Entry* pEntryA = nullptr;					// Числа в слотах (SLOT_C)
+		std::atomic<uint32_t> itemC = 0;			// Количество распределённых слотов
+		uint64_t retiredEpoch = 0;					// Эпоха, в которой поколение было выведено из употребления
+
+		bool IsAllocated() const { return pBloomA != nullptr; }
+		void Allocate(size_t largePageSize, int numaNode);
+		void Reset();
+		void Free();
+	};
+
+	// Возвращает false, если числа с хешем numHash (T::GetHash) гарантированно нет в поколении gen
+	bool MayContain(const Generation& gen, unsigned numHash) const;
+	// Ищет число в поколении pGen (nullptr - поколения ещё не было)
+	static Entry* Find(const Generation* pGen, const T& num, uint64_t hash);
+	// Ищет число среди слотов группы group, байты состояния которых совпали с байтом числа (маска matchMask)
+	static Entry* FindInGroup(const Generation& gen, size_t group, unsigned matchMask, uint8_t ctrl, const T& num);
+	// Помещает число с порядковым номером order в первый пустой слот последовательности пробирования. Возвращает
+	// true, если число было добавлено. Иначе в pFound возвращается элемент этого же числа, добавленного в
+	// поколение другим потоком после поиска в функции Insert
+	static bool Place(Generation& gen, const T& num, uint64_t hash, uint64_t order, Entry*& pFound);
+
+	// Перемешивает биты 32-битного хеша числа (как NumberSet::MixHash): старшие SHARD_BITS бит результата выбирают
+	// шард, биты 26-57 - группу в поколении, а биты 19-25 сохраняются в байте состояния слота
+	static uint64_t MixHash(unsigned hash) { return hash * 0x9e3779b97f4a7c15ull; }
+	static size_t GetShardIndex(uint64_t hash) { return static_cast<size_t>(hash >> (64 - SHARD_BITS)); }
+	static size_t GetGroup(uint64_t hash) { return static_cast<size_t>((((hash >> 26) & 0xffffffff) * GROUP_C) >> 32); }
+	static size_t GetNextGroup(size_t group) { return (group + 1 < GROUP_C) ? group + 1 : 0; }
+	static uint8_t GetCtrl(uint64_t hash) { return static_cast<uint8_t>(FULL | ((hash >> 19) & 0x7f)); }
+
+	std::unique_ptr<Shard<Generation>[]> m_ShardA;	// Шарды (SHARD_C)
+};
+
+using ConcurrentNumberSet = BasicConcurrentNumberSet<FixNumber>;
+using WideConcurrentNumberSet = BasicConcurrentNumberSet<WideFixNumber>;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   ConcurrentNumberFilter - фильтр чисел BasicFixNumber с одновременным доступом из нескольких потоков
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// В отличие от ConcurrentNumberSet, фильтр хранит не сами числа, а их "отпечатки" - FINGERPRINT_BITS бит 64-битного
+// хеша, вместе с младшими ORDER_BITS битами порядковых номеров, т.е. ~10 байт на число вместо ~30. Поэтому в
+// том же объёме памяти фильтр помещает примерно в 3 раза больше чисел, но функция Exists может ошибочно вернуть true
+// для отсутствующего числа, если его отпечаток совпал с отпечатком одного из чисел фильтра. Вероятность такой
+// ошибки не превышает 2^-35 (~3e-11) для каждого поиска.
+// Каждое поколение шарда - это массив корзин по SLOT_C слотов (одна линия кеша). Для числа выбираются 2 корзины,
+// и отпечаток помещается в первый свободный слот менее заполненной из них операцией CAS. Если обе корзины
+// заполнены, то число не добавляется. Порядковые номера сравниваются по модулю 2^ORDER_BITS, поэтому номера
+// одного и того же числа не должны различаться более, чем на 2^(ORDER_BITS-1) (при большей разнице функция
+// Exists может не найти число, что для фильтра отсева допустимо)
+
+//----------------------------------------------------------------------------------------------------------------------
+class ConcurrentNumberFilter : public ConcurrentSetBase
+{
+	AML_NONCOPYABLE(ConcurrentNumberFilter)
+
+public:
+	// Память всех поколений фильтра размещается на узле NUMA numaNode (см. конструктор ConcurrentNumberSet)
+	explicit ConcurrentNumberFilter(bool useLargePages = false, int numaNode = -1, bool usePrefilter = true);
+	~ConcurrentNumberFilter();
+
+	// Очищает фильтр. В отличие от остальных функций не может выполняться одновременно с ними
+	void Clear(bool freeMem = true);
+	// Возвращает количество элементов в текущих и предыдущих поколениях всех шардов. Во время
+	// одновременного добавления чисел другими потоками значение будет приблизительным
+	size_t GetSize() const;
+
+	// Возвращает true, если число num (вероятно) содержится в фильтре и было добавлено с порядковым
+	// номером, меньшим order. Функция без параметра order учитывает числа с любыми порядковыми номерами.
+	// Функции фильтра используют только 64-битный хеш числа, который не зависит от размера объекта числа,
+	// поэтому тип T может быть как FixNumber, так и WideFixNumber (в одном фильтре можно их смешивать)
+	template<class T> bool Exists(const T& num) const;
+	template<class T> bool Exists(const T& num, uint64_t order) const;
+	// Выполняет функцию Exists(num, order) для count чисел массива pNumA (аналог ConcurrentNumberSet::ExistsBatch)
+	template<class T> size_t ExistsBatch(const T* pNumA, size_t count, uint64_t order, bool* pResultA) const;
+
+	// Добавляет число num с порядковым номером order (аналог функции ConcurrentNumberSet::Insert)
+	template<class T> bool Insert(const T& num, uint64_t order = 0);
+
+	// Размер записи одного отпечатка в файле (функции Save и Load)
+	static constexpr size_t RECORD_SIZE = sizeof(uint64_t);
+
+	// Записывает отпечатки чисел в файл file и загружает их из файла (аналоги функций ConcurrentNumberSet::Save
+	// и ConcurrentNumberSet::Load). Вместо порядкового номера в записи хранятся номера шарда и корзины
+	bool Save(util::File& file, uint64_t maxOrder, size_t& itemC) const;
+	bool Load(util::File& file, size_t itemC);
+
+protected:
+	// Количество корзин - степень 2 (см. GetBucketOffset), поэтому поколение фильтра занимает не весь объём
+	// GEN_MEM_SIZE, а 9 MiB: 8 MiB корзин и 1 MiB фильтра Блума
+	static constexpr size_t BUCKET_BITS = 17;				// Кол-во бит хеша для выбора корзины в поколении
+	static constexpr size_t BUCKET_C = 1 << BUCKET_BITS;	// Количество корзин в поколении
+	static constexpr size_t SLOT_C = 8;						// Количество слотов в корзине
+	// Количество блоков фильтра Блума поколения (8 бит на слот, т.е. ~9 бит на число поколения)
+	static constexpr size_t BLOOM_BLOCK_C = BUCKET_C * SLOT_C / 64;
+	// Количество элементов в поколении. При заполнении 7/8 слотов обе корзины
+	// оказываются заполненными не более, чем для ~0.2% добавляемых чисел
+	static constexpr size_t ITEM_C = BUCKET_C * SLOT_C / 8 * 7;
+
+	static constexpr unsigned ORDER_BITS = 24;							// Кол-во бит порядкового номера
+	static constexpr unsigned FINGERPRINT_BITS = 64 - ORDER_BITS;		// Кол-во бит отпечатка
+	static constexpr uint64_t ORDER_MASK = (uint64_t(1) << ORDER_BITS) - 1;
+
+	// Слот - отпечаток в старших FINGERPRINT_BITS битах и порядковый номер в младших (0 - пустой слот)
+	struct alignas(64) Bucket {
+		std::atomic<uint64_t> slotA[SLOT_C];
+	};
+
+	// Блоки фильтра Блума и корзины размещаются друг за другом в одном блоке памяти
+	struct Generation {
+		BloomFilter::Block* pBloomA = nullptr;		// Блоки фильтра Блума (BLOOM_BLOCK_C)
+		Bucket* pBucketA = nullptr;					// Корзины (BUCKET_C)
+		std::atomic<uint32_t> itemC = 0;			// Количество распределённых элементов
+		uint64_t retiredEpoch = 0;					// Эпоха, в которой поколение было выведено из употребления
+
+		bool IsAllocated() const { return pBloomA != nullptr; }
+		void Allocate(size_t largePageSize, int numaNode);
+		void Reset();
+		void Free();
+	};
+
+	// Положение числа в фильтре: шард, 2 корзины и отпечаток (не равный 0)
+	struct Key {
+		Key() = default;
+		template<class T> explicit Key(const T& num);
+		// Восстанавливает положение числа по записи, сделанной функцией Save
+		explicit Key(uint64_t record);
+
+		// Возвращает хеш для фильтра Блума. Он не зависит от корзин, так как после загрузки записи
+		// корзины могут идти в другом порядке (см. конструктор Key(uint64_t))
+		uint64_t GetPrefilterHash() const { return fingerprint; }
+
+		size_t shard;
+		size_t bucketA[2];
+		uint64_t fingerprint;
+	};
+
+	bool Insert(const Key& key, uint64_t order);
+	// Возвращает false, если отпечатка key гарантированно нет в поколении gen
+	bool MayContain(const Generation& gen, const Key& key) const;
+	// Ищет отпечаток в поколении pGen (nullptr - поколения ещё не было)
+	static std::atomic<uint64_t>* Find(const Generation* pGen, const Key& key);
+	// Помещает отпечаток с порядковым номером (value) в одну из корзин. Возвращает true, если отпечаток был
+	// добавлен. Иначе в pFound возвращается слот с таким же отпечатком, если его одновременно добавил другой
+	// поток, или nullptr, если обе корзины заполнены
+	static bool Place(Generation& gen, const Key& key, uint64_t value, std::atomic<uint64_t>*& pFound);
+	template<class T> bool Find(const T& num, uint64_t order, bool anyOrder) const;
+	// Возвращает true, если порядковый номер order1 меньше order2 (сравнение по модулю 2^ORDER_BITS)
+	static bool IsBefore(uint64_t order1, uint64_t order2);
+	// Возвращает смещение второй корзины числа относительно первой (зависит только от отпечатка)
+	static size_t GetBucketOffset(uint64_t fingerprint);
+
+	std::unique_ptr<Shard<Generation>[]> m_ShardA;	// Шарды (SHARD_C)
 };
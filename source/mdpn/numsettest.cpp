@@ -2,10 +2,19 @@
 #include "pch.h"
 #include "numsettest.h"
 
+#include "largemempages.h"
 #include "util.h"
 
 #include <core/auxutil.h>
 #include <core/platform.h>
+#include <core/winapi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
@@ -202,3 +211,369 @@ void EndlessTestNumberSet::PrintProgress()
 	}
 	++m_Loop;
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   TestConcurrentSet
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool TestConcurrentSet<T>::Execute()
+{
+	m_VerboseOutput = true;
+	PrintHeader();
+
+	if (!IsCancelled() && !TestSingleThread())
+		return false;
+	if (!IsCancelled() && !TestMultiThread())
+		return false;
+
+	PrintFooter();
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool TestConcurrentSet<T>::OnError(unsigned errorCode)
+{
+	aux::Printf(errorCode ? "\b\b\b: #12failed (%u)\n" : "\b\b\b: #12failed\n", errorCode);
+	return Test::OnError();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool TestConcurrentSet<T>::TestSingleThread()
+{
+	aux::Print("  Testing single-threaded access...");
+
+	// Количество чисел выбрано так, чтобы они гарантированно поместились в текущие поколения всех шардов
+	constexpr unsigned NUM_C = 1000000;
+
+	FixNumber num;
+	m_NumSet.Clear(false);
+	for (unsigned i = 1; i <= NUM_C; ++i)
+	{
+		num = Number(i);
+		// Порядковый номер числа i равен 2 * i, при повторном добавлении он уменьшается до i
+		if (!m_NumSet.Insert(num, 2ull * i))
+			return OnError(1);
+		if (m_NumSet.Insert(num, 2ull * i))
+			return OnError(2);
+	}
+	if (m_NumSet.GetSize() != NUM_C)
+		return OnError(3);
+
+	for (unsigned i = 1; i <= NUM_C; ++i)
+	{
+		num = Number(i);
+		if (!m_NumSet.Exists(num) || m_NumSet.Exists(num, 2ull * i) || !m_NumSet.Exists(num, 2ull * i + 1))
+			return OnError(4);
+		if (m_NumSet.Insert(num, i) || !m_NumSet.Exists(num, i + 1ull) || m_NumSet.Exists(num, i))
+			return OnError(5);
+	}
+	for (unsigned i = NUM_C + 1; i <= 2 * NUM_C; ++i)
+	{
+		num = Number(i);
+		if (m_NumSet.Exists(num))
+			return OnError(6);
+	}
+
+	m_NumSet.Clear(false);
+	num = Number(1u);
+	if (m_NumSet.GetSize() || m_NumSet.Exists(num))
+		return OnError(7);
+
+	aux::Printc("\b\b\b: #10ok\n");
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+bool TestConcurrentSet<T>::TestMultiThread()
+{
+	aux::Print("  Testing concurrent access...");
+
+	// Потоки добавляют и ищут случайные числа из общего диапазона. Число v добавляется потоком t с порядковым
+	// номером 8 * v + t, поэтому поиск с порядковым номером, не превышающим 8 * v, должен быть неудачным. Фильтр
+	// ConcurrentNumberFilter сравнивает номера по модулю 2^24, но запрашиваемые номера близки к 8 * v
+	constexpr unsigned THREAD_C = 4;
+	constexpr unsigned RANGE = 50000000;
+	constexpr unsigned OPERATION_C = 4000000;
+
+	std::atomic<unsigned> errorC = 0;
+	std::atomic<unsigned> foundC = 0;
+	auto threadFn = [&](unsigned t)
+	{
+		FixNumber num;
+		math::RandGen rg(t + 1);
+		for (unsigned i = 0; i < OPERATION_C && !errorC; ++i)
+		{
+			const unsigned v = 1 + rg.UInt(RANGE);
+			num = Number(v);
+			if (i & 1)
+				m_NumSet.Insert(num, 8ull * v + t);
+			else
+			{
+				const uint64_t order = rg.UInt(8) + 8ull * (v - 4 + rg.UInt(8));
+				if (m_NumSet.Exists(num, order))
+				{
+					++foundC;
+					if (order <= 8ull * v)
+						++errorC;
+				}
+			}
+		}
+	};
+
+	m_NumSet.Clear(false);
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < THREAD_C; ++t)
+		threads.emplace_back(threadFn, t);
+	for (auto& thread : threads)
+		thread.join();
+
+	if (errorC)
+		return OnError(1);
+	if (!foundC && !IsCancelled())
+		return OnError(2);
+
+	aux::Printc("\b\b\b: #10ok\n");
+	return true;
+}
+
+// Явное инстанцирование для обоих тестируемых классов
+template class TestConcurrentSet<ConcurrentNumberSet>;
+template class TestConcurrentSet<ConcurrentNumberFilter>;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   TestConcurrentNumberSet
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+std::string TestConcurrentNumberSet::GetPrintedHeader() const
+{
+	return "Testing validity of #9ConcurrentNumberSet#7";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   TestConcurrentNumberFilter
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+std::string TestConcurrentNumberFilter::GetPrintedHeader() const
+{
+	return "Testing validity of #9ConcurrentNumberFilter#7";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   SpeedTestNumberSet
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Тест SpeedTestNumberSet заполняет наборы NumberSet и ConcurrentNumberSet одними и теми же случайными 18-значными
+// числами до нескольких контрольных размеров (последний близок к ёмкости NumberSet, а ConcurrentNumberSet к этому
+// моменту уже сменяет поколения) и на каждом из них измеряет скорость добавления чисел, поиска имеющихся в наборе
+// (в случайном порядке) и отсутствующих чисел, а также объём памяти в расчёте на одно число
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SpeedTestNumberSet::Execute()
+{
+	::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+	m_VerboseOutput = true;
+	PrintHeader();
+
+	aux::Print("  Generating numbers...");
+	constexpr size_t numberC = 90000000;
+	m_Numbers.resize(numberC);
+	m_Missing.resize(QUERY_C);
+
+	math::RandGen rg(196);
+	auto getNumber = [&rg]() {
+		const uint64_t v = (static_cast<uint64_t>(rg.UInt()) << 32) | rg.UInt();
+		return FixNumber(Number(100000000000000000ull + v % 900000000000000000ull));
+	};
+	for (auto& num : m_Numbers)
+		num = getNumber();
+	// Числа m_Missing могут совпасть с числами m_Numbers, но вероятность этого ничтожна
+	for (auto& num : m_Missing)
+		num = getNumber();
+	aux::Print("\r");
+
+	if (!IsCancelled())
+		MeasureSet<NumberSet>("NumberSet");
+	if (!IsCancelled())
+		MeasureSet<NumberSet>("NumberSet (no pre-filter)", false, false);
+	if (!IsCancelled())
+		MeasureSet<ConcurrentNumberSet>("ConcurrentNumberSet");
+
+	m_Numbers = std::vector<FixNumber>();
+	m_Missing = std::vector<FixNumber>();
+
+	PrintFooter();
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T, class... Args>
+void SpeedTestNumberSet::MeasureSet(const char* pName, Args... args)
+{
+	aux::Printf("  #9%s#7:\n", pName);
+
+	LARGE_INTEGER f;
+	::QueryPerformanceFrequency(&f);
+	auto getSpeed = [&f](size_t count, const LARGE_INTEGER& t1, const LARGE_INTEGER& t2) {
+		return static_cast<float>(static_cast<double>(count) * f.QuadPart / std::max(t2.QuadPart - t1.QuadPart, 1ll));
+	};
+
+	const size_t sizes[] = { 1000000, 4000000, 16000000, 32000000, 64000000, m_Numbers.size() };
+	std::unique_ptr<T> numSet(new T(args...));
+
+	size_t addedC = 0;
+	for (size_t size : sizes)
+	{
+		const size_t insertC = size - addedC;
+		LARGE_INTEGER t1, t2, t3, t4;
+		::QueryPerformanceCounter(&t1);
+		for (; addedC < size; ++addedC)
+			numSet->Insert(m_Numbers[addedC]);
+		::QueryPerformanceCounter(&t2);
+
+		// Имеющиеся в наборе числа ищем в псевдослучайном порядке, чтобы обращения к памяти не были последовательными
+		size_t foundC = 0;
+		for (size_t i = 0, j = 0; i < QUERY_C; ++i, j = (j + 7919) % size)
+			foundC += numSet->Exists(m_Numbers[j]) ? 1 : 0;
+		::QueryPerformanceCounter(&t3);
+		for (size_t i = 0; i < QUERY_C; ++i)
+			foundC += numSet->Exists(m_Missing[i]) ? 0 : 1;
+		::QueryPerformanceCounter(&t4);
+
+		const size_t setSize = numSet->GetSize();
+		aux::Printf("    Items #15%11s#7: insert %s, hit %s, miss %s, %5.1f bytes/item%s\n",
+			SeparateWithCommas(setSize).c_str(), FormatSpeed(getSpeed(insertC, t1, t2)).c_str(),
+			FormatSpeed(getSpeed(QUERY_C, t2, t3)).c_str(), FormatSpeed(getSpeed(QUERY_C, t3, t4)).c_str(),
+			static_cast<double>(numSet->GetMemSize()) / std::max<size_t>(setSize, 1),
+			(foundC < 2 * QUERY_C && setSize == addedC) ? " #12(lookup mismatch)#7" : "");
+
+		if (IsCancelled())
+			break;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   SpeedTestSiftReplicas
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Тест SpeedTestSiftReplicas оценивает, как скорость проверки кандидатов на отсев (SearchMode::IsSifted, одна
+// проверка на каждый кандидат, достигший длины siftLength) зависит от размещения набора отсева. Набор заполняется
+// случайными 18-значными числами, после чего потоки всех логических процессоров выполняют проверки (половина
+// чисел есть в наборе). Замеры: потоки одного узла NUMA и набор на нём же; потоки всех узлов и один общий набор
+// на узле 0; потоки всех узлов и реплика набора на каждом узле. На системе с одним узлом выполняется только
+// первый замер. Реплики набора в поиске не используются, пока этот замер на системе с несколькими узлами не
+// покажет выигрыш (привязка потоков к узлам требует Windows 7)
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SpeedTestSiftReplicas::Execute()
+{
+	m_VerboseOutput = true;
+	PrintHeader();
+
+	const size_t nodeC = LargeMemPages::GetNumaNodeC();
+	aux::Printf("  NUMA nodes: #15%u#7\n", static_cast<unsigned>(nodeC));
+
+	aux::Print("  Generating numbers...");
+	m_Numbers.resize(NUMBER_C);
+	m_Queries.resize(QUERY_C);
+
+	math::RandGen rg(196);
+	auto getNumber = [&rg]() {
+		const uint64_t v = (static_cast<uint64_t>(rg.UInt()) << 32) | rg.UInt();
+		return FixNumber(Number(100000000000000000ull + v % 900000000000000000ull));
+	};
+	for (auto& num : m_Numbers)
+		num = getNumber();
+	for (size_t i = 0; i < QUERY_C; ++i)
+		m_Queries[i] = (i & 1) ? getNumber() : m_Numbers[(i * 7919) % NUMBER_C];
+	aux::Print("\r");
+
+	const float singleSpeed = Measure(1, false);
+	aux::Printf("  1 node,  1 set:      #15%s#7 checks\n", FormatSpeed(singleSpeed).c_str());
+
+	if (nodeC > 1 && !IsCancelled())
+	{
+		const float sharedSpeed = Measure(nodeC, false);
+		aux::Printf("  %u nodes, shared set: #15%s#7 checks (%.2fx)\n", static_cast<unsigned>(nodeC),
+			FormatSpeed(sharedSpeed).c_str(), sharedSpeed / std::max(singleSpeed, 1.0f));
+	}
+	if (nodeC > 1 && !IsCancelled())
+	{
+		const float replicatedSpeed = Measure(nodeC, true);
+		aux::Printf("  %u nodes, replicas:   #15%s#7 checks (%.2fx)\n", static_cast<unsigned>(nodeC),
+			FormatSpeed(replicatedSpeed).c_str(), replicatedSpeed / std::max(singleSpeed, 1.0f));
+	}
+
+	m_Numbers = std::vector<FixNumber>();
+	m_Queries = std::vector<FixNumber>();
+
+	PrintFooter();
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+float SpeedTestSiftReplicas::Measure(size_t nodeC, bool replicate)
+{
+	std::vector<std::unique_ptr<ConcurrentNumberSet>> replicas;
+	for (size_t i = 0, replicaC = replicate ? nodeC : 1; i < replicaC; ++i)
+	{
+		replicas.push_back(std::make_unique<ConcurrentNumberSet>(true, static_cast<int>(i)));
+		for (size_t j = 0; j < NUMBER_C; ++j)
+			replicas.back()->Insert(m_Numbers[j], j);
+	}
+
+	// Потоки привязываются к процессорам своего узла и начинают проверки одновременно
+	std::vector<std::thread> threads;
+	std::atomic<size_t> readyC = 0;
+	std::atomic<bool> start = false;
+	std::atomic<size_t> foundC = 0;
+	for (size_t node = 0; node < nodeC; ++node)
+	{
+		const size_t cpuC = std::max<size_t>(LargeMemPages::GetNumaNodeCPUC(static_cast<int>(node)), 1);
+		const ConcurrentNumberSet* pSet = replicas[replicate ? node : 0].get();
+		for (size_t i = 0; i < cpuC && threads.size() < ConcurrentSetBase::MAX_THREAD_C; ++i)
+		{
+			threads.emplace_back([&, node, i, pSet]() {
+				LargeMemPages::BindThreadToNumaNode(static_cast<int>(node));
+				++readyC;
+				while (!start.load(std::memory_order_acquire))
+					std::this_thread::yield();
+
+				size_t found = 0;
+				for (size_t q = 0, j = (i * 104729) % QUERY_C; q < QUERY_C; ++q, j = (j + 7919) % QUERY_C)
+					found += pSet->Exists(m_Queries[j]) ? 1 : 0;
+				foundC += found;
+			});
+		}
+	}
+
+	while (readyC < threads.size())
+		std::this_thread::yield();
+	const auto t1 = std::chrono::steady_clock::now();
+	start.store(true, std::memory_order_release);
+	for (auto& thread : threads)
+		thread.join();
+	const auto t2 = std::chrono::steady_clock::now();
+
+	const double seconds = std::chrono::duration<double>(t2 - t1).count();
+	if (foundC != threads.size() * QUERY_C / 2)
+		aux::Printc("  #12Lookup mismatch#7\n");
+	return static_cast<float>(static_cast<double>(threads.size() * QUERY_C) / std::max(seconds, 1e-9));
+}
@@ -9,6 +9,7 @@
 
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
@@ -69,3 +70,114 @@ protected:
 	virtual bool TestMain() override;
 	virtual void PrintProgress() override;
 };
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   TestConcurrentSet - общая часть тестов корректности классов ConcurrentNumberSet и ConcurrentNumberFilter
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class T>
+class TestConcurrentSet : public Test
+{
+public:
+	virtual bool Execute() override;
+
+protected:
+	bool OnError(unsigned errorCode = 0);
+
+	bool TestSingleThread();
+	bool TestMultiThread();
+
+	T m_NumSet;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Test.Validity.ConcurrentNumberSet - тест корректности работы класса ConcurrentNumberSet
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class TestConcurrentNumberSet : public TestConcurrentSet<ConcurrentNumberSet>
+{
+public:
+	static std::string GetId() { return "Test.Validity.ConcurrentNumberSet"; }
+	static std::string GetPrerequisites() { return "Test.Validity.FixNumber"; }
+
+protected:
+	virtual std::string GetPrintedHeader() const override;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Test.Validity.ConcurrentNumberFilter - тест корректности работы класса ConcurrentNumberFilter
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class TestConcurrentNumberFilter : public TestConcurrentSet<ConcurrentNumberFilter>
+{
+public:
+	static std::string GetId() { return "Test.Validity.ConcurrentNumberFilter"; }
+	static std::string GetPrerequisites() { return "Test.Validity.FixNumber"; }
+
+protected:
+	virtual std::string GetPrintedHeader() const override;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Test.Speed.NumberSet - сравнение скорости работы и расхода памяти классов NumberSet и ConcurrentNumberSet
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class SpeedTestNumberSet : public Test
+{
+public:
+	static std::string GetId() { return "Test.Speed.NumberSet"; }
+
+	virtual bool Execute() override;
+
+protected:
+	static constexpr size_t QUERY_C = 1 << 22;	// Количество поисков чисел в каждом замере
+
+	virtual std::string GetPrintedName() const override { return "NumberSet"; }
+
+	// Измеряет скорость работы набора типа T, созданного с параметрами конструктора args
+	template<class T, class... Args> void MeasureSet(const char* pName, Args... args);
+
+	std::vector<FixNumber> m_Numbers;	// Добавляемые в набор числа
+	std::vector<FixNumber> m_Missing;	// Числа, которых нет в наборе
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Test.Speed.SiftReplicas - скорость проверок по набору ConcurrentNumberSet на одном и нескольких узлах NUMA
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class SpeedTestSiftReplicas : public Test
+{
+public:
+	static std::string GetId() { return "Test.Speed.SiftReplicas"; }
+
+	virtual bool Execute() override;
+
+protected:
+	static constexpr size_t NUMBER_C = 16000000;	// Количество чисел в наборе
+	static constexpr size_t QUERY_C = 1 << 22;		// Количество проверок, выполняемых каждым потоком
+
+	virtual std::string GetPrintedName() const override { return "SiftReplicas"; }
+
+	// Выполняет проверки чисел потоками всех логических процессоров узлов NUMA от 0 до nodeC - 1 и возвращает
+	// их суммарную скорость. Если replicate равно true, то каждый узел использует свою реплику набора, иначе
+	// все узлы используют один набор, память которого размещена на узле 0
+	float Measure(size_t nodeC, bool replicate);
+
+	std::vector<FixNumber> m_Numbers;	// Числа набора
+	std::vector<FixNumber> m_Queries;	// Проверяемые числа (половина из них есть в наборе)
+};
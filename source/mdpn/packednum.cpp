@@ -0,0 +1,714 @@
+﻿//∙MDPN
+#include "pch.h"
+#include "packednum.h"
+
+#include <core/exception.h>
+
+#include <intrin.h>
+#include <utility>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Вспомогательные функции
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Операция RAA над упакованным числом выполняется словами по 16 цифр. Для получения 16 цифр обратного числа
+// мы читаем соответствующие 8 байт из старших разрядов (если длина числа нечётна, то граница слова проходит
+// посередине байта, и нам нужно прочитать ещё 1 байт и сдвинуть слово на 4 бита), после чего меняем порядок
+// байтов и порядок тетрад внутри каждого байта. Сложение двух слов выполняется как обычное 64-битное сложение,
+// к одному из слагаемых которого прибавлено число 0x66..66: тетрады, сумма цифр в которых больше 9, при этом
+// переполняются, давая перенос в следующую тетраду. Из тетрад, в которых переполнения не было, затем вычитаем 6
+
+//----------------------------------------------------------------------------------------------------------------------
+static inline uint64_t ReverseDigits(uint64_t w)
+{
+	// Меняет порядок 16 цифр слова на обратный: порядок байтов, затем порядок тетрад в каждом байте
+	constexpr uint64_t m0f = 0x0f0f0f0f0f0f0f0full;
+	w = util::ByteSwap64(w);
+	return ((w >> 4) & m0f) | ((w & m0f) << 4);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<bool ODD>
+static inline uint64_t LoadReversed(const uint64_t* pDigits, ptrdiff_t end)
+{
+	// Возвращает 16 цифр числа с индексами от end - 16 до end - 1 в обратном порядке (цифра
+	// end - 1 в младших 4 битах слова). Цифры с отрицательными индексами будут равны 0
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(pDigits);
+	uint64_t w;
+	if (ODD)
+	{
+		p += (end - 17) / 2;
+		w = (*reinterpret_cast<const uint64_t*>(p) >> 4) | (static_cast<uint64_t>(p[8]) << 60);
+	} else
+		w = *reinterpret_cast<const uint64_t*>(p + (end - 16) / 2);
+
+	return ReverseDigits(w);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+static inline uint8_t AddBCD(uint64_t a, uint64_t b, uint8_t carry, uint64_t& out)
+{
+	// Складывает 16-значные упакованные числа a и b и входящий перенос carry, возвращая исходящий перенос
+	const uint64_t t1 = a + 0x6666666666666666ull;
+	uint64_t t2;
+	#if AML_64BIT
+		carry = _addcarry_u64(carry, t1, b, reinterpret_cast<unsigned long long*>(&t2));
+	#else
+		uint32_t lo, hi;
+		carry = _addcarry_u32(carry, static_cast<uint32_t>(t1), static_cast<uint32_t>(b), &lo);
+		carry = _addcarry_u32(carry, static_cast<uint32_t>(t1 >> 32), static_cast<uint32_t>(b >> 32), &hi);
+		t2 = (static_cast<uint64_t>(hi) << 32) | lo;
+	#endif
+
+	// Биты переносов в каждый из разрядов суммы. Перенос в тетраду k+1 означает, что тетрада
+	// k переполнилась. Для старшей тетрады признаком переполнения является исходящий перенос
+	const uint64_t carries = t2 ^ t1 ^ b;
+	const uint64_t noCarry = ((~carries & 0x1111111111111110ull) >> 4) | (static_cast<uint64_t>(carry ^ 1) << 60);
+	out = t2 - 6 * noCarry;
+	return carry;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<bool ODD>
+static size_t RAAPackedAVX2(const uint64_t* pIn, uint64_t* pOut, size_t len, size_t wordC, uint8_t& carry)
+{
+	// Векторная версия цикла операции RAA: обрабатывает группы по 4 слова (64 цифры), пока они целиком
+	// входят в первые wordC слов числа. Возвращает количество обработанных слов. Переносы между 64-битными
+	// словами вычисляются так же, как в AVX2-версии BigNumber::RAA: по признаку переполнения слова (G) и
+	// признаку того, что все его тетрады равны 0xf, т.е. перенос в слово распространится дальше (P)
+	const __m256i maskBs = _mm256_set_epi64x(0x0001020304050607ull, 0x08090a0b0c0d0e0full,
+		0x0001020304050607ull, 0x08090a0b0c0d0e0full);
+	const __m256i mask0f = _mm256_set1_epi8(0x0f);
+	const __m256i mask66 = _mm256_set1_epi64x(0x6666666666666666ull);
+	const __m256i mask11 = _mm256_set1_epi64x(0x1111111111111110ull);
+	const __m256i maskSg = _mm256_set1_epi64x(0x8000000000000000ull);
+	const __m256i maskFF = _mm256_set1_epi64x(-1);
+	const __m256i one = _mm256_set1_epi64x(1);
+	const __m256i shiftC = _mm256_set_epi64x(3, 2, 1, 0);
+	const __m256i shiftCo = _mm256_set_epi64x(4, 3, 2, 1);
+
+	const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pIn);
+	unsigned cr = carry;
+
+	size_t i = 0;
+	for (; i + 4 <= wordC; i += 4)
+	{
+		// 32 байта обратного числа: цифры с индексами от end - 64 до end - 1, где end = len - 16 * i
+		__m256i rev;
+		if (ODD)
+		{
+			const uint8_t* p = pBytes + (len - 16 * i - 65) / 2;
+			const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+			rev = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(x, 4), mask0f),
+				_mm256_andnot_si256(mask0f, _mm256_slli_epi16(y, 4)));
+		} else
+			rev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBytes + (len - 16 * i - 64) / 2));
+		rev = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(rev, maskBs), 0x4e);
+		rev = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rev, 4), mask0f),
+			_mm256_slli_epi16(_mm256_and_si256(rev, mask0f), 4));
+
+		const __m256i t1 = _mm256_add_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIn + i)), mask66);
+		__m256i sum = _mm256_add_epi64(t1, rev);
+
+		// Признаки G и P для каждого из 4 слов и маска переносов в слова (биты 0..3) и из старшего слова (бит 4)
+		const unsigned g = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(
+			_mm256_xor_si256(t1, maskSg), _mm256_xor_si256(sum, maskSg))));
+		const unsigned p = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(sum, maskFF)));
+		const unsigned c = (((g << 1) | cr) + p) ^ p;
+		const __m256i cv = _mm256_set1_epi64x(c);
+
+		sum = _mm256_add_epi64(sum, _mm256_and_si256(_mm256_srlv_epi64(cv, shiftC), one));
+		const __m256i co = _mm256_and_si256(_mm256_srlv_epi64(cv, shiftCo), one);
+
+		// Из тетрад, в которых не было переполнения, вычитаем 6
+		const __m256i carries = _mm256_xor_si256(_mm256_xor_si256(sum, t1), rev);
+		const __m256i noCarry = _mm256_or_si256(_mm256_srli_epi64(_mm256_andnot_si256(carries, mask11), 4),
+			_mm256_slli_epi64(_mm256_xor_si256(co, one), 60));
+		sum = _mm256_sub_epi64(sum, _mm256_add_epi64(_mm256_slli_epi64(noCarry, 2), _mm256_slli_epi64(noCarry, 1)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pOut + i), sum);
+
+		cr = c >> 4;
+	}
+
+	_mm256_zeroupper();
+	carry = static_cast<uint8_t>(cr);
+	return i;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+static inline uint64_t GetDigitMask(size_t len)
+{
+	// Маска для последнего слова числа длиной len цифр
+	return (len & 15) ? (1ull << 4 * (len & 15)) - 1 : ~0ull;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<class F, size_t... I>
+static inline void UnrollWords(F&& f, std::index_sequence<I...>)
+{
+	(f(I), ...);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t C, class F>
+static inline void UnrollWords(F&& f)
+{
+	// Вызывает f(i) для i = 0...C-1. Циклы по словам ShortNumber разворачиваются при компиляции, чтобы
+	// индексы слов были константами, и компилятор мог хранить все слова в регистрах, а не в памяти
+	UnrollWords(f, std::make_index_sequence<C>());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+static inline void ReverseWords(const uint64_t* w, size_t len, uint64_t* revA)
+{
+	// Записывает в revA число, обратное числу длиной len цифр в словах w (N / 16 слов). Разворачиваем все
+	// N цифр (слово i - это развёрнутое слово N / 16 - 1 - i) и сдвигаем результат вправо на N - len цифр.
+	// Сдвиг ((hi << 1) << (63 - bitShift)) корректен и при bitShift == 0
+	constexpr size_t WORD_C = N / 16;
+	uint64_t r[WORD_C + 1];
+	UnrollWords<WORD_C>([&](size_t i) { r[i] = ReverseDigits(w[WORD_C - 1 - i]); });
+	r[WORD_C] = 0;
+
+	// Сдвиг на целые слова выполняем по битам wordShift (сдвигами на 1, 2, 4... слова)
+	const size_t shift = 4 * (N - len);
+	const size_t wordShift = shift / 64;
+	const size_t bitShift = shift & 63;
+	for (size_t ws = 1; ws < WORD_C; ws *= 2)
+	{
+		const bool doShift = (wordShift & ws) != 0;
+		UnrollWords<WORD_C>([&](size_t i) { r[i] = doShift ? ((i + ws < WORD_C) ? r[i + ws] : 0) : r[i]; });
+	}
+
+	UnrollWords<WORD_C>([&](size_t i) {
+		const uint64_t lo = r[i], hi = r[i + 1];
+		revA[i] = (lo >> bitShift) | ((hi << 1) << (63 - bitShift));
+	});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   PackedNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t PackedNumber::s_ZeroDigits[GUARD_WORD_C + 1] = { 0 };
+
+//----------------------------------------------------------------------------------------------------------------------
+PackedNumber::~PackedNumber()
+{
+	if (m_MaxLength)
+	{
+		FreeBuffer(m_pDigits);
+		FreeBuffer(m_pRAABuffer);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PackedNumber::SetZero()
+{
+	m_Length = 1;
+	if (m_MaxLength)
+		m_pDigits[0] = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PackedNumber::Set(unsigned long long num)
+{
+	if (m_MaxLength < 20)
+		Allocate(20, false);
+
+	m_pDigits[0] = m_pDigits[1] = 0;
+	size_t len = 0;
+	do {
+		m_pDigits[len / 16] |= (num % 10) << 4 * (len & 15);
+		num /= 10;
+		++len;
+	} while (num);
+	m_Length = len;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PackedNumber::Set(const Number& num)
+{
+	const size_t len = num.m_Length;
+	if (len > m_MaxLength)
+		Allocate(len, false);
+
+	const uint8_t* p = num.m_DigitA;
+	for (size_t i = 0, wordC = (len + 15) / 16; i < wordC; ++i)
+	{
+		uint64_t w = 0;
+		for (size_t j = 0, k = 16 * i; j < 16 && k < len; ++j, ++k)
+			w |= static_cast<uint64_t>(p[k]) << 4 * j;
+		m_pDigits[i] = w;
+	}
+	m_Length = len;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PackedNumber::Reserve(size_t maxLength)
+{
+	if (maxLength > m_MaxLength)
+		Allocate(maxLength, true);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned PackedNumber::GetHash() const
+{
+	constexpr uint32_t FNV_SEED = 0x811c9dc5;
+	constexpr uint32_t FNV_PRIME = 0x01000193;
+
+	uint32_t hash = FNV_SEED;
+	for (size_t i = 0; i < m_Length; i += 16)
+	{
+		uint64_t w = m_pDigits[i / 16];
+		for (size_t j = (m_Length - i < 16) ? m_Length - i : 16; j; --j, w >>= 4)
+			hash = (hash ^ static_cast<uint32_t>(w & 0x0f)) * FNV_PRIME;
+	}
+	return hash;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::string PackedNumber::AsString() const
+{
+	std::string s(m_Length, '0');
+	for (size_t i = 0; i < m_Length; ++i)
+		s[m_Length - 1 - i] += (m_pDigits[i / 16] >> 4 * (i & 15)) & 0x0f;
+
+	return s;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+BigNumber PackedNumber::AsNumber() const
+{
+	BigNumber num;
+	num.Allocate(static_cast<uint32_t>(m_Length));
+	num.m_Length = static_cast<uint32_t>(m_Length);
+
+	uint8_t* p = num.m_DigitA;
+	for (size_t i = 0; i < m_Length; ++i)
+		p[i] = (m_pDigits[i / 16] >> 4 * (i & 15)) & 0x0f;
+
+	return num;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool PackedNumber::RAATillPalindrome(unsigned stepC, unsigned& doneC)
+{
+	unsigned count = m_MaxLength ? RAA(stepC, true) : 1;
+	doneC = count ? count : stepC;
+	return count != 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool PackedNumber::RAATillLength(size_t length, unsigned& doneC)
+{
+	doneC = 0;
+	if (m_Length < length)
+	{
+		if (!m_MaxLength)
+		{
+			doneC = 1;
+			return true;
+		}
+
+		while (m_Length < length)
+		{
+			// Количество операций RAA для достижения нужной длины оцениваем так же, как и в BigNumber::RAATillLength
+			unsigned stepC = static_cast<unsigned>(std::min<size_t>(length - m_Length, 0x40000000));
+			stepC = (stepC > 4) ? 2 * stepC - 2 : stepC + stepC / 4;
+
+			if (unsigned count = RAA(stepC, true))
+			{
+				doneC += count;
+				return true;
+			}
+			doneC += stepC;
+		}
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool PackedNumber::operator ==(const PackedNumber& rhs) const
+{
+	if (m_Length != rhs.m_Length)
+		return false;
+
+	const size_t wordC = (m_Length + 15) / 16;
+	for (size_t i = 0; i < wordC - 1; ++i)
+	{
+		if (m_pDigits[i] != rhs.m_pDigits[i])
+			return false;
+	}
+	return !((m_pDigits[wordC - 1] ^ rhs.m_pDigits[wordC - 1]) & GetDigitMask(m_Length));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+AML_NOINLINE void PackedNumber::Set(const char* pStr, size_t size)
+{
+	if (!size)
+		OnError("Empty string");
+
+	// Пропустим ноли в старших разрядах
+	while (*pStr == '0' && size > 1)
+		++pStr, --size;
+
+	if (size > m_MaxLength)
+		Allocate(size, false);
+
+	const char* p = pStr + size;
+	for (size_t i = 0, wordC = (size + 15) / 16; i < wordC; ++i)
+	{
+		uint64_t w = 0;
+		for (size_t j = 0, k = 16 * i; j < 16 && k < size; ++j, ++k)
+		{
+			const char c = *(--p);
+			if (c < '0' || c > '9')
+			{
+				SetZero();
+				OnError("Not a valid number");
+			}
+			w |= static_cast<uint64_t>(c - '0') << 4 * j;
+		}
+		m_pDigits[i] = w;
+	}
+	m_Length = size;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+AML_NOINLINE void PackedNumber::Allocate(size_t maxLength, bool copy)
+{
+	if (maxLength > (~size_t(0) >> 2) - 64)
+		OnError("Length is too big");
+
+	// Длину округляем до целого количества слов. Дополнительное слово в конце буфера используется
+	// для цифры переноса, возникающей при операции RAA, когда длина числа кратна 16
+	maxLength = (maxLength + 15) & ~size_t(15);
+	const size_t wordC = maxLength / 16 + 1;
+
+	uint64_t* pDigits = AllocateBuffer(wordC);
+	uint64_t* pRAABuffer = AllocateBuffer(wordC);
+
+	if (copy)
+		memcpy(pDigits, m_pDigits, 8 * ((m_Length + 15) / 16));
+	else
+		m_Length = 1, pDigits[0] = 0;
+
+	if (m_MaxLength)
+	{
+		FreeBuffer(m_pDigits);
+		FreeBuffer(m_pRAABuffer);
+	}
+
+	m_pDigits = pDigits;
+	m_pRAABuffer = pRAABuffer;
+	m_MaxLength = maxLength;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t* PackedNumber::AllocateBuffer(size_t wordC)
+{
+	uint64_t* p = new uint64_t[GUARD_WORD_C + wordC];
+	for (size_t i = 0; i < GUARD_WORD_C; ++i)
+		p[i] = 0;
+
+	return p + GUARD_WORD_C;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PackedNumber::FreeBuffer(uint64_t* pDigits)
+{
+	delete[] (pDigits - GUARD_WORD_C);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool PackedNumber::IsPalindrome(const uint64_t* pDigits, size_t len)
+{
+	// Сравниваем слова младшей половины числа с соответствующими словами обратного числа
+	const size_t wordC = (len + 31) / 32;
+	const size_t lastWord = (len - 1) / 16;
+	for (size_t i = 0; i < wordC; ++i)
+	{
+		const uint64_t w = (i == lastWord) ? pDigits[i] & GetDigitMask(len) : pDigits[i];
+		const uint64_t r = (len & 1) ? LoadReversed<true>(pDigits, len - 16 * i) :
+			LoadReversed<false>(pDigits, len - 16 * i);
+		if (w != r)
+			return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+AML_NOINLINE void PackedNumber::OnError(const char* pMsg)
+{
+	throw util::ELogic(pMsg ? pMsg : "Unknown error");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned PackedNumber::RAA(unsigned stepC, bool stopOnPalindrome)
+{
+	const bool useAVX2 = BigNumber::GetRAAKernel() != BigNumber::RAAKernel::SSSE3;
+
+	unsigned doneC = 0;
+	for (unsigned step = 1; step <= stepC; ++step)
+	{
+		// Перенос в старшем разряде может увеличить длину числа на 1 цифру
+		if (m_Length >= m_MaxLength)
+			Allocate(m_Length + 1024, true);
+
+		const size_t len = m_Length;
+		const size_t lastWord = (len - 1) / 16;
+		const uint64_t* pIn = m_pDigits;
+		uint64_t* pOut = m_pRAABuffer;
+
+		// Все слова, кроме последнего, складываем без маскирования. Если процессор поддерживает AVX2 (и
+		// для BigNumber не выбрана SSSE3-версия операции RAA), то большая их часть обрабатывается векторно
+		uint8_t carry = 0;
+		if (len & 1)
+		{
+			size_t i = useAVX2 ? RAAPackedAVX2<true>(pIn, pOut, len, lastWord, carry) : 0;
+			for (; i < lastWord; ++i)
+				carry = AddBCD(pIn[i], LoadReversed<true>(pIn, len - 16 * i), carry, pOut[i]);
+			carry = AddBCD(pIn[lastWord] & GetDigitMask(len), LoadReversed<true>(pIn, len - 16 * lastWord), carry, pOut[lastWord]);
+		} else
+		{
+			size_t i = useAVX2 ? RAAPackedAVX2<false>(pIn, pOut, len, lastWord, carry) : 0;
+			for (; i < lastWord; ++i)
+				carry = AddBCD(pIn[i], LoadReversed<false>(pIn, len - 16 * i), carry, pOut[i]);
+			carry = AddBCD(pIn[lastWord] & GetDigitMask(len), LoadReversed<false>(pIn, len - 16 * lastWord), carry, pOut[lastWord]);
+		}
+
+		// Если длина числа не кратна 16, то перенос из старшего разряда уже записан в тетраду,
+		// следующую за ним (все тетрады старше неё равны 0). Иначе он будет в переменной carry
+		if (len & 15)
+			m_Length += (pOut[lastWord] >> 4 * (len & 15)) & 1;
+		else if (carry)
+		{
+			pOut[lastWord + 1] = 1;
+			++m_Length;
+		}
+
+		m_pRAABuffer = m_pDigits;
+		m_pDigits = pOut;
+
+		if (stopOnPalindrome && IsPalindrome(m_pDigits, m_Length))
+		{
+			doneC = step;
+			break;
+		}
+	}
+
+	return doneC;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   ShortNumber
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+void ShortNumber<N>::SetZero()
+{
+	for (size_t i = 0; i < WORD_C; ++i)
+		m_Words[i] = 0;
+	m_Length = 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+template<size_t SIZE>
+void ShortNumber<N>::Set(const BasicFixNumber<SIZE>& num)
+{
+	const size_t len = num.m_Length;
+	if (len > N)
+		Number::OnError("Too big number");
+
+	// Цифры BasicFixNumber (начиная с байта 1) упакованы так же, как и у нас, но байты за их пределами не
+	// определены, поэтому копируем все байты цифр, которые могут поместиться в наши слова (копирование
+	// постоянного размера не требует вызова memcpy), и обнуляем лишние цифры маской
+	constexpr size_t BYTE_C = std::min(SIZE - 1, sizeof(m_Words));
+	uint64_t w[WORD_C] = {};
+	memcpy(w, num.m_DigitA + 1, BYTE_C);
+	for (size_t i = 0; i < WORD_C; ++i)
+		m_Words[i] = (len >= 16 * (i + 1)) ? w[i] : (len > 16 * i) ? w[i] & GetDigitMask(len) : 0;
+	m_Length = len;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+void ShortNumber<N>::Set(const Number& num)
+{
+	const size_t len = num.m_Length;
+	if (len > N)
+		Number::OnError("Too big number");
+
+	SetZero();
+	const uint8_t* p = num.m_DigitA;
+	for (size_t i = 0; i < len; ++i)
+		m_Words[i / 16] |= static_cast<uint64_t>(p[i]) << 4 * (i & 15);
+	m_Length = len;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+bool ShortNumber<N>::IsPalindrome() const
+{
+	uint64_t revA[WORD_C];
+	ReverseWords<N>(m_Words, m_Length, revA);
+	for (size_t i = 0; i < WORD_C; ++i)
+	{
+		if (revA[i] != m_Words[i])
+			return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+template<size_t SIZE>
+void ShortNumber<N>::Get(BasicFixNumber<SIZE>& num) const
+{
+	if (m_Length > num.MAX_LENGTH)
+		Number::OnError("Too big number");
+
+	// Цифры за пределами длины числа равны 0, поэтому можно скопировать все байты цифр, которые помещаются
+	// в num (байты num за пределами наших слов останутся неопределёнными, но они и не входят в длину числа)
+	num.m_Length = static_cast<uint8_t>(m_Length);
+	memcpy(num.m_DigitA + 1, m_Words, std::min(SIZE - 1, sizeof(m_Words)));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+BigNumber ShortNumber<N>::AsNumber() const
+{
+	BigNumber num;
+	num.Allocate(static_cast<uint32_t>(m_Length));
+	num.m_Length = static_cast<uint32_t>(m_Length);
+
+	uint8_t* p = num.m_DigitA;
+	for (size_t i = 0; i < m_Length; ++i)
+		p[i] = (m_Words[i / 16] >> 4 * (i & 15)) & 0x0f;
+
+	return num;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+bool ShortNumber<N>::RAATillPalindrome(unsigned stepC, unsigned& doneC)
+{
+	unsigned count = RAA(stepC, true);
+	doneC = count ? count : stepC;
+	return count != 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+bool ShortNumber<N>::RAATillLength(size_t length, unsigned& doneC)
+{
+	doneC = 0;
+	while (m_Length < length)
+	{
+		// Количество операций RAA для достижения нужной длины оцениваем так же, как и в BigNumber::RAATillLength
+		unsigned stepC = static_cast<unsigned>(std::min<size_t>(length - m_Length, 0x40000000));
+		stepC = (stepC > 4) ? 2 * stepC - 2 : stepC + stepC / 4;
+
+		if (unsigned count = RAA(stepC, true))
+		{
+			doneC += count;
+			return true;
+		}
+		doneC += stepC;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+size_t ShortNumber<N>::GetRAALengthBound(size_t len, size_t length)
+{
+	// Первая серия из 2 * diff - 2 операций (при diff > 4) может удлинить число на diff - 2 цифры сверх length,
+	// серия из 5 операций (при diff == 4) - на 1 цифру. Последующие серии короче, и их превышение не больше
+	const size_t diff = (len < length) ? length - len : 0;
+	return diff ? length + ((diff > 4) ? diff - 2 : diff / 4) : len;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+bool ShortNumber<N>::operator ==(const ShortNumber& rhs) const
+{
+	if (m_Length != rhs.m_Length)
+		return false;
+
+	for (size_t i = 0; i < WORD_C; ++i)
+	{
+		if (m_Words[i] != rhs.m_Words[i])
+			return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+unsigned ShortNumber<N>::RAA(unsigned stepC, bool stopOnPalindrome)
+{
+	// Работаем с локальными копиями слов числа: после развёртки циклов они размещаются в регистрах
+	uint64_t w[WORD_C], revA[WORD_C];
+	UnrollWords<WORD_C>([&](size_t i) { w[i] = m_Words[i]; });
+	size_t len = m_Length;
+	ReverseWords<N>(w, len, revA);
+
+	unsigned result = 0;
+	for (unsigned step = 1; step <= stepC; ++step)
+	{
+		uint8_t carry = 0;
+		UnrollWords<WORD_C>([&](size_t i) { carry = AddBCD(w[i], revA[i], carry, w[i]); });
+
+		// Перенос из старшего разряда записан в следующую за ним тетраду (если она есть)
+		if (len < N)
+		{
+			uint64_t top = 0;
+			UnrollWords<WORD_C>([&](size_t i) { top |= (i == len / 16) ? w[i] : 0; });
+			len += (top >> 4 * (len & 15)) & 1;
+		}
+		else if (carry)
+			Number::OnError("Too big number");
+
+		// Обратное число нужно для следующей операции, поэтому проверка на палиндром ничего не стоит
+		ReverseWords<N>(w, len, revA);
+		if (stopOnPalindrome)
+		{
+			uint64_t diff = 0;
+			UnrollWords<WORD_C>([&](size_t i) { diff |= revA[i] ^ w[i]; });
+			if (!diff)
+			{
+				result = step;
+				break;
+			}
+		}
+	}
+
+	UnrollWords<WORD_C>([&](size_t i) { m_Words[i] = w[i]; });
+	m_Length = len;
+	return result;
+}
+
+// Явное инстанцирование для чисел длиной до 128 и 256 бит
+template class ShortNumber<32>;
+template class ShortNumber<64>;
+
+template void ShortNumber<32>::Set(const FixNumber& num);
+template void ShortNumber<32>::Set(const WideFixNumber& num);
+template void ShortNumber<64>::Set(const FixNumber& num);
+template void ShortNumber<64>::Set(const WideFixNumber& num);
+
+template void ShortNumber<32>::Get(FixNumber& num) const;
+template void ShortNumber<32>::Get(WideFixNumber& num) const;
+template void ShortNumber<64>::Get(FixNumber& num) const;
+template void ShortNumber<64>::Get(WideFixNumber& num) const;
@@ -0,0 +1,177 @@
+﻿//∙MDPN
+#pragma once
+
+#include "number.h"
+
+#include <core/platform.h>
+#include <core/util.h>
+
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   PackedNumber - длинное число, хранящее по 2 цифры в байте (упакованный BCD)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Класс предназначен для задач вроде "проблемы 196", где длина числа достигает десятков миллионов цифр. По сравнению
+// с BigNumber он требует вдвое меньше памяти и, соответственно, вдвое меньшего объёма данных, передаваемых между
+// памятью и процессором за одну операцию RAA. Для чисел, не помещающихся в кеш L2, это заметно выгоднее, чем
+// использование векторных инструкций. Для коротких чисел класс BigNumber остаётся более быстрым
+
+//----------------------------------------------------------------------------------------------------------------------
+class PackedNumber
+{
+	AML_NONCOPYABLE(PackedNumber)
+
+public:
+	PackedNumber() = default;
+	PackedNumber(const char* pNum) { Set(pNum); }
+	PackedNumber(const std::string& num) { Set(num); }
+	PackedNumber(const Number& num) { Set(num); }
+	~PackedNumber();
+
+	void SetZero();
+	void Set(unsigned long long num);
+	void Set(const char* pNum) { Set(pNum, pNum ? strlen(pNum) : 0); }
+	void Set(const std::string& num) { Set(num.c_str(), num.size()); }
+	void Set(const Number& num);
+
+	// Выделяет память, достаточную для хранения числа, состоящего из maxLength цифр.
+	// Также будет выделен временный буфер для операции RAA (такого же размера)
+	void Reserve(size_t maxLength);
+
+	// Возвращает true, если число равно 0
+	bool IsZero() const { return m_Length == 1 && !(m_pDigits[0] & 0x0f); }
+	// Возвращает true, если число является палиндромом
+	bool IsPalindrome() const { return IsPalindrome(m_pDigits, m_Length); }
+
+	// Возвращает длину числа (количество цифр)
+	size_t GetLength() const { return m_Length; }
+	// Возвращает 32-битный хеш числа (совпадает с хешем Number с тем же значением)
+	unsigned GetHash() const;
+
+	// Преобразует число в строку
+	std::string AsString() const;
+	// Преобразует число в формат BigNumber
+	BigNumber AsNumber() const;
+
+	// Добавляет к числу обратное ему число (Reverse-And-Add) stepС раз
+	void ReverseAndAdd(unsigned stepC = 1) { if (m_MaxLength) RAA(stepC, false); }
+	// Выполняет над числом операцию Reverse-And-Add до тех пор, пока оно не станет палиндромом, или
+	// не будет выполнено stepC операций. Поведение аналогично функции BigNumber::RAATillPalindrome
+	bool RAATillPalindrome(unsigned stepC, unsigned& doneC);
+	// Выполняет над числом операцию Reverse-And-Add до тех пор, пока оно не станет палиндромом, или не
+	// достигнет длины length цифр. Поведение аналогично функции BigNumber::RAATillLength
+	bool RAATillLength(size_t length, unsigned& doneC);
+
+	PackedNumber& operator =(const char* pNum) { Set(pNum); return *this; }
+	PackedNumber& operator =(const std::string& num) { Set(num); return *this; }
+	PackedNumber& operator =(const Number& num) { Set(num); return *this; }
+
+	bool operator ==(const PackedNumber& rhs) const;
+	bool operator !=(const PackedNumber& rhs) const { return !(*this == rhs); }
+
+protected:
+	// Количество нулевых 64-битных слов, расположенных перед цифрами числа в каждом из буферов. Они
+	// позволяют при формировании обратного числа читать память перед младшими разрядами без проверок
+	static constexpr size_t GUARD_WORD_C = 1;
+
+	void Set(const char* pStr, size_t size);
+	void Allocate(size_t maxLength, bool copy);
+	static uint64_t* AllocateBuffer(size_t wordC);
+	static void FreeBuffer(uint64_t* pDigits);
+
+	static bool IsPalindrome(const uint64_t* pDigits, size_t len);
+	static void OnError(const char* pMsg = nullptr);
+
+	// Если stopOnPalindrome равен false, то функция выполнит ровно stepC операций RAA и вернёт 0. Если
+	// stopOnPalindrome равен true, то функция выполнит не более stepC шагов до нахождения палиндрома.
+	// Если палиндром был получен, то функция вернёт количество выполненных шагов, иначе вернёт 0
+	unsigned RAA(unsigned stepC, bool stopOnPalindrome);
+
+	static uint64_t s_ZeroDigits[GUARD_WORD_C + 1];
+
+	size_t m_Length = 1;				// Длина числа (количество цифр)
+	size_t m_MaxLength = 0;				// Макс. допустимое количество цифр в буферах m_pDigits и m_pRAABuffer
+	// Цифры числа, по 16 в 64-битном слове, от младшего разряда к старшему (младшая цифра
+	// находится в младших 4 битах слова). Цифры за пределами длины числа не определены
+	uint64_t* m_pDigits = s_ZeroDigits + GUARD_WORD_C;
+	uint64_t* m_pRAABuffer = nullptr;	// Временный буфер для операции RAA (такого же размера)
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   ShortNumber - число фиксированной максимальной длины N цифр в упакованном BCD (без выделения памяти)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Число хранится в N / 16 64-битных словах (128 бит для N = 32, 256 бит для N = 64) в том же формате, что и
+// PackedNumber. Класс предназначен для коротких чисел, над которыми выполняется немного операций RAA (например,
+// для кандидатов в режиме поиска, доводимых до длины отсева): одна операция RAA здесь - это разворот нескольких
+// слов (перестановка байтов и тетрад и сдвиг на количество незанятых цифр) и их сложение. Формат совпадает с
+// форматом цифр FixNumber и WideFixNumber, поэтому преобразования между этими классами сводятся к копированию байтов
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+class ShortNumber
+{
+	static_assert(N && N % 16 == 0, "Invalid number of digits");
+
+public:
+	static constexpr size_t MAX_LENGTH = N;	// Максимальная длина числа
+
+	ShortNumber() = default;
+	template<size_t SIZE>
+	ShortNumber(const BasicFixNumber<SIZE>& num) { Set(num); }
+	ShortNumber(const Number& num) { Set(num); }
+
+	void SetZero();
+	template<size_t SIZE> void Set(const BasicFixNumber<SIZE>& num);
+	void Set(const Number& num);
+
+	// Возвращает true, если число является палиндромом
+	bool IsPalindrome() const;
+	// Возвращает длину числа (количество цифр)
+	size_t GetLength() const { return m_Length; }
+
+	// Копирует число в num. Если длина числа больше, чем вмещает num, то будет выброшено исключение
+	template<size_t SIZE> void Get(BasicFixNumber<SIZE>& num) const;
+	// Преобразует число в формат BigNumber
+	BigNumber AsNumber() const;
+
+	// Добавляет к числу обратное ему число (Reverse-And-Add) stepС раз
+	void ReverseAndAdd(unsigned stepC = 1) { RAA(stepC, false); }
+	// Выполняет над числом операцию Reverse-And-Add до тех пор, пока оно не станет палиндромом, или
+	// не будет выполнено stepC операций. Поведение аналогично функции BigNumber::RAATillPalindrome
+	bool RAATillPalindrome(unsigned stepC, unsigned& doneC);
+	// Выполняет над числом операцию Reverse-And-Add до тех пор, пока оно не станет палиндромом, или не
+	// достигнет длины length цифр. Поведение аналогично функции BigNumber::RAATillLength. Если длина
+	// числа должна превысить N цифр, то будет выброшено исключение (см. функцию GetRAALengthBound)
+	bool RAATillLength(size_t length, unsigned& doneC);
+
+	// Возвращает наибольшую длину, которой может достичь число длиной len цифр при вызове функции
+	// RAATillLength(length): длина числа за 1 операцию RAA увеличивается не более чем на 1 цифру, а
+	// количество операций в каждой серии известно. Если результат не больше N, то исключения не будет
+	static size_t GetRAALengthBound(size_t len, size_t length);
+
+	template<size_t SIZE>
+	ShortNumber& operator =(const BasicFixNumber<SIZE>& num) { Set(num); return *this; }
+	ShortNumber& operator =(const Number& num) { Set(num); return *this; }
+
+	bool operator ==(const ShortNumber& rhs) const;
+	bool operator !=(const ShortNumber& rhs) const { return !(*this == rhs); }
+
+protected:
+	static constexpr size_t WORD_C = N / 16;
+
+	// Если stopOnPalindrome равен false, то функция выполнит ровно stepC операций RAA и вернёт 0. Если
+	// stopOnPalindrome равен true, то функция выполнит не более stepC шагов до нахождения палиндрома.
+	// Если палиндром был получен, то функция вернёт количество выполненных шагов, иначе вернёт 0
+	unsigned RAA(unsigned stepC, bool stopOnPalindrome);
+
+	// Цифры числа, по 16 в 64-битном слове, от младшего разряда к старшему (младшая
+	// цифра находится в младших 4 битах слова). Цифры за пределами длины числа равны 0
+	uint64_t m_Words[WORD_C] = {};
+	size_t m_Length = 1;			// Длина числа (количество цифр)
+};
@@ -0,0 +1,49 @@
+﻿//∙MDPN
+#include "pch.h"
+#include "packmode.h"
+
+#include "dbase.h"
+#include "log.h"
+
+#include <core/auxutil.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+bool PackMode::Run()
+{
+	// Команда "pack" - перенос отдельных файлов БД в сегменты (см. DBPack) с уплотнением разреженных сегментов.
+	// Опция "--unpack" выполняет обратное: переносит все файлы из сегментов в отдельные файлы и удаляет сегменты
+	if (!CheckOptions({ "unpack" }))
+		return false;
+	if (m_Params.size() != 1)
+	{
+		OnInvalidCmdLine();
+		return false;
+	}
+	const bool unpack = GetOption("unpack");
+
+	if (!m_Data.Init(false, DBChunkState::HEADERONLY))
+	{
+		aux::Print("Database not found, exiting...\n");
+		return false;
+	}
+
+	SystemLog::SetPath(m_Data.GetBasePath() + L"log.txt");
+	PrintDatabasePath(m_Data.GetBasePath(), 46);
+
+	const size_t packedC = m_Data.GetPackedChunkC();
+	const bool result = unpack ? m_Data.UnpackChunks("Unpacking files: %.1f%%...") :
+		m_Data.PackChunks("Packing files: %.1f%%...");
+
+	if (!result)
+		aux::Printf("#12Error: #7failed to %s database files\n", unpack ? "unpack" : "pack");
+	else if (!unpack)
+	{
+		aux::Printf("Files packed/total: %u/%u in %u segment(s)\n", m_Data.GetPackedChunkC(),
+			m_Data.GetChunkC(), m_Data.GetSegmentC());
+	}
+	else
+		aux::Printf("Files unpacked: %u\n", packedC);
+
+	SystemLog::Instance().Close();
+	return result;
+}
@@ -0,0 +1,19 @@
+﻿//∙MDPN
+#pragma once
+
+#include "dbmode.h"
+
+#include <core/platform.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   PackMode - перенос файлов БД в сегменты и обратно (режим работы программы)
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+class PackMode final : public DBMode
+{
+public:
+	virtual bool Run() override;
+};
@@ -6,16 +6,24 @@
 #include "const.h"
 #include "dbchunk.h"
 #include "eventmgr.h"
+#include "largemempages.h"
 #include "log.h"
+#include "numbatch.h"
+#include "packednum.h"
 #include "ttime.h"
 #include "util.h"
 
 #include <core/auxutil.h>
 #include <core/console.h>
+#include <core/crc32.h>
+#include <core/file.h>
+#include <core/filesystem.h>
 #include <core/strutil.h>
 #include <core/winapi.h>
 
+#include <chrono>
 #include <intrin.h>
+#include <stddef.h>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
@@ -69,10 +77,27 @@ std::mutex& SearchModeClasses::Queue::LockMutex(size_t spinCount)
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Реализация очереди основана на статье "Correct and Efficient Work-Stealing for Weak Memory Models" (N. M. Le и др.,
+// 2013). Так как все задания создаёт главный поток, то очередь одна, и её владельцем является главный поток. Рабочие
+// потоки извлекают задания со стороны m_Top, т.е. в порядке их создания, что уменьшает задержку в очереди результатов
+
 //----------------------------------------------------------------------------------------------------------------------
 SearchModeClasses::TaskQueue::TaskQueue(WorkThreads& workThreads)
 	: m_WorkThreads(workThreads)
+	, m_Tasks(new std::atomic<NumberBlock*>[CAPACITY])
+{
+	static_assert(CAPACITY && !(CAPACITY & (CAPACITY - 1)), "CAPACITY must be a power of 2");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+SearchModeClasses::TaskQueue::~TaskQueue()
 {
+	const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+	for (int64_t i = m_Top.load(std::memory_order_relaxed); i < bottom; ++i)
+	{
+		NumberBlock* pBlock = m_Tasks[i & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		AML_SAFE_DELETE(pBlock);
+	}
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -80,48 +105,71 @@ void SearchModeClasses::TaskQueue::PushTask(NumberBlock* pBlock)
 {
 	if (pBlock)
 	{
-		size_t taskC;
-		{
-			MutexLock lock(this);
+		const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+		const int64_t top = m_Top.load(std::memory_order_acquire);
+		Assert(bottom - top < static_cast<int64_t>(CAPACITY));
 
-			m_Queue.push_back(pBlock);
-			// NB: внутри критической секции атомарность инкремента
-			// не нужна, поэтому избегаем лишних блокировок шины
-			taskC = m_TaskC.load(std::memory_order_relaxed);
-			m_TaskC.store(taskC + 1, std::memory_order_relaxed);
-		}
+		m_Tasks[bottom & (CAPACITY - 1)].store(pBlock, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
 
 		// Если в очереди накопилось 10 и более заданий в расчёте на каждый активный поток,
 		// то разбудим один из них сразу. В ином случае поток будет разбужен по таймеру
+		const size_t taskC = static_cast<size_t>(bottom - top);
 		if (taskC >= 10 * m_WorkThreads.GetActiveC())
 			m_CV.notify_one();
 	}
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-SearchModeClasses::NumberBlock* SearchModeClasses::TaskQueue::PopTask(bool waitIfNoTask)
+SearchModeClasses::NumberBlock* SearchModeClasses::TaskQueue::StealTask(bool waitIfNoTask)
 {
-	MutexLock lock(this);
-
-	if (m_Queue.empty())
+	bool isEmpty;
+	for (size_t attempt = 0;; ++attempt)
 	{
-		if (!waitIfNoTask)
+		if (NumberBlock* pBlock = TrySteal(isEmpty))
+			return pBlock;
+
+		if (!isEmpty)
+		{
+			// Задание перехватил другой поток, но в очереди есть ещё задания
+			_mm_pause();
+			continue;
+		}
+
+		if (!waitIfNoTask || attempt)
 			return nullptr;
 
+		std::unique_lock<std::mutex> lock(m_Mutex);
 		m_CV.wait_for(lock, std::chrono::milliseconds(35));
-		if (m_Queue.empty())
-			return nullptr;
 	}
+}
 
-	NumberBlock* pBlock = m_Queue.front();
-	// NB: внутри критической секции атомарность декремента
-	// не нужна, поэтому избегаем лишних блокировок шины
-	const size_t taskC = m_TaskC.load(std::memory_order_relaxed);
-	m_TaskC.store(taskC - 1, std::memory_order_relaxed);
-	m_Queue.pop_front();
+//----------------------------------------------------------------------------------------------------------------------
+SearchModeClasses::NumberBlock* SearchModeClasses::TaskQueue::TrySteal(bool& isEmpty)
+{
+	int64_t top = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+
+	isEmpty = top >= bottom;
+	if (isEmpty)
+		return nullptr;
+
+	NumberBlock* pBlock = m_Tasks[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
 	return pBlock;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+size_t SearchModeClasses::TaskQueue::GetTaskC() const
+{
+	const int64_t top = m_Top.load(std::memory_order_relaxed);
+	const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+	return (bottom > top) ? static_cast<size_t>(bottom - top) : 0;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void SearchModeClasses::TaskQueue::WakeThread(bool all)
 {
@@ -140,34 +188,58 @@ void SearchModeClasses::TaskQueue::WakeThread(bool all)
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Очередь результатов - кольцевой буфер ячеек, в котором блок с номером id хранится в ячейке id % CAPACITY.
+// Главный поток ждёт блоки строго по порядку, поэтому проверяет только одну ячейку, а рабочие потоки пишут
+// каждый в свою ячейку, и никакой другой синхронизации, кроме атомарности записи указателя, не требуется
+
+//----------------------------------------------------------------------------------------------------------------------
+SearchModeClasses::WorkQueue::WorkQueue()
+	: m_Works(new std::atomic<NumberBlock*>[CAPACITY])
+{
+	static_assert(CAPACITY && !(CAPACITY & (CAPACITY - 1)), "CAPACITY must be a power of 2");
+
+	for (size_t i = 0; i < CAPACITY; ++i)
+		m_Works[i].store(nullptr, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+SearchModeClasses::WorkQueue::~WorkQueue()
+{
+	for (size_t i = 0; i < CAPACITY; ++i)
+	{
+		NumberBlock* pBlock = m_Works[i].load(std::memory_order_relaxed);
+		AML_SAFE_DELETE(pBlock);
+	}
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void SearchModeClasses::WorkQueue::PushWork(NumberBlock* pBlock)
 {
 	if (pBlock)
 	{
-		MutexLock lock(this);
-
-		m_Queue.push_back(pBlock);
-		m_HasWorks.store(true, std::memory_order_relaxed);
+		std::atomic<NumberBlock*>& slot = m_Works[pBlock->id & (CAPACITY - 1)];
+		Assert(!slot.load(std::memory_order_relaxed));
+		slot.store(pBlock, std::memory_order_release);
 	}
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-SearchModeClasses::NumberBlock* SearchModeClasses::WorkQueue::PopWork()
+SearchModeClasses::NumberBlock* SearchModeClasses::WorkQueue::PopWork(uint64_t id)
 {
-	if (m_HasWorks.load(std::memory_order_relaxed))
+	std::atomic<NumberBlock*>& slot = m_Works[id & (CAPACITY - 1)];
+	NumberBlock* pBlock = slot.load(std::memory_order_acquire);
+	if (pBlock)
 	{
-		MutexLock lock(this);
-
-		if (size_t count = m_Queue.size())
-		{
-			NumberBlock* pBlock = m_Queue.front();
-			m_HasWorks.store(count > 1, std::memory_order_relaxed);
-			m_Queue.pop_front();
-			return pBlock;
-		}
+		Assert(pBlock->id == id);
+		slot.store(nullptr, std::memory_order_relaxed);
 	}
-	return nullptr;
+	return pBlock;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SearchModeClasses::WorkQueue::HasWork(uint64_t id) const
+{
+	return m_Works[id & (CAPACITY - 1)].load(std::memory_order_relaxed) != nullptr;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -227,6 +299,36 @@ SearchModeClasses::NumberBlock* SearchModeClasses::DBQueue::PopTask(unsigned& st
 	return pBlock;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+void SearchModeClasses::DBQueue::PushWork(NumberBlock* pBlock)
+{
+	if (pBlock)
+	{
+		MutexLock lock(this);
+
+		m_Queue.push_back(pBlock);
+		m_HasWorks.store(true, std::memory_order_relaxed);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+SearchModeClasses::NumberBlock* SearchModeClasses::DBQueue::PopWork()
+{
+	if (m_HasWorks.load(std::memory_order_relaxed))
+	{
+		MutexLock lock(this);
+
+		if (size_t count = m_Queue.size())
+		{
+			NumberBlock* pBlock = m_Queue.front();
+			m_HasWorks.store(count > 1, std::memory_order_relaxed);
+			m_Queue.pop_front();
+			return pBlock;
+		}
+	}
+	return nullptr;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void SearchModeClasses::DBQueue::WakeThread()
 {
@@ -240,6 +342,8 @@ void SearchModeClasses::DBQueue::WakeThread()
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+std::vector<SearchModeClasses::WorkThreads::CPUGroup> SearchModeClasses::WorkThreads::s_CPUGroups;
+
 //----------------------------------------------------------------------------------------------------------------------
 SearchModeClasses::WorkThreads::WorkThreads(SearchMode* pOwner)
 	: m_Owner(*pOwner)
@@ -271,8 +375,10 @@ void SearchModeClasses::WorkThreads::AddRemove(int count)
 				m_ThreadTimeA[i] = 0;
 				ThreadInfo& info = m_ThreadA[i];
 
+				info.cpuTime = 0;
 				info.isActive = false;
 				info.isStopping = false;
+				info.isWakeRequested = false;
 				info.threadObj = std::thread([=]() { DoThread(i); });
 				++m_TotalThreadC;
 			}
@@ -287,50 +393,48 @@ void SearchModeClasses::WorkThreads::AddRemove(int count)
 		if (toStopC)
 		{
 			thread::CriticalSection::Lock lock(m_CS);
-			for (size_t i = 0; i < toStopC; ++i)
 			{
-				ThreadInfo& info = m_ThreadA[m_TotalThreadC - i - 1];
-				info.isStopping = true;
+				// Флаг устанавливается под мьютексом, чтобы поток, который как раз собирается
+				// приостановиться в ParkThread, либо увидел его, либо получил уведомление
+				std::lock_guard<std::mutex> parkLock(m_ParkMutex);
+				for (size_t i = 0; i < toStopC; ++i)
+					m_ThreadA[m_TotalThreadC - i - 1].isStopping = true;
 			}
+			m_ParkCV.notify_all();
+
 			for (size_t i = 0; i < toStopC; ++i)
 			{
 				ThreadInfo& info = m_ThreadA[--m_TotalThreadC];
 				if (info.threadObj.joinable())
-				{
-					// Для избежания дедлока в ситуациях, когда рабочий поток был переключен диспетчером ОС,
-					// например, между проверкой им фалага info.isStopping и установкой info.isActive или
-					// между установкой этого же флага и вызовом SuspendThread, мы будем ждать завершения
-					// потока в цикле, периодически проверяя по тайм-ауту, не был ли он приостановлен
-					while (void* pOSHandle = info.threadObj.native_handle())
-					{
-						if (!info.isActive)
-							::ResumeThread(pOSHandle);
-						if (::WaitForSingleObject(pOSHandle, 1) != WAIT_TIMEOUT)
-							break;
-					}
-					// Окончательно завершаем поток
 					info.threadObj.join();
-				}
 			}
 		}
 	}
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void SearchModeClasses::WorkThreads::CreateAll(const ThreadFn& threadFn)
+void SearchModeClasses::WorkThreads::CreateAll(const ThreadFn& threadFn, size_t threadC)
 {
 	// Функция CreateAll должна вызываться в самом начале работы. Поэтому
 	// пользовательская функция потоков и их количество должны быть не заданы
 	Assert(!m_ThreadFn && !m_TotalThreadC && threadFn);
+	// Слоты наборов ConcurrentSetBase нужны всем рабочим потокам, главному потоку и служебным потокам (поток БД и
+	// др.). Если слотов не хватит, то функция GetThreadSlotIndex выбросит исключение в рабочем потоке
+	static_assert(MAX_THREAD_C + 3 <= ConcurrentSetBase::MAX_THREAD_C, "Not enough concurrent set slots");
 
-	size_t physicalC, logicalC;
-	GetCoreC(physicalC, logicalC);
-	// Если количество физических и логических ядер процессора одинаково (т.е. CPU без HT), то рабочих
-	// потоков должно быть на 1 меньше, чем ядер, а главный поток полностью загрузит оставшееся ядро.
-	// Если CPU с HT, то обычно логических ядер будет вдвое больше. В таком случае будем использовать
-	// для рабочих потоков все логические ядра, кроме 2, которые займут главный поток и поток БД
-	const size_t threadC = (physicalC < logicalC) ? logicalC - 2 : physicalC - 1;
-	m_MaxThreadC = (threadC < MAX_THREAD_C) ? threadC : MAX_THREAD_C;
+	if (!threadC)
+	{
+		size_t physicalC, logicalC;
+		GetCoreC(physicalC, logicalC);
+		// Если количество физических и логических ядер процессора одинаково (т.е. CPU без HT), то рабочих
+		// потоков должно быть на 1 меньше, чем ядер, а главный поток полностью загрузит оставшееся ядро.
+		// Если CPU с HT, то обычно логических ядер будет вдвое больше. В таком случае будем использовать
+		// для рабочих потоков все логические ядра, кроме 2, которые займут главный поток и поток БД
+		threadC = (physicalC < logicalC) ? logicalC - 2 : physicalC - 1;
+	}
+	m_MaxThreadC = std::clamp(threadC, size_t(1), MAX_THREAD_C);
+	m_ThreadA.reset(new ThreadInfo[m_MaxThreadC]);
+	m_ThreadTimeA.reset(new uint64_t[m_MaxThreadC]);
 
 	m_ThreadFn = threadFn;
 	AddRemove(static_cast<int>(m_MaxThreadC));
@@ -339,10 +443,82 @@ void SearchModeClasses::WorkThreads::CreateAll(const ThreadFn& threadFn)
 //----------------------------------------------------------------------------------------------------------------------
 void SearchModeClasses::WorkThreads::KillAll()
 {
-	AddRemove(-static_cast<int>(MAX_THREAD_C));
+	AddRemove(-static_cast<int>(m_TotalThreadC));
 	m_ThreadFn = nullptr;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool SearchModeClasses::WorkThreads::BindToCPUs(const std::vector<uint32_t>& cpuA)
+{
+	if (cpuA.empty())
+		return true;
+
+	// Сквозной номер процессора переводим в номер группы процессоров и номер процессора в ней. Маска
+	// ограничения SetProcessAffinityMask действует только в пределах одной группы (до 64 процессоров),
+	// поэтому ограничение задаётся каждому потоку отдельно (см. функцию BindThread)
+	const WORD groupC = GetProcessorGroupC();
+	std::vector<CPUGroup> cpuGroups;
+	std::vector<uint64_t> groupMasks(groupC);
+	for (uint32_t cpu : cpuA)
+	{
+		WORD group = 0;
+		size_t index = cpu;
+		while (group < groupC && index >= GetProcessorC(group))
+			index -= GetProcessorC(group++);
+		if (group >= groupC || index >= sizeof(DWORD_PTR) * 8)
+			return false;
+
+		groupMasks[group] |= uint64_t(1) << index;
+		cpuGroups.push_back({ group, 0 });
+	}
+	// Поток может выполняться на процессорах только одной группы, поэтому маска
+	// каждого элемента включает все выбранные процессоры его группы
+	for (auto& item : cpuGroups)
+		item.mask = groupMasks[item.group];
+
+	s_CPUGroups = std::move(cpuGroups);
+	return BindThread(0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SearchModeClasses::WorkThreads::BindThread(size_t index)
+{
+	if (s_CPUGroups.empty())
+		return true;
+
+	const CPUGroup& item = s_CPUGroups[index % s_CPUGroups.size()];
+	// Функция SetThreadGroupAffinity есть только начиная с Windows 7. В более ранних версиях ОС группа
+	// процессоров всего одна, и маска задаётся функцией SetThreadAffinityMask
+	if (util::WinAPI::CanSetThreadGroupAffinity())
+	{
+		GROUP_AFFINITY affinity = {};
+		affinity.Group = item.group;
+		affinity.Mask = static_cast<KAFFINITY>(item.mask);
+		return util::WinAPI::SetThreadGroupAffinity(::GetCurrentThread(), &affinity, nullptr) != FALSE;
+	}
+	return !item.group && ::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(item.mask)) != 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t SearchModeClasses::WorkThreads::GetProcessorGroupC()
+{
+	const WORD groupC = util::WinAPI::CanGetActiveProcessorGroupCount() ?
+		util::WinAPI::GetActiveProcessorGroupCount() : 0;
+	return groupC ? groupC : 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t SearchModeClasses::WorkThreads::GetProcessorC(uint16_t group)
+{
+	if (util::WinAPI::CanGetActiveProcessorCount())
+		return util::WinAPI::GetActiveProcessorCount(group);
+
+	// До Windows 7 все процессоры находятся в группе 0
+	SYSTEM_INFO sysInfo;
+	::GetSystemInfo(&sysInfo);
+	return (group == 0 || group == ALL_PROCESSOR_GROUPS) ? sysInfo.dwNumberOfProcessors : 0;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 uint64_t SearchModeClasses::WorkThreads::GetPerfCounter()
 {
@@ -364,11 +540,13 @@ uint64_t SearchModeClasses::WorkThreads::GetPerfCounter(uint64_t& frequency)
 //----------------------------------------------------------------------------------------------------------------------
 void SearchModeClasses::WorkThreads::GetCoreC(size_t& physicalCoreC, size_t& logicalCoreC)
 {
-	SYSTEM_INFO sysInfo;
-	::GetSystemInfo(&sysInfo);
-	logicalCoreC = sysInfo.dwNumberOfProcessors ? sysInfo.dwNumberOfProcessors : 1;
+	// Процессоры считаются по всем группам процессоров (в системе может быть больше 64 процессоров)
+	const size_t processorC = GetProcessorC(ALL_PROCESSOR_GROUPS);
+	logicalCoreC = processorC ? processorC : 1;
 	physicalCoreC = logicalCoreC;
 
+	// Функция GetLogicalProcessorInformation описывает только группу процессоров вызывающего потока. Считаем,
+	// что соотношение количества физических и логических ядер во всех группах такое же, как в ней
 	DWORD bufferSize = 0;
 	::GetLogicalProcessorInformation(nullptr, &bufferSize);
 	if (::GetLastError() == ERROR_INSUFFICIENT_BUFFER && bufferSize)
@@ -388,13 +566,43 @@ void SearchModeClasses::WorkThreads::GetCoreC(size_t& physicalCoreC, size_t& log
 				}
 				++pInfo;
 			}
-			physicalCoreC = coreC ? coreC : 1;
-			logicalCoreC = logicalC ? logicalC : 1;
-			if (logicalCoreC < physicalCoreC)
-				logicalCoreC = physicalCoreC;
+			if (coreC && logicalC >= coreC)
+				physicalCoreC = std::max(logicalCoreC * coreC / logicalC, size_t(1));
 		}
 		delete[] p;
 	}
+
+	// Количество логических процессоров, на которых разрешено выполняться рабочим потокам: заданных
+	// функцией BindToCPUs или, если она не вызывалась, разрешённых процессу (в пределах его группы)
+	size_t allowedC = 0;
+	if (!s_CPUGroups.empty())
+	{
+		std::vector<uint64_t> groupMasks(GetProcessorGroupC());
+		for (const auto& item : s_CPUGroups)
+			groupMasks[item.group] = item.mask;
+		for (auto mask : groupMasks)
+		{
+			for (; mask; mask >>= 1)
+				allowedC += (mask & 1) ? 1 : 0;
+		}
+	}
+	else if (GetProcessorGroupC() == 1)
+	{
+		DWORD_PTR processMask, systemMask;
+		if (::GetProcessAffinityMask(::GetCurrentProcess(), &processMask, &systemMask))
+		{
+			for (auto mask = processMask; mask; mask >>= 1)
+				allowedC += (mask & 1) ? 1 : 0;
+		}
+	}
+
+	// Если выполнение ограничено частью логических процессоров (например, функцией BindToCPUs), то
+	// считаем, что физических ядер среди них столько же, сколько в среднем приходится на всю систему
+	if (allowedC && allowedC < logicalCoreC)
+	{
+		physicalCoreC = std::max(physicalCoreC * allowedC / logicalCoreC, size_t(1));
+		logicalCoreC = allowedC;
+	}
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -404,8 +612,10 @@ void SearchModeClasses::WorkThreads::DoThread(size_t index)
 	info.isActive = true;
 	++m_ActiveC;
 
-	// Рабочий поток будет выполняться с наименьшим приоритетом
+	// Рабочий поток будет выполняться с наименьшим приоритетом. Группу процессоров 0-го элемента
+	// привязки (см. BindToCPUs) использует главный поток, поэтому рабочие потоки начинают с 1-го
 	::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_IDLE);
+	BindThread(index + 1);
 
 	info.lowLoadCounter = 0;
 	info.lastCPULoadTick = ::GetTickCount();
@@ -415,6 +625,8 @@ void SearchModeClasses::WorkThreads::DoThread(size_t index)
 	while (!info.isStopping && !m_Owner.IsCancelled())
 	{
 		bool hadWork = m_ThreadFn && m_ThreadFn(timer);
+		// Время CPU потока публикуется для оценки общей загруженности потоков в AreThreadsOverloaded
+		info.cpuTime.store(ThreadTime::GetCurrent(), std::memory_order_relaxed);
 		CheckThreadLoad(index, threadTime, hadWork);
 	}
 
@@ -472,15 +684,12 @@ void SearchModeClasses::WorkThreads::CheckThreadLoad(size_t index, ThreadTime& t
 				++info.lowLoadCounter;
 				if (info.lowLoadCounter >= 8 && !info.isStopping)
 				{
-					--m_ActiveC;
-					info.isActive = false;
-					::SuspendThread(::GetCurrentThread());
-					info.isActive = true;
-					++m_ActiveC;
+					ParkThread(info);
 
 					info.lowLoadCounter = 0;
 					info.lastCPULoadTick = ::GetTickCount();
 					info.lastCPULoadCounter = GetPerfCounter();
+					threadTime.Reset();
 				}
 			}
 			else if (cpuLoad >= hiGainA[activeThreadC])
@@ -489,21 +698,32 @@ void SearchModeClasses::WorkThreads::CheckThreadLoad(size_t index, ThreadTime& t
 	}
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+void SearchModeClasses::WorkThreads::ParkThread(ThreadInfo& info)
+{
+	std::unique_lock<std::mutex> lock(m_ParkMutex);
+	if (!info.isStopping)
+	{
+		--m_ActiveC;
+		info.isActive = false;
+		m_ParkCV.wait(lock, [&info]() { return info.isWakeRequested || info.isStopping; });
+		info.isWakeRequested = false;
+		info.isActive = true;
+		++m_ActiveC;
+	}
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 bool SearchModeClasses::WorkThreads::AreThreadsOverloaded()
 {
+	// Значения времени CPU потоков публикуются ими самими (см. DoThread), поэтому для
+	// потока, выполняющего длительное задание, они могут отставать на время этого задания
 	uint64_t totalCPUTime = 0;
 	for (size_t i = 0; i < m_TotalThreadC; ++i)
 	{
-		FILETIME t1, t2, tk, tu;
-		void* pOSHandle = m_ThreadA[i].threadObj.native_handle();
-		if (pOSHandle && ::GetThreadTimes(pOSHandle, &t1, &t2, &tk, &tu))
-		{
-			uint64_t cpuTime = (static_cast<uint64_t>(tk.dwHighDateTime) << 32) | tk.dwLowDateTime;
-			cpuTime += (static_cast<uint64_t>(tu.dwHighDateTime) << 32) | tu.dwLowDateTime;
-			totalCPUTime += cpuTime - m_ThreadTimeA[i];
-			m_ThreadTimeA[i] = cpuTime;
-		}
+		const uint64_t cpuTime = m_ThreadA[i].cpuTime.load(std::memory_order_relaxed);
+		totalCPUTime += cpuTime - m_ThreadTimeA[i];
+		m_ThreadTimeA[i] = cpuTime;
 	}
 
 	uint64_t freq, counter = GetPerfCounter(freq);
@@ -512,7 +732,7 @@ bool SearchModeClasses::WorkThreads::AreThreadsOverloaded()
 
 	// Вычисляем среднюю загрузку активных потоков в процентах. Считаем, что потоки
 	// перегружены, если средняя их загрузка в последнем интервале была не менее 85%
-	float cpuLoad = totalCPUTime / (100000.f * GetActiveC() * ticksElapsed / freq);
+	float cpuLoad = totalCPUTime / (10000.f * GetActiveC() * ticksElapsed / freq);
 	return cpuLoad >= 85;
 }
 
@@ -521,17 +741,247 @@ void SearchModeClasses::WorkThreads::WakeOneThread()
 {
 	if (GetActiveC() < m_TotalThreadC)
 	{
-		for (size_t i = 1; i < m_TotalThreadC; ++i)
+		bool isWakeRequested = false;
 		{
-			ThreadInfo& info = m_ThreadA[i];
-			if (!info.isActive && !info.isStopping)
+			std::lock_guard<std::mutex> lock(m_ParkMutex);
+			for (size_t i = 1; i < m_TotalThreadC; ++i)
+			{
+				ThreadInfo& info = m_ThreadA[i];
+				if (!info.isActive && !info.isStopping && !info.isWakeRequested)
+				{
+					info.isWakeRequested = true;
+					isWakeRequested = true;
+					break;
+				}
+			}
+		}
+		// Все приостановленные потоки ожидают на одной CV, но проснётся (выйдет из ожидания) только тот,
+		// которому установлен флаг. Пробуждения происходят не чаще 1 раза в 500ms, так что это не важно
+		if (isWakeRequested)
+			m_ParkCV.notify_all();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   SearchModeClasses::SiftTuner
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t SearchModeClasses::SiftTuner::GetSiftLength(size_t range) const
+{
+	// Отсев "работает" и при длине, большей длины кандидатов всего на 2 знака (см. GetSiftLength)
+	const int length = static_cast<int>(::GetSiftLength(range)) + m_Offset;
+	const int minLength = static_cast<int>(range + 2);
+	return static_cast<size_t>(std::clamp(length, minLength, static_cast<int>(GetMaxLength(range))));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SearchModeClasses::SiftTuner::SetSiftLength(size_t range, size_t siftLength)
+{
+	if (siftLength >= range + 2 && siftLength <= GetMaxLength(range))
+		m_Offset = static_cast<int>(siftLength) - static_cast<int>(::GetSiftLength(range));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SearchModeClasses::SiftTuner::StartRange(size_t range, size_t siftLength)
+{
+	m_Range = range;
+	m_SiftLength = siftLength;
+	m_SampleC = 0;
+	m_StepC = 0;
+	m_SiftHitC = 0;
+
+	// Наборы выборки очищаются в начале каждого диапазона, так как меняются и проверяемые длины, и ограничение
+	// на количество шагов. Память наборов недопустимых для диапазона длин освобождается
+	const size_t maxLength = GetMaxLength(range);
+	for (size_t i = 0; i < LENGTH_C; ++i)
+	{
+		Stat& stat = m_StatA[i];
+		const size_t length = siftLength + i - CURRENT;
+		stat.length = (length >= range + 2 && length <= maxLength) ? length : 0;
+		stat.checkC = stat.hitC = stat.mergeC = 0;
+		stat.hitSavedC = stat.mergeSavedC = 0;
+
+		if (!stat.length)
+			stat.pSet.reset();
+		else if (stat.pSet)
+			stat.pSet->Clear(false);
+		else
+			stat.pSet = std::make_unique<WideNumberSet>(false, false);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SearchModeClasses::SiftTuner::AddBlock(const NumberBlock& block)
+{
+	if (!m_SiftLength || block.id % SAMPLE_INTERVAL)
+		return;
+
+	m_SiftHitC += block.siftHitC;
+	for (auto& stat : m_StatA)
+	{
+		stat.lychrels.clear();
+		stat.blockNums.clear();
+	}
+
+	for (const NumberItem& item : block.numA)
+	{
+		if (!item.IsValid())
+			continue;
+
+		// Количество операций RAA над числом без отсева: до палиндрома или до ограничения на кол-во шагов. Отсеянные
+		// числа палиндромами не стали, поэтому для них это количество тоже равно ограничению stepLimit
+		const bool isLychrel = !item.IsPalindrome();
+		const unsigned totalStepC = isLychrel ? item.stepLimit : item.GetStepDoneC();
+		++m_SampleC;
+		m_StepC += totalStepC;
+
+		// Длины отсева проверяются по возрастанию, поэтому операции RAA над числом продолжаются от предыдущей длины
+		m_Num = item.num;
+		unsigned stepC = 0;
+		for (auto& stat : m_StatA)
+		{
+			if (!stat.length)
+				continue;
+
+			unsigned doneC = 0;
+			if (m_Num.RAATillLength(stat.length, doneC) || (stepC += doneC) >= totalStepC ||
+				m_Num.GetLength() > WideFixNumber::MAX_LENGTH)
 			{
-				if (void* pOSHandle = info.threadObj.native_handle())
-					::ResumeThread(pOSHandle);
 				break;
 			}
+
+			const WideFixNumber sifting(m_Num);
+			++stat.checkC;
+			if (stat.pSet->Exists(sifting))
+			{
+				++stat.hitC;
+				stat.hitSavedC += totalStepC - stepC;
+			}
+			else if (!stat.blockNums.insert(sifting).second)
+			{
+				++stat.mergeC;
+				stat.mergeSavedC += totalStepC - stepC;
+			}
+			if (isLychrel)
+				stat.lychrels.push_back(sifting);
 		}
 	}
+
+	// Как и в набор отсева, числа блока добавляются в наборы выборки после проверки всех чисел блока. Наборы
+	// очищаются одновременно, чтобы попадания в них для разных длин оставались сравнимыми
+	bool isFull = false;
+	for (auto& stat : m_StatA)
+		isFull |= stat.length && stat.pSet->GetSize() + stat.lychrels.size() > MAX_SAMPLE_C;
+
+	for (auto& stat : m_StatA)
+	{
+		if (!stat.length)
+			continue;
+		if (isFull)
+			stat.pSet->Clear(false);
+		for (const auto& num : stat.lychrels)
+			stat.pSet->Insert(num);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<std::string> SearchModeClasses::SiftTuner::FinishRange()
+{
+	std::vector<std::string> messages;
+	if (!m_StepC)
+		return messages;
+
+	// Попадания в наборы выборки масштабируются до попаданий в набор отсева (см. описание класса). Совпадения
+	// с числами того же блока не зависят от размера набора и учитываются как есть
+	const Stat& current = m_StatA[CURRENT];
+	const double scale = current.hitC ? static_cast<double>(m_SiftHitC) / current.hitC : 0;
+
+	size_t best = CURRENT;
+	double savedA[LENGTH_C] = {};
+	std::string siftedRates, savedRates;
+	for (size_t i = 0; i < LENGTH_C; ++i)
+	{
+		const Stat& stat = m_StatA[i];
+		if (!stat.length)
+			continue;
+
+		savedA[i] = stat.mergeSavedC + scale * stat.hitSavedC;
+		if (savedA[i] > savedA[best])
+			best = i;
+
+		const double siftedC = std::min(stat.mergeC + scale * stat.hitC, static_cast<double>(stat.checkC));
+		const char* pFormat = (i == CURRENT) ? "%s[%u] #15%.2f%%#3" : "%s%u #15%.2f%%#3";
+		const char* pSeparator = siftedRates.empty() ? "" : ", ";
+		const unsigned length = static_cast<unsigned>(stat.length);
+		siftedRates += util::Format(pFormat, pSeparator, length, stat.checkC ? 100.0 * siftedC / stat.checkC : 0.0);
+		savedRates += util::Format(pFormat, pSeparator, length, 100.0 * savedA[i] / m_StepC);
+	}
+
+	messages.push_back(util::Format("#3Sift tuning (%s numbers sampled), est. sifted checks by length: %s",
+		SeparateWithCommas(m_SampleC).c_str(), siftedRates.c_str()));
+	messages.push_back("#3Sift tuning, est. RAA steps saved by length: " + savedRates);
+
+	// Длина меняется не более чем на 1 за диапазон: оценки для далёких от текущей длин менее точны
+	if (current.hitC < MIN_HIT_C)
+		messages.push_back("#3Sift tuning: not enough samples, sift length is unchanged");
+	else if (best != CURRENT && savedA[best] - savedA[CURRENT] > MIN_GAIN * m_StepC)
+	{
+		SetSiftLength(m_Range, (best > CURRENT) ? m_SiftLength + 1 : m_SiftLength - 1);
+		messages.push_back(util::Format("#3Sift tuning: sift length offset changed to #15%+d", m_Offset));
+	}
+	return messages;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t SearchModeClasses::SiftTuner::GetMaxLength(size_t range)
+{
+	return (::GetSiftLength(range) > FixNumber::MAX_LENGTH) ? WideFixNumber::MAX_LENGTH : FixNumber::MAX_LENGTH;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   SiftFileHeader - заголовок файла снимка набора отсева
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Файл снимка состоит из заголовка и itemC записей функции Save набора ConcurrentNumberSet или фильтра
+// ConcurrentNumberFilter (в зависимости от поля isFilter). Снимок можно загрузить, только если длина чисел
+// в наборе (siftLength) и ограничение на количество шагов (stepLimit) совпадают с текущими. Поле range в
+// файлах, записанных до появления подбора длины отсева (SiftTuner), равно 0. В версии 2 изменился размер поколения
+// фильтра (и номера корзин в его записях), поэтому снимки фильтра версии 1 не загружаются
+
+//----------------------------------------------------------------------------------------------------------------------
+struct SiftFileHeader
+{
+	static constexpr uint32_t LATEST_VERSION = 2;
+
+	char signature[8] = { 'M', 'D', 'P', 'N', 'S', 'I', 'F', 'T' };
+	uint32_t version = LATEST_VERSION;	// Версия формата файла
+	uint32_t isFilter = 0;				// 1, если записи сделаны фильтром ConcurrentNumberFilter
+	uint32_t recordSize = 0;			// Размер одной записи в байтах
+	uint32_t siftLength = 0;			// Длина чисел в наборе отсева
+	uint32_t stepLimit = 0;				// Ограничение на кол-во шагов, с которым проверялись числа набора
+	uint32_t range = 0;					// Диапазон (длина кандидатов), в котором был сделан снимок
+	uint64_t itemC = 0;					// Количество записей
+	uint32_t dataCRC = 0;				// CRC32 всех записей
+	uint32_t headerCRC = 0;				// CRC32 заголовка (всех предыдущих полей)
+
+	uint32_t GetCRC() const { return hash::GetCRC32(this, offsetof(SiftFileHeader, headerCRC)); }
+
+	// Читает заголовок из файла file. Возвращает false, если заголовок повреждён или это не заголовок снимка
+	bool Read(util::BinaryFile& file);
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SiftFileHeader::Read(util::BinaryFile& file)
+{
+	const SiftFileHeader expected;
+	return file.Read(this, sizeof(SiftFileHeader)) && headerCRC == GetCRC() &&
+		(version == expected.version || (version == 1 && !isFilter)) &&
+		!memcmp(signature, expected.signature, sizeof(signature));
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -544,7 +994,6 @@ void SearchModeClasses::WorkThreads::WakeOneThread()
 SearchMode::SearchMode()
 	: m_WorkThreads(this)
 	, m_Tasks(m_WorkThreads)
-	, m_SiftSet(true)
 	, m_DBCS(300)
 {
 }
@@ -564,6 +1013,12 @@ bool SearchMode::Run()
 	{
 		m_IsExecuted = true;
 
+		if (!ParseOptions())
+		{
+			m_IsExecuted = false;
+			return false;
+		}
+
 		// Без параметров - продолжаем поиск чисел, начиная с самого последнего проверенного
 		// числа в базе данных. Если БД не существует (не найдена), то завершаемся с ошибкой
 		if (m_Params.empty())
@@ -579,7 +1034,7 @@ bool SearchMode::Run()
 			if (IsNumber(m_Params[1].c_str()))
 			{
 				const Number first = m_Params[1];
-				if (first && first.GetLength() <= Const::MAX_DIGIT_C - 2)
+				if (first && first.GetLength() <= Const::MAX_DIGIT_C)
 					return SlowSearch(true, first);
 			}
 		}
@@ -590,12 +1045,99 @@ bool SearchMode::Run()
 	return false;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+bool SearchMode::ParseOptions()
+{
+	if (!CheckOptions({ "threads", "affinity", "numa-node", "codec", "no-prefilter", "sift-tuning", "sift" }))
+		return false;
+
+	std::string value;
+	if (GetOption("threads", &value))
+	{
+		const unsigned long threadC = IsNumber(value.c_str()) ? strtoul(value.c_str(), nullptr, 10) : 0;
+		if (!threadC || threadC > SearchModeClasses::WorkThreads::MAX_THREAD_C)
+		{
+			OnInvalidCmdLine();
+			return false;
+		}
+		m_WorkThreadC = threadC;
+	}
+
+	if (GetOption("affinity", &value))
+	{
+		// Список состоит из номеров процессоров и их диапазонов, разделённых запятыми
+		std::vector<uint32_t> cpuA;
+		for (auto& item : util::Split(value, ","))
+		{
+			const size_t pos = item.find('-');
+			const std::string first = item.substr(0, pos);
+			const std::string last = (pos != std::string::npos) ? item.substr(pos + 1) : first;
+
+			if (!IsNumber(first.c_str()) || !IsNumber(last.c_str()) || first.size() > 4 || last.size() > 4)
+			{
+				OnInvalidCmdLine();
+				return false;
+			}
+			const uint32_t from = atoi(first.c_str()), to = atoi(last.c_str());
+			for (uint32_t cpu = from; cpu <= to; ++cpu)
+				cpuA.push_back(cpu);
+		}
+
+		if (cpuA.empty())
+		{
+			OnInvalidCmdLine();
+			return false;
+		}
+		if (!WorkThreads::BindToCPUs(cpuA))
+		{
+			aux::Printc("#12Error: #7failed to set CPU affinity\n");
+			return false;
+		}
+	}
+
+	if (GetOption("numa-node", &value))
+	{
+		// Память набора отсева будет размещаться на заданном узле NUMA
+		const bool isValid = IsNumber(value.c_str()) && value.size() <= 4;
+		const unsigned long node = isValid ? strtoul(value.c_str(), nullptr, 10) : ~0ul;
+		if (node >= LargeMemPages::GetNumaNodeC())
+		{
+			OnInvalidCmdLine();
+			return false;
+		}
+		LargeMemPages::SetNumaNode(static_cast<int>(node));
+	}
+
+	if (!ParseCodecOption())
+		return false;
+
+	m_UseSiftPrefilter = !GetOption("no-prefilter");
+	if (GetOption("sift-tuning"))
+		m_SiftTuner = std::make_unique<SiftTuner>();
+	bool useFilter = false;
+	if (GetOption("sift", &value))
+	{
+		useFilter = !util::StrInsCmp(value, "filter");
+		if (!useFilter && util::StrInsCmp(value, "set"))
+		{
+			OnInvalidCmdLine();
+			return false;
+		}
+	}
+
+	if (useFilter)
+		m_pSiftFilter = std::make_unique<ConcurrentNumberFilter>(true, -1, m_UseSiftPrefilter);
+	else
+		m_pSiftSet = std::make_unique<ConcurrentNumberSet>(true, -1, m_UseSiftPrefilter);
+	return true;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void SearchMode::CreateThreads()
 {
 	Assert(!m_WorkThreads.GetThreadC() && !m_pDBThread);
 
-	m_WorkThreads.CreateAll([this](ThreadTime& timer) { return DoNextTask(timer, true); });
+	m_WorkThreads.CreateAll([this](ThreadTime& timer) { return DoNextTask(timer, false); }, m_WorkThreadC);
 	m_pDBThread = new std::thread([this]() { DBThreadFN(); });
 }
 
@@ -611,6 +1153,7 @@ void SearchMode::KillThreads()
 			m_pDBThread->join();
 		AML_SAFE_DELETE(m_pDBThread);
 	}
+	WaitSiftSave();
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -677,7 +1220,6 @@ bool SearchMode::SlowSearch(bool createNewDb, const Number& startFrom)
 void SearchMode::DoSearch(const Number& firstNum)
 {
 	Assert(firstNum && firstNum.GetLength() <= Const::MAX_DIGIT_C);
-	m_SiftSetReaderC.store(1u << 31, std::memory_order_relaxed);
 
 	if (m_Data.HasGaps())
 	{
@@ -685,7 +1227,8 @@ void SearchMode::DoSearch(const Number& firstNum)
 			" has one or more unsearched gaps!", firstNum.GetLength()));
 	}
 
-	if (!m_SiftSet.IsLargePageEnabled())
+	if (!(m_pSiftFilter ? m_pSiftFilter->IsLargePageEnabled() : m_pWideSiftSet ? m_pWideSiftSet->IsLargePageEnabled() :
+		m_pSiftSet->IsLargePageEnabled()))
 	{
 		EventManager::PublishEvent("#12WARNING: #3Large page support is not enabled!");
 	}
@@ -700,23 +1243,38 @@ void SearchMode::DoSearch(const Number& firstNum)
 	BigNumber lastNum = firstNum - 1u;
 	size_t lastNumLength = firstNum.GetLength();
 
-	size_t conseqLen = 20;
-	if (lastNumLength + 4 > conseqLen)
+	// Длина числа, до достижения которой над ним выполняются операции RAA, прежде чем оно будет проверено
+	// на сходимость к одному из потоков уже проверенных чисел Лишрел (и добавлено в набор). Если снимок набора
+	// отсева был сделан в этом же диапазоне, то длина отсева, подобранная в прошлый раз, восстанавливается
+	if (m_SiftTuner)
+	{
+		util::BinaryFile file;
+		SiftFileHeader header;
+		const std::wstring path = m_Data.GetBasePath() + SIFT_FILE_NAME;
+		if (util::FileSystem::FileExists(path) && file.Open(path) && header.Read(file) && header.range == lastNumLength)
+			m_SiftTuner->SetSiftLength(lastNumLength, header.siftLength);
+	}
+	size_t conseqLen = GetRangeSiftLength(lastNumLength);
+	UpdateSiftKeys(conseqLen);
+
+	m_SiftRange = lastNumLength;
+	m_SiftLength = conseqLen;
+	m_SiftStepLimit = stepLimit;
+	if (m_SiftTuner)
+		m_SiftTuner->StartRange(lastNumLength, conseqLen);
+	m_SiftSaveTick = ::GetTickCount();
+	if (const size_t loadedC = LoadSiftSet())
 	{
-		// Длина числа, до достижения которой над ним выполняются операции RAA, прежде чем оно будет проверено
-		// на сходимость к одному из потоков уже проверенных чисел Лишрел (и добавлено в набор). Тестирование
-		// показало, что длины на 4 большей, чем длина тестируемых чисел, достаточно для эффективного отсева,
-		// а чем ниже будет это значение, тем быстрее будет происходить отсев. Значение не должно превышать
-		// максимальную длину чисел, хранимых в NumberSet (для FixNumber сейчас это 30 знаков)
-		conseqLen = std::min(lastNumLength + 4, Const::MAX_DIGIT_C);
+		m_Events->OnCustomEvent(util::Format("Sift set snapshot loaded (#15#%s#7 numbers)",
+			SeparateWithCommas(loadedC).c_str()));
 	}
 
-	uint64_t nextNewBlockId = 0, nextReadyBlockId = 0;
+	// Числа, загруженные из снимка набора отсева, имеют порядковый номер 0. Чтобы они участвовали в отсеве
+	// чисел всех блоков (номер должен быть меньше id блока), id блоков начинаются с 1
+	uint64_t nextNewBlockId = 1, nextReadyBlockId = 1;
 	size_t pendingTaskC = 0, pendingDBTaskC = 0;
-	std::vector<NumberBlock*> pendingWorks;
 	uint32_t lastTick = ::GetTickCount();
-	bool wait, checkPending = false;
-	bool rangeCompleted = false;
+	bool wait, rangeCompleted = false;
 
 	while (true)
 	{
@@ -725,49 +1283,19 @@ void SearchMode::DoSearch(const Number& firstNum)
 		// попробуем выполнить одно задание, предназначенное для рабочих потоков
 		wait = true;
 
-		// Первым делом проверим, есть ли задания в очереди готовых заданий и извлечём из неё
-		// самое первое (если есть). Если очередь пуста, то PopWork сразу вернёт управление
-		NumberBlock* pWork = m_Works.PopWork();
-		if (pWork)
-		{
-			--pendingTaskC;
-			// Если id задания не тот, которого мы ожидаем следующим, то
-			// поместим его в очередь ожидания, чтобы обработать позднее
-			if (pWork->id != nextReadyBlockId)
-			{
-				pendingWorks.push_back(pWork);
-				pWork = nullptr;
-			}
-		}
-
-		// Если новых готовых заданий нет, то проверим ожидающие обработки готовые задания, которые
-		// были получены в неверном порядке (раньше, чем те, которые должны быть обработаны первыми)
-		if (!pWork && checkPending)
-		{
-			// NB: используем линейный поиск в несортированном массиве, так как это быстрее всего.
-			// Среднее значение длины вектора будет близко к количеству рабочих потоков, а искомый
-			// элемент, если он присутствует в векторе, будет чаще находиться ближе к его началу
-			for (auto it = pendingWorks.begin(); it != pendingWorks.end(); ++it)
-			{
-				if ((*it)->id == nextReadyBlockId)
-				{
-					pWork = *it;
-					pendingWorks.erase(it);
-					break;
-				}
-			}
-			checkPending = false;
-		}
+		// Первым делом проверим, готово ли задание, которое должно быть обработано следующим. Задания
+		// извлекаются из очереди готовых заданий строго в порядке возрастания id (если следующее по
+		// порядку задание ещё не готово, то PopWork сразу вернёт nullptr)
+		NumberBlock* pWork = m_Works.PopWork(nextReadyBlockId);
 
 		// Если следующее по позрастанию id задание готово,
 		// то обработаем его и передадим дальше потоку БД
 		if (pWork)
 		{
-			ProcessWork(pWork, stepLimit);
 			pWork->cpuTime += threadTime.GetElapsed(true);
 			m_DBQueue.PushTask(pWork, stepLimit);
-			checkPending = !pendingWorks.empty();
 			++nextReadyBlockId;
+			--pendingTaskC;
 			++pendingDBTaskC;
 			wait = false;
 		}
@@ -796,30 +1324,46 @@ void SearchMode::DoSearch(const Number& firstNum)
 		}
 
 		// Если текущий диапазон был закончен, то ждём готовности оставшихся заданий
-		if (rangeCompleted && !(pendingTaskC + pendingWorks.size()) && !pendingDBTaskC)
+		if (rangeCompleted && !pendingTaskC && !pendingDBTaskC)
 		{
 			rangeCompleted = false;
+			// Набор отсева и параметры его снимка меняются ниже, поэтому запущенное сохранение снимка дождёмся
+			WaitSiftSave();
 			if (!OnRangeCompleted())
 				break;
 			Number next = lastNum + 1u;
 			lastNumLength = next.GetLength();
-			if (lastNumLength + 4 > conseqLen)
+			if (GetRangeSiftLength(lastNumLength) != conseqLen)
 			{
-				conseqLen = std::min(lastNumLength + 4, Const::MAX_DIGIT_C);
-				m_SiftSet.Clear(false);
+				conseqLen = GetRangeSiftLength(lastNumLength);
+				ClearSiftSet();
+				UpdateSiftKeys(conseqLen);
 			}
 			UpdateStepLimit(stepLimit, next);
+			m_SiftRange = lastNumLength;
+			m_SiftLength = conseqLen;
+			m_SiftStepLimit = stepLimit;
+			if (m_SiftTuner)
+				m_SiftTuner->StartRange(lastNumLength, conseqLen);
 		}
 
-		const size_t totalPendingC = pendingTaskC + pendingWorks.size();
 		const size_t threadC = std::max(m_WorkThreads.GetThreadC(), size_t(1));
+		// Количество заданий, которые ещё не были обработаны главным потоком, ограничено размерами
+		// очередей заданий и готовых заданий. Но при большом количестве рабочих потоков на каждый
+		// из них должно приходиться хотя бы несколько заданий
+		static_assert(WorkQueue::CAPACITY <= TaskQueue::CAPACITY);
+		const size_t maxPendingC = std::min(std::max(4 * threadC, size_t(192)), WorkQueue::CAPACITY);
 		// Если в очереди рабочих потоков недостаточно заданий, добавим ещё, но при условии, что в
 		// очередях готовых заданий и очереди БД нет большого количества скопившихся готовых заданий
-		if (!rangeCompleted && m_Tasks.GetTaskC() < 32 * threadC && totalPendingC < 192 && pendingDBTaskC < 128)
+		if (!rangeCompleted && m_Tasks.GetTaskC() < 32 * threadC && pendingTaskC < maxPendingC &&
+			pendingDBTaskC < 128)
 		{
 			NumberBlock* pNumBlock = GetNumberBlock();
 			pNumBlock->id = nextNewBlockId++;
 			pNumBlock->cpuTime = 0;
+			pNumBlock->siftCheckC = 0;
+			pNumBlock->siftHitC = 0;
+			pNumBlock->siftRejectC = 0;
 
 			for (size_t i = 0; i < NumberBlock::SIZE; ++i)
 			{
@@ -851,10 +1395,10 @@ void SearchMode::DoSearch(const Number& firstNum)
 		// Если мы ничего полезного не сделали (для диспетчера нет работы), и очередь готовых заданий пуста,
 		// то выполним следующее задание. Если заданий нет, то отдадим остаток тайм-слайса системе. Помимо
 		// задания будем освобождать каждый раз небольшое количество неиспользуемых блоков чисел
-		if (wait && !m_Works.HasWorks())
+		if (wait && !m_Works.HasWork(nextReadyBlockId))
 		{
 			ReleaseSurplusNumberBlocks(1);
-			if (!DoNextTask(threadTime, false))
+			if (!DoNextTask(threadTime, true))
 			{
 				ReleaseSurplusNumberBlocks(4);
 				::Sleep(0);
@@ -870,11 +1414,6 @@ void SearchMode::DoSearch(const Number& firstNum)
 		m_pDBThread->join();
 	}
 
-	// Если работа была прервана, то блоки чисел, находящиеся в pendingWorks, нужно
-	// переместить в m_NumBlocks, чтобы они были корректно уничтожены в деструкторе
-	for (NumberBlock* p : pendingWorks)
-		m_NumBlocks.push_back(p);
-
 	const uint32_t endTime = ::GetTickCount();
 	// К этому моменту поток БД уже завершился, поэтому нет необходимости
 	// захватывать критическую секцию m_DBCS для манипуляций с текущим файлом БД
@@ -883,6 +1422,9 @@ void SearchMode::DoSearch(const Number& firstNum)
 	// 1/8 обычного объёма данных, либо с момента последнего сохранения прошло не менее 30 секунд
 	if (m_Last > m_Data.GetLast() && (isEnoughData || endTime - m_LastSaveTick >= 30000))
 		SaveResults();
+	// Снимок набора отсева сохраняем всегда, чтобы при следующем запуске отсев сразу был эффективным
+	WaitSiftSave();
+	SaveSiftSet(m_NextBlockId);
 
 	bool newLine = m_Events->HasEvents(true);
 	m_Events->PublishAll();
@@ -899,16 +1441,40 @@ bool SearchMode::OnRangeCompleted()
 	m_Progress.progress = 0;
 	m_Events->OnRangeCompleted(m_Last.GetLength());
 
+	if (m_Progress.siftCheckC)
+	{
+		const double hitRate = 100.0 * m_Progress.siftHitC / m_Progress.siftCheckC;
+		m_Events->OnCustomEvent(util::Format("#3Sift hit rate: #15%.2f%%#3 of %s checks (%s)", hitRate,
+			SeparateWithCommas(m_Progress.siftCheckC).c_str(), m_pSiftFilter ? "filter" : "set"));
+		// Доля проверок, для которых не понадобилось обращаться к слотам набора отсева (их отклонили фильтры Блума
+		// поколений). Влияние фильтров на скорость поиска можно оценить, сравнив скорость с запуском с опцией
+		// --no-prefilter
+		if (m_UseSiftPrefilter)
+		{
+			const double rejectRate = 100.0 * m_Progress.siftRejectC / m_Progress.siftCheckC;
+			m_Events->OnCustomEvent(util::Format("#3Sift pre-filter rejected #15%.2f%%#3 of checks", rejectRate));
+		}
+	}
+	m_Progress.siftCheckC = 0;
+	m_Progress.siftHitC = 0;
+	m_Progress.siftRejectC = 0;
+
+	// Статистика подбора длины отсева. Новая длина (если она изменилась) применяется со следующего диапазона
+	if (m_SiftTuner)
+	{
+		for (const auto& message : m_SiftTuner->FinishRange())
+			m_Events->OnCustomEvent(message);
+	}
+
 	if (m_Last.GetLength() >= 3 && m_Last >= m_pActiveChunk->GetFirst())
 	{
 		SaveResults();
 		CreateNewChunk(m_Last + 1u);
 	}
 
-	// В принципе мы можем продолжить поиск вплоть до длины чисел Const::MAX_DIGIT_C. Но сейчас длина чисел,
-	// добавляемых в набор отсева, также ограничена этим значением (из-за ограничений FixNumber). И чтобы
-	// отсев "работал", длина чисел в наборе должна быть хотя бы на 2 знака больше, чем текущий диапазон
-	return m_Last.GetLength() < Const::MAX_DIGIT_C - 2;
+	// Поиск продолжается вплоть до длины чисел Const::MAX_DIGIT_C. Длина чисел набора отсева этим значением
+	// не ограничена: для диапазонов, в которых она больше 30 цифр, используются ключи WideFixNumber
+	return m_Last.GetLength() < Const::MAX_DIGIT_C;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -1031,6 +1597,116 @@ void SearchMode::SaveResults()
 	m_PublishEvents.store(true, std::memory_order_release);
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+void SearchMode::StartSiftSave()
+{
+	const uint32_t tick = ::GetTickCount();
+	if (tick - m_SiftSaveTick < Const::SIFT_SAVE_INTERVAL || m_IsSiftSaving.load(std::memory_order_acquire))
+		return;
+
+	// Снимок может занимать несколько GiB, поэтому он записывается отдельным потоком: поток БД продолжает
+	// обрабатывать результаты, а главный поток не ждёт окончания записи на критической секции m_DBCS
+	WaitSiftSave();
+	m_SiftSaveTick = tick;
+	m_IsSiftSaving.store(true, std::memory_order_relaxed);
+
+	const uint64_t maxOrder = m_NextBlockId;
+	m_pSiftSaveThread = new std::thread([this, maxOrder]() {
+		SaveSiftSet(maxOrder);
+		m_IsSiftSaving.store(false, std::memory_order_release);
+	});
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SearchMode::WaitSiftSave()
+{
+	if (m_pSiftSaveThread)
+	{
+		if (m_pSiftSaveThread->joinable())
+			m_pSiftSaveThread->join();
+		AML_SAFE_DELETE(m_pSiftSaveThread);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SearchMode::SaveSiftSet(uint64_t maxOrder)
+{
+	// Снимок записывается во временный файл, который затем заменяет предыдущий снимок. Сохраняются только
+	// числа блоков с id меньше maxOrder (уже обработанных потоком БД); числа, добавляемые рабочими потоками
+	// во время записи, могут быть не сохранены (набор отсева в любом случае может содержать не все числа).
+	const std::wstring path = m_Data.GetBasePath() + SIFT_FILE_NAME;
+	const std::wstring tmpPath = path + L".tmp";
+
+	SiftFileHeader header;
+	header.isFilter = m_pSiftFilter ? 1 : 0;
+	header.recordSize = static_cast<uint32_t>(GetSiftRecordSize());
+	header.siftLength = static_cast<uint32_t>(m_SiftLength);
+	header.stepLimit = m_SiftStepLimit;
+	header.range = static_cast<uint32_t>(m_SiftRange);
+
+	bool savedOk = false;
+	util::BinaryFile file;
+	if (file.Open(tmpPath, util::FILE_CREATE_ALWAYS | util::FILE_OPEN_READWRITE))
+	{
+		size_t itemC = 0;
+		if (file.Write(&header, sizeof(header)) && (m_pSiftFilter ? m_pSiftFilter->Save(file, maxOrder, itemC) :
+			m_pWideSiftSet ? m_pWideSiftSet->Save(file, maxOrder, itemC) : m_pSiftSet->Save(file, maxOrder, itemC)) &&
+			file.GetCRC32(header.dataCRC, sizeof(header)))
+		{
+			header.itemC = itemC;
+			header.headerCRC = header.GetCRC();
+			savedOk = file.SetPosition(0) && file.Write(&header, sizeof(header));
+		}
+		file.Close();
+	}
+
+	if (savedOk)
+	{
+		if (util::FileSystem::FileExists(path) && !util::FileSystem::RemoveFile(path))
+			return false;
+		return util::FileSystem::Rename(tmpPath, path);
+	}
+	util::FileSystem::RemoveFile(tmpPath);
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t SearchMode::LoadSiftSet()
+{
+	const std::wstring path = m_Data.GetBasePath() + SIFT_FILE_NAME;
+	if (!util::FileSystem::FileExists(path))
+		return 0;
+
+	util::BinaryFile file;
+	SiftFileHeader header, expected;
+	if (!file.Open(path) || !header.Read(file))
+		return 0;
+
+	// Снимок, сделанный набором другого типа или при других параметрах отсева, не используется
+	expected.isFilter = m_pSiftFilter ? 1 : 0;
+	expected.recordSize = static_cast<uint32_t>(GetSiftRecordSize());
+	if (header.isFilter != expected.isFilter || header.recordSize != expected.recordSize ||
+		header.siftLength != m_SiftLength || header.stepLimit != m_SiftStepLimit ||
+		file.GetSize() != static_cast<long long>(sizeof(header) + header.itemC * header.recordSize))
+	{
+		return 0;
+	}
+
+	uint32_t crc = 0;
+	if (!file.GetCRC32(crc, sizeof(header)) || crc != header.dataCRC || !file.SetPosition(sizeof(header)))
+		return 0;
+
+	const size_t itemC = static_cast<size_t>(header.itemC);
+	if (m_pSiftFilter ? m_pSiftFilter->Load(file, itemC) : m_pWideSiftSet ? m_pWideSiftSet->Load(file, itemC) :
+		m_pSiftSet->Load(file, itemC))
+	{
+		return itemC;
+	}
+
+	ClearSiftSet();
+	return 0;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 SearchMode::NumberBlock* SearchMode::GetNumberBlock()
 {
@@ -1060,40 +1736,6 @@ void SearchMode::ReleaseSurplusNumberBlocks(size_t count)
 	}
 }
 
-//----------------------------------------------------------------------------------------------------------------------
-void SearchMode::ProcessWork(NumberBlock* pWork, unsigned stepLimit)
-{
-	Assert(pWork && stepLimit >= 100);
-
-	m_SiftSetReaderC.fetch_and(~(1 << 31), std::memory_order_seq_cst);
-	for (size_t spinC = 0; m_SiftSetReaderC.load(std::memory_order_acquire);)
-	{
-		_mm_pause();
-		if (++spinC == 1000)
-		{
-			// В нормальном режиме (когда CPU не загружен на 100%, а потоки не вынуждены конкурировать)
-			// количество циклов обычно равно 10-25 (при неэффективном отсеве) и 400-450 (при максимально
-			// эффективном отсеве в конце диапазона). Поэтому после 1000 циклов отдаём управление системе
-			// и ждём сигнала (который появится, когда счётчик достигнет 0)
-			std::unique_lock<std::mutex> lock(m_SiftSetMutex);
-			m_SiftSetCV.wait(lock);
-			break;
-		}
-	}
-
-	for (size_t i = 0; i < NumberBlock::SIZE; ++i)
-	{
-		const NumberItem& item = pWork->numA[i];
-		if (item.stepDoneC >= stepLimit && !item.IsPalindrome())
-			m_SiftSet.Insert(item.sifting);
-	}
-
-	// Устанавливаем 31-бит, разрешая чтение. Здесь нет гарантии, что значение счётчика равно 0, так
-	// как рабочий поток мог, прочитав 1 в старшем бите, быть прерван. Он увеличит счётчик на 1, когда
-	// будет возобновлён (например непосредственно перед нашей попыткой установить 31-й бит)
-	m_SiftSetReaderC.fetch_or(1u << 31, std::memory_order_release);
-}
-
 //----------------------------------------------------------------------------------------------------------------------
 bool SearchMode::ProcessDBWork(NumberBlock* pWork)
 {
@@ -1117,56 +1759,360 @@ bool SearchMode::ProcessDBWork(NumberBlock* pWork)
 	}
 	m_Progress.counter += counter;
 	m_Progress.progress += counter;
+	m_Progress.siftCheckC += pWork->siftCheckC;
+	m_Progress.siftHitC += pWork->siftHitC;
+	m_Progress.siftRejectC += pWork->siftRejectC;
+
+	// Блоки передаются сюда в порядке возрастания id, как того требует SiftTuner
+	if (m_SiftTuner && !hasErrors)
+		m_SiftTuner->AddBlock(*pWork);
 	return !hasErrors;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-bool SearchMode::DoNextTask(ThreadTime& threadTime, bool waitIfNoTask)
+bool SearchMode::DoNextTask(ThreadTime& threadTime, bool isMainThread)
+{
+	// Все потоки, включая главный (владельца очереди заданий), берут самые старые задания: блоки обрабатываются
+	// примерно в порядке id, и главный поток не задерживает извлечение готовых блоков из очереди m_Works. Если
+	// заданий нет, то рабочий поток будет ждать их появления, а главный сразу вернётся к своему циклу
+	if (NumberBlock* pBlock = m_Tasks.StealTask(!isMainThread))
+	{
+		CheckNumbers(pBlock);
+		AddToSiftSet(pBlock);
+
+		pBlock->cpuTime += threadTime.GetElapsed(true);
+		m_Works.PushWork(pBlock);
+		return true;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SearchMode::CheckNumbers(NumberBlock* pBlock)
 {
-	if (NumberBlock* pBlock = m_Tasks.PopTask(waitIfNoTask))
+	// Обработка числа состоит из 2 этапов (как и в функции CheckNumber). 1-й этап - операции RAA до длины siftLength
+	// (функция SiftNumber) и проверка на отсев. Не отсеянные числа проходят 2-й этап (операции RAA до палиндрома
+	// или до достижения stepLimit) в группе чисел NumberBatch, по одному числу в каждой дорожке. Почти каждая
+	// проверка на отсев - это промах кеша, поэтому 1-й этап выполняется для всех чисел блока, после чего все
+	// полученные числа sifting проверяются одним пакетом: задержки обращений к набору отсева перекрываются
+
+	// Траектории соседних кандидатов часто сходятся до достижения длины siftLength (числа sifting равны), и
+	// тогда результаты 2-го этапа у них совпадают. Поэтому не отсеянные числа блока разбиваются на классы по
+	// числу sifting, и 2-й этап выполняется один раз для каждого класса: для его первого (ведущего) элемента
+	// с наибольшим количеством операций среди всех элементов класса. Затем результат распространяется на
+	// все элементы класса с учётом количества операций, допустимого для каждого из них
+	struct Class {
+		uint16_t leader = 0;	// Индекс ведущего элемента класса + 1 (0, если обработка завершена на 1-м этапе)
+		uint16_t stepC = 0;		// Для ведущего: наибольшее количество операций 2-го этапа в классе
+		uint32_t result = 0;	// Для ведущего: результат 2-го этапа (31-й бит - признак палиндрома)
+	};
+
+	struct Lane {
+		Class* pClass = nullptr;	// Класс, 2-й этап которого выполняется (nullptr, если дорожка свободна)
+		unsigned stepDoneC = 0;		// Количество операций RAA, выполненных на 2-м этапе
+		unsigned stepLeftC = 0;		// Количество операций, оставшихся до конца 2-го этапа
+	};
+
+	// Открытая хеш-таблица индексов (+ 1) ведущих элементов классов
+	constexpr size_t TABLE_SIZE = 4096;
+	static_assert(NumberBlock::SIZE < TABLE_SIZE && NumberBlock::SIZE < 65536);
+
+	Class classA[NumberBlock::SIZE];
+	uint16_t tableA[TABLE_SIZE] = {};
+
+	// Числа, которые нужно проверить на отсев, их индексы в блоке и количество операций 2-го этапа
+	WideFixNumber checkA[NumberBlock::SIZE];
+	uint16_t checkIndexA[NumberBlock::SIZE];
+	uint16_t checkStepA[NumberBlock::SIZE];
+	bool siftedA[NumberBlock::SIZE];
+
+	// NB: в неполных блоках (случается в конце диапазона), чисел будет меньше.
+	// Для "отсутствующих" элементов поля siftLength и stepLimit равны 0
+	size_t itemC = 0;
+	size_t checkC = 0;
+	for (; itemC < NumberBlock::SIZE && pBlock->numA[itemC].siftLength; ++itemC)
+	{
+		NumberItem& item = pBlock->numA[itemC];
+		if (const unsigned stepC = SiftNumber(item, *pBlock))
+		{
+			checkA[checkC] = item.sifting;
+			checkIndexA[checkC] = static_cast<uint16_t>(itemC);
+			checkStepA[checkC++] = static_cast<uint16_t>(stepC);
+		}
+	}
+	IsSifted(checkA, checkC, *pBlock, siftedA);
+
+	for (size_t c = 0; c < checkC; ++c)
 	{
-		BigNumber num;
-		for (size_t i = 0; i < NumberBlock::SIZE; ++i)
+		if (siftedA[c])
+			continue;
+
+		const size_t index = checkIndexA[c];
+		const NumberItem& item = pBlock->numA[index];
+		const uint16_t stepC = checkStepA[c];
+		for (size_t i = item.sifting.GetHash() & (TABLE_SIZE - 1);; i = (i + 1) & (TABLE_SIZE - 1))
 		{
-			NumberItem& item = pBlock->numA[i];
-			// NB: в неполных блоках (случается в конце диапазона), чисел будет меньше.
-			// Для "отсутствующих" элементов поля siftLength и stepLimit будут равны 0
-			if (!item.siftLength)
+			if (!tableA[i])
+			{
+				tableA[i] = static_cast<uint16_t>(index + 1);
+				classA[index].leader = tableA[i];
+				classA[index].stepC = stepC;
 				break;
+			}
 
-			num = item.num;
-			unsigned stepDoneC = 0;
-			if (num.RAATillLength(item.siftLength, stepDoneC))
-				stepDoneC |= 0x80000000;
-			else
+			if (pBlock->numA[tableA[i] - 1].sifting == item.sifting)
+			{
+				Class& leader = classA[tableA[i] - 1];
+				classA[index].leader = tableA[i];
+				leader.stepC = std::max(leader.stepC, stepC);
+				break;
+			}
+		}
+	}
+
+	// Время операции RAA над группой определяется длиной самого длинного числа в ней, и для длинных чисел функции
+	// BigNumber работают быстрее. Поэтому числа, длина которых достигла MAX_LENGTH, обрабатываются по одному
+	constexpr size_t MAX_LENGTH = 160;
+	static_assert(MAX_LENGTH < NumberBatch::MAX_LENGTH);
+
+	NumberBatch batch;
+	Lane laneA[NumberBatch::LANE_C];
+	BigNumber num;
+
+	size_t next = 0;
+	size_t activeC = 0;
+	for (;;)
+	{
+		// Заполняем свободные дорожки числами sifting очередных ведущих элементов классов
+		for (size_t lane = 0; lane < NumberBatch::LANE_C; ++lane)
+		{
+			for (; !laneA[lane].pClass && next < itemC; ++next)
 			{
-				item.sifting = num;
-				if (stepDoneC < item.stepLimit)
+				if (classA[next].leader == next + 1)
 				{
-					bool isSifted = false;
-					const uint32_t v = m_SiftSetReaderC.load(std::memory_order_relaxed) >> 31;
-					if (v && (m_SiftSetReaderC.fetch_add(v, std::memory_order_acquire) & (1 << 31)))
-						isSifted = m_SiftSet.Exists(item.sifting);
-					if (!m_SiftSetReaderC.fetch_sub(v, std::memory_order_release))
-						m_SiftSetCV.notify_one();
-
-					if (!isSifted)
-					{
-						item.stepDoneC += stepDoneC;
-						unsigned maxStepC = item.stepLimit - stepDoneC;
-						if (num.RAATillPalindrome(maxStepC, stepDoneC))
-							stepDoneC |= 0x80000000;
-					}
+					laneA[lane].pClass = &classA[next];
+					laneA[lane].stepDoneC = 0;
+					laneA[lane].stepLeftC = classA[next].stepC;
+
+					num = pBlock->numA[next].sifting;
+					batch.SetLane(lane, num);
+					++activeC;
 				}
 			}
+		}
+
+		if (!activeC)
+			break;
+
+		// Если длина какого-то из чисел достигла предела, то его обработку завершаем функциями BigNumber
+		if (batch.GetMaxLength() >= MAX_LENGTH)
+		{
+			for (size_t lane = 0; lane < NumberBatch::LANE_C; ++lane)
+			{
+				Lane& state = laneA[lane];
+				if (!state.pClass || batch.GetLength(lane) < MAX_LENGTH)
+					continue;
+
+				batch.GetLane(lane, num);
+				unsigned stepDoneC = 0;
+				if (num.RAATillPalindrome(state.stepLeftC, stepDoneC))
+					stepDoneC |= 0x80000000;
+				state.pClass->result = state.stepDoneC + stepDoneC;
+
+				batch.ClearLane(lane);
+				state.pClass = nullptr;
+				--activeC;
+			}
+			continue;
+		}
+
+		const uint32_t palMask = batch.ReverseAndAdd();
+		for (size_t lane = 0; lane < NumberBatch::LANE_C; ++lane)
+		{
+			Lane& state = laneA[lane];
+			if (!state.pClass)
+				continue;
+
+			++state.stepDoneC;
+			const bool isPalindrome = (palMask & (1u << lane)) != 0;
+			if (isPalindrome || !--state.stepLeftC)
+			{
+				state.pClass->result = isPalindrome ? state.stepDoneC | 0x80000000 : state.stepDoneC;
+				batch.ClearLane(lane);
+				state.pClass = nullptr;
+				--activeC;
+			}
+		}
+	}
+
+	// Распространяем результаты 2-го этапа на все элементы классов. Если ведущий элемент стал палиндромом
+	// за большее количество операций, чем допустимо для элемента, то для элемента палиндром не найден
+	for (size_t i = 0; i < itemC; ++i)
+	{
+		if (!classA[i].leader)
+			continue;
+
+		NumberItem& item = pBlock->numA[i];
+		const unsigned stepC = item.stepLimit - item.stepDoneC;
+		const uint32_t result = classA[classA[i].leader - 1].result;
+		const bool isPalindrome = (result & 0x80000000) && (result & ~0x80000000) <= stepC;
+		item.stepDoneC += isPalindrome ? result : stepC;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned SearchMode::SiftNumber(NumberItem& item, NumberBlock& block)
+{
+	// Число, которое может получиться на 1-м этапе, почти всегда помещается в 128 бит (32 цифры). Для очень
+	// коротких кандидатов при большом siftLength используется 256-битное число, а если не хватит и его, то
+	// число целиком (включая 2-й этап) будет обработано функцией CheckNumber
+	const size_t maxLength = ShortNumber<32>::GetRAALengthBound(item.num.GetLength(), item.siftLength);
+	if (maxLength <= 32)
+		return SiftNumber<32>(item, block);
+	if (maxLength <= 64)
+		return SiftNumber<64>(item, block);
+
+	BigNumber num;
+	num = item.num;
+	CheckNumber(item, num, block);
+	return 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t N>
+unsigned SearchMode::SiftNumber(NumberItem& item, NumberBlock& block)
+{
+	ShortNumber<N> num(item.num);
+	unsigned stepDoneC = 0;
+	if (num.RAATillLength(item.siftLength, stepDoneC))
+	{
+		item.stepDoneC += stepDoneC | 0x80000000;
+		return 0;
+	}
+
+	num.Get(item.sifting);
+	item.stepDoneC += stepDoneC;
+	return (stepDoneC < item.stepLimit) ? item.stepLimit - stepDoneC : 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SearchMode::CheckNumber(NumberItem& item, BigNumber& num, NumberBlock& block)
+{
+	unsigned stepDoneC = 0;
+	if (num.RAATillLength(item.siftLength, stepDoneC))
+		stepDoneC |= 0x80000000;
+	else
+	{
+		item.sifting = num;
+		if (stepDoneC < item.stepLimit && !IsSifted(item.sifting, block))
+		{
 			item.stepDoneC += stepDoneC;
+			unsigned maxStepC = item.stepLimit - stepDoneC;
+			if (num.RAATillPalindrome(maxStepC, stepDoneC))
+				stepDoneC |= 0x80000000;
 		}
+	}
+	item.stepDoneC += stepDoneC;
+}
 
-		pBlock->cpuTime += threadTime.GetElapsed(true);
-		m_Works.PushWork(pBlock);
-		return true;
+//----------------------------------------------------------------------------------------------------------------------
+bool SearchMode::IsSifted(const WideFixNumber& num, NumberBlock& block) const
+{
+	// Проверка выполняется пакетом из одного числа, так как количество
+	// отклонённых фильтром Блума проверок возвращают только функции ExistsBatch
+	bool isSifted;
+	IsSifted(&num, 1, block, &isSifted);
+	return isSifted;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SearchMode::IsSifted(const WideFixNumber* pNumA, size_t count, NumberBlock& block, bool* pResultA) const
+{
+	// Блок обрабатывается одним потоком, поэтому его счётчики можно изменять без синхронизации
+	size_t rejectC = 0;
+	if (m_pSiftFilter)
+		rejectC = m_pSiftFilter->ExistsBatch(pNumA, count, block.id, pResultA);
+	else if (m_pWideSiftSet)
+		rejectC = m_pWideSiftSet->ExistsBatch(pNumA, count, block.id, pResultA);
+	else
+	{
+		// Длина отсева не больше 30 цифр: числа преобразуются в ключи набора (FixNumber) частями по BATCH_C
+		constexpr size_t BATCH_C = 256;
+		FixNumber numA[BATCH_C];
+		for (size_t first = 0; first < count; first += BATCH_C)
+		{
+			const size_t n = std::min(count - first, BATCH_C);
+			for (size_t i = 0; i < n; ++i)
+				numA[i] = pNumA[first + i];
+			rejectC += m_pSiftSet->ExistsBatch(numA, n, block.id, pResultA + first);
+		}
 	}
-	return false;
+
+	block.siftCheckC += static_cast<uint32_t>(count);
+	block.siftRejectC += static_cast<uint32_t>(rejectC);
+	for (size_t i = 0; i < count; ++i)
+		block.siftHitC += pResultA[i] ? 1 : 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SearchMode::AddToSiftSet(const NumberBlock* pBlock)
+{
+	// Числа добавляются с порядковым номером, равным id блока, поэтому на отсев чисел блока влияют только числа
+	// из блоков с меньшими id (как и тогда, когда набор пополнялся главным потоком в порядке возрастания id).
+	// Все блоки с числами, добавленными в набор, обрабатываются с одним и тем же ограничением на кол-во шагов,
+	// так как оно меняется (а набор очищается) только тогда, когда не обрабатывается ни одного блока
+	for (size_t i = 0; i < NumberBlock::SIZE; ++i)
+	{
+		const NumberItem& item = pBlock->numA[i];
+		if (item.IsValid() && item.stepDoneC >= item.stepLimit && !item.IsPalindrome())
+		{
+			if (m_pSiftFilter)
+				m_pSiftFilter->Insert(item.sifting, pBlock->id);
+			else if (m_pWideSiftSet)
+				m_pWideSiftSet->Insert(item.sifting, pBlock->id);
+			else
+				m_pSiftSet->Insert(FixNumber(item.sifting), pBlock->id);
+		}
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SearchMode::ClearSiftSet()
+{
+	if (m_pSiftFilter)
+		m_pSiftFilter->Clear(false);
+	else if (m_pWideSiftSet)
+		m_pWideSiftSet->Clear(false);
+	else
+		m_pSiftSet->Clear(false);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t SearchMode::GetRangeSiftLength(size_t range) const
+{
+	return m_SiftTuner ? m_SiftTuner->GetSiftLength(range) : GetSiftLength(range);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SearchMode::UpdateSiftKeys(size_t siftLength)
+{
+	// Фильтр хранит только отпечатки чисел, которые не зависят от типа ключа, поэтому не заменяется. Набор
+	// m_pWideSiftSet подходит для любой длины отсева (в том числе уменьшенной SiftTuner), поэтому обратно
+	// не заменяется, и замена происходит не более 1 раза за всё время поиска
+	if (siftLength <= FixNumber::MAX_LENGTH || !m_pSiftSet)
+		return;
+
+	// Сначала освобождаем память прежнего набора, чтобы не держать в памяти оба набора одновременно
+	m_pSiftSet.reset();
+	m_pWideSiftSet = std::make_unique<WideConcurrentNumberSet>(true, -1, m_UseSiftPrefilter);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t SearchMode::GetSiftRecordSize() const
+{
+	if (m_pSiftFilter)
+		return ConcurrentNumberFilter::RECORD_SIZE;
+	return m_pWideSiftSet ? WideConcurrentNumberSet::RECORD_SIZE : ConcurrentNumberSet::RECORD_SIZE;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -1175,6 +2121,8 @@ void SearchMode::DBThreadFN()
 	// Поток базы данных должен иметь повышенный приоритет, чтобы гарантированно успевать
 	// обрабатывать и сжимать данные, приходящие от главного и (N-1) рабочих потоков
 	::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+	// Поток БД выполняется в той же группе процессоров, что и главный поток
+	WorkThreads::BindThread(0);
 
 	Number num;
 	BigNumber bigNum;
@@ -1192,6 +2140,7 @@ void SearchMode::DBThreadFN()
 			{
 				m_CPUTime += pWork->cpuTime;
 				m_Last = pWork->lastNum;
+				m_NextBlockId = pWork->id + 1;
 
 				for (size_t i = 0; i < NumberBlock::SIZE; ++i)
 				{
@@ -1264,6 +2213,10 @@ void SearchMode::DBThreadFN()
 						SaveResults();
 						CreateNewChunk(m_Last + 1u);
 					}
+					lock.Leave();
+
+					// Снимок набора отсева сохраняется реже результатов и без захвата m_DBCS
+					StartSiftSave();
 				}
 			}
 
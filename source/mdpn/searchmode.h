@@ -14,9 +14,12 @@
 #include <condition_variable>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <set>
+#include <string>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 
 class SearchMode;
@@ -42,6 +45,7 @@ protected:
 	class DBQueue;
 
 	class WorkThreads;
+	class SiftTuner;
 };
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -52,7 +56,7 @@ struct SearchModeClasses::NumberItem
 	uint16_t stepLimit = 0;		// Ограничение на количество шагов при проверке числа num на палиндром
 
 	FixNumber num;				// Исходное проверяемое число (кандидат)
-	FixNumber sifting;			// Результат операций RAA над num после достижения длины siftLength
+	WideFixNumber sifting;		// Результат операций RAA над num после достижения длины siftLength
 
 	void Clear();
 	// Возвращает true, если число было обработано, то есть если
@@ -74,6 +78,9 @@ struct SearchModeClasses::NumberBlock
 
 	uint64_t id = 0;			// Порядковый номер блока
 	uint64_t cpuTime = 0;		// Суммарное время (микросекунды), затраченное потоками на обработку блока
+	uint32_t siftCheckC = 0;	// Количество проверок чисел блока на отсев
+	uint32_t siftHitC = 0;		// Количество отсеянных чисел блока
+	uint32_t siftRejectC = 0;	// Количество проверок блока, отклонённых фильтром Блума набора отсева
 	Number lastNum;				// Последнее проверяемое число (кандидат) для блока
 	NumberItem numA[SIZE];		// Массив чисел для обработки
 };
@@ -112,38 +119,72 @@ protected:
 };
 
 //----------------------------------------------------------------------------------------------------------------------
-class SearchModeClasses::TaskQueue final : Queue
+class SearchModeClasses::TaskQueue final : AssertHelper<>
 {
+	AML_NONCOPYABLE(TaskQueue)
+
 public:
+	// Максимальное количество заданий в очереди (должно быть степенью 2)
+	static constexpr size_t CAPACITY = 4096;
+
 	TaskQueue(WorkThreads& workThreads);
+	~TaskQueue();
 
+	// Добавляет задание в конец очереди. Может вызываться только главным потоком (владельцем очереди)
 	void PushTask(NumberBlock* pBlock);
-	NumberBlock* PopTask(bool waitIfNoTask);
+	// Извлекает самое старое задание (может вызываться любым потоком). Если заданий нет, а параметр
+	// waitIfNoTask равен true, то поток будет ждать появления задания, но не дольше 35 ms
+	NumberBlock* StealTask(bool waitIfNoTask);
 
-	size_t GetTaskC() const { return m_TaskC.load(std::memory_order_relaxed); }
+	// Возвращает количество заданий в очереди (приблизительное, если очередь меняется другими потоками)
+	size_t GetTaskC() const;
 	void WakeThread(bool all = false);
 
 private:
+	NumberBlock* TrySteal(bool& isEmpty);
+
 	WorkThreads& m_WorkThreads;
+
+	// Очередь (deque) Чейза-Леви фиксированного размера. Владелец добавляет задания со стороны m_Bottom, а все
+	// потоки (включая владельца) извлекают их со стороны m_Top в порядке добавления: обработка блоков в обратном
+	// порядке задерживала бы их извлечение из кольцевого буфера WorkQueue. Синхронизация выполняется без
+	// блокировок: за задание со стороны m_Top потоки соревнуются с помощью CAS
+	std::unique_ptr<std::atomic<NumberBlock*>[]> m_Tasks;
+	alignas(64) std::atomic<int64_t> m_Top = 0;
+	alignas(64) std::atomic<int64_t> m_Bottom = 0;
+
+	// Мьютекс и CV используются только для ожидания заданий рабочими потоками
+	alignas(64) std::mutex m_Mutex;
 	std::condition_variable m_CV;
-	std::atomic<size_t> m_TaskC = 0;
 };
 
 //----------------------------------------------------------------------------------------------------------------------
-class SearchModeClasses::WorkQueue : protected Queue
+class SearchModeClasses::WorkQueue final : AssertHelper<>
 {
+	AML_NONCOPYABLE(WorkQueue)
+
 public:
-	void PushWork(NumberBlock* pBlock);
-	NumberBlock* PopWork();
+	// Максимальная разница id ещё не извлечённых блоков (должна быть степенью 2)
+	static constexpr size_t CAPACITY = 4096;
 
-	bool HasWorks() const { return m_HasWorks.load(std::memory_order_relaxed); }
+	WorkQueue();
+	~WorkQueue();
 
-protected:
-	std::atomic<bool> m_HasWorks = false;
+	// Помещает обработанный блок в ячейку кольцевого буфера, соответствующую его id. Может вызываться
+	// любым потоком; id всех блоков, находящихся в очереди, должны различаться меньше, чем на CAPACITY
+	void PushWork(NumberBlock* pBlock);
+	// Извлекает блок с номером id, если он уже помещён в очередь (иначе вернёт nullptr). Блоки
+	// извлекаются в порядке возрастания id. Может вызываться только одним потоком (главным)
+	NumberBlock* PopWork(uint64_t id);
+	// Возвращает true, если блок с номером id уже помещён в очередь
+	bool HasWork(uint64_t id) const;
+
+private:
+	std::unique_ptr<std::atomic<NumberBlock*>[]> m_Works;
 };
 
 //----------------------------------------------------------------------------------------------------------------------
-class SearchModeClasses::DBQueue final : public WorkQueue
+class SearchModeClasses::DBQueue final : protected Queue
 {
 public:
 	~DBQueue();
@@ -151,6 +192,9 @@ public:
 	void PushTask(NumberBlock* pBlock, unsigned stepLimit);
 	NumberBlock* PopTask(unsigned& stepLimit);
 
+	void PushWork(NumberBlock* pBlock);
+	NumberBlock* PopWork();
+
 	void WakeThread();
 
 private:
@@ -162,6 +206,7 @@ private:
 	std::deque<Item> m_Tasks;
 	std::condition_variable m_CV;
 	std::atomic<bool> m_HasTasks = false;
+	std::atomic<bool> m_HasWorks = false;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -176,6 +221,10 @@ class SearchModeClasses::WorkThreads final : AssertHelper<>
 	AML_NONCOPYABLE(WorkThreads)
 
 public:
+	// Максимальное количество рабочих потоков. Наборы отсева используются также главным потоком и служебными
+	// потоками (поток БД и др.), поэтому слотов ConcurrentSetBase должно хватать ещё как минимум на 3 потока
+	static constexpr size_t MAX_THREAD_C = 1024;
+
 	// Функция потока. Должна возвращать false, если для потока в
 	// данный момент нет заданий и он может быть деактивирован
 	using ThreadFn = std::function<bool(ThreadTime& timer)>;
@@ -193,29 +242,49 @@ public:
 	// которые необходимо создать (+), или число потоков, которые нужно остановить (-)
 	void AddRemove(int count);
 
-	void CreateAll(const ThreadFn& threadFn);
+	// Создаёт рабочие потоки. Если threadC равно 0, то количество потоков выбирается автоматически по количеству
+	// ядер процессора (из них учитываются только разрешённые функцией BindToCPUs), но не более MAX_THREAD_C
+	void CreateAll(const ThreadFn& threadFn, size_t threadC = 0);
 	void KillAll();
 
-private:
-	// Максимально возможное количество рабочих потоков. Теоритически может быть любым значением,
-	// реальное количество потоков будет ограничено количеством логических процессоров в системе
-	static constexpr size_t MAX_THREAD_C = 22;
+	// Ограничивает выполнение вызывающего (главного) потока и потоков, вызывающих функцию BindThread, набором
+	// логических процессоров cpuA (сквозные номера от 0 по всем группам процессоров). Должна вызываться до
+	// создания рабочих потоков
+	static bool BindToCPUs(const std::vector<uint32_t>& cpuA);
+	// Привязывает вызывающий поток к группе процессоров элемента index (по модулю количества процессоров) набора,
+	// заданного функцией BindToCPUs. Поток может выполняться в пределах только одной группы, поэтому потоки
+	// распределяются по группам пропорционально количеству выбранных в них процессоров
+	static bool BindThread(size_t index);
 
+private:
 	struct ThreadInfo {
 		std::thread threadObj;				// Объект потока
 		unsigned lowLoadCounter = 0;		// Счётчик интервалов с низкой загрузкой
 		uint32_t lastCPULoadTick = 0;		// Тик последней оценки загруженности потока
 		uint64_t lastCPULoadCounter = 0;	// Значение счётчика последней оценки загруженности
-		volatile bool isActive = false;		// true, если поток активен (false, если приостановлен)
-		volatile bool isStopping = false;	// true, если поток должен завершить работу
+		std::atomic<uint64_t> cpuTime = 0;	// Время CPU потока (мкс), обновляемое им после каждого задания
+		std::atomic<bool> isActive = false;	// true, если поток активен (false, если приостановлен)
+		std::atomic<bool> isStopping = false;	// true, если поток должен завершить работу
+		bool isWakeRequested = false;		// true, если приостановленный поток нужно разбудить (под m_ParkMutex)
+	};
+
+	// Группа процессоров и маска выбранных в ней процессоров для одного элемента набора BindToCPUs
+	struct CPUGroup {
+		uint16_t group;
+		uint64_t mask;
 	};
 
 	static uint64_t GetPerfCounter();
 	static uint64_t GetPerfCounter(uint64_t& frequency);
 	static void GetCoreC(size_t& physicalCoreC, size_t& logicalCoreC);
+	// Возвращают количество групп процессоров и количество процессоров в группе group (или во всех группах,
+	// если group равно ALL_PROCESSOR_GROUPS). До Windows 7 группа процессоров всегда одна
+	static uint16_t GetProcessorGroupC();
+	static size_t GetProcessorC(uint16_t group);
 
 	void DoThread(size_t index);
 	void CheckThreadLoad(size_t index, ThreadTime& threadTime, bool hadWork);
+	void ParkThread(ThreadInfo& info);
 	bool AreThreadsOverloaded();
 	void WakeOneThread();
 
@@ -225,9 +294,96 @@ private:
 	ThreadFn m_ThreadFn;					// Пользовательская функция рабочих потоков
 	size_t m_MaxThreadC = 0;				// Максимально возможное количество рабочих потоков
 	volatile size_t m_TotalThreadC = 0;		// Количество созданных (актуальных) рабочих потоков
-	ThreadInfo m_ThreadA[MAX_THREAD_C];		// Рабочие потоки (актуальные от [0] до [m_TotalThreadC - 1])
-	uint64_t m_ThreadTimeA[MAX_THREAD_C];	// Значения времени CPU потоков в последней оценке загруженности
+	// Рабочие потоки (актуальные от [0] до [m_TotalThreadC - 1]) и значения времени CPU потоков в последней
+	// оценке загруженности. Размер обоих массивов равен m_MaxThreadC (количеству логических процессоров)
+	std::unique_ptr<ThreadInfo[]> m_ThreadA;
+	std::unique_ptr<uint64_t[]> m_ThreadTimeA;
+	// Приостановленные рабочие потоки ожидают на m_ParkCV, пока им не будет установлен флаг isWakeRequested
+	// или isStopping (оба устанавливаются под m_ParkMutex). В отличие от приостановки потока средствами ОС
+	// поток паркуется только в точке, где он не удерживает никаких блокировок (между заданиями), и его
+	// пробуждение не может быть потеряно
+	std::mutex m_ParkMutex;
+	std::condition_variable m_ParkCV;
 	std::atomic<size_t> m_ActiveC = 0;		// Количество активных рабочих потоков в данных момент
+
+	static std::vector<CPUGroup> s_CPUGroups;	// Набор процессоров BindToCPUs (по элементу на процессор)
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   SearchModeClasses::SiftTuner - подбор длины отсева
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Для блоков выборки (каждого SAMPLE_INTERVAL-го блока) главный поток вычисляет числа, в которые превращаются
+// кандидаты при нескольких длинах отсева вокруг текущей, и проверяет их по собственным наборам выборки, куда
+// добавляются числа Лишрел только блоков выборки. Для каждой длины подсчитывается, сколько операций RAA сэкономил
+// бы отсев: у чисел, найденных в наборе выборки, и у чисел, совпавших с числом того же блока (такие числа проходят
+// 2-й этап обработки один раз, см. SearchMode::CheckNumbers). Набор выборки содержит лишь часть чисел Лишрел, и в
+// нём находится меньше чисел, чем в наборе отсева. Поэтому количество попаданий в него масштабируется отношением
+// количества отсеянных чисел блоков выборки к количеству попаданий в набор выборки для текущей длины. По завершении
+// диапазона поправка к длине отсева (относительно функции GetSiftLength) сдвигается на 1 в сторону длины с
+// наибольшей экономией операций, если выигрыш превышает MIN_GAIN от всех операций RAA над числами выборки
+
+// Подбор включается только опцией --sift-tuning. Подобранная длина отсева не сохраняется в файлах БД, а команды
+// "check" и "update" повторяют поиск с длиной GetSiftLength. Поэтому результаты повтора для файлов, записанных с
+// изменённой длиной, могут не совпасть с сохранёнными, и команда "check" сочтёт такие файлы повреждёнными
+
+//----------------------------------------------------------------------------------------------------------------------
+class SearchModeClasses::SiftTuner final
+{
+	AML_NONCOPYABLE(SiftTuner)
+
+public:
+	static constexpr uint64_t SAMPLE_INTERVAL = 64;		// В выборку входит каждый SAMPLE_INTERVAL-й блок (по id)
+
+	SiftTuner() = default;
+
+	// Возвращает длину отсева для диапазона range: длину GetSiftLength(range) с текущей поправкой
+	size_t GetSiftLength(size_t range) const;
+	// Устанавливает поправку так, чтобы длина отсева для диапазона range была равна siftLength (например, длине
+	// чисел снимка набора отсева). Длина, недопустимая для диапазона, игнорируется
+	void SetSiftLength(size_t range, size_t siftLength);
+
+	// Начинает сбор статистики для диапазона range, числа которого проверяются на отсев при длине siftLength
+	void StartRange(size_t range, size_t siftLength);
+	// Учитывает в статистике блок block, если он входит в выборку. Блоки передаются в порядке возрастания id
+	void AddBlock(const NumberBlock& block);
+	// Завершает сбор статистики для диапазона: сдвигает поправку к длине отсева, если это выгодно,
+	// и возвращает сообщения для журнала (пустой массив, если в выборку не попало ни одного числа)
+	std::vector<std::string> FinishRange();
+
+private:
+	static constexpr size_t LENGTH_C = 5;				// Количество проверяемых длин отсева
+	static constexpr size_t CURRENT = LENGTH_C / 2;		// Индекс текущей длины (проверяются длины ± 2)
+	static constexpr size_t MAX_SAMPLE_C = 1 << 19;		// Размер набора выборки, при котором все наборы очищаются
+	static constexpr uint64_t MIN_HIT_C = 64;			// Мин. кол-во попаданий в набор выборки для текущей длины
+	static constexpr double MIN_GAIN = 0.005;			// Мин. выигрыш (доля всех операций RAA) для смены длины
+
+	struct Stat {
+		size_t length = 0;			// Проверяемая длина отсева (0, если длина недопустима для диапазона)
+		uint64_t checkC = 0;		// Количество проверок на отсев
+		uint64_t hitC = 0;			// Количество попаданий в набор выборки
+		uint64_t mergeC = 0;		// Количество совпадений с числом того же блока
+		uint64_t hitSavedC = 0;		// Операции RAA, сэкономленные попаданиями в набор выборки
+		uint64_t mergeSavedC = 0;	// Операции RAA, сэкономленные совпадениями с числами того же блока
+		std::unique_ptr<WideNumberSet> pSet;			// Набор выборки (числа Лишрел блоков выборки)
+		std::vector<WideFixNumber> lychrels;			// Числа Лишрел текущего блока для добавления в набор
+		std::unordered_set<WideFixNumber, WideFixNumber::Hasher> blockNums;	// Числа текущего блока
+	};
+
+	// Возвращает наибольшую длину отсева для диапазона range. Поправка не переводит
+	// диапазон с наборов FixNumber на наборы WideFixNumber, расходующие вдвое больше памяти
+	static size_t GetMaxLength(size_t range);
+
+	Stat m_StatA[LENGTH_C];		// Статистика для длин отсева от m_SiftLength - CURRENT по возрастанию
+	size_t m_Range = 0;			// Текущий диапазон (длина кандидатов)
+	size_t m_SiftLength = 0;	// Длина отсева текущего диапазона
+	int m_Offset = 0;			// Поправка к длине отсева GetSiftLength(range)
+	uint64_t m_SampleC = 0;		// Количество чисел в выборке текущего диапазона
+	uint64_t m_StepC = 0;		// Количество операций RAA над числами выборки без отсева
+	uint64_t m_SiftHitC = 0;	// Количество чисел блоков выборки, отсеянных набором отсева
+	BigNumber m_Num;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -247,6 +403,9 @@ public:
 	bool IsCancelled() const { return m_IsCancelled; }
 
 private:
+	// Имя файла снимка набора отсева в каталоге БД
+	static constexpr const wchar_t* SIFT_FILE_NAME = L"siftset.bin";
+
 	struct Progress {
 		uint64_t counter = 0;		// Количество проверенных чисел с момента последнего вывода прогресса
 		uint64_t progress = 0;		// Полное количество проверенных чисел в текущем диапазоне
@@ -254,8 +413,19 @@ private:
 		uint32_t startTime = 0;		// Тик времени в момент начала работы (периодически обновляется)
 		uint32_t lastTick = 0;		// Тик, в котором прогресс выводился на экран в последний раз
 		float lastSpeed = 0;		// Последнее вычисленное значение скорости проверки чисел
+		uint64_t siftCheckC = 0;	// Количество проверок на отсев в текущем диапазоне
+		uint64_t siftHitC = 0;		// Количество отсеянных чисел в текущем диапазоне
+		uint64_t siftRejectC = 0;	// Количество проверок, отклонённых фильтром Блума, в текущем диапазоне
 	};
 
+	// Разбирает опции командной строки --threads=N (количество рабочих потоков), --affinity=<список>
+	// (номера логических процессоров, на которых будут выполняться все потоки, например, 0-15,32-47),
+	// --sift=set|filter (хранение набора отсева: числа целиком или их отпечатки, см. IsSifted),
+	// --numa-node=N (узел NUMA для памяти набора отсева; потоки к узлу не привязываются, см. --affinity),
+	// --no-prefilter (проверки на отсев без фильтра Блума, для сравнения скорости поиска),
+	// --sift-tuning (подбор длины отсева классом SiftTuner; без неё длина всегда равна GetSiftLength) и
+	// --codec=имя[:уровень] (алгоритм сжатия сохраняемых файлов БД, например, zstd:3 или lz4)
+	bool ParseOptions();
 	void CreateThreads();
 	void KillThreads();
 
@@ -272,23 +442,73 @@ private:
 	NumberBlock* GetNumberBlock();
 	void ReleaseSurplusNumberBlocks(size_t count);
 
-	void ProcessWork(NumberBlock* pWork, unsigned stepLimit);
 	bool ProcessDBWork(NumberBlock* pWork);
-	bool DoNextTask(ThreadTime& threadTime, bool waitIfNoTask);
+	bool DoNextTask(ThreadTime& threadTime, bool isMainThread);
+	// Обрабатывает все числа блока, выполняя операции RAA одновременно над группами чисел (NumberBatch)
+	void CheckNumbers(NumberBlock* pBlock);
+	// Выполняет операции RAA до длины siftLength (1-й этап обработки числа без проверки на отсев). Возвращает
+	// количество операций 2-го этапа (проверки на палиндром) или 0, если обработка числа уже завершена
+	unsigned SiftNumber(NumberItem& item, NumberBlock& block);
+	template<size_t N> unsigned SiftNumber(NumberItem& item, NumberBlock& block);
+	// Обрабатывает одно число блока block; num - копия исходного числа item.num
+	void CheckNumber(NumberItem& item, BigNumber& num, NumberBlock& block);
+	// Возвращает true, если число num было добавлено в набор отсева при обработке блока с id, меньшим id блока
+	// block, и обновляет счётчики проверок блока, в том числе счётчик проверок, отклонённых фильтром Блума без
+	// обращения к набору. Фильтр вмещает в ~2 раза больше чисел, чем набор ConcurrentNumberSet, но с вероятностью
+	// до 2^-35 на проверку может отсеять число ошибочно (и оно будет ошибочно признано числом Лишрел), поэтому
+	// по умолчанию используется набор
+	bool IsSifted(const WideFixNumber& num, NumberBlock& block) const;
+	// Выполняет проверку IsSifted для count чисел массива pNumA одним пакетом и записывает результаты в pResultA
+	void IsSifted(const WideFixNumber* pNumA, size_t count, NumberBlock& block, bool* pResultA) const;
+	// Добавляет в набор отсева числа sifting всех чисел Лишрел блока (достигших ограничения на кол-во шагов)
+	void AddToSiftSet(const NumberBlock* pBlock);
+	// Очищает набор отсева, не освобождая память. Не может выполняться одновременно с обработкой блоков
+	void ClearSiftSet();
+	// Возвращает длину отсева для диапазона range: подобранную SiftTuner или, если подбор отключён, GetSiftLength
+	size_t GetRangeSiftLength(size_t range) const;
+	// Заменяет набор m_pSiftSet пустым набором m_pWideSiftSet, если длина отсева siftLength больше, чем вмещает
+	// FixNumber (см. GetSiftLength). Не может выполняться одновременно с обработкой блоков
+	void UpdateSiftKeys(size_t siftLength);
+	// Возвращает размер записи снимка для текущего типа набора отсева
+	size_t GetSiftRecordSize() const;
+	// Сохраняет снимок набора отсева (числа блоков с id меньше maxOrder) в файл SIFT_FILE_NAME в каталоге
+	// БД. Функция может выполняться одновременно с обработкой блоков рабочими потоками
+	bool SaveSiftSet(uint64_t maxOrder);
+	// Запускает функцию SaveSiftSet в потоке m_pSiftSaveThread, если с предыдущего сохранения снимка прошло
+	// не менее Const::SIFT_SAVE_INTERVAL и предыдущее сохранение завершено. Вызывается потоком БД
+	void StartSiftSave();
+	// Ожидает завершения сохранения снимка, запущенного функцией StartSiftSave. Вызывается главным потоком,
+	// когда поток БД не обрабатывает задания (или уже завершён), до изменения набора отсева и его параметров
+	void WaitSiftSave();
+	// Загружает в набор отсева снимок, если он был сделан при текущих значениях m_SiftLength и m_SiftStepLimit.
+	// Возвращает количество загруженных чисел (0, если снимок отсутствует, повреждён или не подходит)
+	size_t LoadSiftSet();
 	void DBThreadFN();
 
 	WorkThreads m_WorkThreads;					// Рабочие потоки
+	size_t m_WorkThreadC = 0;					// Количество рабочих потоков (0 - выбирается автоматически)
 	std::thread* m_pDBThread = nullptr;			// Поток базы данных
+	std::thread* m_pSiftSaveThread = nullptr;	// Поток сохранения снимка набора отсева
 
 	std::vector<NumberBlock*> m_NumBlocks;		// Свободные блоки чисел
-	TaskQueue m_Tasks;							// Очередь FIFO для заданий
-	WorkQueue m_Works;							// Очередь FIFO для результатов
+	TaskQueue m_Tasks;							// Очередь заданий (work-stealing)
+	WorkQueue m_Works;							// Очередь результатов, упорядоченных по id блоков
 	DBQueue m_DBQueue;							// Очередь заданий сохранения результатов в БД
 
-	NumberSet m_SiftSet;						// Набор отсева чисел Лишрел
-	std::atomic<uint32_t> m_SiftSetReaderC = 0;	// Счётчик "читателей" набора m_SiftSet; 31-й бит == <можно читать>
-	std::condition_variable m_SiftSetCV;		// CV пробуждения главного потока при ожидании им записи в m_SiftSet
-	std::mutex m_SiftSetMutex;					// Мьютекс для m_SiftSetCV
+	// Набор отсева чисел Лишрел (порядковые номера чисел - id блоков). Создаётся либо набор m_pSiftSet
+	// (по умолчанию), либо фильтр m_pSiftFilter (--sift=filter). Когда длина отсева превышает 30 цифр,
+	// набор m_pSiftSet заменяется набором m_pWideSiftSet (см. UpdateSiftKeys)
+	std::unique_ptr<ConcurrentNumberSet> m_pSiftSet;
+	std::unique_ptr<WideConcurrentNumberSet> m_pWideSiftSet;
+	std::unique_ptr<ConcurrentNumberFilter> m_pSiftFilter;
+	bool m_UseSiftPrefilter = true;				// true, если проверки на отсев проходят через фильтр Блума
+	std::unique_ptr<SiftTuner> m_SiftTuner;		// Подбор длины отсева (nullptr, если подбор отключён)
+	volatile size_t m_SiftRange = 0;			// Диапазон (длина кандидатов), для которого задана m_SiftLength
+	volatile size_t m_SiftLength = 0;			// Текущая длина чисел в наборе отсева
+	volatile unsigned m_SiftStepLimit = 0;		// Текущее ограничение на кол-во шагов для чисел набора отсева
+	volatile uint32_t m_SiftSaveTick = 0;		// Тик последнего сохранения снимка набора отсева
+	std::atomic<bool> m_IsSiftSaving = false;	// true, пока поток m_pSiftSaveThread сохраняет снимок
+	volatile uint64_t m_NextBlockId = 0;		// id блока, следующего за последним обработанным потоком БД
 
 	thread::CriticalSection m_DBCS;				// Крит. секция для синхронизации с потоком БД
 	DBChunk* volatile m_pActiveChunk = nullptr;	// Текущий (активный) файл БД
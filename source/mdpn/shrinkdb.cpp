@@ -290,7 +290,7 @@ bool DBShrinker::SaveChunkAndUnload(DBChunk* chunk, size_t& compressedCount)
 			m_Data.Save(0u, 0, 0, true);
 			++compressedCount;
 		}
-		else if (!chunk->IsMaxCompressed())
+		else if (!chunk->IsMaxCompressed(m_Data.GetCodec()))
 		{
 			if (!LoadChunkFullData(chunk))
 				return false;
@@ -22,37 +22,46 @@ ThreadTime::~ThreadTime()
 //----------------------------------------------------------------------------------------------------------------------
 void ThreadTime::Reset()
 {
-	if (m_ThreadHandle)
+	if (uint64_t time = GetThreadTime())
+		m_Time = time;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t ThreadTime::GetElapsed(bool reset)
+{
+	if (uint64_t time = GetThreadTime())
 	{
-		FILETIME t1, t2, tk, tu;
-		if (::GetThreadTimes(m_ThreadHandle, &t1, &t2, &tk, &tu))
-		{
-			m_KernelTime = (static_cast<uint64_t>(tk.dwHighDateTime) << 32) | tk.dwLowDateTime;
-			m_UserTime = (static_cast<uint64_t>(tu.dwHighDateTime) << 32) | tu.dwLowDateTime;
-		}
+		uint64_t elapsed = (time - m_Time) / 10;
+		if (reset)
+			m_Time = time;
+
+		return elapsed;
 	}
+	return 0;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-uint64_t ThreadTime::GetElapsed(bool reset)
+uint64_t ThreadTime::GetCurrent()
 {
-	if (m_ThreadHandle)
+	FILETIME t1, t2, tk, tu;
+	if (::GetThreadTimes(::GetCurrentThread(), &t1, &t2, &tk, &tu))
+	{
+		uint64_t kernelTime = (static_cast<uint64_t>(tk.dwHighDateTime) << 32) | tk.dwLowDateTime;
+		uint64_t userTime = (static_cast<uint64_t>(tu.dwHighDateTime) << 32) | tu.dwLowDateTime;
+		return (kernelTime + userTime) / 10;
+	}
+	return 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t ThreadTime::GetThreadTime() const
+{
+	FILETIME t1, t2, tk, tu;
+	if (m_ThreadHandle && ::GetThreadTimes(m_ThreadHandle, &t1, &t2, &tk, &tu))
 	{
-		FILETIME t1, t2, tk, tu;
-		if (::GetThreadTimes(m_ThreadHandle, &t1, &t2, &tk, &tu))
-		{
-			uint64_t kernelTime = (static_cast<uint64_t>(tk.dwHighDateTime) << 32) | tk.dwLowDateTime;
-			uint64_t userTime = (static_cast<uint64_t>(tu.dwHighDateTime) << 32) | tu.dwLowDateTime;
-			uint64_t elapsed = (kernelTime + userTime - m_KernelTime - m_UserTime) / 10;
-
-			if (reset)
-			{
-				m_KernelTime = kernelTime;
-				m_UserTime = userTime;
-			}
-
-			return elapsed;
-		}
+		uint64_t kernelTime = (static_cast<uint64_t>(tk.dwHighDateTime) << 32) | tk.dwLowDateTime;
+		uint64_t userTime = (static_cast<uint64_t>(tu.dwHighDateTime) << 32) | tu.dwLowDateTime;
+		return kernelTime + userTime;
 	}
 	return 0;
 }
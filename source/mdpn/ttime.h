@@ -26,8 +26,13 @@ public:
 	// с момента последнего сброса или создания объекта класса
 	uint64_t GetElapsed(bool reset = false);
 
+	// Возвращает суммарное время работы вызывающего потока (в микросекундах) с момента его запуска
+	static uint64_t GetCurrent();
+
 protected:
-	void* m_ThreadHandle = nullptr;
-	uint64_t m_KernelTime = 0;
-	uint64_t m_UserTime = 0;
+	// Возвращает суммарное время работы потока в единицах по 100ns (0 в случае ошибки)
+	uint64_t GetThreadTime() const;
+
+	void* m_ThreadHandle = nullptr;		// Дескриптор потока
+	uint64_t m_Time = 0;				// Время работы потока в момент последнего сброса
 };
@@ -41,33 +41,29 @@ UpdateDBMode::UpdateDBMode()
 //----------------------------------------------------------------------------------------------------------------------
 bool UpdateDBMode::Run()
 {
-	if (!m_IsExecuted)
+	if (!m_IsExecuted && CheckOptions({ "skipgaps", "fromknown", "compress", "codec" }))
 	{
 		// Команда "update" - обновление существующих файлов БД и проверка пропущенных интервалов чисел.
-		// Опционально может быть указан один из параметров: "--skipgaps", "--fromknown" или "--compress"
-		if (m_Params.size() >= 1 && m_Params.size() <= 2 && !util::StrInsCmp(m_Params[0], "update"))
+		// Опционально может быть указана одна из опций: "--skipgaps", "--fromknown" или "--compress"
+		if (m_Params.size() == 1 && !util::StrInsCmp(m_Params[0], "update"))
 		{
-			bool okToGo = true;
-			if (m_Params.size() == 2)
+			// Опция "--skipgaps" отключает проверку всех
+			// непроверенных (пропущенных) интервалов чисел
+			m_DontFillGaps = GetOption("skipgaps");
+			// Опция "--fromknown" отключает только проверку пропущенного
+			// интервала перед первым существующим файлом базы данных
+			m_From1stKnown = GetOption("fromknown");
+			// Опция "--compress" заставляет пересохранить все файлы БД с максимально возможной степенью
+			// сжатия. Только при этом файлы переводятся в двоичный формат (DBChunkData::BINARY_FORMAT_VERSION)
+			m_MaxCompression = GetOption("compress");
+
+			if (m_DontFillGaps + m_From1stKnown + m_MaxCompression <= 1)
 			{
-				// Параметр "--skipgaps" отключает проверку всех
-				// непроверенных (пропущенных) интервалов чисел
-				if (!util::StrInsCmp(m_Params[1], "--skipgaps"))
-					m_DontFillGaps = true;
-				// Параметр "--fromknown" отключает только проверку пропущенного
-				// интервала перед первым существующим файлом базы данных
-				else if (!util::StrInsCmp(m_Params[1], "--fromknown"))
-					m_From1stKnown = true;
-				// Параметр "--compress" заставляет пересохранить все
-				// файлы БД с максимально возможной степенью сжатия
-				else if (!util::StrInsCmp(m_Params[1], "--compress"))
-					m_MaxCompression = true;
-				else
-					okToGo = false;
-			}
+				// Опция "--codec" задаёт алгоритм сжатия сохраняемых файлов. Вместе с "--compress"
+				// она позволяет пересжать все файлы БД другим алгоритмом (или с новым словарём)
+				if (!ParseCodecOption())
+					return false;
 
-			if (okToGo)
-			{
 				m_IsExecuted = true;
 				return UpdateDataBase();
 			}
@@ -216,7 +212,7 @@ float UpdateDBMode::UpdateAllChunks()
 			++toUpdateCount;
 		} else
 		{
-			if (chunk->IsMaxCompressed())
+			if (chunk->IsMaxCompressed(m_Data.GetCodec()))
 				++compressedCount;
 			size_t range = chunk->GetLast().GetLength();
 			if (range >= 4 && range <= Const::MAX_DIGIT_C)
@@ -385,13 +381,13 @@ float UpdateDBMode::CompressChunks(const std::vector<std::pair<DBChunk*, bool>>&
 			break;
 
 		DBChunk* chunk = item.first;
-		if (chunk->GetFormatVer() != DBChunkData::LATEST_FORMAT_VERSION || !chunk->GetMinSavedStep())
+		if (chunk->HasOldFormat() || !chunk->GetMinSavedStep())
 		{
 			++chunksSkipped;
 			EventManager::PublishEvent(util::Format("Skipped file %s, because of old format",
 				chunk->GetFilePath().c_str()));
 		}
-		else if (chunk->IsMaxCompressed())
+		else if (chunk->IsMaxCompressed(m_Data.GetCodec()))
 		{
 			++chunksSkipped;
 		} else
@@ -460,9 +456,7 @@ void UpdateDBMode::DoSearch(const Number& startFrom, const Number& target, Known
 	if ((lastNum + 1u).GetLength() > lastNumLength)
 		++lastNumLength;
 
-	size_t conseqLen = 20;
-	if (lastNumLength + 4 > conseqLen)
-		conseqLen = std::min(lastNumLength + 4, Const::MAX_DIGIT_C);
+	size_t conseqLen = GetSiftLength(lastNumLength);
 
 	uint64_t testedCount = 0;
 	for (auto nextKnown = known.numbers.cbegin();; ++m_Progress.counter)
@@ -490,10 +484,11 @@ void UpdateDBMode::DoSearch(const Number& startFrom, const Number& target, Known
 				testedCount = 0;
 			}
 			lastNumLength = lastNum.GetLength();
-			if (lastNumLength + 4 > conseqLen)
+			if (GetSiftLength(lastNumLength) != conseqLen)
 			{
-				conseqLen = std::min(lastNumLength + 4, Const::MAX_DIGIT_C);
+				conseqLen = GetSiftLength(lastNumLength);
 				m_LychThreads.Clear(false);
+				m_WideLychThreads.Clear(false);
 			}
 			stepLimit = m_Steps->GetSearchLimit(lastNumLength);
 			known.searchDepth = stepLimit;
@@ -509,7 +504,8 @@ void UpdateDBMode::DoSearch(const Number& startFrom, const Number& target, Known
 			if (nextKnown != known.numbers.end() && lastNum == nextKnown->num)
 				++nextKnown;
 		}
-		else if (!m_LychThreads.Exists(current))
+		else if (conseqLen > FixNumber::MAX_LENGTH ? !m_WideLychThreads.Exists(current) :
+			!m_LychThreads.Exists(current))
 		{
 			if (nextKnown != known.numbers.end() && lastNum == nextKnown->num)
 			{
@@ -526,7 +522,12 @@ void UpdateDBMode::DoSearch(const Number& startFrom, const Number& target, Known
 					totalStepsDone += stepsDone;
 				}
 				if (!isPalindrome)
-					m_LychThreads.Insert(cnum);
+				{
+					if (conseqLen > FixNumber::MAX_LENGTH)
+						m_WideLychThreads.Insert(cnum);
+					else
+						m_LychThreads.Insert(cnum);
+				}
 			}
 		}
 
@@ -767,10 +768,9 @@ bool UpdateDBMode::NeedsUpdate(const DBChunk* chunk) const
 	Assert(m_Steps && chunk);
 
 	const size_t digitC = chunk->GetFirst().GetLength();
-	// В самых первых версиях формата v5 (используемого сейчас) не сохранялось поле MINSTEP (я решил
-	// не менять версию формата, при загрузке БД этот параметр вычисляется, а здесь я добавил проверку),
-	// поэтому если это поле отсутствует в чанке, то его необходимо обновить
-	static_assert(DBChunkData::LATEST_FORMAT_VERSION == 5, "Remove obsolete condition below. See comment above");
+	// В самых первых версиях формата v5 не сохранялось поле MINSTEP (я решил не менять версию формата,
+	// при загрузке БД этот параметр вычисляется, а здесь я добавил проверку), поэтому если это поле
+	// отсутствует в чанке, то его необходимо обновить. Файлы версий 3 и 4 обновляются всегда
 	return chunk->HasOldFormat() || !chunk->GetMinSavedStep() ||
 		GetMinSavedStep(chunk) > m_Steps->GetMinSaveable(digitC);
 }
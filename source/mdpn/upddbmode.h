@@ -77,6 +77,7 @@ private:
 
 private:
 	NumberSet m_LychThreads;
+	WideNumberSet m_WideLychThreads;	// Набор отсева для длины отсева больше 30 цифр (см. GetSiftLength)
 	DBChunk* m_activeChunk = nullptr;	// Текущий (активный) чанк (файл БД)
 
 	Progress m_Progress;				// Параметры для отслеживания прогресса проверки чисел
@@ -151,6 +151,26 @@ bool DecompressFile(util::File& src, util::File& dst)
 	return res == Z_STREAM_END;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//   Функция GetFileInfo
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//----------------------------------------------------------------------------------------------------------------------
+bool GetFileInfo(const std::wstring& path, uint64_t& fileSize, uint64_t& lastWriteTime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attrData;
+	if (::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attrData))
+	{
+		fileSize = (static_cast<uint64_t>(attrData.nFileSizeHigh) << 32) | attrData.nFileSizeLow;
+		lastWriteTime = (static_cast<uint64_t>(attrData.ftLastWriteTime.dwHighDateTime) << 32) |
+			attrData.ftLastWriteTime.dwLowDateTime;
+		return true;
+	}
+	return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //   Прочие функции
@@ -234,6 +254,17 @@ float GetRangeProgress(size_t range, uint64_t count)
 		count * invTotalA[range] : 0;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+size_t GetSiftLength(size_t range)
+{
+	// Тестирование показало, что длины на 4 большей, чем длина тестируемых чисел, достаточно для эффективного
+	// отсева, а чем ниже будет это значение, тем быстрее будет происходить отсев. Но отсев "работает" и при
+	// длине, большей всего на 2 знака, поэтому для диапазонов 27 и 28 используется длина 30: числа этой длины
+	// ещё помещаются в FixNumber, а наборы таких чисел расходуют почти вдвое меньше памяти
+	const size_t length = std::max(range + 4, size_t(20));
+	return (length > FixNumber::MAX_LENGTH && range + 2 <= FixNumber::MAX_LENGTH) ? FixNumber::MAX_LENGTH : length;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 static AML_NOINLINE std::string SeparateWithCommas(const char* pStr, size_t size, char separator)
 {
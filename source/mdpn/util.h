@@ -22,6 +22,10 @@ bool CompressFile(util::File& src, util::File& dst, int level = 5);
 // позиции до конца файла) и сохраняет их в файл dst, начиная с текущей позиции
 bool DecompressFile(util::File& src, util::File& dst);
 
+// Возвращает размер файла path и дату/время его последней модификации средствами ОС.
+// Если файл не существует или информацию получить не удалось, функция вернёт false
+bool GetFileInfo(const std::wstring& path, uint64_t& fileSize, uint64_t& lastWriteTime);
+
 // Возвращает true, если pStr содержит только цифры. Если
 // pStr указывает на пустую строку, функция вернёт false
 bool IsNumber(const char* pStr);
@@ -35,6 +39,11 @@ bool ConvertToNumber(std::wstring_view s, Number& number);
 // количеству чисел, подлежащих проверке в указанном диапазоне range
 float GetRangeProgress(size_t range, uint64_t count);
 
+// Возвращает длину отсева для чисел длиной range цифр: длину, до достижения которой над числом выполняются
+// операции RAA, прежде чем оно будет проверено на сходимость к уже проверенным числам Лишрел. Если длина
+// больше FixNumber::MAX_LENGTH, то числа отсева хранятся в наборах с ключами WideFixNumber
+size_t GetSiftLength(size_t range);
+
 // Форматирует число, разделяя группы цифр указанным символом
 std::string SeparateWithCommas(uint64_t number, char separator = ',');
 std::string SeparateWithCommas(const Number& number, char separator = ',');